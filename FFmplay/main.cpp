@@ -1,3804 +1,7750 @@
-
-#include <cassert>
-#include <string>
-#include <codecvt>
-#include <thread>
-#include <mutex>
-#include <condition_variable>
-#include <future>
-#include <memory>
-
-extern "C"
-{
-    #include "config.h"
-    #include <inttypes.h>
-    #include <math.h>
-    #include <limits.h>
-    #include <signal.h>
-    #include <stdint.h>
-    
-    #include "libavutil/avstring.h"
-    #include "libavutil/eval.h"
-    #include "libavutil/mathematics.h"
-    #include "libavutil/pixdesc.h"
-    #include "libavutil/imgutils.h"
-    #include "libavutil/dict.h"
-    #include "libavutil/parseutils.h"
-    #include "libavutil/samplefmt.h"
-    #include "libavutil/avassert.h"
-    #include "libavutil/time.h"
-    #include "libavformat/avformat.h"
-    #include "libavdevice/avdevice.h"
-    #include "libswscale/swscale.h"
-    #include "libavutil/opt.h"
-    #include "libavcodec/avfft.h"
-    #include "libswresample/swresample.h"
-    
-    #if CONFIG_AVFILTER
-    # include "libavfilter/avfilter.h"
-    # include "libavfilter/buffersink.h"
-    # include "libavfilter/buffersrc.h"
-    #endif
-    
-    #include <SDL.h>
-    #include <SDL_thread.h>
-    
-    #include "cmdutils.h"
-}
-
-#include <assert.h>
-
-const char program_name[] = "ffplay";
-const int program_birth_year = 2003;
-
-#define MAX_QUEUE_SIZE (15 * 1024 * 1024)
-#define MIN_FRAMES 25
-#define EXTERNAL_CLOCK_MIN_FRAMES 2
-#define EXTERNAL_CLOCK_MAX_FRAMES 10
-
-/* Minimum SDL audio buffer size, in samples. */
-#define SDL_AUDIO_MIN_BUFFER_SIZE 512
-/* Calculate actual buffer size keeping in mind not cause too frequent audio callbacks */
-#define SDL_AUDIO_MAX_CALLBACKS_PER_SEC 30
-
-/* Step size for volume control in dB */
-#define SDL_VOLUME_STEP (0.75)
-
-/* no AV sync correction is done if below the minimum AV sync threshold */
-#define AV_SYNC_THRESHOLD_MIN 0.04
-/* AV sync correction is done if above the maximum AV sync threshold */
-#define AV_SYNC_THRESHOLD_MAX 0.1
-/* If a frame duration is longer than this, it will not be duplicated to compensate AV sync */
-#define AV_SYNC_FRAMEDUP_THRESHOLD 0.1
-/* no AV correction is done if too big error */
-#define AV_NOSYNC_THRESHOLD 10.0
-
-/* maximum audio speed change to get correct sync */
-#define SAMPLE_CORRECTION_PERCENT_MAX 10
-
-/* external clock speed adjustment constants for realtime sources based on buffer fullness */
-#define EXTERNAL_CLOCK_SPEED_MIN  0.900
-#define EXTERNAL_CLOCK_SPEED_MAX  1.010
-#define EXTERNAL_CLOCK_SPEED_STEP 0.001
-
-/* we use about AUDIO_DIFF_AVG_NB A-V differences to make the average */
-#define AUDIO_DIFF_AVG_NB   20
-
-/* polls for possible required screen refresh at least this often, should be less than 1/fps */
-#define REFRESH_RATE 0.01
-
-/* NOTE: the size must be big enough to compensate the hardware audio buffersize size */
-/* TODO: We assume that a decoded and resampled frame fits into this buffer */
-#define SAMPLE_ARRAY_SIZE (8 * 65536)
-
-#define CURSOR_HIDE_DELAY 1000000
-
-#define USE_ONEPASS_SUBTITLE_RENDER 1
-
-static unsigned sws_flags = SWS_BICUBIC;
-
-typedef struct MyAVPacketList {
-    AVPacket pkt;
-    struct MyAVPacketList* next;
-    int serial;
-} MyAVPacketList;
-
-typedef struct PacketQueue {
-    MyAVPacketList* first_pkt, * last_pkt;
-    int nb_packets;
-    int size;
-    int64_t duration;
-    int abort_request;
-    int serial;
-    SDL_mutex* mutex;
-    SDL_cond* cond;
-} PacketQueue;
-
-#define VIDEO_PICTURE_QUEUE_SIZE 3
-#define SUBPICTURE_QUEUE_SIZE 16
-#define SAMPLE_QUEUE_SIZE 9
-#define FRAME_QUEUE_SIZE FFMAX(SAMPLE_QUEUE_SIZE, FFMAX(VIDEO_PICTURE_QUEUE_SIZE, SUBPICTURE_QUEUE_SIZE))
-
-typedef struct AudioParams {
-    int freq;
-    int channels;
-    int64_t channel_layout;
-    enum AVSampleFormat fmt;
-    int frame_size;
-    int bytes_per_sec;
-} AudioParams;
-
-typedef struct Clock {
-    double pts;           /* clock base */
-    double pts_drift;     /* clock base minus time at which we updated the clock */
-    double last_updated;
-    double speed;
-    int serial;           /* clock is based on a packet with this serial */
-    int paused;
-    int* queue_serial;    /* pointer to the current packet queue serial, used for obsolete clock detection */
-} Clock;
-
-/* Common struct for handling all types of decoded data and allocated render buffers. */
-typedef struct Frame {
-    AVFrame* frame;
-    AVSubtitle sub;
-    int serial;
-    double pts;           /* presentation timestamp for the frame */
-    double duration;      /* estimated duration of the frame */
-    int64_t pos;          /* byte position of the frame in the input file */
-    int width;
-    int height;
-    int format;
-    AVRational sar;
-    int uploaded;
-    int flip_v;
-} Frame;
-
-typedef struct FrameQueue {
-    Frame queue[FRAME_QUEUE_SIZE];
-    int rindex;
-    int windex;
-    int size;
-    int max_size;
-    int keep_last;
-    int rindex_shown;
-    SDL_mutex* mutex;
-    SDL_cond* cond;
-    PacketQueue* pktq;
-} FrameQueue;
-
-enum {
-    AV_SYNC_AUDIO_MASTER, /* default choice */
-    AV_SYNC_VIDEO_MASTER,
-    AV_SYNC_EXTERNAL_CLOCK, /* synchronize to an external clock */
-};
-
-typedef struct Decoder {
-    AVPacket pkt;
-    PacketQueue* queue;
-    AVCodecContext* avctx;
-    int pkt_serial;
-    int finished;
-    int packet_pending;
-    SDL_cond* empty_queue_cond;
-    int64_t start_pts;
-    AVRational start_pts_tb;
-    int64_t next_pts;
-    AVRational next_pts_tb;
-    SDL_Thread* decoder_tid;
-} Decoder;
-
-class FMediaPlayer 
-{
-public:
-    enum struct EShowMode : Uint8
-    {
-        SHOW_MODE_NONE = 0, SHOW_MODE_VIDEO, SHOW_MODE_WAVES, SHOW_MODE_RDFT, SHOW_MODE_NB
-    } eShow_mode;
-
-public:
-    SDL_Thread* read_tid;
-    AVInputFormat* iformat;
-    int abort_request;
-    int force_refresh;
-    int paused;
-    int last_paused;
-    int queue_attachments_req;
-    int seek_req;
-    int seek_flags;
-    int64_t seek_pos;
-    int64_t seek_rel;
-    int read_pause_return;
-    AVFormatContext* ic;
-    int realtime;
-
-    Clock audclk;
-    Clock vidclk;
-    Clock extclk;
-
-    FrameQueue pictq;
-    FrameQueue subpq;
-    FrameQueue sampq;
-
-    Decoder auddec;
-    Decoder viddec;
-    Decoder subdec;
-
-    int audio_stream;
-
-    int av_sync_type;
-
-    double audio_clock;
-    int audio_clock_serial;
-    double audio_diff_cum; /* used for AV difference average computation */
-    double audio_diff_avg_coef;
-    double audio_diff_threshold;
-    int audio_diff_avg_count;
-    AVStream* audio_st;
-    PacketQueue audioq;
-    int audio_hw_buf_size;
-    uint8_t* audio_buf;
-    uint8_t* audio_buf1;
-    unsigned int audio_buf_size; /* in bytes */
-    unsigned int audio_buf1_size;
-    int audio_buf_index; /* in bytes */
-    int audio_write_buf_size;
-    int audio_volume;
-    int muted;
-    struct AudioParams audio_src;
-#if CONFIG_AVFILTER
-    struct AudioParams audio_filter_src;
-#endif
-    struct AudioParams audio_tgt;
-    struct SwrContext* swr_ctx;
-    int frame_drops_early;
-    int frame_drops_late;
-
-    int16_t sample_array[SAMPLE_ARRAY_SIZE];
-    int sample_array_index;
-    int last_i_start;
-    RDFTContext* rdft;
-    int rdft_bits;
-    FFTSample* rdft_data;
-    int xpos;
-    double last_vis_time;
-    SDL_Texture* vis_texture;
-    SDL_Texture* sub_texture;
-    SDL_Texture* vid_texture;
-
-    int subtitle_stream;
-    AVStream* subtitle_st;
-    PacketQueue subtitleq;
-
-    double frame_timer;
-    double frame_last_returned_time;
-    double frame_last_filter_delay;
-    int video_stream;
-    AVStream* video_st;
-    PacketQueue videoq;
-    double max_frame_duration;      // maximum duration of a frame - above this, we consider the jump a timestamp discontinuity
-    struct SwsContext* img_convert_ctx;
-    struct SwsContext* sub_convert_ctx;
-    int eof;
-
-    char* filename;
-    int width, height, xleft, ytop;
-    int step;
-
-#if CONFIG_AVFILTER
-    int vfilter_idx;
-    AVFilterContext* in_video_filter;   // the first filter in the video chain
-    AVFilterContext* out_video_filter;  // the last filter in the video chain
-    AVFilterContext* in_audio_filter;   // the first filter in the audio chain
-    AVFilterContext* out_audio_filter;  // the last filter in the audio chain
-    AVFilterGraph* agraph;              // audio filter graph
-#endif
-
-    int last_video_stream, last_audio_stream, last_subtitle_stream;
-
-    SDL_cond* continue_read_thread;
-};
-
-/* options specified by the user */
-static AVInputFormat* file_iformat;
-static const char* input_filename;
-static const char* window_title;
-static int default_width = 640;
-static int default_height = 480;
-static int screen_width = 0;
-static int screen_height = 0;
-static int screen_left = SDL_WINDOWPOS_CENTERED;
-static int screen_top = SDL_WINDOWPOS_CENTERED;
-static int audio_disable;
-static int video_disable;
-static int subtitle_disable;
-static const char* wanted_stream_spec[AVMEDIA_TYPE_NB] = { 0 };
-static int seek_by_bytes = -1;
-static float seek_interval = 10;
-static int display_disable;
-static int borderless;
-static int alwaysontop;
-static int startup_volume = 100;
-static int show_status = 1;
-static int av_sync_type = AV_SYNC_AUDIO_MASTER;
-static int64_t start_time = AV_NOPTS_VALUE;
-static int64_t duration = AV_NOPTS_VALUE;
-static int fast = 0;
-static int genpts = 0;
-static int lowres = 0;
-static int decoder_reorder_pts = -1;
-static int autoexit;
-static int exit_on_keydown;
-static int exit_on_mousedown;
-static int loop = 1;
-static int framedrop = -1;
-static int infinite_buffer = -1;
-static FMediaPlayer::EShowMode show_mode = FMediaPlayer::EShowMode::SHOW_MODE_NONE;
-static const char* audio_codec_name;
-static const char* subtitle_codec_name;
-static const char* video_codec_name;
-double rdftspeed = 0.02;
-static int64_t cursor_last_shown;
-static int cursor_hidden = 0;
-#if CONFIG_AVFILTER
-static const char** vfilters_list = NULL;
-static int nb_vfilters = 0;
-static char* afilters = NULL;
-#endif
-static int autorotate = 1;
-static int find_stream_info = 1;
-static int filter_nbthreads = 0;
-
-/* current context */
-static int is_full_screen;
-static int64_t audio_callback_time;
-
-static AVPacket flush_pkt;
-
-#define FF_QUIT_EVENT    (SDL_USEREVENT + 2)
-
-static SDL_Window* window;
-static SDL_Renderer* renderer;
-static SDL_RendererInfo renderer_info = { 0 };
-static SDL_AudioDeviceID audio_dev;
-
-static const struct TextureFormatEntry {
-    enum AVPixelFormat format;
-    int texture_fmt;
-} sdl_texture_format_map[] = {
-    { AV_PIX_FMT_RGB8,           SDL_PIXELFORMAT_RGB332 },
-    { AV_PIX_FMT_RGB444,         SDL_PIXELFORMAT_RGB444 },
-    { AV_PIX_FMT_RGB555,         SDL_PIXELFORMAT_RGB555 },
-    { AV_PIX_FMT_BGR555,         SDL_PIXELFORMAT_BGR555 },
-    { AV_PIX_FMT_RGB565,         SDL_PIXELFORMAT_RGB565 },
-    { AV_PIX_FMT_BGR565,         SDL_PIXELFORMAT_BGR565 },
-    { AV_PIX_FMT_RGB24,          SDL_PIXELFORMAT_RGB24 },
-    { AV_PIX_FMT_BGR24,          SDL_PIXELFORMAT_BGR24 },
-    { AV_PIX_FMT_0RGB32,         SDL_PIXELFORMAT_RGB888 },
-    { AV_PIX_FMT_0BGR32,         SDL_PIXELFORMAT_BGR888 },
-    { AV_PIX_FMT_NE(RGB0, 0BGR), SDL_PIXELFORMAT_RGBX8888 },
-    { AV_PIX_FMT_NE(BGR0, 0RGB), SDL_PIXELFORMAT_BGRX8888 },
-    { AV_PIX_FMT_RGB32,          SDL_PIXELFORMAT_ARGB8888 },
-    { AV_PIX_FMT_RGB32_1,        SDL_PIXELFORMAT_RGBA8888 },
-    { AV_PIX_FMT_BGR32,          SDL_PIXELFORMAT_ABGR8888 },
-    { AV_PIX_FMT_BGR32_1,        SDL_PIXELFORMAT_BGRA8888 },
-    { AV_PIX_FMT_YUV420P,        SDL_PIXELFORMAT_IYUV },
-    { AV_PIX_FMT_YUYV422,        SDL_PIXELFORMAT_YUY2 },
-    { AV_PIX_FMT_UYVY422,        SDL_PIXELFORMAT_UYVY },
-    { AV_PIX_FMT_NONE,           SDL_PIXELFORMAT_UNKNOWN },
-};
-
-#if CONFIG_AVFILTER
-static int opt_add_vfilter(void* optctx, const char* opt, const char* arg)
-{
-    GROW_ARRAY(vfilters_list, nb_vfilters);
-    vfilters_list[nb_vfilters - 1] = arg;
-    return 0;
-}
-#endif
-
-static inline
-int cmp_audio_fmts(enum AVSampleFormat fmt1, int64_t channel_count1,
-    enum AVSampleFormat fmt2, int64_t channel_count2)
-{
-    /* If channel count == 1, planar and non-planar formats are the same */
-    if (channel_count1 == 1 && channel_count2 == 1)
-        return av_get_packed_sample_fmt(fmt1) != av_get_packed_sample_fmt(fmt2);
-    else
-        return channel_count1 != channel_count2 || fmt1 != fmt2;
-}
-
-static inline
-int64_t get_valid_channel_layout(int64_t channel_layout, int channels)
-{
-    if (channel_layout && av_get_channel_layout_nb_channels(channel_layout) == channels)
-        return channel_layout;
-    else
-        return 0;
-}
-
-static int packet_queue_put_private(PacketQueue* q, AVPacket* pkt)
-{
-    MyAVPacketList* pkt1;
-
-    if (q->abort_request)
-        return -1;
-
-    pkt1 = static_cast<MyAVPacketList*>(av_malloc(sizeof(MyAVPacketList)));
-    if (!pkt1)
-        return -1;
-    pkt1->pkt = *pkt;
-    pkt1->next = NULL;
-    if (pkt == &flush_pkt)
-        q->serial++;
-    pkt1->serial = q->serial;
-
-    if (!q->last_pkt)
-        q->first_pkt = pkt1;
-    else
-        q->last_pkt->next = pkt1;
-    q->last_pkt = pkt1;
-    q->nb_packets++;
-    q->size += pkt1->pkt.size + sizeof(*pkt1);
-    q->duration += pkt1->pkt.duration;
-    /* XXX: should duplicate packet data in DV case */
-    SDL_CondSignal(q->cond);
-    return 0;
-}
-
-static int packet_queue_put(PacketQueue* q, AVPacket* pkt)
-{
-    int ret;
-
-    SDL_LockMutex(q->mutex);
-    ret = packet_queue_put_private(q, pkt);
-    SDL_UnlockMutex(q->mutex);
-
-    if (pkt != &flush_pkt && ret < 0)
-        av_packet_unref(pkt);
-
-    return ret;
-}
-
-static int packet_queue_put_nullpacket(PacketQueue* q, int stream_index)
-{
-    AVPacket pkt1, * pkt = &pkt1;
-    av_init_packet(pkt);
-    pkt->data = NULL;
-    pkt->size = 0;
-    pkt->stream_index = stream_index;
-    return packet_queue_put(q, pkt);
-}
-
-/* packet queue handling */
-static int packet_queue_init(PacketQueue* q)
-{
-    memset(q, 0, sizeof(PacketQueue));
-    q->mutex = SDL_CreateMutex();
-    if (!q->mutex) {
-        av_log(NULL, AV_LOG_FATAL, "SDL_CreateMutex(): %s\n", SDL_GetError());
-        return AVERROR(ENOMEM);
-    }
-    q->cond = SDL_CreateCond();
-    if (!q->cond) {
-        av_log(NULL, AV_LOG_FATAL, "SDL_CreateCond(): %s\n", SDL_GetError());
-        return AVERROR(ENOMEM);
-    }
-    q->abort_request = 1;
-    return 0;
-}
-
-static void packet_queue_flush(PacketQueue* q)
-{
-    MyAVPacketList* pkt, * pkt1;
-
-    SDL_LockMutex(q->mutex);
-    for (pkt = q->first_pkt; pkt; pkt = pkt1) {
-        pkt1 = pkt->next;
-        av_packet_unref(&pkt->pkt);
-        av_freep(&pkt);
-    }
-    q->last_pkt = NULL;
-    q->first_pkt = NULL;
-    q->nb_packets = 0;
-    q->size = 0;
-    q->duration = 0;
-    SDL_UnlockMutex(q->mutex);
-}
-
-static void packet_queue_destroy(PacketQueue* q)
-{
-    packet_queue_flush(q);
-    SDL_DestroyMutex(q->mutex);
-    SDL_DestroyCond(q->cond);
-}
-
-static void packet_queue_abort(PacketQueue* q)
-{
-    SDL_LockMutex(q->mutex);
-
-    q->abort_request = 1;
-
-    SDL_CondSignal(q->cond);
-
-    SDL_UnlockMutex(q->mutex);
-}
-
-static void packet_queue_start(PacketQueue* q)
-{
-    SDL_LockMutex(q->mutex);
-    q->abort_request = 0;
-    packet_queue_put_private(q, &flush_pkt);
-    SDL_UnlockMutex(q->mutex);
-}
-
-/* return < 0 if aborted, 0 if no packet and > 0 if packet.  */
-static int packet_queue_get(PacketQueue* q, AVPacket* pkt, int block, int* serial)
-{
-    MyAVPacketList* pkt1;
-    int ret;
-
-    SDL_LockMutex(q->mutex);
-
-    for (;;) {
-        if (q->abort_request) {
-            ret = -1;
-            break;
-        }
-
-        pkt1 = q->first_pkt;
-        if (pkt1) {
-            q->first_pkt = pkt1->next;
-            if (!q->first_pkt)
-                q->last_pkt = NULL;
-            q->nb_packets--;
-            q->size -= pkt1->pkt.size + sizeof(*pkt1);
-            q->duration -= pkt1->pkt.duration;
-            *pkt = pkt1->pkt;
-            if (serial)
-                *serial = pkt1->serial;
-            av_free(pkt1);
-            ret = 1;
-            break;
-        }
-        else if (!block) {
-            ret = 0;
-            break;
-        }
-        else {
-            SDL_CondWait(q->cond, q->mutex);
-        }
-    }
-    SDL_UnlockMutex(q->mutex);
-    return ret;
-}
-
-static void decoder_init(Decoder* d, AVCodecContext* avctx, PacketQueue* queue, SDL_cond* empty_queue_cond) {
-    memset(d, 0, sizeof(Decoder));
-    d->avctx = avctx;
-    d->queue = queue;
-    d->empty_queue_cond = empty_queue_cond;
-    d->start_pts = AV_NOPTS_VALUE;
-    d->pkt_serial = -1;
-}
-
-static int decoder_decode_frame(Decoder* d, AVFrame* frame, AVSubtitle* sub) {
-    int ret = AVERROR(EAGAIN);
-
-    for (;;) {
-        AVPacket pkt;
-
-        if (d->queue->serial == d->pkt_serial) {
-            do {
-                if (d->queue->abort_request)
-                    return -1;
-
-                switch (d->avctx->codec_type) {
-                case AVMEDIA_TYPE_VIDEO:
-                    ret = avcodec_receive_frame(d->avctx, frame);
-                    if (ret >= 0) {
-                        if (decoder_reorder_pts == -1) {
-                            frame->pts = frame->best_effort_timestamp;
-                        }
-                        else if (!decoder_reorder_pts) {
-                            frame->pts = frame->pkt_dts;
-                        }
-                    }
-                    break;
-                case AVMEDIA_TYPE_AUDIO:
-                    ret = avcodec_receive_frame(d->avctx, frame);
-                    if (ret >= 0) {
-                        AVRational tb = AVRational{ 1, frame->sample_rate };
-                        if (frame->pts != AV_NOPTS_VALUE)
-                            frame->pts = av_rescale_q(frame->pts, d->avctx->pkt_timebase, tb);
-                        else if (d->next_pts != AV_NOPTS_VALUE)
-                            frame->pts = av_rescale_q(d->next_pts, d->next_pts_tb, tb);
-                        if (frame->pts != AV_NOPTS_VALUE) {
-                            d->next_pts = frame->pts + frame->nb_samples;
-                            d->next_pts_tb = tb;
-                        }
-                    }
-                    break;
-                }
-                if (ret == AVERROR_EOF) {
-                    d->finished = d->pkt_serial;
-                    avcodec_flush_buffers(d->avctx);
-                    return 0;
-                }
-                if (ret >= 0)
-                    return 1;
-            } while (ret != AVERROR(EAGAIN));
-        }
-
-        do {
-            if (d->queue->nb_packets == 0)
-                SDL_CondSignal(d->empty_queue_cond);
-            if (d->packet_pending) {
-                av_packet_move_ref(&pkt, &d->pkt);
-                d->packet_pending = 0;
-            }
-            else {
-                if (packet_queue_get(d->queue, &pkt, 1, &d->pkt_serial) < 0)
-                    return -1;
-            }
-        } while (d->queue->serial != d->pkt_serial);
-
-        if (pkt.data == flush_pkt.data) {
-            avcodec_flush_buffers(d->avctx);
-            d->finished = 0;
-            d->next_pts = d->start_pts;
-            d->next_pts_tb = d->start_pts_tb;
-        }
-        else {
-            if (d->avctx->codec_type == AVMEDIA_TYPE_SUBTITLE) {
-                int got_frame = 0;
-                ret = avcodec_decode_subtitle2(d->avctx, sub, &got_frame, &pkt);
-                if (ret < 0) {
-                    ret = AVERROR(EAGAIN);
-                }
-                else {
-                    if (got_frame && !pkt.data) {
-                        d->packet_pending = 1;
-                        av_packet_move_ref(&d->pkt, &pkt);
-                    }
-                    ret = got_frame ? 0 : (pkt.data ? AVERROR(EAGAIN) : AVERROR_EOF);
-                }
-            }
-            else {
-                if (avcodec_send_packet(d->avctx, &pkt) == AVERROR(EAGAIN)) {
-                    av_log(d->avctx, AV_LOG_ERROR, "Receive_frame and send_packet both returned EAGAIN, which is an API violation.\n");
-                    d->packet_pending = 1;
-                    av_packet_move_ref(&d->pkt, &pkt);
-                }
-            }
-            av_packet_unref(&pkt);
-        }
-    }
-}
-
-static void decoder_destroy(Decoder* d) {
-    av_packet_unref(&d->pkt);
-    avcodec_free_context(&d->avctx);
-}
-
-static void frame_queue_unref_item(Frame* vp)
-{
-    av_frame_unref(vp->frame);
-    avsubtitle_free(&vp->sub);
-}
-
-static int frame_queue_init(FrameQueue* f, PacketQueue* pktq, int max_size, int keep_last)
-{
-    int i;
-    memset(f, 0, sizeof(FrameQueue));
-    if (!(f->mutex = SDL_CreateMutex())) {
-        av_log(NULL, AV_LOG_FATAL, "SDL_CreateMutex(): %s\n", SDL_GetError());
-        return AVERROR(ENOMEM);
-    }
-    if (!(f->cond = SDL_CreateCond())) {
-        av_log(NULL, AV_LOG_FATAL, "SDL_CreateCond(): %s\n", SDL_GetError());
-        return AVERROR(ENOMEM);
-    }
-    f->pktq = pktq;
-    f->max_size = FFMIN(max_size, FRAME_QUEUE_SIZE);
-    f->keep_last = !!keep_last;
-    for (i = 0; i < f->max_size; i++)
-        if (!(f->queue[i].frame = av_frame_alloc()))
-            return AVERROR(ENOMEM);
-    return 0;
-}
-
-static void frame_queue_destory(FrameQueue* f)
-{
-    int i;
-    for (i = 0; i < f->max_size; i++) {
-        Frame* vp = &f->queue[i];
-        frame_queue_unref_item(vp);
-        av_frame_free(&vp->frame);
-    }
-    SDL_DestroyMutex(f->mutex);
-    SDL_DestroyCond(f->cond);
-}
-
-static void frame_queue_signal(FrameQueue* f)
-{
-    SDL_LockMutex(f->mutex);
-    SDL_CondSignal(f->cond);
-    SDL_UnlockMutex(f->mutex);
-}
-
-static Frame* frame_queue_peek(FrameQueue* f)
-{
-    return &f->queue[(f->rindex + f->rindex_shown) % f->max_size];
-}
-
-static Frame* frame_queue_peek_next(FrameQueue* f)
-{
-    return &f->queue[(f->rindex + f->rindex_shown + 1) % f->max_size];
-}
-
-static Frame* frame_queue_peek_last(FrameQueue* f)
-{
-    return &f->queue[f->rindex];
-}
-
-static Frame* frame_queue_peek_writable(FrameQueue* f)
-{
-    /* wait until we have space to put a new frame */
-    SDL_LockMutex(f->mutex);
-    while (f->size >= f->max_size &&
-        !f->pktq->abort_request) {
-        SDL_CondWait(f->cond, f->mutex);
-    }
-    SDL_UnlockMutex(f->mutex);
-
-    if (f->pktq->abort_request)
-        return NULL;
-
-    return &f->queue[f->windex];
-}
-
-static Frame* frame_queue_peek_readable(FrameQueue* f)
-{
-    /* wait until we have a readable a new frame */
-    SDL_LockMutex(f->mutex);
-    while (f->size - f->rindex_shown <= 0 &&
-        !f->pktq->abort_request) {
-        SDL_CondWait(f->cond, f->mutex);
-    }
-    SDL_UnlockMutex(f->mutex);
-
-    if (f->pktq->abort_request)
-        return NULL;
-
-    return &f->queue[(f->rindex + f->rindex_shown) % f->max_size];
-}
-
-static void frame_queue_push(FrameQueue* f)
-{
-    if (++f->windex == f->max_size)
-        f->windex = 0;
-    SDL_LockMutex(f->mutex);
-    f->size++;
-    SDL_CondSignal(f->cond);
-    SDL_UnlockMutex(f->mutex);
-}
-
-static void frame_queue_next(FrameQueue* f)
-{
-    if (f->keep_last && !f->rindex_shown) {
-        f->rindex_shown = 1;
-        return;
-    }
-    frame_queue_unref_item(&f->queue[f->rindex]);
-    if (++f->rindex == f->max_size)
-        f->rindex = 0;
-    SDL_LockMutex(f->mutex);
-    f->size--;
-    SDL_CondSignal(f->cond);
-    SDL_UnlockMutex(f->mutex);
-}
-
-/* return the number of undisplayed frames in the queue */
-static int frame_queue_nb_remaining(FrameQueue* f)
-{
-    return f->size - f->rindex_shown;
-}
-
-/* return last shown position */
-static int64_t frame_queue_last_pos(FrameQueue* f)
-{
-    Frame* fp = &f->queue[f->rindex];
-    if (f->rindex_shown && fp->serial == f->pktq->serial)
-        return fp->pos;
-    else
-        return -1;
-}
-
-static void decoder_abort(Decoder* d, FrameQueue* fq)
-{
-    packet_queue_abort(d->queue);
-    frame_queue_signal(fq);
-    SDL_WaitThread(d->decoder_tid, NULL);
-    d->decoder_tid = NULL;
-    packet_queue_flush(d->queue);
-}
-
-static inline void fill_rectangle(int x, int y, int w, int h)
-{
-    SDL_Rect rect;
-    rect.x = x;
-    rect.y = y;
-    rect.w = w;
-    rect.h = h;
-    if (w && h)
-        SDL_RenderFillRect(renderer, &rect);
-}
-
-static int realloc_texture(SDL_Texture** texture, Uint32 new_format, int new_width, int new_height, SDL_BlendMode blendmode, int init_texture)
-{
-    Uint32 format;
-    int access, w, h;
-    if (!*texture || SDL_QueryTexture(*texture, &format, &access, &w, &h) < 0 || new_width != w || new_height != h || new_format != format) {
-        void* pixels;
-        int pitch;
-        if (*texture)
-            SDL_DestroyTexture(*texture);
-        if (!(*texture = SDL_CreateTexture(renderer, new_format, SDL_TEXTUREACCESS_STREAMING, new_width, new_height)))
-            return -1;
-        if (SDL_SetTextureBlendMode(*texture, blendmode) < 0)
-            return -1;
-        if (init_texture) {
-            if (SDL_LockTexture(*texture, NULL, &pixels, &pitch) < 0)
-                return -1;
-            memset(pixels, 0, pitch * new_height);
-            SDL_UnlockTexture(*texture);
-        }
-        av_log(NULL, AV_LOG_VERBOSE, "Created %dx%d texture with %s.\n", new_width, new_height, SDL_GetPixelFormatName(new_format));
-    }
-    return 0;
-}
-
-static void calculate_display_rect(SDL_Rect* rect,
-    int scr_xleft, int scr_ytop, int scr_width, int scr_height,
-    int pic_width, int pic_height, AVRational pic_sar)
-{
-    AVRational aspect_ratio = pic_sar;
-    int64_t width, height, x, y;
-
-    if (av_cmp_q(aspect_ratio, av_make_q(0, 1)) <= 0)
-        aspect_ratio = av_make_q(1, 1);
-
-    aspect_ratio = av_mul_q(aspect_ratio, av_make_q(pic_width, pic_height));
-
-    /* XXX: we suppose the screen has a 1.0 pixel ratio */
-    height = scr_height;
-    width = av_rescale(height, aspect_ratio.num, aspect_ratio.den) & ~1;
-    if (width > scr_width) {
-        width = scr_width;
-        height = av_rescale(width, aspect_ratio.den, aspect_ratio.num) & ~1;
-    }
-    x = (scr_width - width) / 2;
-    y = (scr_height - height) / 2;
-    rect->x = scr_xleft + x;
-    rect->y = scr_ytop + y;
-    rect->w = FFMAX((int)width, 1);
-    rect->h = FFMAX((int)height, 1);
-}
-
-static void get_sdl_pix_fmt_and_blendmode(int format, Uint32* sdl_pix_fmt, SDL_BlendMode* sdl_blendmode)
-{
-    int i;
-    *sdl_blendmode = SDL_BLENDMODE_NONE;
-    *sdl_pix_fmt = SDL_PIXELFORMAT_UNKNOWN;
-    if (format == AV_PIX_FMT_RGB32 ||
-        format == AV_PIX_FMT_RGB32_1 ||
-        format == AV_PIX_FMT_BGR32 ||
-        format == AV_PIX_FMT_BGR32_1)
-        *sdl_blendmode = SDL_BLENDMODE_BLEND;
-    for (i = 0; i < FF_ARRAY_ELEMS(sdl_texture_format_map) - 1; i++) {
-        if (format == sdl_texture_format_map[i].format) {
-            *sdl_pix_fmt = sdl_texture_format_map[i].texture_fmt;
-            return;
-        }
-    }
-}
-
-static int upload_texture(SDL_Texture** tex, AVFrame* frame, struct SwsContext** img_convert_ctx) {
-    int ret = 0;
-    Uint32 sdl_pix_fmt;
-    SDL_BlendMode sdl_blendmode;
-    get_sdl_pix_fmt_and_blendmode(frame->format, &sdl_pix_fmt, &sdl_blendmode);
-    if (realloc_texture(tex, sdl_pix_fmt == SDL_PIXELFORMAT_UNKNOWN ? SDL_PIXELFORMAT_ARGB8888 : sdl_pix_fmt, frame->width, frame->height, sdl_blendmode, 0) < 0)
-        return -1;
-    switch (sdl_pix_fmt) {
-    case SDL_PIXELFORMAT_UNKNOWN:
-        /* This should only happen if we are not using avfilter... */
-        *img_convert_ctx = sws_getCachedContext(*img_convert_ctx,
-            frame->width, frame->height, static_cast<AVPixelFormat>(frame->format), frame->width, frame->height,
-            AV_PIX_FMT_BGRA, sws_flags, NULL, NULL, NULL);
-        if (*img_convert_ctx != NULL) {
-            uint8_t* pixels[4];
-            int pitch[4];
-            if (!SDL_LockTexture(*tex, NULL, (void**)pixels, pitch)) {
-                sws_scale(*img_convert_ctx, (const uint8_t* const*)frame->data, frame->linesize,
-                    0, frame->height, pixels, pitch);
-                SDL_UnlockTexture(*tex);
-            }
-        }
-        else {
-            av_log(NULL, AV_LOG_FATAL, "Cannot initialize the conversion context\n");
-            ret = -1;
-        }
-        break;
-    case SDL_PIXELFORMAT_IYUV:
-        if (frame->linesize[0] > 0 && frame->linesize[1] > 0 && frame->linesize[2] > 0) {
-            ret = SDL_UpdateYUVTexture(*tex, NULL, frame->data[0], frame->linesize[0],
-                frame->data[1], frame->linesize[1],
-                frame->data[2], frame->linesize[2]);
-        }
-        else if (frame->linesize[0] < 0 && frame->linesize[1] < 0 && frame->linesize[2] < 0) {
-            ret = SDL_UpdateYUVTexture(*tex, NULL, frame->data[0] + frame->linesize[0] * (frame->height - 1), -frame->linesize[0],
-                frame->data[1] + frame->linesize[1] * (AV_CEIL_RSHIFT(frame->height, 1) - 1), -frame->linesize[1],
-                frame->data[2] + frame->linesize[2] * (AV_CEIL_RSHIFT(frame->height, 1) - 1), -frame->linesize[2]);
-        }
-        else {
-            av_log(NULL, AV_LOG_ERROR, "Mixed negative and positive linesizes are not supported.\n");
-            return -1;
-        }
-        break;
-    default:
-        if (frame->linesize[0] < 0) {
-            ret = SDL_UpdateTexture(*tex, NULL, frame->data[0] + frame->linesize[0] * (frame->height - 1), -frame->linesize[0]);
-        }
-        else {
-            ret = SDL_UpdateTexture(*tex, NULL, frame->data[0], frame->linesize[0]);
-        }
-        break;
-    }
-    return ret;
-}
-
-static void set_sdl_yuv_conversion_mode(AVFrame* frame)
-{
-#if SDL_VERSION_ATLEAST(2,0,8)
-    SDL_YUV_CONVERSION_MODE mode = SDL_YUV_CONVERSION_AUTOMATIC;
-    if (frame && (frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUYV422 || frame->format == AV_PIX_FMT_UYVY422)) {
-        if (frame->color_range == AVCOL_RANGE_JPEG)
-            mode = SDL_YUV_CONVERSION_JPEG;
-        else if (frame->colorspace == AVCOL_SPC_BT709)
-            mode = SDL_YUV_CONVERSION_BT709;
-        else if (frame->colorspace == AVCOL_SPC_BT470BG || frame->colorspace == AVCOL_SPC_SMPTE170M || frame->colorspace == AVCOL_SPC_SMPTE240M)
-            mode = SDL_YUV_CONVERSION_BT601;
-    }
-    SDL_SetYUVConversionMode(mode);
-#endif
-}
-
-static void video_image_display(FMediaPlayer* is)
-{
-    Frame* vp;
-    Frame* sp = NULL;
-    SDL_Rect rect;
-
-    vp = frame_queue_peek_last(&is->pictq);
-    if (is->subtitle_st) {
-        if (frame_queue_nb_remaining(&is->subpq) > 0) {
-            sp = frame_queue_peek(&is->subpq);
-
-            if (vp->pts >= sp->pts + ((float)sp->sub.start_display_time / 1000)) {
-                if (!sp->uploaded) {
-                    uint8_t* pixels[4];
-                    int pitch[4];
-                    int i;
-                    if (!sp->width || !sp->height) {
-                        sp->width = vp->width;
-                        sp->height = vp->height;
-                    }
-                    if (realloc_texture(&is->sub_texture, SDL_PIXELFORMAT_ARGB8888, sp->width, sp->height, SDL_BLENDMODE_BLEND, 1) < 0)
-                        return;
-
-                    for (i = 0; i < sp->sub.num_rects; i++) {
-                        AVSubtitleRect* sub_rect = sp->sub.rects[i];
-
-                        sub_rect->x = av_clip(sub_rect->x, 0, sp->width);
-                        sub_rect->y = av_clip(sub_rect->y, 0, sp->height);
-                        sub_rect->w = av_clip(sub_rect->w, 0, sp->width - sub_rect->x);
-                        sub_rect->h = av_clip(sub_rect->h, 0, sp->height - sub_rect->y);
-
-                        is->sub_convert_ctx = sws_getCachedContext(is->sub_convert_ctx,
-                            sub_rect->w, sub_rect->h, AV_PIX_FMT_PAL8,
-                            sub_rect->w, sub_rect->h, AV_PIX_FMT_BGRA,
-                            0, NULL, NULL, NULL);
-                        if (!is->sub_convert_ctx) {
-                            av_log(NULL, AV_LOG_FATAL, "Cannot initialize the conversion context\n");
-                            return;
-                        }
-                        if (!SDL_LockTexture(is->sub_texture, (SDL_Rect*)sub_rect, (void**)pixels, pitch)) {
-                            sws_scale(is->sub_convert_ctx, (const uint8_t* const*)sub_rect->data, sub_rect->linesize,
-                                0, sub_rect->h, pixels, pitch);
-                            SDL_UnlockTexture(is->sub_texture);
-                        }
-                    }
-                    sp->uploaded = 1;
-                }
-            }
-            else
-                sp = NULL;
-        }
-    }
-
-    calculate_display_rect(&rect, is->xleft, is->ytop, is->width, is->height, vp->width, vp->height, vp->sar);
-
-    if (!vp->uploaded) {
-        if (upload_texture(&is->vid_texture, vp->frame, &is->img_convert_ctx) < 0)
-            return;
-        vp->uploaded = 1;
-        vp->flip_v = vp->frame->linesize[0] < 0;
-    }
-
-    set_sdl_yuv_conversion_mode(vp->frame);
-    SDL_RenderCopyEx(renderer, is->vid_texture, NULL, &rect, 0, NULL, static_cast<SDL_RendererFlip>(vp->flip_v ? SDL_FLIP_VERTICAL : 0));
-    set_sdl_yuv_conversion_mode(NULL);
-    if (sp) {
-#if USE_ONEPASS_SUBTITLE_RENDER
-        SDL_RenderCopy(renderer, is->sub_texture, NULL, &rect);
-#else
-        int i;
-        double xratio = (double)rect.w / (double)sp->width;
-        double yratio = (double)rect.h / (double)sp->height;
-        for (i = 0; i < sp->sub.num_rects; i++) {
-            SDL_Rect* sub_rect = (SDL_Rect*)sp->sub.rects[i];
-            SDL_Rect target = { .x = rect.x + sub_rect->x * xratio,
-                               .y = rect.y + sub_rect->y * yratio,
-                               .w = sub_rect->w * xratio,
-                               .h = sub_rect->h * yratio };
-            SDL_RenderCopy(renderer, is->sub_texture, sub_rect, &target);
-        }
-#endif
-    }
-}
-
-static inline int compute_mod(int a, int b)
-{
-    return a < 0 ? a % b + b : a % b;
-}
-
-static void video_audio_display(FMediaPlayer* s)
-{
-    int i, i_start, x, y1, y, ys, delay, n, nb_display_channels;
-    int ch, channels, h, h2;
-    int64_t time_diff;
-    int rdft_bits, nb_freq;
-
-    for (rdft_bits = 1; (1 << rdft_bits) < 2 * s->height; rdft_bits++)
-        ;
-    nb_freq = 1 << (rdft_bits - 1);
-
-    /* compute display index : center on currently output samples */
-    channels = s->audio_tgt.channels;
-    nb_display_channels = channels;
-    if (!s->paused) {
-        int data_used = s->eShow_mode == FMediaPlayer::EShowMode::SHOW_MODE_WAVES ? s->width : (2 * nb_freq);
-        n = 2 * channels;
-        delay = s->audio_write_buf_size;
-        delay /= n;
-
-        /* to be more precise, we take into account the time spent since
-           the last buffer computation */
-        if (audio_callback_time) {
-            time_diff = av_gettime_relative() - audio_callback_time;
-            delay -= (time_diff * s->audio_tgt.freq) / 1000000;
-        }
-
-        delay += 2 * data_used;
-        if (delay < data_used)
-            delay = data_used;
-
-        i_start = x = compute_mod(s->sample_array_index - delay * channels, SAMPLE_ARRAY_SIZE);
-        if (s->eShow_mode == FMediaPlayer::EShowMode::SHOW_MODE_WAVES) {
-            h = INT_MIN;
-            for (i = 0; i < 1000; i += channels) {
-                int idx = (SAMPLE_ARRAY_SIZE + x - i) % SAMPLE_ARRAY_SIZE;
-                int a = s->sample_array[idx];
-                int b = s->sample_array[(idx + 4 * channels) % SAMPLE_ARRAY_SIZE];
-                int c = s->sample_array[(idx + 5 * channels) % SAMPLE_ARRAY_SIZE];
-                int d = s->sample_array[(idx + 9 * channels) % SAMPLE_ARRAY_SIZE];
-                int score = a - d;
-                if (h < score && (b ^ c) < 0) {
-                    h = score;
-                    i_start = idx;
-                }
-            }
-        }
-
-        s->last_i_start = i_start;
-    }
-    else {
-        i_start = s->last_i_start;
-    }
-
-    if (s->eShow_mode == FMediaPlayer::EShowMode::SHOW_MODE_WAVES) {
-        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
-
-        /* total height for one channel */
-        h = s->height / nb_display_channels;
-        /* graph height / 2 */
-        h2 = (h * 9) / 20;
-        for (ch = 0; ch < nb_display_channels; ch++) {
-            i = i_start + ch;
-            y1 = s->ytop + ch * h + (h / 2); /* position of center line */
-            for (x = 0; x < s->width; x++) {
-                y = (s->sample_array[i] * h2) >> 15;
-                if (y < 0) {
-                    y = -y;
-                    ys = y1 - y;
-                }
-                else {
-                    ys = y1;
-                }
-                fill_rectangle(s->xleft + x, ys, 1, y);
-                i += channels;
-                if (i >= SAMPLE_ARRAY_SIZE)
-                    i -= SAMPLE_ARRAY_SIZE;
-            }
-        }
-
-        SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255);
-
-        for (ch = 1; ch < nb_display_channels; ch++) {
-            y = s->ytop + ch * h;
-            fill_rectangle(s->xleft, y, s->width, 1);
-        }
-    }
-    else {
-        if (realloc_texture(&s->vis_texture, SDL_PIXELFORMAT_ARGB8888, s->width, s->height, SDL_BLENDMODE_NONE, 1) < 0)
-            return;
-
-        nb_display_channels = FFMIN(nb_display_channels, 2);
-        if (rdft_bits != s->rdft_bits) {
-            av_rdft_end(s->rdft);
-            av_free(s->rdft_data);
-            s->rdft = av_rdft_init(rdft_bits, DFT_R2C);
-            s->rdft_bits = rdft_bits;
-            s->rdft_data = static_cast<FFTSample*>(av_malloc_array(nb_freq, 4 * sizeof(*s->rdft_data)));
-        }
-        if (!s->rdft || !s->rdft_data) {
-            av_log(NULL, AV_LOG_ERROR, "Failed to allocate buffers for RDFT, switching to waves display\n");
-            s->eShow_mode = FMediaPlayer::EShowMode::SHOW_MODE_WAVES;
-        }
-        else {
-            FFTSample* data[2];
-            SDL_Rect rect;
-            rect.x = s->xpos; rect.y = 0; rect.w = 1; rect.h = s->height;
-
-            uint32_t* pixels;
-            int pitch;
-            for (ch = 0; ch < nb_display_channels; ch++) {
-                data[ch] = s->rdft_data + 2 * nb_freq * ch;
-                i = i_start + ch;
-                for (x = 0; x < 2 * nb_freq; x++) {
-                    double w = (x - nb_freq) * (1.0 / nb_freq);
-                    data[ch][x] = s->sample_array[i] * (1.0 - w * w);
-                    i += channels;
-                    if (i >= SAMPLE_ARRAY_SIZE)
-                        i -= SAMPLE_ARRAY_SIZE;
-                }
-                av_rdft_calc(s->rdft, data[ch]);
-            }
-            /* Least efficient way to do this, we should of course
-             * directly access it but it is more than fast enough. */
-            if (!SDL_LockTexture(s->vis_texture, &rect, (void**)&pixels, &pitch)) {
-                pitch >>= 2;
-                pixels += pitch * s->height;
-                for (y = 0; y < s->height; y++) {
-                    double w = 1 / sqrt(nb_freq);
-                    int a = sqrt(w * sqrt(data[0][2 * y + 0] * data[0][2 * y + 0] + data[0][2 * y + 1] * data[0][2 * y + 1]));
-                    int b = (nb_display_channels == 2) ? sqrt(w * hypot(data[1][2 * y + 0], data[1][2 * y + 1]))
-                        : a;
-                    a = FFMIN(a, 255);
-                    b = FFMIN(b, 255);
-                    pixels -= pitch;
-                    *pixels = (a << 16) + (b << 8) + ((a + b) >> 1);
-                }
-                SDL_UnlockTexture(s->vis_texture);
-            }
-            SDL_RenderCopy(renderer, s->vis_texture, NULL, NULL);
-        }
-        if (!s->paused)
-            s->xpos++;
-        if (s->xpos >= s->width)
-            s->xpos = s->xleft;
-    }
-}
-
-static void stream_component_close(FMediaPlayer* is, int stream_index)
-{
-    AVFormatContext* ic = is->ic;
-    AVCodecParameters* codecpar;
-
-    if (stream_index < 0 || stream_index >= ic->nb_streams)
-        return;
-    codecpar = ic->streams[stream_index]->codecpar;
-
-    switch (codecpar->codec_type) {
-    case AVMEDIA_TYPE_AUDIO:
-        decoder_abort(&is->auddec, &is->sampq);
-        SDL_CloseAudioDevice(audio_dev);
-        decoder_destroy(&is->auddec);
-        swr_free(&is->swr_ctx);
-        av_freep(&is->audio_buf1);
-        is->audio_buf1_size = 0;
-        is->audio_buf = NULL;
-
-        if (is->rdft) {
-            av_rdft_end(is->rdft);
-            av_freep(&is->rdft_data);
-            is->rdft = NULL;
-            is->rdft_bits = 0;
-        }
-        break;
-    case AVMEDIA_TYPE_VIDEO:
-        decoder_abort(&is->viddec, &is->pictq);
-        decoder_destroy(&is->viddec);
-        break;
-    case AVMEDIA_TYPE_SUBTITLE:
-        decoder_abort(&is->subdec, &is->subpq);
-        decoder_destroy(&is->subdec);
-        break;
-    default:
-        break;
-    }
-
-    ic->streams[stream_index]->discard = AVDISCARD_ALL;
-    switch (codecpar->codec_type) {
-    case AVMEDIA_TYPE_AUDIO:
-        is->audio_st = NULL;
-        is->audio_stream = -1;
-        break;
-    case AVMEDIA_TYPE_VIDEO:
-        is->video_st = NULL;
-        is->video_stream = -1;
-        break;
-    case AVMEDIA_TYPE_SUBTITLE:
-        is->subtitle_st = NULL;
-        is->subtitle_stream = -1;
-        break;
-    default:
-        break;
-    }
-}
-
-static void stream_close(FMediaPlayer* is)
-{
-    /* XXX: use a special url_shutdown call to abort parse cleanly */
-    is->abort_request = 1;
-    SDL_WaitThread(is->read_tid, NULL);
-
-    /* close each stream */
-    if (is->audio_stream >= 0)
-        stream_component_close(is, is->audio_stream);
-    if (is->video_stream >= 0)
-        stream_component_close(is, is->video_stream);
-    if (is->subtitle_stream >= 0)
-        stream_component_close(is, is->subtitle_stream);
-
-    avformat_close_input(&is->ic);
-
-    packet_queue_destroy(&is->videoq);
-    packet_queue_destroy(&is->audioq);
-    packet_queue_destroy(&is->subtitleq);
-
-    /* free all pictures */
-    frame_queue_destory(&is->pictq);
-    frame_queue_destory(&is->sampq);
-    frame_queue_destory(&is->subpq);
-    SDL_DestroyCond(is->continue_read_thread);
-    sws_freeContext(is->img_convert_ctx);
-    sws_freeContext(is->sub_convert_ctx);
-    av_free(is->filename);
-    if (is->vis_texture)
-        SDL_DestroyTexture(is->vis_texture);
-    if (is->vid_texture)
-        SDL_DestroyTexture(is->vid_texture);
-    if (is->sub_texture)
-        SDL_DestroyTexture(is->sub_texture);
-    av_free(is);
-}
-
-static void do_exit(FMediaPlayer* is)
-{
-    if (is) {
-        stream_close(is);
-    }
-    if (renderer)
-        SDL_DestroyRenderer(renderer);
-    if (window)
-        SDL_DestroyWindow(window);
-    uninit_opts();
-#if CONFIG_AVFILTER
-    av_freep(&vfilters_list);
-#endif
-    avformat_network_deinit();
-    if (show_status)
-        printf("\n");
-    SDL_Quit();
-    av_log(NULL, AV_LOG_QUIET, "%s", "");
-    exit(0);
-}
-
-static void sigterm_handler(int sig)
-{
-    exit(123);
-}
-
-static void set_default_window_size(int width, int height, AVRational sar)
-{
-    SDL_Rect rect;
-    int max_width = screen_width ? screen_width : INT_MAX;
-    int max_height = screen_height ? screen_height : INT_MAX;
-    if (max_width == INT_MAX && max_height == INT_MAX)
-        max_height = height;
-    calculate_display_rect(&rect, 0, 0, max_width, max_height, width, height, sar);
-    default_width = rect.w;
-    default_height = rect.h;
-}
-
-static int video_open(FMediaPlayer* is)
-{
-    int w, h;
-
-    w = screen_width ? screen_width : default_width;
-    h = screen_height ? screen_height : default_height;
-
-    if (!window_title)
-        window_title = input_filename;
-    SDL_SetWindowTitle(window, window_title);
-
-    SDL_SetWindowSize(window, w, h);
-    SDL_SetWindowPosition(window, screen_left, screen_top);
-    if (is_full_screen)
-        SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN_DESKTOP);
-    SDL_ShowWindow(window);
-
-    is->width = w;
-    is->height = h;
-
-    return 0;
-}
-
-/* display the current picture, if any */
-static void video_display(FMediaPlayer* is)
-{
-    if (!is->width)
-        video_open(is);
-
-    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-    SDL_RenderClear(renderer);
-    if (is->audio_st && is->eShow_mode != FMediaPlayer::EShowMode::SHOW_MODE_VIDEO)
-        video_audio_display(is);
-    else if (is->video_st)
-        video_image_display(is);
-    SDL_RenderPresent(renderer);
-}
-
-static double get_clock(Clock* c)
-{
-    if (*c->queue_serial != c->serial)
-        return NAN;
-    if (c->paused) {
-        return c->pts;
-    }
-    else {
-        double time = av_gettime_relative() / 1000000.0;
-        return c->pts_drift + time - (time - c->last_updated) * (1.0 - c->speed);
-    }
-}
-
-static void set_clock_at(Clock* c, double pts, int serial, double time)
-{
-    c->pts = pts;
-    c->last_updated = time;
-    c->pts_drift = c->pts - time;
-    c->serial = serial;
-}
-
-static void set_clock(Clock* c, double pts, int serial)
-{
-    double time = av_gettime_relative() / 1000000.0;
-    set_clock_at(c, pts, serial, time);
-}
-
-static void set_clock_speed(Clock* c, double speed)
-{
-    set_clock(c, get_clock(c), c->serial);
-    c->speed = speed;
-}
-
-static void init_clock(Clock* c, int* queue_serial)
-{
-    c->speed = 1.0;
-    c->paused = 0;
-    c->queue_serial = queue_serial;
-    set_clock(c, NAN, -1);
-}
-
-static void sync_clock_to_slave(Clock* c, Clock* slave)
-{
-    double clock = get_clock(c);
-    double slave_clock = get_clock(slave);
-    if (!isnan(slave_clock) && (isnan(clock) || fabs(clock - slave_clock) > AV_NOSYNC_THRESHOLD))
-        set_clock(c, slave_clock, slave->serial);
-}
-
-static int get_master_sync_type(FMediaPlayer* is) {
-    if (is->av_sync_type == AV_SYNC_VIDEO_MASTER) {
-        if (is->video_st)
-            return AV_SYNC_VIDEO_MASTER;
-        else
-            return AV_SYNC_AUDIO_MASTER;
-    }
-    else if (is->av_sync_type == AV_SYNC_AUDIO_MASTER) {
-        if (is->audio_st)
-            return AV_SYNC_AUDIO_MASTER;
-        else
-            return AV_SYNC_EXTERNAL_CLOCK;
-    }
-    else {
-        return AV_SYNC_EXTERNAL_CLOCK;
-    }
-}
-
-/* get the current master clock value */
-static double get_master_clock(FMediaPlayer* is)
-{
-    double val;
-
-    switch (get_master_sync_type(is)) {
-    case AV_SYNC_VIDEO_MASTER:
-        val = get_clock(&is->vidclk);
-        break;
-    case AV_SYNC_AUDIO_MASTER:
-        val = get_clock(&is->audclk);
-        break;
-    default:
-        val = get_clock(&is->extclk);
-        break;
-    }
-    return val;
-}
-
-static void check_external_clock_speed(FMediaPlayer* is) {
-    if (is->video_stream >= 0 && is->videoq.nb_packets <= EXTERNAL_CLOCK_MIN_FRAMES ||
-        is->audio_stream >= 0 && is->audioq.nb_packets <= EXTERNAL_CLOCK_MIN_FRAMES) {
-        set_clock_speed(&is->extclk, FFMAX(EXTERNAL_CLOCK_SPEED_MIN, is->extclk.speed - EXTERNAL_CLOCK_SPEED_STEP));
-    }
-    else if ((is->video_stream < 0 || is->videoq.nb_packets > EXTERNAL_CLOCK_MAX_FRAMES) &&
-        (is->audio_stream < 0 || is->audioq.nb_packets > EXTERNAL_CLOCK_MAX_FRAMES)) {
-        set_clock_speed(&is->extclk, FFMIN(EXTERNAL_CLOCK_SPEED_MAX, is->extclk.speed + EXTERNAL_CLOCK_SPEED_STEP));
-    }
-    else {
-        double speed = is->extclk.speed;
-        if (speed != 1.0)
-            set_clock_speed(&is->extclk, speed + EXTERNAL_CLOCK_SPEED_STEP * (1.0 - speed) / fabs(1.0 - speed));
-    }
-}
-
-/* seek in the stream */
-static void stream_seek(FMediaPlayer* is, int64_t pos, int64_t rel, int seek_by_bytes)
-{
-    if (!is->seek_req) {
-        is->seek_pos = pos;
-        is->seek_rel = rel;
-        is->seek_flags &= ~AVSEEK_FLAG_BYTE;
-        if (seek_by_bytes)
-            is->seek_flags |= AVSEEK_FLAG_BYTE;
-        is->seek_req = 1;
-        SDL_CondSignal(is->continue_read_thread);
-    }
-}
-
-/* pause or resume the video */
-static void stream_toggle_pause(FMediaPlayer* is)
-{
-    if (is->paused) {
-        is->frame_timer += av_gettime_relative() / 1000000.0 - is->vidclk.last_updated;
-        if (is->read_pause_return != AVERROR(ENOSYS)) {
-            is->vidclk.paused = 0;
-        }
-        set_clock(&is->vidclk, get_clock(&is->vidclk), is->vidclk.serial);
-    }
-    set_clock(&is->extclk, get_clock(&is->extclk), is->extclk.serial);
-    is->paused = is->audclk.paused = is->vidclk.paused = is->extclk.paused = !is->paused;
-}
-
-static void toggle_pause(FMediaPlayer* is)
-{
-    stream_toggle_pause(is);
-    is->step = 0;
-}
-
-static void toggle_mute(FMediaPlayer* is)
-{
-    is->muted = !is->muted;
-}
-
-static void update_volume(FMediaPlayer* is, int sign, double step)
-{
-    double volume_level = is->audio_volume ? (20 * log(is->audio_volume / (double)SDL_MIX_MAXVOLUME) / log(10)) : -1000.0;
-    int new_volume = lrint(SDL_MIX_MAXVOLUME * pow(10.0, (volume_level + sign * step) / 20.0));
-    is->audio_volume = av_clip(is->audio_volume == new_volume ? (is->audio_volume + sign) : new_volume, 0, SDL_MIX_MAXVOLUME);
-}
-
-static void step_to_next_frame(FMediaPlayer* is)
-{
-    /* if the stream is paused unpause it, then step */
-    if (is->paused)
-        stream_toggle_pause(is);
-    is->step = 1;
-}
-
-static double compute_target_delay(double delay, FMediaPlayer* is)
-{
-    double sync_threshold, diff = 0;
-
-    /* update delay to follow master synchronisation source */
-    if (get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER) {
-        /* if video is slave, we try to correct big delays by
-           duplicating or deleting a frame */
-        diff = get_clock(&is->vidclk) - get_master_clock(is);
-
-        /* skip or repeat frame. We take into account the
-           delay to compute the threshold. I still don't know
-           if it is the best guess */
-        sync_threshold = FFMAX(AV_SYNC_THRESHOLD_MIN, FFMIN(AV_SYNC_THRESHOLD_MAX, delay));
-        if (!isnan(diff) && fabs(diff) < is->max_frame_duration) {
-            if (diff <= -sync_threshold)
-                delay = FFMAX(0, delay + diff);
-            else if (diff >= sync_threshold && delay > AV_SYNC_FRAMEDUP_THRESHOLD)
-                delay = delay + diff;
-            else if (diff >= sync_threshold)
-                delay = 2 * delay;
-        }
-    }
-
-    av_log(NULL, AV_LOG_TRACE, "video: delay=%0.3f A-V=%f\n",
-        delay, -diff);
-
-    return delay;
-}
-
-static double vp_duration(FMediaPlayer* is, Frame* vp, Frame* nextvp) {
-    if (vp->serial == nextvp->serial) {
-        double duration = nextvp->pts - vp->pts;
-        if (isnan(duration) || duration <= 0 || duration > is->max_frame_duration)
-            return vp->duration;
-        else
-            return duration;
-    }
-    else {
-        return 0.0;
-    }
-}
-
-static void update_video_pts(FMediaPlayer* is, double pts, int64_t pos, int serial) {
-    /* update current video pts */
-    set_clock(&is->vidclk, pts, serial);
-    sync_clock_to_slave(&is->extclk, &is->vidclk);
-}
-
-/* called to display each frame */
-static void video_refresh(void* pUserData, double* remaining_time)
-{
-    FMediaPlayer* is = static_cast<FMediaPlayer*>(pUserData);
-    double time;
-
-    Frame* sp, * sp2;
-
-    if (!is->paused && get_master_sync_type(is) == AV_SYNC_EXTERNAL_CLOCK && is->realtime)
-        check_external_clock_speed(is);
-
-    if (!display_disable && is->eShow_mode != FMediaPlayer::EShowMode::SHOW_MODE_VIDEO && is->audio_st) {
-        time = av_gettime_relative() / 1000000.0;
-        if (is->force_refresh || is->last_vis_time + rdftspeed < time) {
-            video_display(is);
-            is->last_vis_time = time;
-        }
-        *remaining_time = FFMIN(*remaining_time, is->last_vis_time + rdftspeed - time);
-    }
-
-    if (is->video_st) {
-    retry:
-        if (frame_queue_nb_remaining(&is->pictq) == 0) {
-            // nothing to do, no picture to display in the queue
-        }
-        else {
-            double last_duration, duration, delay;
-            Frame* vp, * lastvp;
-
-            /* dequeue the picture */
-            lastvp = frame_queue_peek_last(&is->pictq);
-            vp = frame_queue_peek(&is->pictq);
-
-            if (vp->serial != is->videoq.serial) {
-                frame_queue_next(&is->pictq);
-                goto retry;
-            }
-
-            if (lastvp->serial != vp->serial)
-                is->frame_timer = av_gettime_relative() / 1000000.0;
-
-            if (is->paused)
-                goto display;
-
-            /* compute nominal last_duration */
-            last_duration = vp_duration(is, lastvp, vp);
-            delay = compute_target_delay(last_duration, is);
-
-            time = av_gettime_relative() / 1000000.0;
-            if (time < is->frame_timer + delay) {
-                *remaining_time = FFMIN(is->frame_timer + delay - time, *remaining_time);
-                goto display;
-            }
-
-            is->frame_timer += delay;
-            if (delay > 0 && time - is->frame_timer > AV_SYNC_THRESHOLD_MAX)
-                is->frame_timer = time;
-
-            SDL_LockMutex(is->pictq.mutex);
-            if (!isnan(vp->pts))
-                update_video_pts(is, vp->pts, vp->pos, vp->serial);
-            SDL_UnlockMutex(is->pictq.mutex);
-
-            if (frame_queue_nb_remaining(&is->pictq) > 1) {
-                Frame* nextvp = frame_queue_peek_next(&is->pictq);
-                duration = vp_duration(is, vp, nextvp);
-                if (!is->step && (framedrop > 0 || (framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)) && time > is->frame_timer + duration) {
-                    is->frame_drops_late++;
-                    frame_queue_next(&is->pictq);
-                    goto retry;
-                }
-            }
-
-            if (is->subtitle_st) {
-                while (frame_queue_nb_remaining(&is->subpq) > 0) {
-                    sp = frame_queue_peek(&is->subpq);
-
-                    if (frame_queue_nb_remaining(&is->subpq) > 1)
-                        sp2 = frame_queue_peek_next(&is->subpq);
-                    else
-                        sp2 = NULL;
-
-                    if (sp->serial != is->subtitleq.serial
-                        || (is->vidclk.pts > (sp->pts + ((float)sp->sub.end_display_time / 1000)))
-                        || (sp2 && is->vidclk.pts > (sp2->pts + ((float)sp2->sub.start_display_time / 1000))))
-                    {
-                        if (sp->uploaded) {
-                            int i;
-                            for (i = 0; i < sp->sub.num_rects; i++) {
-                                AVSubtitleRect* sub_rect = sp->sub.rects[i];
-                                uint8_t* pixels;
-                                int pitch, j;
-
-                                if (!SDL_LockTexture(is->sub_texture, (SDL_Rect*)sub_rect, (void**)&pixels, &pitch)) {
-                                    for (j = 0; j < sub_rect->h; j++, pixels += pitch)
-                                        memset(pixels, 0, sub_rect->w << 2);
-                                    SDL_UnlockTexture(is->sub_texture);
-                                }
-                            }
-                        }
-                        frame_queue_next(&is->subpq);
-                    }
-                    else {
-                        break;
-                    }
-                }
-            }
-
-            frame_queue_next(&is->pictq);
-            is->force_refresh = 1;
-
-            if (is->step && !is->paused)
-                stream_toggle_pause(is);
-        }
-    display:
-        /* display picture */
-        if (!display_disable && is->force_refresh && is->eShow_mode == FMediaPlayer::EShowMode::SHOW_MODE_VIDEO && is->pictq.rindex_shown)
-            video_display(is);
-    }
-    is->force_refresh = 0;
-    if (show_status) {
-        static int64_t last_time;
-        int64_t cur_time;
-        int aqsize, vqsize, sqsize;
-        double av_diff;
-
-        cur_time = av_gettime_relative();
-        if (!last_time || (cur_time - last_time) >= 30000) {
-            aqsize = 0;
-            vqsize = 0;
-            sqsize = 0;
-            if (is->audio_st)
-                aqsize = is->audioq.size;
-            if (is->video_st)
-                vqsize = is->videoq.size;
-            if (is->subtitle_st)
-                sqsize = is->subtitleq.size;
-            av_diff = 0;
-            if (is->audio_st && is->video_st)
-                av_diff = get_clock(&is->audclk) - get_clock(&is->vidclk);
-            else if (is->video_st)
-                av_diff = get_master_clock(is) - get_clock(&is->vidclk);
-            else if (is->audio_st)
-                av_diff = get_master_clock(is) - get_clock(&is->audclk);
-            /*av_log(NULL, AV_LOG_INFO,
-                "%7.2f %s:%7.3f fd=%4d aq=%5dKB vq=%5dKB sq=%5dB f=%"PRId64"/%"PRId64"   \r",
-                get_master_clock(is),
-                (is->audio_st && is->video_st) ? "A-V" : (is->video_st ? "M-V" : (is->audio_st ? "M-A" : "   ")),
-                av_diff,
-                is->frame_drops_early + is->frame_drops_late,
-                aqsize / 1024,
-                vqsize / 1024,
-                sqsize,
-                is->video_st ? is->viddec.avctx->pts_correction_num_faulty_dts : 0,
-                is->video_st ? is->viddec.avctx->pts_correction_num_faulty_pts : 0);*/
-            fflush(stdout);
-            last_time = cur_time;
-        }
-    }
-}
-
-static int queue_picture(FMediaPlayer* is, AVFrame* src_frame, double pts, double duration, int64_t pos, int serial)
-{
-    Frame* vp;
-
-#if defined(DEBUG_SYNC)
-    printf("frame_type=%c pts=%0.3f\n",
-        av_get_picture_type_char(src_frame->pict_type), pts);
-#endif
-
-    if (!(vp = frame_queue_peek_writable(&is->pictq)))
-        return -1;
-
-    vp->sar = src_frame->sample_aspect_ratio;
-    vp->uploaded = 0;
-
-    vp->width = src_frame->width;
-    vp->height = src_frame->height;
-    vp->format = src_frame->format;
-
-    vp->pts = pts;
-    vp->duration = duration;
-    vp->pos = pos;
-    vp->serial = serial;
-
-    set_default_window_size(vp->width, vp->height, vp->sar);
-
-    av_frame_move_ref(vp->frame, src_frame);
-    frame_queue_push(&is->pictq);
-    return 0;
-}
-
-static int get_video_frame(FMediaPlayer* is, AVFrame* frame)
-{
-    int got_picture;
-
-    if ((got_picture = decoder_decode_frame(&is->viddec, frame, NULL)) < 0)
-        return -1;
-
-    if (got_picture) {
-        double dpts = NAN;
-
-        if (frame->pts != AV_NOPTS_VALUE)
-            dpts = av_q2d(is->video_st->time_base) * frame->pts;
-
-        frame->sample_aspect_ratio = av_guess_sample_aspect_ratio(is->ic, is->video_st, frame);
-
-        if (framedrop > 0 || (framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)) {
-            if (frame->pts != AV_NOPTS_VALUE) {
-                double diff = dpts - get_master_clock(is);
-                if (!isnan(diff) && fabs(diff) < AV_NOSYNC_THRESHOLD &&
-                    diff - is->frame_last_filter_delay < 0 &&
-                    is->viddec.pkt_serial == is->vidclk.serial &&
-                    is->videoq.nb_packets) {
-                    is->frame_drops_early++;
-                    av_frame_unref(frame);
-                    got_picture = 0;
-                }
-            }
-        }
-    }
-
-    return got_picture;
-}
-
-#if CONFIG_AVFILTER
-static int configure_filtergraph(AVFilterGraph* graph, const char* filtergraph,
-    AVFilterContext* source_ctx, AVFilterContext* sink_ctx)
-{
-    int ret, i;
-    int nb_filters = graph->nb_filters;
-    AVFilterInOut* outputs = NULL, * inputs = NULL;
-
-    if (filtergraph) {
-        outputs = avfilter_inout_alloc();
-        inputs = avfilter_inout_alloc();
-        if (!outputs || !inputs) {
-            ret = AVERROR(ENOMEM);
-            goto fail;
-        }
-
-        outputs->name = av_strdup("in");
-        outputs->filter_ctx = source_ctx;
-        outputs->pad_idx = 0;
-        outputs->next = NULL;
-
-        inputs->name = av_strdup("out");
-        inputs->filter_ctx = sink_ctx;
-        inputs->pad_idx = 0;
-        inputs->next = NULL;
-
-        if ((ret = avfilter_graph_parse_ptr(graph, filtergraph, &inputs, &outputs, NULL)) < 0)
-            goto fail;
-    }
-    else {
-        if ((ret = avfilter_link(source_ctx, 0, sink_ctx, 0)) < 0)
-            goto fail;
-    }
-
-    /* Reorder the filters to ensure that inputs of the custom filters are merged first */
-    for (i = 0; i < graph->nb_filters - nb_filters; i++)
-        FFSWAP(AVFilterContext*, graph->filters[i], graph->filters[i + nb_filters]);
-
-    ret = avfilter_graph_config(graph, NULL);
-fail:
-    avfilter_inout_free(&outputs);
-    avfilter_inout_free(&inputs);
-    return ret;
-}
-
-static int configure_video_filters(AVFilterGraph* graph, VideoState* is, const char* vfilters, AVFrame* frame)
-{
-    enum AVPixelFormat pix_fmts[FF_ARRAY_ELEMS(sdl_texture_format_map)];
-    char sws_flags_str[512] = "";
-    char buffersrc_args[256];
-    int ret;
-    AVFilterContext* filt_src = NULL, * filt_out = NULL, * last_filter = NULL;
-    AVCodecParameters* codecpar = is->video_st->codecpar;
-    AVRational fr = av_guess_frame_rate(is->ic, is->video_st, NULL);
-    AVDictionaryEntry* e = NULL;
-    int nb_pix_fmts = 0;
-    int i, j;
-
-    for (i = 0; i < renderer_info.num_texture_formats; i++) {
-        for (j = 0; j < FF_ARRAY_ELEMS(sdl_texture_format_map) - 1; j++) {
-            if (renderer_info.texture_formats[i] == sdl_texture_format_map[j].texture_fmt) {
-                pix_fmts[nb_pix_fmts++] = sdl_texture_format_map[j].format;
-                break;
-            }
-        }
-    }
-    pix_fmts[nb_pix_fmts] = AV_PIX_FMT_NONE;
-
-    while ((e = av_dict_get(sws_dict, "", e, AV_DICT_IGNORE_SUFFIX))) {
-        if (!strcmp(e->key, "sws_flags")) {
-            av_strlcatf(sws_flags_str, sizeof(sws_flags_str), "%s=%s:", "flags", e->value);
-        }
-        else
-            av_strlcatf(sws_flags_str, sizeof(sws_flags_str), "%s=%s:", e->key, e->value);
-    }
-    if (strlen(sws_flags_str))
-        sws_flags_str[strlen(sws_flags_str) - 1] = '\0';
-
-    graph->scale_sws_opts = av_strdup(sws_flags_str);
-
-    snprintf(buffersrc_args, sizeof(buffersrc_args),
-        "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
-        frame->width, frame->height, frame->format,
-        is->video_st->time_base.num, is->video_st->time_base.den,
-        codecpar->sample_aspect_ratio.num, FFMAX(codecpar->sample_aspect_ratio.den, 1));
-    if (fr.num && fr.den)
-        av_strlcatf(buffersrc_args, sizeof(buffersrc_args), ":frame_rate=%d/%d", fr.num, fr.den);
-
-    if ((ret = avfilter_graph_create_filter(&filt_src,
-        avfilter_get_by_name("buffer"),
-        "ffplay_buffer", buffersrc_args, NULL,
-        graph)) < 0)
-        goto fail;
-
-    ret = avfilter_graph_create_filter(&filt_out,
-        avfilter_get_by_name("buffersink"),
-        "ffplay_buffersink", NULL, NULL, graph);
-    if (ret < 0)
-        goto fail;
-
-    if ((ret = av_opt_set_int_list(filt_out, "pix_fmts", pix_fmts, AV_PIX_FMT_NONE, AV_OPT_SEARCH_CHILDREN)) < 0)
-        goto fail;
-
-    last_filter = filt_out;
-
-    /* Note: this macro adds a filter before the lastly added filter, so the
-     * processing order of the filters is in reverse */
-#define INSERT_FILT(name, arg) do {                                          \
-    AVFilterContext *filt_ctx;                                               \
-                                                                             \
-    ret = avfilter_graph_create_filter(&filt_ctx,                            \
-                                       avfilter_get_by_name(name),           \
-                                       "ffplay_" name, arg, NULL, graph);    \
-    if (ret < 0)                                                             \
-        goto fail;                                                           \
-                                                                             \
-    ret = avfilter_link(filt_ctx, 0, last_filter, 0);                        \
-    if (ret < 0)                                                             \
-        goto fail;                                                           \
-                                                                             \
-    last_filter = filt_ctx;                                                  \
-} while (0)
-
-    if (autorotate) {
-        double theta = get_rotation(is->video_st);
-
-        if (fabs(theta - 90) < 1.0) {
-            INSERT_FILT("transpose", "clock");
-        }
-        else if (fabs(theta - 180) < 1.0) {
-            INSERT_FILT("hflip", NULL);
-            INSERT_FILT("vflip", NULL);
-        }
-        else if (fabs(theta - 270) < 1.0) {
-            INSERT_FILT("transpose", "cclock");
-        }
-        else if (fabs(theta) > 1.0) {
-            char rotate_buf[64];
-            snprintf(rotate_buf, sizeof(rotate_buf), "%f*PI/180", theta);
-            INSERT_FILT("rotate", rotate_buf);
-        }
-    }
-
-    if ((ret = configure_filtergraph(graph, vfilters, filt_src, last_filter)) < 0)
-        goto fail;
-
-    is->in_video_filter = filt_src;
-    is->out_video_filter = filt_out;
-
-fail:
-    return ret;
-}
-
-static int configure_audio_filters(VideoState* is, const char* afilters, int force_output_format)
-{
-    static const enum AVSampleFormat sample_fmts[] = { AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_NONE };
-    int sample_rates[2] = { 0, -1 };
-    int64_t channel_layouts[2] = { 0, -1 };
-    int channels[2] = { 0, -1 };
-    AVFilterContext* filt_asrc = NULL, * filt_asink = NULL;
-    char aresample_swr_opts[512] = "";
-    AVDictionaryEntry* e = NULL;
-    char asrc_args[256];
-    int ret;
-
-    avfilter_graph_free(&is->agraph);
-    if (!(is->agraph = avfilter_graph_alloc()))
-        return AVERROR(ENOMEM);
-    is->agraph->nb_threads = filter_nbthreads;
-
-    while ((e = av_dict_get(swr_opts, "", e, AV_DICT_IGNORE_SUFFIX)))
-        av_strlcatf(aresample_swr_opts, sizeof(aresample_swr_opts), "%s=%s:", e->key, e->value);
-    if (strlen(aresample_swr_opts))
-        aresample_swr_opts[strlen(aresample_swr_opts) - 1] = '\0';
-    av_opt_set(is->agraph, "aresample_swr_opts", aresample_swr_opts, 0);
-
-    ret = snprintf(asrc_args, sizeof(asrc_args),
-        "sample_rate=%d:sample_fmt=%s:channels=%d:time_base=%d/%d",
-        is->audio_filter_src.freq, av_get_sample_fmt_name(is->audio_filter_src.fmt),
-        is->audio_filter_src.channels,
-        1, is->audio_filter_src.freq);
-    if (is->audio_filter_src.channel_layout)
-        snprintf(asrc_args + ret, sizeof(asrc_args) - ret,
-            ":channel_layout=0x%"PRIx64, is->audio_filter_src.channel_layout);
-
-    ret = avfilter_graph_create_filter(&filt_asrc,
-        avfilter_get_by_name("abuffer"), "ffplay_abuffer",
-        asrc_args, NULL, is->agraph);
-    if (ret < 0)
-        goto end;
-
-
-    ret = avfilter_graph_create_filter(&filt_asink,
-        avfilter_get_by_name("abuffersink"), "ffplay_abuffersink",
-        NULL, NULL, is->agraph);
-    if (ret < 0)
-        goto end;
-
-    if ((ret = av_opt_set_int_list(filt_asink, "sample_fmts", sample_fmts, AV_SAMPLE_FMT_NONE, AV_OPT_SEARCH_CHILDREN)) < 0)
-        goto end;
-    if ((ret = av_opt_set_int(filt_asink, "all_channel_counts", 1, AV_OPT_SEARCH_CHILDREN)) < 0)
-        goto end;
-
-    if (force_output_format) {
-        channel_layouts[0] = is->audio_tgt.channel_layout;
-        channels[0] = is->audio_tgt.channels;
-        sample_rates[0] = is->audio_tgt.freq;
-        if ((ret = av_opt_set_int(filt_asink, "all_channel_counts", 0, AV_OPT_SEARCH_CHILDREN)) < 0)
-            goto end;
-        if ((ret = av_opt_set_int_list(filt_asink, "channel_layouts", channel_layouts, -1, AV_OPT_SEARCH_CHILDREN)) < 0)
-            goto end;
-        if ((ret = av_opt_set_int_list(filt_asink, "channel_counts", channels, -1, AV_OPT_SEARCH_CHILDREN)) < 0)
-            goto end;
-        if ((ret = av_opt_set_int_list(filt_asink, "sample_rates", sample_rates, -1, AV_OPT_SEARCH_CHILDREN)) < 0)
-            goto end;
-    }
-
-
-    if ((ret = configure_filtergraph(is->agraph, afilters, filt_asrc, filt_asink)) < 0)
-        goto end;
-
-    is->in_audio_filter = filt_asrc;
-    is->out_audio_filter = filt_asink;
-
-end:
-    if (ret < 0)
-        avfilter_graph_free(&is->agraph);
-    return ret;
-}
-#endif  /* CONFIG_AVFILTER */
-
-static int audio_thread(void* pUserData)
-{
-    FMediaPlayer* is = static_cast<FMediaPlayer*>(pUserData);
-    AVFrame* frame = av_frame_alloc();
-    Frame* af;
-#if CONFIG_AVFILTER
-    int last_serial = -1;
-    int64_t dec_channel_layout;
-    int reconfigure;
-#endif
-    int got_frame = 0;
-    AVRational tb;
-    int ret = 0;
-
-    if (!frame)
-        return AVERROR(ENOMEM);
-
-    do {
-        if ((got_frame = decoder_decode_frame(&is->auddec, frame, NULL)) < 0)
-            goto the_end;
-
-        if (got_frame) {
-            tb = AVRational{ 1, frame->sample_rate };
-
-#if CONFIG_AVFILTER
-            dec_channel_layout = get_valid_channel_layout(frame->channel_layout, frame->channels);
-
-            reconfigure =
-                cmp_audio_fmts(is->audio_filter_src.fmt, is->audio_filter_src.channels,
-                    frame->format, frame->channels) ||
-                is->audio_filter_src.channel_layout != dec_channel_layout ||
-                is->audio_filter_src.freq != frame->sample_rate ||
-                is->auddec.pkt_serial != last_serial;
-
-            if (reconfigure) {
-                char buf1[1024], buf2[1024];
-                av_get_channel_layout_string(buf1, sizeof(buf1), -1, is->audio_filter_src.channel_layout);
-                av_get_channel_layout_string(buf2, sizeof(buf2), -1, dec_channel_layout);
-                av_log(NULL, AV_LOG_DEBUG,
-                    "Audio frame changed from rate:%d ch:%d fmt:%s layout:%s serial:%d to rate:%d ch:%d fmt:%s layout:%s serial:%d\n",
-                    is->audio_filter_src.freq, is->audio_filter_src.channels, av_get_sample_fmt_name(is->audio_filter_src.fmt), buf1, last_serial,
-                    frame->sample_rate, frame->channels, av_get_sample_fmt_name(frame->format), buf2, is->auddec.pkt_serial);
-
-                is->audio_filter_src.fmt = frame->format;
-                is->audio_filter_src.channels = frame->channels;
-                is->audio_filter_src.channel_layout = dec_channel_layout;
-                is->audio_filter_src.freq = frame->sample_rate;
-                last_serial = is->auddec.pkt_serial;
-
-                if ((ret = configure_audio_filters(is, afilters, 1)) < 0)
-                    goto the_end;
-            }
-
-            if ((ret = av_buffersrc_add_frame(is->in_audio_filter, frame)) < 0)
-                goto the_end;
-
-            while ((ret = av_buffersink_get_frame_flags(is->out_audio_filter, frame, 0)) >= 0) {
-                tb = av_buffersink_get_time_base(is->out_audio_filter);
-#endif
-                if (!(af = frame_queue_peek_writable(&is->sampq)))
-                    goto the_end;
-
-                af->pts = (frame->pts == AV_NOPTS_VALUE) ? NAN : frame->pts * av_q2d(tb);
-                af->pos = frame->pkt_pos;
-                af->serial = is->auddec.pkt_serial;
-                af->duration = av_q2d(AVRational { frame->nb_samples, frame->sample_rate });
-
-                av_frame_move_ref(af->frame, frame);
-                frame_queue_push(&is->sampq);
-
-#if CONFIG_AVFILTER
-                if (is->audioq.serial != is->auddec.pkt_serial)
-                    break;
-            }
-            if (ret == AVERROR_EOF)
-                is->auddec.finished = is->auddec.pkt_serial;
-#endif
-        }
-    } while (ret >= 0 || ret == AVERROR(EAGAIN) || ret == AVERROR_EOF);
-the_end:
-#if CONFIG_AVFILTER
-    avfilter_graph_free(&is->agraph);
-#endif
-    av_frame_free(&frame);
-    return ret;
-}
-
-static int decoder_start(Decoder* d, int (*fn)(void*), const char* thread_name, void* arg)
-{
-    packet_queue_start(d->queue);
-    d->decoder_tid = SDL_CreateThread(fn, thread_name, arg);
-    if (!d->decoder_tid) {
-        av_log(NULL, AV_LOG_ERROR, "SDL_CreateThread(): %s\n", SDL_GetError());
-        return AVERROR(ENOMEM);
-    }
-    return 0;
-}
-
-static int video_thread(void* pUserData)
-{
-    FMediaPlayer* is = static_cast<FMediaPlayer*>(pUserData);
-    AVFrame* frame = av_frame_alloc();
-    double pts;
-    double duration;
-    int ret;
-    AVRational tb = is->video_st->time_base;
-    AVRational frame_rate = av_guess_frame_rate(is->ic, is->video_st, NULL);
-
-#if CONFIG_AVFILTER
-    AVFilterGraph* graph = NULL;
-    AVFilterContext* filt_out = NULL, * filt_in = NULL;
-    int last_w = 0;
-    int last_h = 0;
-    enum AVPixelFormat last_format = -2;
-    int last_serial = -1;
-    int last_vfilter_idx = 0;
-#endif
-
-    if (!frame)
-        return AVERROR(ENOMEM);
-
-    for (;;) {
-        ret = get_video_frame(is, frame);
-        if (ret < 0)
-            goto the_end;
-        if (!ret)
-            continue;
-
-#if CONFIG_AVFILTER
-        if (last_w != frame->width
-            || last_h != frame->height
-            || last_format != frame->format
-            || last_serial != is->viddec.pkt_serial
-            || last_vfilter_idx != is->vfilter_idx) {
-            av_log(NULL, AV_LOG_DEBUG,
-                "Video frame changed from size:%dx%d format:%s serial:%d to size:%dx%d format:%s serial:%d\n",
-                last_w, last_h,
-                (const char*)av_x_if_null(av_get_pix_fmt_name(last_format), "none"), last_serial,
-                frame->width, frame->height,
-                (const char*)av_x_if_null(av_get_pix_fmt_name(frame->format), "none"), is->viddec.pkt_serial);
-            avfilter_graph_free(&graph);
-            graph = avfilter_graph_alloc();
-            if (!graph) {
-                ret = AVERROR(ENOMEM);
-                goto the_end;
-            }
-            graph->nb_threads = filter_nbthreads;
-            if ((ret = configure_video_filters(graph, is, vfilters_list ? vfilters_list[is->vfilter_idx] : NULL, frame)) < 0) {
-                SDL_Event event;
-                event.type = FF_QUIT_EVENT;
-                event.user.data1 = is;
-                SDL_PushEvent(&event);
-                goto the_end;
-            }
-            filt_in = is->in_video_filter;
-            filt_out = is->out_video_filter;
-            last_w = frame->width;
-            last_h = frame->height;
-            last_format = frame->format;
-            last_serial = is->viddec.pkt_serial;
-            last_vfilter_idx = is->vfilter_idx;
-            frame_rate = av_buffersink_get_frame_rate(filt_out);
-        }
-
-        ret = av_buffersrc_add_frame(filt_in, frame);
-        if (ret < 0)
-            goto the_end;
-
-        while (ret >= 0) {
-            is->frame_last_returned_time = av_gettime_relative() / 1000000.0;
-
-            ret = av_buffersink_get_frame_flags(filt_out, frame, 0);
-            if (ret < 0) {
-                if (ret == AVERROR_EOF)
-                    is->viddec.finished = is->viddec.pkt_serial;
-                ret = 0;
-                break;
-            }
-
-            is->frame_last_filter_delay = av_gettime_relative() / 1000000.0 - is->frame_last_returned_time;
-            if (fabs(is->frame_last_filter_delay) > AV_NOSYNC_THRESHOLD / 10.0)
-                is->frame_last_filter_delay = 0;
-            tb = av_buffersink_get_time_base(filt_out);
-#endif
-            duration = (frame_rate.num && frame_rate.den ? av_q2d(AVRational { frame_rate.den, frame_rate.num }) : 0);
-            pts = (frame->pts == AV_NOPTS_VALUE) ? NAN : frame->pts * av_q2d(tb);
-            ret = queue_picture(is, frame, pts, duration, frame->pkt_pos, is->viddec.pkt_serial);
-            av_frame_unref(frame);
-#if CONFIG_AVFILTER
-            if (is->videoq.serial != is->viddec.pkt_serial)
-                break;
-        }
-#endif
-
-        if (ret < 0)
-            goto the_end;
-    }
-the_end:
-#if CONFIG_AVFILTER
-    avfilter_graph_free(&graph);
-#endif
-    av_frame_free(&frame);
-    return 0;
-}
-
-static int subtitle_thread(void* pUserData)
-{
-    FMediaPlayer* is = static_cast<FMediaPlayer*>(pUserData);
-    Frame* sp;
-    int got_subtitle;
-    double pts;
-
-    for (;;) {
-        if (!(sp = frame_queue_peek_writable(&is->subpq)))
-            return 0;
-
-        if ((got_subtitle = decoder_decode_frame(&is->subdec, NULL, &sp->sub)) < 0)
-            break;
-
-        pts = 0;
-
-        if (got_subtitle && sp->sub.format == 0) {
-            if (sp->sub.pts != AV_NOPTS_VALUE)
-                pts = sp->sub.pts / (double)AV_TIME_BASE;
-            sp->pts = pts;
-            sp->serial = is->subdec.pkt_serial;
-            sp->width = is->subdec.avctx->width;
-            sp->height = is->subdec.avctx->height;
-            sp->uploaded = 0;
-
-            /* now we can update the picture count */
-            frame_queue_push(&is->subpq);
-        }
-        else if (got_subtitle) {
-            avsubtitle_free(&sp->sub);
-        }
-    }
-    return 0;
-}
-
-/* copy samples for viewing in editor window */
-static void update_sample_display(FMediaPlayer* is, short* samples, int samples_size)
-{
-    int size, len;
-
-    size = samples_size / sizeof(short);
-    while (size > 0) {
-        len = SAMPLE_ARRAY_SIZE - is->sample_array_index;
-        if (len > size)
-            len = size;
-        memcpy(is->sample_array + is->sample_array_index, samples, len * sizeof(short));
-        samples += len;
-        is->sample_array_index += len;
-        if (is->sample_array_index >= SAMPLE_ARRAY_SIZE)
-            is->sample_array_index = 0;
-        size -= len;
-    }
-}
-
-/* return the wanted number of samples to get better sync if sync_type is video
- * or external master clock */
-static int synchronize_audio(FMediaPlayer* is, int nb_samples)
-{
-    int wanted_nb_samples = nb_samples;
-
-    /* if not master, then we try to remove or add samples to correct the clock */
-    if (get_master_sync_type(is) != AV_SYNC_AUDIO_MASTER) {
-        double diff, avg_diff;
-        int min_nb_samples, max_nb_samples;
-
-        diff = get_clock(&is->audclk) - get_master_clock(is);
-
-        if (!isnan(diff) && fabs(diff) < AV_NOSYNC_THRESHOLD) {
-            is->audio_diff_cum = diff + is->audio_diff_avg_coef * is->audio_diff_cum;
-            if (is->audio_diff_avg_count < AUDIO_DIFF_AVG_NB) {
-                /* not enough measures to have a correct estimate */
-                is->audio_diff_avg_count++;
-            }
-            else {
-                /* estimate the A-V difference */
-                avg_diff = is->audio_diff_cum * (1.0 - is->audio_diff_avg_coef);
-
-                if (fabs(avg_diff) >= is->audio_diff_threshold) {
-                    wanted_nb_samples = nb_samples + (int)(diff * is->audio_src.freq);
-                    min_nb_samples = ((nb_samples * (100 - SAMPLE_CORRECTION_PERCENT_MAX) / 100));
-                    max_nb_samples = ((nb_samples * (100 + SAMPLE_CORRECTION_PERCENT_MAX) / 100));
-                    wanted_nb_samples = av_clip(wanted_nb_samples, min_nb_samples, max_nb_samples);
-                }
-                av_log(NULL, AV_LOG_TRACE, "diff=%f adiff=%f sample_diff=%d apts=%0.3f %f\n",
-                    diff, avg_diff, wanted_nb_samples - nb_samples,
-                    is->audio_clock, is->audio_diff_threshold);
-            }
-        }
-        else {
-            /* too big difference : may be initial PTS errors, so
-               reset A-V filter */
-            is->audio_diff_avg_count = 0;
-            is->audio_diff_cum = 0;
-        }
-    }
-
-    return wanted_nb_samples;
-}
-
-/**
- * Decode one audio frame and return its uncompressed size.
- *
- * The processed audio frame is decoded, converted if required, and
- * stored in is->audio_buf, with size in bytes given by the return
- * value.
- */
-static int audio_decode_frame(FMediaPlayer* is)
-{
-    int data_size, resampled_data_size;
-    int64_t dec_channel_layout;
-    av_unused double audio_clock0;
-    int wanted_nb_samples;
-    Frame* af;
-
-    if (is->paused)
-        return -1;
-
-    do {
-#if defined(_WIN32)
-        while (frame_queue_nb_remaining(&is->sampq) == 0) {
-            if ((av_gettime_relative() - audio_callback_time) > 1000000LL * is->audio_hw_buf_size / is->audio_tgt.bytes_per_sec / 2)
-                return -1;
-            av_usleep(1000);
-        }
-#endif
-        if (!(af = frame_queue_peek_readable(&is->sampq)))
-            return -1;
-        frame_queue_next(&is->sampq);
-    } while (af->serial != is->audioq.serial);
-
-    data_size = av_samples_get_buffer_size(NULL, af->frame->channels,af->frame->nb_samples, static_cast<AVSampleFormat>(af->frame->format), 1);
-
-    dec_channel_layout =
-        (af->frame->channel_layout && af->frame->channels == av_get_channel_layout_nb_channels(af->frame->channel_layout)) ?
-        af->frame->channel_layout : av_get_default_channel_layout(af->frame->channels);
-    wanted_nb_samples = synchronize_audio(is, af->frame->nb_samples);
-
-    if (af->frame->format != is->audio_src.fmt ||
-        dec_channel_layout != is->audio_src.channel_layout ||
-        af->frame->sample_rate != is->audio_src.freq ||
-        (wanted_nb_samples != af->frame->nb_samples && !is->swr_ctx)) {
-        swr_free(&is->swr_ctx);
-        is->swr_ctx = swr_alloc_set_opts(NULL,
-            is->audio_tgt.channel_layout, is->audio_tgt.fmt, is->audio_tgt.freq,
-            dec_channel_layout, static_cast<AVSampleFormat>(af->frame->format), af->frame->sample_rate,
-            0, NULL);
-        if (!is->swr_ctx || swr_init(is->swr_ctx) < 0) {
-            av_log(NULL, AV_LOG_ERROR,
-                "Cannot create sample rate converter for conversion of %d Hz %s %d channels to %d Hz %s %d channels!\n",
-                af->frame->sample_rate, av_get_sample_fmt_name(static_cast<AVSampleFormat>(af->frame->format)), af->frame->channels,
-                is->audio_tgt.freq, av_get_sample_fmt_name(is->audio_tgt.fmt), is->audio_tgt.channels);
-            swr_free(&is->swr_ctx);
-            return -1;
-        }
-        is->audio_src.channel_layout = dec_channel_layout;
-        is->audio_src.channels = af->frame->channels;
-        is->audio_src.freq = af->frame->sample_rate;
-        is->audio_src.fmt = static_cast<AVSampleFormat>(af->frame->format);
-    }
-
-    if (is->swr_ctx) {
-        const uint8_t** in = (const uint8_t**)af->frame->extended_data;
-        uint8_t** out = &is->audio_buf1;
-        int out_count = (int64_t)wanted_nb_samples * is->audio_tgt.freq / af->frame->sample_rate + 256;
-        int out_size = av_samples_get_buffer_size(NULL, is->audio_tgt.channels, out_count, is->audio_tgt.fmt, 0);
-        int len2;
-        if (out_size < 0) {
-            av_log(NULL, AV_LOG_ERROR, "av_samples_get_buffer_size() failed\n");
-            return -1;
-        }
-        if (wanted_nb_samples != af->frame->nb_samples) {
-            if (swr_set_compensation(is->swr_ctx, (wanted_nb_samples - af->frame->nb_samples) * is->audio_tgt.freq / af->frame->sample_rate,
-                wanted_nb_samples * is->audio_tgt.freq / af->frame->sample_rate) < 0) {
-                av_log(NULL, AV_LOG_ERROR, "swr_set_compensation() failed\n");
-                return -1;
-            }
-        }
-        av_fast_malloc(&is->audio_buf1, &is->audio_buf1_size, out_size);
-        if (!is->audio_buf1)
-            return AVERROR(ENOMEM);
-        len2 = swr_convert(is->swr_ctx, out, out_count, in, af->frame->nb_samples);
-        if (len2 < 0) {
-            av_log(NULL, AV_LOG_ERROR, "swr_convert() failed\n");
-            return -1;
-        }
-        if (len2 == out_count) {
-            av_log(NULL, AV_LOG_WARNING, "audio buffer is probably too small\n");
-            if (swr_init(is->swr_ctx) < 0)
-                swr_free(&is->swr_ctx);
-        }
-        is->audio_buf = is->audio_buf1;
-        resampled_data_size = len2 * is->audio_tgt.channels * av_get_bytes_per_sample(is->audio_tgt.fmt);
-    }
-    else {
-        is->audio_buf = af->frame->data[0];
-        resampled_data_size = data_size;
-    }
-
-    audio_clock0 = is->audio_clock;
-    /* update the audio clock with the pts */
-    if (!isnan(af->pts))
-        is->audio_clock = af->pts + (double)af->frame->nb_samples / af->frame->sample_rate;
-    else
-        is->audio_clock = NAN;
-    is->audio_clock_serial = af->serial;
-#ifdef DEBUG
-    {
-        static double last_clock;
-        printf("audio: delay=%0.3f clock=%0.3f clock0=%0.3f\n",
-            is->audio_clock - last_clock,
-            is->audio_clock, audio_clock0);
-        last_clock = is->audio_clock;
-    }
-#endif
-    return resampled_data_size;
-}
-
-/* prepare a new audio buffer */
-static void sdl_audio_callback(void* pUserData, Uint8* stream, int len)
-{
-    FMediaPlayer* is = static_cast<FMediaPlayer*>(pUserData);
-    int audio_size, len1;
-
-    audio_callback_time = av_gettime_relative();
-
-    while (len > 0) {
-        if (is->audio_buf_index >= is->audio_buf_size) {
-            audio_size = audio_decode_frame(is);
-            if (audio_size < 0) {
-                /* if error, just output silence */
-                is->audio_buf = NULL;
-                is->audio_buf_size = SDL_AUDIO_MIN_BUFFER_SIZE / is->audio_tgt.frame_size * is->audio_tgt.frame_size;
-            }
-            else {
-                if (is->eShow_mode != FMediaPlayer::EShowMode::SHOW_MODE_VIDEO)
-                    update_sample_display(is, (int16_t*)is->audio_buf, audio_size);
-                is->audio_buf_size = audio_size;
-            }
-            is->audio_buf_index = 0;
-        }
-        len1 = is->audio_buf_size - is->audio_buf_index;
-        if (len1 > len)
-            len1 = len;
-        if (!is->muted && is->audio_buf && is->audio_volume == SDL_MIX_MAXVOLUME)
-            memcpy(stream, (uint8_t*)is->audio_buf + is->audio_buf_index, len1);
-        else {
-            memset(stream, 0, len1);
-            if (!is->muted && is->audio_buf)
-                SDL_MixAudioFormat(stream, (uint8_t*)is->audio_buf + is->audio_buf_index, AUDIO_S16SYS, len1, is->audio_volume);
-        }
-        len -= len1;
-        stream += len1;
-        is->audio_buf_index += len1;
-    }
-    is->audio_write_buf_size = is->audio_buf_size - is->audio_buf_index;
-    /* Let's assume the audio driver that is used by SDL has two periods. */
-    if (!isnan(is->audio_clock)) {
-        set_clock_at(&is->audclk, is->audio_clock - (double)(2 * is->audio_hw_buf_size + is->audio_write_buf_size) / is->audio_tgt.bytes_per_sec, is->audio_clock_serial, audio_callback_time / 1000000.0);
-        sync_clock_to_slave(&is->extclk, &is->audclk);
-    }
-}
-
-static int audio_open(void* opaque, int64_t wanted_channel_layout, int wanted_nb_channels, int wanted_sample_rate, struct AudioParams* audio_hw_params)
-{
-    SDL_AudioSpec wanted_spec, spec;
-    const char* env;
-    static const int next_nb_channels[] = { 0, 0, 1, 6, 2, 6, 4, 6 };
-    static const int next_sample_rates[] = { 0, 44100, 48000, 96000, 192000 };
-    int next_sample_rate_idx = FF_ARRAY_ELEMS(next_sample_rates) - 1;
-
-    env = SDL_getenv("SDL_AUDIO_CHANNELS");
-    if (env) {
-        wanted_nb_channels = atoi(env);
-        wanted_channel_layout = av_get_default_channel_layout(wanted_nb_channels);
-    }
-    if (!wanted_channel_layout || wanted_nb_channels != av_get_channel_layout_nb_channels(wanted_channel_layout)) {
-        wanted_channel_layout = av_get_default_channel_layout(wanted_nb_channels);
-        wanted_channel_layout &= ~AV_CH_LAYOUT_STEREO_DOWNMIX;
-    }
-    wanted_nb_channels = av_get_channel_layout_nb_channels(wanted_channel_layout);
-    wanted_spec.channels = wanted_nb_channels;
-    wanted_spec.freq = wanted_sample_rate;
-    if (wanted_spec.freq <= 0 || wanted_spec.channels <= 0) {
-        av_log(NULL, AV_LOG_ERROR, "Invalid sample rate or channel count!\n");
-        return -1;
-    }
-    while (next_sample_rate_idx && next_sample_rates[next_sample_rate_idx] >= wanted_spec.freq)
-        next_sample_rate_idx--;
-    wanted_spec.format = AUDIO_S16SYS;
-    wanted_spec.silence = 0;
-    wanted_spec.samples = FFMAX(SDL_AUDIO_MIN_BUFFER_SIZE, 2 << av_log2(wanted_spec.freq / SDL_AUDIO_MAX_CALLBACKS_PER_SEC));
-    wanted_spec.callback = sdl_audio_callback;
-    wanted_spec.userdata = opaque;
-    while (!(audio_dev = SDL_OpenAudioDevice(NULL, 0, &wanted_spec, &spec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_CHANNELS_CHANGE))) {
-        av_log(NULL, AV_LOG_WARNING, "SDL_OpenAudio (%d channels, %d Hz): %s\n",
-            wanted_spec.channels, wanted_spec.freq, SDL_GetError());
-        wanted_spec.channels = next_nb_channels[FFMIN(7, wanted_spec.channels)];
-        if (!wanted_spec.channels) {
-            wanted_spec.freq = next_sample_rates[next_sample_rate_idx--];
-            wanted_spec.channels = wanted_nb_channels;
-            if (!wanted_spec.freq) {
-                av_log(NULL, AV_LOG_ERROR,
-                    "No more combinations to try, audio open failed\n");
-                return -1;
-            }
-        }
-        wanted_channel_layout = av_get_default_channel_layout(wanted_spec.channels);
-    }
-    if (spec.format != AUDIO_S16SYS) {
-        av_log(NULL, AV_LOG_ERROR,
-            "SDL advised audio format %d is not supported!\n", spec.format);
-        return -1;
-    }
-    if (spec.channels != wanted_spec.channels) {
-        wanted_channel_layout = av_get_default_channel_layout(spec.channels);
-        if (!wanted_channel_layout) {
-            av_log(NULL, AV_LOG_ERROR,
-                "SDL advised channel count %d is not supported!\n", spec.channels);
-            return -1;
-        }
-    }
-
-    audio_hw_params->fmt = AV_SAMPLE_FMT_S16;
-    audio_hw_params->freq = spec.freq;
-    audio_hw_params->channel_layout = wanted_channel_layout;
-    audio_hw_params->channels = spec.channels;
-    audio_hw_params->frame_size = av_samples_get_buffer_size(NULL, audio_hw_params->channels, 1, audio_hw_params->fmt, 1);
-    audio_hw_params->bytes_per_sec = av_samples_get_buffer_size(NULL, audio_hw_params->channels, audio_hw_params->freq, audio_hw_params->fmt, 1);
-    if (audio_hw_params->bytes_per_sec <= 0 || audio_hw_params->frame_size <= 0) {
-        av_log(NULL, AV_LOG_ERROR, "av_samples_get_buffer_size failed\n");
-        return -1;
-    }
-    return spec.size;
-}
-
-/* open a given stream. Return 0 if OK */
-static int stream_component_open(FMediaPlayer* is, int stream_index)
-{
-    AVFormatContext* ic = is->ic;
-    AVCodecContext* avctx;
-    AVCodec* codec;
-    const char* forced_codec_name = NULL;
-    AVDictionary* opts = NULL;
-    AVDictionaryEntry* t = NULL;
-    int sample_rate, nb_channels;
-    int64_t channel_layout;
-    int ret = 0;
-    int stream_lowres = lowres;
-
-    if (stream_index < 0 || stream_index >= ic->nb_streams)
-        return -1;
-
-    avctx = avcodec_alloc_context3(NULL);
-    if (!avctx)
-        return AVERROR(ENOMEM);
-
-    ret = avcodec_parameters_to_context(avctx, ic->streams[stream_index]->codecpar);
-    if (ret < 0)
-        goto fail;
-    avctx->pkt_timebase = ic->streams[stream_index]->time_base;
-
-    codec = avcodec_find_decoder(avctx->codec_id);
-
-    switch (avctx->codec_type) {
-    case AVMEDIA_TYPE_AUDIO: is->last_audio_stream = stream_index; forced_codec_name = audio_codec_name; break;
-    case AVMEDIA_TYPE_SUBTITLE: is->last_subtitle_stream = stream_index; forced_codec_name = subtitle_codec_name; break;
-    case AVMEDIA_TYPE_VIDEO: is->last_video_stream = stream_index; forced_codec_name = video_codec_name; break;
-    }
-    if (forced_codec_name)
-        codec = avcodec_find_decoder_by_name(forced_codec_name);
-    if (!codec) {
-        if (forced_codec_name) av_log(NULL, AV_LOG_WARNING,
-            "No codec could be found with name '%s'\n", forced_codec_name);
-        else                   av_log(NULL, AV_LOG_WARNING,
-            "No decoder could be found for codec %s\n", avcodec_get_name(avctx->codec_id));
-        ret = AVERROR(EINVAL);
-        goto fail;
-    }
-
-    avctx->codec_id = codec->id;
-    if (stream_lowres > codec->max_lowres) {
-        av_log(avctx, AV_LOG_WARNING, "The maximum value for lowres supported by the decoder is %d\n",
-            codec->max_lowres);
-        stream_lowres = codec->max_lowres;
-    }
-    avctx->lowres = stream_lowres;
-
-    if (fast)
-        avctx->flags2 |= AV_CODEC_FLAG2_FAST;
-
-    opts = filter_codec_opts(codec_opts, avctx->codec_id, ic, ic->streams[stream_index], codec);
-    if (!av_dict_get(opts, "threads", NULL, 0))
-        av_dict_set(&opts, "threads", "auto", 0);
-    if (stream_lowres)
-        av_dict_set_int(&opts, "lowres", stream_lowres, 0);
-    if (avctx->codec_type == AVMEDIA_TYPE_VIDEO || avctx->codec_type == AVMEDIA_TYPE_AUDIO)
-        av_dict_set(&opts, "refcounted_frames", "1", 0);
-    if ((ret = avcodec_open2(avctx, codec, &opts)) < 0) {
-        goto fail;
-    }
-    if ((t = av_dict_get(opts, "", NULL, AV_DICT_IGNORE_SUFFIX))) {
-        av_log(NULL, AV_LOG_ERROR, "Option %s not found.\n", t->key);
-        ret = AVERROR_OPTION_NOT_FOUND;
-        goto fail;
-    }
-
-    is->eof = 0;
-    ic->streams[stream_index]->discard = AVDISCARD_DEFAULT;
-    switch (avctx->codec_type) {
-    case AVMEDIA_TYPE_AUDIO:
-#if CONFIG_AVFILTER
-    {
-        AVFilterContext* sink;
-
-        is->audio_filter_src.freq = avctx->sample_rate;
-        is->audio_filter_src.channels = avctx->channels;
-        is->audio_filter_src.channel_layout = get_valid_channel_layout(avctx->channel_layout, avctx->channels);
-        is->audio_filter_src.fmt = avctx->sample_fmt;
-        if ((ret = configure_audio_filters(is, afilters, 0)) < 0)
-            goto fail;
-        sink = is->out_audio_filter;
-        sample_rate = av_buffersink_get_sample_rate(sink);
-        nb_channels = av_buffersink_get_channels(sink);
-        channel_layout = av_buffersink_get_channel_layout(sink);
-    }
-#else
-        sample_rate = avctx->sample_rate;
-        nb_channels = avctx->channels;
-        channel_layout = avctx->channel_layout;
-#endif
-
-        /* prepare audio output */
-        if ((ret = audio_open(is, channel_layout, nb_channels, sample_rate, &is->audio_tgt)) < 0)
-            goto fail;
-        is->audio_hw_buf_size = ret;
-        is->audio_src = is->audio_tgt;
-        is->audio_buf_size = 0;
-        is->audio_buf_index = 0;
-
-        /* init averaging filter */
-        is->audio_diff_avg_coef = exp(log(0.01) / AUDIO_DIFF_AVG_NB);
-        is->audio_diff_avg_count = 0;
-        /* since we do not have a precise anough audio FIFO fullness,
-           we correct audio sync only if larger than this threshold */
-        is->audio_diff_threshold = (double)(is->audio_hw_buf_size) / is->audio_tgt.bytes_per_sec;
-
-        is->audio_stream = stream_index;
-        is->audio_st = ic->streams[stream_index];
-
-        decoder_init(&is->auddec, avctx, &is->audioq, is->continue_read_thread);
-        if ((is->ic->iformat->flags & (AVFMT_NOBINSEARCH | AVFMT_NOGENSEARCH | AVFMT_NO_BYTE_SEEK)) && !is->ic->iformat->read_seek) {
-            is->auddec.start_pts = is->audio_st->start_time;
-            is->auddec.start_pts_tb = is->audio_st->time_base;
-        }
-        if ((ret = decoder_start(&is->auddec, audio_thread, "audio_decoder", is)) < 0)
-            goto out;
-        SDL_PauseAudioDevice(audio_dev, 0);
-        break;
-    case AVMEDIA_TYPE_VIDEO:
-        is->video_stream = stream_index;
-        is->video_st = ic->streams[stream_index];
-
-        decoder_init(&is->viddec, avctx, &is->videoq, is->continue_read_thread);
-        if ((ret = decoder_start(&is->viddec, video_thread, "video_decoder", is)) < 0)
-            goto out;
-        is->queue_attachments_req = 1;
-        break;
-    case AVMEDIA_TYPE_SUBTITLE:
-        is->subtitle_stream = stream_index;
-        is->subtitle_st = ic->streams[stream_index];
-
-        decoder_init(&is->subdec, avctx, &is->subtitleq, is->continue_read_thread);
-        if ((ret = decoder_start(&is->subdec, subtitle_thread, "subtitle_decoder", is)) < 0)
-            goto out;
-        break;
-    default:
-        break;
-    }
-    goto out;
-
-fail:
-    avcodec_free_context(&avctx);
-out:
-    av_dict_free(&opts);
-
-    return ret;
-}
-
-static int decode_interrupt_cb(void* pUserData)
-{
-    FMediaPlayer* is = static_cast<FMediaPlayer*>(pUserData);
-    return is->abort_request;
-}
-
-static int stream_has_enough_packets(AVStream* st, int stream_id, PacketQueue* queue) {
-    return stream_id < 0 ||
-        queue->abort_request ||
-        (st->disposition & AV_DISPOSITION_ATTACHED_PIC) ||
-        queue->nb_packets > MIN_FRAMES && (!queue->duration || av_q2d(st->time_base) * queue->duration > 1.0);
-}
-
-static int is_realtime(AVFormatContext* s)
-{
-    if (!strcmp(s->iformat->name, "rtp")
-        || !strcmp(s->iformat->name, "rtsp")
-        || !strcmp(s->iformat->name, "sdp")
-        )
-        return 1;
-
-    if (s->pb && (!strncmp(s->url, "rtp:", 4)
-        || !strncmp(s->url, "udp:", 4)
-        )
-        )
-        return 1;
-    return 0;
-}
-
-/* this thread gets the stream from the disk or the network */
-static int read_thread(void* pUserData)
-{
-    FMediaPlayer* is = static_cast<FMediaPlayer*>(pUserData);
-    AVFormatContext* ic = NULL;
-    int err, i, ret;
-    int st_index[AVMEDIA_TYPE_NB];
-    AVPacket pkt1, * pkt = &pkt1;
-    int64_t stream_start_time;
-    int pkt_in_play_range = 0;
-    AVDictionaryEntry* t;
-    SDL_mutex* wait_mutex = SDL_CreateMutex();
-    int scan_all_pmts_set = 0;
-    int64_t pkt_ts;
-
-    if (!wait_mutex) {
-        av_log(NULL, AV_LOG_FATAL, "SDL_CreateMutex(): %s\n", SDL_GetError());
-        ret = AVERROR(ENOMEM);
-        goto fail;
-    }
-
-    memset(st_index, -1, sizeof(st_index));
-    is->last_video_stream = is->video_stream = -1;
-    is->last_audio_stream = is->audio_stream = -1;
-    is->last_subtitle_stream = is->subtitle_stream = -1;
-    is->eof = 0;
-
-    ic = avformat_alloc_context();
-    if (!ic) {
-        av_log(NULL, AV_LOG_FATAL, "Could not allocate context.\n");
-        ret = AVERROR(ENOMEM);
-        goto fail;
-    }
-    ic->interrupt_callback.callback = decode_interrupt_cb;
-    ic->interrupt_callback.opaque = is;
-    if (!av_dict_get(format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE)) {
-        av_dict_set(&format_opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
-        scan_all_pmts_set = 1;
-    }
-    err = avformat_open_input(&ic, is->filename, is->iformat, &format_opts);
-    if (err < 0) {
-        print_error(is->filename, err);
-        ret = -1;
-        goto fail;
-    }
-    if (scan_all_pmts_set)
-        av_dict_set(&format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE);
-
-    if ((t = av_dict_get(format_opts, "", NULL, AV_DICT_IGNORE_SUFFIX))) {
-        av_log(NULL, AV_LOG_ERROR, "Option %s not found.\n", t->key);
-        ret = AVERROR_OPTION_NOT_FOUND;
-        goto fail;
-    }
-    is->ic = ic;
-
-    if (genpts)
-        ic->flags |= AVFMT_FLAG_GENPTS;
-
-    av_format_inject_global_side_data(ic);
-
-    if (find_stream_info) {
-        AVDictionary** opts = setup_find_stream_info_opts(ic, codec_opts);
-        int orig_nb_streams = ic->nb_streams;
-
-        err = avformat_find_stream_info(ic, opts);
-
-        for (i = 0; i < orig_nb_streams; i++)
-            av_dict_free(&opts[i]);
-        av_freep(&opts);
-
-        if (err < 0) {
-            av_log(NULL, AV_LOG_WARNING,
-                "%s: could not find codec parameters\n", is->filename);
-            ret = -1;
-            goto fail;
-        }
-    }
-
-    if (ic->pb)
-        ic->pb->eof_reached = 0; // FIXME hack, ffplay maybe should not use avio_feof() to test for the end
-
-    if (seek_by_bytes < 0)
-        seek_by_bytes = !!(ic->iformat->flags & AVFMT_TS_DISCONT) && strcmp("ogg", ic->iformat->name);
-
-    is->max_frame_duration = (ic->iformat->flags & AVFMT_TS_DISCONT) ? 10.0 : 3600.0;
-
-    if (!window_title && (t = av_dict_get(ic->metadata, "title", NULL, 0)))
-        window_title = av_asprintf("%s - %s", t->value, input_filename);
-
-    /* if seeking requested, we execute it */
-    if (start_time != AV_NOPTS_VALUE) {
-        int64_t timestamp;
-
-        timestamp = start_time;
-        /* add the stream start time */
-        if (ic->start_time != AV_NOPTS_VALUE)
-            timestamp += ic->start_time;
-        ret = avformat_seek_file(ic, -1, INT64_MIN, timestamp, INT64_MAX, 0);
-        if (ret < 0) {
-            av_log(NULL, AV_LOG_WARNING, "%s: could not seek to position %0.3f\n",
-                is->filename, (double)timestamp / AV_TIME_BASE);
-        }
-    }
-
-    is->realtime = is_realtime(ic);
-
-    if (show_status)
-        av_dump_format(ic, 0, is->filename, 0);
-
-    for (i = 0; i < ic->nb_streams; i++) {
-        AVStream* st = ic->streams[i];
-        enum AVMediaType type = st->codecpar->codec_type;
-        st->discard = AVDISCARD_ALL;
-        if (type >= 0 && wanted_stream_spec[type] && st_index[type] == -1)
-            if (avformat_match_stream_specifier(ic, st, wanted_stream_spec[type]) > 0)
-                st_index[type] = i;
-    }
-    for (i = 0; i < AVMEDIA_TYPE_NB; i++) {
-        if (wanted_stream_spec[i] && st_index[i] == -1) {
-            av_log(NULL, AV_LOG_ERROR, "Stream specifier %s does not match any %s stream\n", wanted_stream_spec[i], av_get_media_type_string(static_cast<AVMediaType>(i)));
-            st_index[i] = INT_MAX;
-        }
-    }
-
-    if (!video_disable)
-        st_index[AVMEDIA_TYPE_VIDEO] =
-        av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO,
-            st_index[AVMEDIA_TYPE_VIDEO], -1, NULL, 0);
-    if (!audio_disable)
-        st_index[AVMEDIA_TYPE_AUDIO] =
-        av_find_best_stream(ic, AVMEDIA_TYPE_AUDIO,
-            st_index[AVMEDIA_TYPE_AUDIO],
-            st_index[AVMEDIA_TYPE_VIDEO],
-            NULL, 0);
-    if (!video_disable && !subtitle_disable)
-        st_index[AVMEDIA_TYPE_SUBTITLE] =
-        av_find_best_stream(ic, AVMEDIA_TYPE_SUBTITLE,
-            st_index[AVMEDIA_TYPE_SUBTITLE],
-            (st_index[AVMEDIA_TYPE_AUDIO] >= 0 ?
-                st_index[AVMEDIA_TYPE_AUDIO] :
-                st_index[AVMEDIA_TYPE_VIDEO]),
-            NULL, 0);
-
-    is->eShow_mode = show_mode;
-    if (st_index[AVMEDIA_TYPE_VIDEO] >= 0) {
-        AVStream* st = ic->streams[st_index[AVMEDIA_TYPE_VIDEO]];
-        AVCodecParameters* codecpar = st->codecpar;
-        AVRational sar = av_guess_sample_aspect_ratio(ic, st, NULL);
-        if (codecpar->width)
-            set_default_window_size(codecpar->width, codecpar->height, sar);
-    }
-
-    /* open the streams */
-    if (st_index[AVMEDIA_TYPE_AUDIO] >= 0) {
-        stream_component_open(is, st_index[AVMEDIA_TYPE_AUDIO]);
-    }
-
-    ret = -1;
-    if (st_index[AVMEDIA_TYPE_VIDEO] >= 0) {
-        ret = stream_component_open(is, st_index[AVMEDIA_TYPE_VIDEO]);
-    }
-    if (is->eShow_mode == FMediaPlayer::EShowMode::SHOW_MODE_NONE)
-        is->eShow_mode = ret >= 0 ? FMediaPlayer::EShowMode::SHOW_MODE_VIDEO : FMediaPlayer::EShowMode::SHOW_MODE_RDFT;
-
-    if (st_index[AVMEDIA_TYPE_SUBTITLE] >= 0) {
-        stream_component_open(is, st_index[AVMEDIA_TYPE_SUBTITLE]);
-    }
-
-    if (is->video_stream < 0 && is->audio_stream < 0) {
-        av_log(NULL, AV_LOG_FATAL, "Failed to open file '%s' or configure filtergraph\n",
-            is->filename);
-        ret = -1;
-        goto fail;
-    }
-
-    if (infinite_buffer < 0 && is->realtime)
-        infinite_buffer = 1;
-
-    for (;;) {
-        if (is->abort_request)
-            break;
-        if (is->paused != is->last_paused) {
-            is->last_paused = is->paused;
-            if (is->paused)
-                is->read_pause_return = av_read_pause(ic);
-            else
-                av_read_play(ic);
-        }
-#if CONFIG_RTSP_DEMUXER || CONFIG_MMSH_PROTOCOL
-        if (is->paused &&
-            (!strcmp(ic->iformat->name, "rtsp") ||
-            (ic->pb && !strncmp(input_filename, "mmsh:", 5)))) {
-            /* wait 10 ms to avoid trying to get another packet */
-            /* XXX: horrible */
-            SDL_Delay(10);
-            continue;
-        }
-#endif
-        if (is->seek_req) {
-            int64_t seek_target = is->seek_pos;
-            int64_t seek_min = is->seek_rel > 0 ? seek_target - is->seek_rel + 2 : INT64_MIN;
-            int64_t seek_max = is->seek_rel < 0 ? seek_target - is->seek_rel - 2 : INT64_MAX;
-            // FIXME the +-2 is due to rounding being not done in the correct direction in generation
-            //      of the seek_pos/seek_rel variables
-
-            ret = avformat_seek_file(is->ic, -1, seek_min, seek_target, seek_max, is->seek_flags);
-            if (ret < 0) {
-                av_log(NULL, AV_LOG_ERROR,
-                    "%s: error while seeking\n", is->ic->url);
-            }
-            else {
-                if (is->audio_stream >= 0) {
-                    packet_queue_flush(&is->audioq);
-                    packet_queue_put(&is->audioq, &flush_pkt);
-                }
-                if (is->subtitle_stream >= 0) {
-                    packet_queue_flush(&is->subtitleq);
-                    packet_queue_put(&is->subtitleq, &flush_pkt);
-                }
-                if (is->video_stream >= 0) {
-                    packet_queue_flush(&is->videoq);
-                    packet_queue_put(&is->videoq, &flush_pkt);
-                }
-                if (is->seek_flags & AVSEEK_FLAG_BYTE) {
-                    set_clock(&is->extclk, NAN, 0);
-                }
-                else {
-                    set_clock(&is->extclk, seek_target / (double)AV_TIME_BASE, 0);
-                }
-            }
-            is->seek_req = 0;
-            is->queue_attachments_req = 1;
-            is->eof = 0;
-            if (is->paused)
-                step_to_next_frame(is);
-        }
-        if (is->queue_attachments_req) {
-            if (is->video_st && is->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC) {
-                AVPacket copy = { 0 };
-                if ((ret = av_packet_ref(&copy, &is->video_st->attached_pic)) < 0)
-                    goto fail;
-                packet_queue_put(&is->videoq, &copy);
-                packet_queue_put_nullpacket(&is->videoq, is->video_stream);
-            }
-            is->queue_attachments_req = 0;
-        }
-
-        /* if the queue are full, no need to read more */
-        if (infinite_buffer < 1 &&
-            (is->audioq.size + is->videoq.size + is->subtitleq.size > MAX_QUEUE_SIZE
-                || (stream_has_enough_packets(is->audio_st, is->audio_stream, &is->audioq) &&
-                    stream_has_enough_packets(is->video_st, is->video_stream, &is->videoq) &&
-                    stream_has_enough_packets(is->subtitle_st, is->subtitle_stream, &is->subtitleq)))) {
-            /* wait 10 ms */
-            SDL_LockMutex(wait_mutex);
-            SDL_CondWaitTimeout(is->continue_read_thread, wait_mutex, 10);
-            SDL_UnlockMutex(wait_mutex);
-            continue;
-        }
-        if (!is->paused &&
-            (!is->audio_st || (is->auddec.finished == is->audioq.serial && frame_queue_nb_remaining(&is->sampq) == 0)) &&
-            (!is->video_st || (is->viddec.finished == is->videoq.serial && frame_queue_nb_remaining(&is->pictq) == 0))) {
-            if (loop != 1 && (!loop || --loop)) {
-                stream_seek(is, start_time != AV_NOPTS_VALUE ? start_time : 0, 0, 0);
-            }
-            else if (autoexit) {
-                ret = AVERROR_EOF;
-                goto fail;
-            }
-        }
-        ret = av_read_frame(ic, pkt);
-        if (ret < 0) {
-            if ((ret == AVERROR_EOF || avio_feof(ic->pb)) && !is->eof) {
-                if (is->video_stream >= 0)
-                    packet_queue_put_nullpacket(&is->videoq, is->video_stream);
-                if (is->audio_stream >= 0)
-                    packet_queue_put_nullpacket(&is->audioq, is->audio_stream);
-                if (is->subtitle_stream >= 0)
-                    packet_queue_put_nullpacket(&is->subtitleq, is->subtitle_stream);
-                is->eof = 1;
-            }
-            if (ic->pb && ic->pb->error)
-                break;
-            SDL_LockMutex(wait_mutex);
-            SDL_CondWaitTimeout(is->continue_read_thread, wait_mutex, 10);
-            SDL_UnlockMutex(wait_mutex);
-            continue;
-        }
-        else {
-            is->eof = 0;
-        }
-        /* check if packet is in play range specified by user, then queue, otherwise discard */
-        stream_start_time = ic->streams[pkt->stream_index]->start_time;
-        pkt_ts = pkt->pts == AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
-        pkt_in_play_range = duration == AV_NOPTS_VALUE ||
-            (pkt_ts - (stream_start_time != AV_NOPTS_VALUE ? stream_start_time : 0)) *
-            av_q2d(ic->streams[pkt->stream_index]->time_base) -
-            (double)(start_time != AV_NOPTS_VALUE ? start_time : 0) / 1000000
-            <= ((double)duration / 1000000);
-        if (pkt->stream_index == is->audio_stream && pkt_in_play_range) {
-            packet_queue_put(&is->audioq, pkt);
-        }
-        else if (pkt->stream_index == is->video_stream && pkt_in_play_range
-            && !(is->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
-            packet_queue_put(&is->videoq, pkt);
-        }
-        else if (pkt->stream_index == is->subtitle_stream && pkt_in_play_range) {
-            packet_queue_put(&is->subtitleq, pkt);
-        }
-        else {
-            av_packet_unref(pkt);
-        }
-    }
-
-    ret = 0;
-fail:
-    if (ic && !is->ic)
-        avformat_close_input(&ic);
-
-    if (ret != 0) {
-        SDL_Event event;
-
-        event.type = FF_QUIT_EVENT;
-        event.user.data1 = is;
-        SDL_PushEvent(&event);
-    }
-    SDL_DestroyMutex(wait_mutex);
-    return 0;
-}
-
-static FMediaPlayer* stream_open(const char* filename, AVInputFormat* iformat)
-{
-    FMediaPlayer* pPlayer;
-
-    pPlayer = static_cast<FMediaPlayer*>(av_mallocz(sizeof(FMediaPlayer)));
-    if (!pPlayer)
-        return NULL;
-    pPlayer->filename = av_strdup(filename);
-    if (!pPlayer->filename)
-        goto fail;
-    pPlayer->iformat = iformat;
-    pPlayer->ytop = 0;
-    pPlayer->xleft = 0;
-
-    /* start video display */
-    if (frame_queue_init(&pPlayer->pictq, &pPlayer->videoq, VIDEO_PICTURE_QUEUE_SIZE, 1) < 0)
-        goto fail;
-    if (frame_queue_init(&pPlayer->subpq, &pPlayer->subtitleq, SUBPICTURE_QUEUE_SIZE, 0) < 0)
-        goto fail;
-    if (frame_queue_init(&pPlayer->sampq, &pPlayer->audioq, SAMPLE_QUEUE_SIZE, 1) < 0)
-        goto fail;
-
-    if (packet_queue_init(&pPlayer->videoq) < 0 ||
-        packet_queue_init(&pPlayer->audioq) < 0 ||
-        packet_queue_init(&pPlayer->subtitleq) < 0)
-        goto fail;
-
-    if (!(pPlayer->continue_read_thread = SDL_CreateCond())) {
-        av_log(NULL, AV_LOG_FATAL, "SDL_CreateCond(): %s\n", SDL_GetError());
-        goto fail;
-    }
-
-    init_clock(&pPlayer->vidclk, &pPlayer->videoq.serial);
-    init_clock(&pPlayer->audclk, &pPlayer->audioq.serial);
-    init_clock(&pPlayer->extclk, &pPlayer->extclk.serial);
-    pPlayer->audio_clock_serial = -1;
-    if (startup_volume < 0)
-        av_log(NULL, AV_LOG_WARNING, "-volume=%d < 0, setting to 0\n", startup_volume);
-    if (startup_volume > 100)
-        av_log(NULL, AV_LOG_WARNING, "-volume=%d > 100, setting to 100\n", startup_volume);
-    startup_volume = av_clip(startup_volume, 0, 100);
-    startup_volume = av_clip(SDL_MIX_MAXVOLUME * startup_volume / 100, 0, SDL_MIX_MAXVOLUME);
-    pPlayer->audio_volume = startup_volume;
-    pPlayer->muted = 0;
-    pPlayer->av_sync_type = av_sync_type;
-    pPlayer->read_tid = SDL_CreateThread(read_thread, "read_thread", pPlayer);
-    if (!pPlayer->read_tid) {
-        av_log(NULL, AV_LOG_FATAL, "SDL_CreateThread(): %s\n", SDL_GetError());
-    fail:
-        stream_close(pPlayer);
-        return NULL;
-    }
-    return pPlayer;
-}
-
-static void stream_cycle_channel(FMediaPlayer* pPlayer, int codec_type)
-{
-    AVFormatContext* ic = pPlayer->ic;
-    int start_index, stream_index;
-    int old_index;
-    AVStream* st;
-    AVProgram* p = NULL;
-    int nb_streams = pPlayer->ic->nb_streams;
-
-    if (codec_type == AVMEDIA_TYPE_VIDEO) {
-        start_index = pPlayer->last_video_stream;
-        old_index = pPlayer->video_stream;
-    }
-    else if (codec_type == AVMEDIA_TYPE_AUDIO) {
-        start_index = pPlayer->last_audio_stream;
-        old_index = pPlayer->audio_stream;
-    }
-    else {
-        start_index = pPlayer->last_subtitle_stream;
-        old_index = pPlayer->subtitle_stream;
-    }
-    stream_index = start_index;
-
-    if (codec_type != AVMEDIA_TYPE_VIDEO && pPlayer->video_stream != -1) {
-        p = av_find_program_from_stream(ic, NULL, pPlayer->video_stream);
-        if (p) {
-            nb_streams = p->nb_stream_indexes;
-            for (start_index = 0; start_index < nb_streams; start_index++)
-                if (p->stream_index[start_index] == stream_index)
-                    break;
-            if (start_index == nb_streams)
-                start_index = -1;
-            stream_index = start_index;
-        }
-    }
-
-    for (;;) {
-        if (++stream_index >= nb_streams)
-        {
-            if (codec_type == AVMEDIA_TYPE_SUBTITLE)
-            {
-                stream_index = -1;
-                pPlayer->last_subtitle_stream = -1;
-                goto the_end;
-            }
-            if (start_index == -1)
-                return;
-            stream_index = 0;
-        }
-        if (stream_index == start_index)
-            return;
-        st = pPlayer->ic->streams[p ? p->stream_index[stream_index] : stream_index];
-        if (st->codecpar->codec_type == codec_type) {
-            /* check that parameters are OK */
-            switch (codec_type) {
-            case AVMEDIA_TYPE_AUDIO:
-                if (st->codecpar->sample_rate != 0 &&
-                    st->codecpar->channels != 0)
-                    goto the_end;
-                break;
-            case AVMEDIA_TYPE_VIDEO:
-            case AVMEDIA_TYPE_SUBTITLE:
-                goto the_end;
-            default:
-                break;
-            }
-        }
-    }
-the_end:
-    if (p && stream_index != -1)
-        stream_index = p->stream_index[stream_index];
-    av_log(NULL, AV_LOG_INFO, "Switch %s stream from #%d to #%d\n", av_get_media_type_string(static_cast<AVMediaType>(codec_type)), old_index, stream_index);
-
-    stream_component_close(pPlayer, old_index);
-    stream_component_open(pPlayer, stream_index);
-}
-
-
-static void toggle_full_screen(FMediaPlayer* pPlayer)
-{
-    is_full_screen = !is_full_screen;
-    SDL_SetWindowFullscreen(window, is_full_screen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0);
-}
-
-static void toggle_audio_display(FMediaPlayer* pPlayer)
-{
-    int next = static_cast<int>(pPlayer->eShow_mode);
-    do {
-        next = (next + 1) % int(FMediaPlayer::EShowMode::SHOW_MODE_NB);
-    } while (next != int(pPlayer->eShow_mode) && (next == int(FMediaPlayer::EShowMode::SHOW_MODE_VIDEO) && !pPlayer->video_st || next != int(FMediaPlayer::EShowMode::SHOW_MODE_VIDEO) && !pPlayer->audio_st));
-    if (int(pPlayer->eShow_mode) != next) {
-        pPlayer->force_refresh = 1;
-        pPlayer->eShow_mode = FMediaPlayer::EShowMode(next);
-    }
-}
-
-static void refresh_loop_wait_event(FMediaPlayer* pPlayer, SDL_Event* event) {
-    double remaining_time = 0.0;
-    SDL_PumpEvents();
-    while (!SDL_PeepEvents(event, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT)) {
-        if (!cursor_hidden && av_gettime_relative() - cursor_last_shown > CURSOR_HIDE_DELAY) {
-            SDL_ShowCursor(0);
-            cursor_hidden = 1;
-        }
-        if (remaining_time > 0.0)
-            av_usleep((int64_t)(remaining_time * 1000000.0));
-        remaining_time = REFRESH_RATE;
-        if (pPlayer->eShow_mode != FMediaPlayer::EShowMode::SHOW_MODE_NONE && (!pPlayer->paused || pPlayer->force_refresh))
-            video_refresh(pPlayer, &remaining_time);
-        SDL_PumpEvents();
-    }
-}
-
-static void seek_chapter(FMediaPlayer* pPlayer, int incr)
-{
-    int64_t pos = get_master_clock(pPlayer) * AV_TIME_BASE;
-    int i;
-
-    if (!pPlayer->ic->nb_chapters)
-        return;
-
-    /* find the current chapter */
-    for (i = 0; i < pPlayer->ic->nb_chapters; i++) {
-        AVChapter* ch = pPlayer->ic->chapters[i];
-        if (av_compare_ts(pos, AVRational{ 1, AV_TIME_BASE }, ch->start, ch->time_base) < 0) {
-            i--;
-            break;
-        }
-    }
-
-    i += incr;
-    i = FFMAX(i, 0);
-    if (i >= pPlayer->ic->nb_chapters)
-        return;
-
-    av_log(NULL, AV_LOG_VERBOSE, "Seeking to chapter %d.\n", i);
-    stream_seek(pPlayer, av_rescale_q(pPlayer->ic->chapters[i]->start, pPlayer->ic->chapters[i]->time_base,
-        AVRational{1, AV_TIME_BASE}), 0, 0);
-}
-
-/* handle an event sent by the GUI */
-static void event_loop(FMediaPlayer* cur_stream)
-{
-    SDL_Event event;
-    double incr, pos, frac;
-
-    for (;;) {
-        double x;
-        refresh_loop_wait_event(cur_stream, &event);
-        switch (event.type) {
-        case SDL_KEYDOWN:
-            if (exit_on_keydown || event.key.keysym.sym == SDLK_ESCAPE || event.key.keysym.sym == SDLK_q) {
-                do_exit(cur_stream);
-                break;
-            }
-            // If we don't yet have a window, skip all key events, because read_thread might still be initializing...
-            if (!cur_stream->width)
-                continue;
-            switch (event.key.keysym.sym) {
-            case SDLK_f:
-                toggle_full_screen(cur_stream);
-                cur_stream->force_refresh = 1;
-                break;
-            case SDLK_p:
-            case SDLK_SPACE:
-                toggle_pause(cur_stream);
-                break;
-            case SDLK_m:
-                toggle_mute(cur_stream);
-                break;
-            case SDLK_KP_MULTIPLY:
-            case SDLK_0:
-                update_volume(cur_stream, 1, SDL_VOLUME_STEP);
-                break;
-            case SDLK_KP_DIVIDE:
-            case SDLK_9:
-                update_volume(cur_stream, -1, SDL_VOLUME_STEP);
-                break;
-            case SDLK_s: // S: Step to next frame
-                step_to_next_frame(cur_stream);
-                break;
-            case SDLK_a:
-                stream_cycle_channel(cur_stream, AVMEDIA_TYPE_AUDIO);
-                break;
-            case SDLK_v:
-                stream_cycle_channel(cur_stream, AVMEDIA_TYPE_VIDEO);
-                break;
-            case SDLK_c:
-                stream_cycle_channel(cur_stream, AVMEDIA_TYPE_VIDEO);
-                stream_cycle_channel(cur_stream, AVMEDIA_TYPE_AUDIO);
-                stream_cycle_channel(cur_stream, AVMEDIA_TYPE_SUBTITLE);
-                break;
-            case SDLK_t:
-                stream_cycle_channel(cur_stream, AVMEDIA_TYPE_SUBTITLE);
-                break;
-            case SDLK_w:
-#if CONFIG_AVFILTER
-                if (cur_stream->show_mode == SHOW_MODE_VIDEO && cur_stream->vfilter_idx < nb_vfilters - 1) {
-                    if (++cur_stream->vfilter_idx >= nb_vfilters)
-                        cur_stream->vfilter_idx = 0;
-                }
-                else {
-                    cur_stream->vfilter_idx = 0;
-                    toggle_audio_display(cur_stream);
-                }
-#else
-                toggle_audio_display(cur_stream);
-#endif
-                break;
-            case SDLK_PAGEUP:
-                if (cur_stream->ic->nb_chapters <= 1) {
-                    incr = 600.0;
-                    goto do_seek;
-                }
-                seek_chapter(cur_stream, 1);
-                break;
-            case SDLK_PAGEDOWN:
-                if (cur_stream->ic->nb_chapters <= 1) {
-                    incr = -600.0;
-                    goto do_seek;
-                }
-                seek_chapter(cur_stream, -1);
-                break;
-            case SDLK_LEFT:
-                incr = seek_interval ? -seek_interval : -10.0;
-                goto do_seek;
-            case SDLK_RIGHT:
-                incr = seek_interval ? seek_interval : 10.0;
-                goto do_seek;
-            case SDLK_UP:
-                incr = 60.0;
-                goto do_seek;
-            case SDLK_DOWN:
-                incr = -60.0;
-            do_seek:
-                if (seek_by_bytes) {
-                    pos = -1;
-                    if (pos < 0 && cur_stream->video_stream >= 0)
-                        pos = frame_queue_last_pos(&cur_stream->pictq);
-                    if (pos < 0 && cur_stream->audio_stream >= 0)
-                        pos = frame_queue_last_pos(&cur_stream->sampq);
-                    if (pos < 0)
-                        pos = avio_tell(cur_stream->ic->pb);
-                    if (cur_stream->ic->bit_rate)
-                        incr *= cur_stream->ic->bit_rate / 8.0;
-                    else
-                        incr *= 180000.0;
-                    pos += incr;
-                    stream_seek(cur_stream, pos, incr, 1);
-                }
-                else {
-                    pos = get_master_clock(cur_stream);
-                    if (isnan(pos))
-                        pos = (double)cur_stream->seek_pos / AV_TIME_BASE;
-                    pos += incr;
-                    if (cur_stream->ic->start_time != AV_NOPTS_VALUE && pos < cur_stream->ic->start_time / (double)AV_TIME_BASE)
-                        pos = cur_stream->ic->start_time / (double)AV_TIME_BASE;
-                    stream_seek(cur_stream, (int64_t)(pos * AV_TIME_BASE), (int64_t)(incr * AV_TIME_BASE), 0);
-                }
-                break;
-            default:
-                break;
-            }
-            break;
-        case SDL_MOUSEBUTTONDOWN:
-            if (exit_on_mousedown) {
-                do_exit(cur_stream);
-                break;
-            }
-            if (event.button.button == SDL_BUTTON_LEFT) {
-                static int64_t last_mouse_left_click = 0;
-                if (av_gettime_relative() - last_mouse_left_click <= 500000) {
-                    toggle_full_screen(cur_stream);
-                    cur_stream->force_refresh = 1;
-                    last_mouse_left_click = 0;
-                }
-                else {
-                    last_mouse_left_click = av_gettime_relative();
-                }
-            }
-        case SDL_MOUSEMOTION:
-            if (cursor_hidden) {
-                SDL_ShowCursor(1);
-                cursor_hidden = 0;
-            }
-            cursor_last_shown = av_gettime_relative();
-            if (event.type == SDL_MOUSEBUTTONDOWN) {
-                if (event.button.button != SDL_BUTTON_RIGHT)
-                    break;
-                x = event.button.x;
-            }
-            else {
-                if (!(event.motion.state & SDL_BUTTON_RMASK))
-                    break;
-                x = event.motion.x;
-            }
-            if (seek_by_bytes || cur_stream->ic->duration <= 0) {
-                uint64_t size = avio_size(cur_stream->ic->pb);
-                stream_seek(cur_stream, size * x / cur_stream->width, 0, 1);
-            }
-            else {
-                int64_t ts;
-                int ns, hh, mm, ss;
-                int tns, thh, tmm, tss;
-                tns = cur_stream->ic->duration / 1000000LL;
-                thh = tns / 3600;
-                tmm = (tns % 3600) / 60;
-                tss = (tns % 60);
-                frac = x / cur_stream->width;
-                ns = frac * tns;
-                hh = ns / 3600;
-                mm = (ns % 3600) / 60;
-                ss = (ns % 60);
-                av_log(NULL, AV_LOG_INFO,
-                    "Seek to %2.0f%% (%2d:%02d:%02d) of total duration (%2d:%02d:%02d)       \n", frac * 100,
-                    hh, mm, ss, thh, tmm, tss);
-                ts = frac * cur_stream->ic->duration;
-                if (cur_stream->ic->start_time != AV_NOPTS_VALUE)
-                    ts += cur_stream->ic->start_time;
-                stream_seek(cur_stream, ts, 0, 0);
-            }
-            break;
-        case SDL_WINDOWEVENT:
-            switch (event.window.event) {
-            case SDL_WINDOWEVENT_SIZE_CHANGED:
-                screen_width = cur_stream->width = event.window.data1;
-                screen_height = cur_stream->height = event.window.data2;
-                if (cur_stream->vis_texture) {
-                    SDL_DestroyTexture(cur_stream->vis_texture);
-                    cur_stream->vis_texture = NULL;
-                }
-            case SDL_WINDOWEVENT_EXPOSED:
-                cur_stream->force_refresh = 1;
-            }
-            break;
-        case SDL_QUIT:
-        case FF_QUIT_EVENT:
-            do_exit(cur_stream);
-            break;
-        default:
-            break;
-        }
-    }
-}
-
-static int opt_frame_size(void* optctx, const char* opt, const char* arg)
-{
-    av_log(NULL, AV_LOG_WARNING, "Option -s is deprecated, use -video_size.\n");
-    return opt_default(NULL, "video_size", arg);
-}
-
-static int opt_width(void* optctx, const char* opt, const char* arg)
-{
-    screen_width = parse_number_or_die(opt, arg, OPT_INT64, 1, INT_MAX);
-    return 0;
-}
-
-static int opt_height(void* optctx, const char* opt, const char* arg)
-{
-    screen_height = parse_number_or_die(opt, arg, OPT_INT64, 1, INT_MAX);
-    return 0;
-}
-
-static int opt_format(void* optctx, const char* opt, const char* arg)
-{
-    file_iformat = av_find_input_format(arg);
-    if (!file_iformat) {
-        av_log(NULL, AV_LOG_FATAL, "Unknown input format: %s\n", arg);
-        return AVERROR(EINVAL);
-    }
-    return 0;
-}
-
-static int opt_frame_pix_fmt(void* optctx, const char* opt, const char* arg)
-{
-    av_log(NULL, AV_LOG_WARNING, "Option -pix_fmt is deprecated, use -pixel_format.\n");
-    return opt_default(NULL, "pixel_format", arg);
-}
-
-static int opt_sync(void* optctx, const char* opt, const char* arg)
-{
-    if (!strcmp(arg, "audio"))
-        av_sync_type = AV_SYNC_AUDIO_MASTER;
-    else if (!strcmp(arg, "video"))
-        av_sync_type = AV_SYNC_VIDEO_MASTER;
-    else if (!strcmp(arg, "ext"))
-        av_sync_type = AV_SYNC_EXTERNAL_CLOCK;
-    else {
-        av_log(NULL, AV_LOG_ERROR, "Unknown value for %s: %s\n", opt, arg);
-        exit(1);
-    }
-    return 0;
-}
-
-static int opt_seek(void* optctx, const char* opt, const char* arg)
-{
-    start_time = parse_time_or_die(opt, arg, 1);
-    return 0;
-}
-
-static int opt_duration(void* optctx, const char* opt, const char* arg)
-{
-    duration = parse_time_or_die(opt, arg, 1);
-    return 0;
-}
-
-static int opt_show_mode(void* optctx, const char* opt, const char* arg)
-{
-    show_mode = !strcmp(arg, "video") ? FMediaPlayer::EShowMode::SHOW_MODE_VIDEO :
-        !strcmp(arg, "waves") ? FMediaPlayer::EShowMode::SHOW_MODE_WAVES :
-        !strcmp(arg, "rdft") ? FMediaPlayer::EShowMode::SHOW_MODE_RDFT : FMediaPlayer::EShowMode(int(parse_number_or_die(opt, arg, OPT_INT, 0, double(int(FMediaPlayer::EShowMode::SHOW_MODE_NB) - 1))));
-    return 0;
-}
-
-static void opt_input_file(void* optctx, const char* filename)
-{
-    if (input_filename) {
-        av_log(NULL, AV_LOG_FATAL,
-            "Argument '%s' provided as input filename, but '%s' was already specified.\n",
-            filename, input_filename);
-        exit(1);
-    }
-    if (!strcmp(filename, "-"))
-        filename = "pipe:";
-    input_filename = filename;
-}
-
-static int opt_codec(void* optctx, const char* opt, const char* arg)
-{
-    const char* spec = strchr(opt, ':');
-    if (!spec) {
-        av_log(NULL, AV_LOG_ERROR,
-            "No media specifier was specified in '%s' in option '%s'\n",
-            arg, opt);
-        return AVERROR(EINVAL);
-    }
-    spec++;
-    switch (spec[0]) {
-    case 'a':    audio_codec_name = arg; break;
-    case 's': subtitle_codec_name = arg; break;
-    case 'v':    video_codec_name = arg; break;
-    default:
-        av_log(NULL, AV_LOG_ERROR,
-            "Invalid media specifier '%s' in option '%s'\n", spec, opt);
-        return AVERROR(EINVAL);
-    }
-    return 0;
-}
-
-static int dummy;
-
-static const OptionDef options[] = {
-    //CMDUTILS_COMMON_OPTIONS
-    { "x", HAS_ARG, /*{.func_arg = */opt_width/* }*/, "force displayed width", "width" },
-    { "y", HAS_ARG, /*{.func_arg = */opt_height/* }*/, "force displayed height", "height" },
-    { "s", HAS_ARG | OPT_VIDEO,/* {.func_arg = */opt_frame_size/* }*/, "set frame size (WxH or abbreviation)", "size" },
-    { "fs", OPT_BOOL, { &is_full_screen }, "force full screen" },
-    { "an", OPT_BOOL, { &audio_disable }, "disable audio" },
-    { "vn", OPT_BOOL, { &video_disable }, "disable video" },
-    { "sn", OPT_BOOL, { &subtitle_disable }, "disable subtitling" },
-    { "ast", OPT_STRING | HAS_ARG | OPT_EXPERT, { &wanted_stream_spec[AVMEDIA_TYPE_AUDIO] }, "select desired audio stream", "stream_specifier" },
-    { "vst", OPT_STRING | HAS_ARG | OPT_EXPERT, { &wanted_stream_spec[AVMEDIA_TYPE_VIDEO] }, "select desired video stream", "stream_specifier" },
-    { "sst", OPT_STRING | HAS_ARG | OPT_EXPERT, { &wanted_stream_spec[AVMEDIA_TYPE_SUBTITLE] }, "select desired subtitle stream", "stream_specifier" },
-    { "ss", HAS_ARG, /*{.func_arg = */opt_seek/* }*/, "seek to a given position in seconds", "pos" },
-    { "t", HAS_ARG, /*{.func_arg = */opt_duration/* }*/, "play  \"duration\" seconds of audio/video", "duration" },
-    { "bytes", OPT_INT | HAS_ARG, { &seek_by_bytes }, "seek by bytes 0=off 1=on -1=auto", "val" },
-    { "seek_interval", OPT_FLOAT | HAS_ARG, { &seek_interval }, "set seek interval for left/right keys, in seconds", "seconds" },
-    { "nodisp", OPT_BOOL, { &display_disable }, "disable graphical display" },
-    { "noborder", OPT_BOOL, { &borderless }, "borderless window" },
-    { "alwaysontop", OPT_BOOL, { &alwaysontop }, "window always on top" },
-    { "volume", OPT_INT | HAS_ARG, { &startup_volume}, "set startup volume 0=min 100=max", "volume" },
-    { "f", HAS_ARG,/* {.func_arg = */opt_format/* }*/, "force format", "fmt" },
-    { "pix_fmt", HAS_ARG | OPT_EXPERT | OPT_VIDEO, /*{.func_arg = */opt_frame_pix_fmt/* }*/, "set pixel format", "format" },
-    { "stats", OPT_BOOL | OPT_EXPERT, { &show_status }, "show status", "" },
-    { "fast", OPT_BOOL | OPT_EXPERT, { &fast }, "non spec compliant optimizations", "" },
-    { "genpts", OPT_BOOL | OPT_EXPERT, { &genpts }, "generate pts", "" },
-    { "drp", OPT_INT | HAS_ARG | OPT_EXPERT, { &decoder_reorder_pts }, "let decoder reorder pts 0=off 1=on -1=auto", ""},
-    { "lowres", OPT_INT | HAS_ARG | OPT_EXPERT, { &lowres }, "", "" },
-    { "sync", HAS_ARG | OPT_EXPERT,/* {.func_arg = */opt_sync/* }*/, "set audio-video sync. type (type=audio/video/ext)", "type" },
-    { "autoexit", OPT_BOOL | OPT_EXPERT, { &autoexit }, "exit at the end", "" },
-    { "exitonkeydown", OPT_BOOL | OPT_EXPERT, { &exit_on_keydown }, "exit on key down", "" },
-    { "exitonmousedown", OPT_BOOL | OPT_EXPERT, { &exit_on_mousedown }, "exit on mouse down", "" },
-    { "loop", OPT_INT | HAS_ARG | OPT_EXPERT, { &loop }, "set number of times the playback shall be looped", "loop count" },
-    { "framedrop", OPT_BOOL | OPT_EXPERT, { &framedrop }, "drop frames when cpu is too slow", "" },
-    { "infbuf", OPT_BOOL | OPT_EXPERT, { &infinite_buffer }, "don't limit the input buffer size (useful with realtime streams)", "" },
-    { "window_title", OPT_STRING | HAS_ARG, { &window_title }, "set window title", "window title" },
-    { "left", OPT_INT | HAS_ARG | OPT_EXPERT, { &screen_left }, "set the x position for the left of the window", "x pos" },
-    { "top", OPT_INT | HAS_ARG | OPT_EXPERT, { &screen_top }, "set the y position for the top of the window", "y pos" },
-#if CONFIG_AVFILTER
-    { "vf", OPT_EXPERT | HAS_ARG, {.func_arg = opt_add_vfilter }, "set video filters", "filter_graph" },
-    { "af", OPT_STRING | HAS_ARG, { &afilters }, "set audio filters", "filter_graph" },
-#endif
-    { "rdftspeed", OPT_INT | HAS_ARG | OPT_AUDIO | OPT_EXPERT, { &rdftspeed }, "rdft speed", "msecs" },
-    { "showmode", HAS_ARG, /*{.func_arg = */opt_show_mode/*}*/, "select show mode (0 = video, 1 = waves, 2 = RDFT)", "mode" },
-    { "default", HAS_ARG | OPT_AUDIO | OPT_VIDEO | OPT_EXPERT, /*{.func_arg = */opt_default/* }*/, "generic catch all option", "" },
-    { "i", OPT_BOOL, { &dummy}, "read specified file", "input_file"},
-    { "codec", HAS_ARG,/* {.func_arg = */opt_codec/*}*/, "force decoder", "decoder_name" },
-    { "acodec", HAS_ARG | OPT_STRING | OPT_EXPERT, {    &audio_codec_name }, "force audio decoder",    "decoder_name" },
-    { "scodec", HAS_ARG | OPT_STRING | OPT_EXPERT, { &subtitle_codec_name }, "force subtitle decoder", "decoder_name" },
-    { "vcodec", HAS_ARG | OPT_STRING | OPT_EXPERT, {    &video_codec_name }, "force video decoder",    "decoder_name" },
-    { "autorotate", OPT_BOOL, { &autorotate }, "automatically rotate video", "" },
-    { "find_stream_info", OPT_BOOL | OPT_INPUT | OPT_EXPERT, { &find_stream_info },
-        "read and decode the streams to fill missing information with heuristics" },
-    { "filter_threads", HAS_ARG | OPT_INT | OPT_EXPERT, { &filter_nbthreads }, "number of filter threads per graph" },
-    { NULL, },
-};
-
-static void show_usage(void)
-{
-    av_log(NULL, AV_LOG_INFO, "Simple media player\n");
-    av_log(NULL, AV_LOG_INFO, "usage: %s [options] input_file\n", program_name);
-    av_log(NULL, AV_LOG_INFO, "\n");
-}
-
-void show_help_default(const char* opt, const char* arg)
-{
-    av_log_set_callback(log_callback_help);
-    show_usage();
-    show_help_options(options, "Main options:", 0, OPT_EXPERT, 0);
-    show_help_options(options, "Advanced options:", OPT_EXPERT, 0, 0);
-    printf("\n");
-    show_help_children(avcodec_get_class(), AV_OPT_FLAG_DECODING_PARAM);
-    show_help_children(avformat_get_class(), AV_OPT_FLAG_DECODING_PARAM);
-#if !CONFIG_AVFILTER
-    show_help_children(sws_get_class(), AV_OPT_FLAG_ENCODING_PARAM);
-#else
-    show_help_children(avfilter_get_class(), AV_OPT_FLAG_FILTERING_PARAM);
-#endif
-    printf("\nWhile playing:\n"
-        "q, ESC              quit\n"
-        "f                   toggle full screen\n"
-        "p, SPC              pause\n"
-        "m                   toggle mute\n"
-        "9, 0                decrease and increase volume respectively\n"
-        "/, *                decrease and increase volume respectively\n"
-        "a                   cycle audio channel in the current program\n"
-        "v                   cycle video channel\n"
-        "t                   cycle subtitle channel in the current program\n"
-        "c                   cycle program\n"
-        "w                   cycle video filters or show modes\n"
-        "s                   activate frame-step mode\n"
-        "left/right          seek backward/forward 10 seconds or to custom interval if -seek_interval is set\n"
-        "down/up             seek backward/forward 1 minute\n"
-        "page down/page up   seek backward/forward 10 minutes\n"
-        "right mouse click   seek to percentage in file corresponding to fraction of width\n"
-        "left double-click   toggle full screen\n"
-    );
-}
-
-/* Called from the main */
-int main(int argc, char** argv)
-{
-    int flags;
-    FMediaPlayer* is;
-
-    init_dynload();
-
-    av_log_set_flags(AV_LOG_SKIP_REPEATED);
-    parse_loglevel(argc, argv, options);
-
-    /* register all codecs, demux and protocols */
-#if CONFIG_AVDEVICE
-    avdevice_register_all();
-#endif
-    avformat_network_init();
-
-    init_opts();
-
-    signal(SIGINT, sigterm_handler); /* Interrupt (ANSI).    */
-    signal(SIGTERM, sigterm_handler); /* Termination (ANSI).  */
-
-    show_banner(argc, argv, options);
-
-    parse_options(NULL, argc, argv, options, opt_input_file);
-
-    if (!input_filename) {
-        show_usage();
-        av_log(NULL, AV_LOG_FATAL, "An input file must be specified\n");
-        av_log(NULL, AV_LOG_FATAL,
-            "Use -h to get full help or, even better, run 'man %s'\n", program_name);
-        exit(1);
-    }
-
-    if (display_disable) {
-        video_disable = 1;
-    }
-    flags = SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER;
-    if (audio_disable)
-        flags &= ~SDL_INIT_AUDIO;
-    else {
-        /* Try to work around an occasional ALSA buffer underflow issue when the
-         * period size is NPOT due to ALSA resampling by forcing the buffer size. */
-        if (!SDL_getenv("SDL_AUDIO_ALSA_SET_BUFFER_SIZE"))
-            SDL_setenv("SDL_AUDIO_ALSA_SET_BUFFER_SIZE", "1", 1);
-    }
-    if (display_disable)
-        flags &= ~SDL_INIT_VIDEO;
-    if (SDL_Init(flags)) {
-        av_log(NULL, AV_LOG_FATAL, "Could not initialize SDL - %s\n", SDL_GetError());
-        av_log(NULL, AV_LOG_FATAL, "(Did you set the DISPLAY variable?)\n");
-        exit(1);
-    }
-
-    SDL_EventState(SDL_SYSWMEVENT, SDL_IGNORE);
-    SDL_EventState(SDL_USEREVENT, SDL_IGNORE);
-
-    av_init_packet(&flush_pkt);
-    flush_pkt.data = (uint8_t*)&flush_pkt;
-
-    if (!display_disable) {
-        int flags = SDL_WINDOW_HIDDEN;
-        if (alwaysontop)
-#if SDL_VERSION_ATLEAST(2,0,5)
-            flags |= SDL_WINDOW_ALWAYS_ON_TOP;
-#else
-            av_log(NULL, AV_LOG_WARNING, "Your SDL version doesn't support SDL_WINDOW_ALWAYS_ON_TOP. Feature will be inactive.\n");
-#endif
-        if (borderless)
-            flags |= SDL_WINDOW_BORDERLESS;
-        else
-            flags |= SDL_WINDOW_RESIZABLE;
-        window = SDL_CreateWindow(program_name, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, default_width, default_height, flags);
-        SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
-        if (window) {
-            renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-            if (!renderer) {
-                av_log(NULL, AV_LOG_WARNING, "Failed to initialize a hardware accelerated renderer: %s\n", SDL_GetError());
-                renderer = SDL_CreateRenderer(window, -1, 0);
-            }
-            if (renderer) {
-                if (!SDL_GetRendererInfo(renderer, &renderer_info))
-                    av_log(NULL, AV_LOG_VERBOSE, "Initialized %s renderer.\n", renderer_info.name);
-            }
-        }
-        if (!window || !renderer || !renderer_info.num_texture_formats) {
-            av_log(NULL, AV_LOG_FATAL, "Failed to create window or renderer: %s", SDL_GetError());
-            do_exit(NULL);
-        }
-    }
-
-    is = stream_open(input_filename, file_iformat);
-    if (!is) {
-        av_log(NULL, AV_LOG_FATAL, "Failed to initialize VideoState!\n");
-        do_exit(NULL);
-    }
-
-    event_loop(is);
-
-    /* never returns */
-
-    return 0;
-}
+
+#include <cassert>
+#include <string>
+#include <codecvt>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <memory>
+
+extern "C"
+{
+    #include "config.h"
+    #include <inttypes.h>
+    #include <math.h>
+    #include <limits.h>
+    #include <signal.h>
+    #include <stdint.h>
+    
+    #include "libavutil/avstring.h"
+    #include "libavutil/eval.h"
+    #include "libavutil/mathematics.h"
+    #include "libavutil/pixdesc.h"
+    #include "libavutil/imgutils.h"
+    #include "libavutil/dict.h"
+    #include "libavutil/parseutils.h"
+    #include "libavutil/samplefmt.h"
+    #include "libavutil/avassert.h"
+    #include "libavutil/time.h"
+    #include "libavutil/cpu.h"
+    #include "libavutil/mastering_display_metadata.h"
+    #include "libavformat/avformat.h"
+    #include "libavdevice/avdevice.h"
+    #include "libswscale/swscale.h"
+    #include "libavutil/opt.h"
+    #include "libavcodec/avfft.h"
+    #include "libswresample/swresample.h"
+    
+    #if CONFIG_AVFILTER
+    # include "libavfilter/avfilter.h"
+    # include "libavfilter/buffersink.h"
+    # include "libavfilter/buffersrc.h"
+    #endif
+    
+    #include <SDL.h>
+    #include <SDL_thread.h>
+    
+    #include "cmdutils.h"
+}
+
+#include <assert.h>
+#if ARCH_X86
+#include <immintrin.h>
+#endif
+#if HAVE_VIRTUALALLOC
+#include <windows.h>
+#elif HAVE_MMAP
+#include <sys/mman.h>
+#endif
+
+/* functions using instruction sets beyond the compiler's baseline, called
+ * only after checking av_get_cpu_flags() */
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+const char program_name[] = "ffplay";
+const int program_birth_year = 2003;
+
+/* hard limit on buffered packet bytes, normally the time targets stop reading long before */
+#define MAX_QUEUE_SIZE (256 * 1024 * 1024)
+/* read space of a spill file reclaimed at once, at least */
+#define PACKET_SPILL_COMPACT_SIZE (4 * 1024 * 1024)
+/* buffer targets in seconds: read until every stream has BUFFER_MAX_TIME
+ * buffered, resume once one of them drains below BUFFER_MIN_TIME */
+#define BUFFER_MIN_TIME 1.0
+#define BUFFER_MAX_TIME 5.0
+/* target in packets for streams without packet durations */
+#define MIN_FRAMES 25
+#define EXTERNAL_CLOCK_MIN_FRAMES 2
+#define EXTERNAL_CLOCK_MAX_FRAMES 10
+
+/* Minimum SDL audio buffer size, in samples. */
+#define SDL_AUDIO_MIN_BUFFER_SIZE 512
+/* Calculate actual buffer size keeping in mind not cause too frequent audio callbacks */
+#define SDL_AUDIO_MAX_CALLBACKS_PER_SEC 30
+
+/* Step size for volume control in dB */
+#define SDL_VOLUME_STEP (0.75)
+
+/* no AV sync correction is done if below the minimum AV sync threshold */
+#define AV_SYNC_THRESHOLD_MIN 0.04
+/* AV sync correction is done if above the maximum AV sync threshold */
+#define AV_SYNC_THRESHOLD_MAX 0.1
+/* If a frame duration is longer than this, it will not be duplicated to compensate AV sync */
+#define AV_SYNC_FRAMEDUP_THRESHOLD 0.1
+/* no AV correction is done if too big error */
+#define AV_NOSYNC_THRESHOLD 10.0
+
+/* maximum audio speed change to get correct sync */
+#define SAMPLE_CORRECTION_PERCENT_MAX 10
+
+/* external clock speed adjustment constants for realtime sources based on buffer fullness */
+#define EXTERNAL_CLOCK_SPEED_MIN  0.900
+#define EXTERNAL_CLOCK_SPEED_MAX  1.010
+#define EXTERNAL_CLOCK_SPEED_STEP 0.001
+
+/* we use about AUDIO_DIFF_AVG_NB A-V differences to make the average */
+#define AUDIO_DIFF_AVG_NB   20
+
+/* polls for possible required screen refresh at least this often, should be less than 1/fps */
+#define REFRESH_RATE 0.01
+
+/* NOTE: the size must be big enough to compensate the hardware audio buffersize size */
+/* TODO: We assume that a decoded and resampled frame fits into this buffer */
+#define SAMPLE_ARRAY_SIZE (8 * 65536)
+
+#define CURSOR_HIDE_DELAY 1000000
+
+#define USE_ONEPASS_SUBTITLE_RENDER 1
+
+static unsigned sws_flags = SWS_BICUBIC;
+
+/* Smallest number of packet list nodes allocated at once by a packet pool */
+#define PACKET_POOL_MIN_CHUNK 32
+
+typedef struct MyAVPacketList {
+    AVPacket pkt;
+    struct MyAVPacketList* next;
+    int serial;
+} MyAVPacketList;
+
+typedef struct PacketPoolChunk {
+    struct PacketPoolChunk* next;
+    int nb_nodes;
+} PacketPoolChunk;
+
+/* Free-list arena for the nodes of one packet queue. Chunks grow geometrically
+ * with the number of nodes in use, so the pool settles at no more than twice the
+ * queue's high-water mark and steady-state playback never calls av_malloc(). */
+typedef struct PacketPool {
+    MyAVPacketList* free_list;
+    PacketPoolChunk* chunks;
+    int nb_nodes;           /* nodes owned by the pool, free or in use */
+    int nb_free;
+    int max_in_use;         /* high-water mark of nodes handed out */
+    int64_t nb_node_gets;   /* nodes handed out since the queue was created */
+    int64_t nb_mallocs;     /* chunk allocations since the queue was created */
+} PacketPool;
+
+/* Assumed size of a cache line, used to keep data written by different threads apart */
+#define CACHE_LINE_SIZE 64
+
+/* Eventcount: lets a thread sleep on a condition that is otherwise tested with
+ * plain atomics. The notifying side only takes the mutex when someone has
+ * announced itself with event_prepare_wait(), so an uncontended handoff never
+ * enters the kernel. */
+typedef struct EventCount {
+    SDL_atomic_t epoch;
+    SDL_atomic_t waiters;
+    SDL_mutex* mutex;
+    SDL_cond* cond;
+} EventCount;
+
+/* Bounded single-producer/single-consumer packet ring. windex is only written
+ * by the producer and rindex only by the consumer; both are free-running
+ * counters, so the number of queued packets is windex - rindex. */
+typedef struct PacketRing {
+    MyAVPacketList* slots;
+    unsigned capacity;      /* power of two, 0 if the queue is a linked list */
+    unsigned mask;
+
+    char pad0[CACHE_LINE_SIZE];
+    /* producer side */
+    SDL_atomic_t windex;
+    SDL_atomic_t in_size;
+    SDL_atomic_t in_duration;   /* wraps, only the difference to out_duration is used */
+    SDL_atomic_t flush_serial;  /* of a flush packet the full ring had no room for */
+
+    char pad1[CACHE_LINE_SIZE];
+    /* consumer side */
+    SDL_atomic_t rindex;
+    SDL_atomic_t out_size;
+    SDL_atomic_t out_duration;
+    int out_serial;             /* of the last packet returned */
+
+    char pad2[CACHE_LINE_SIZE];
+    EventCount not_empty;   /* waited on by the consumer */
+    EventCount not_full;    /* waited on by the producer */
+} PacketRing;
+
+/* Background thread that unrefs flushed packets and returns their nodes to the
+ * pool of the queue they came from, so a flush only has to detach its list. */
+typedef struct PacketReclaimer {
+    SDL_mutex* mutex;
+    SDL_cond* cond;
+    SDL_Thread* tid;
+    struct PacketQueue* first, * last;  /* queues with packets to reclaim */
+    int running;
+    int abort_request;
+} PacketReclaimer;
+
+/* HDR to SDR tone mapping tables, indexed by 10-bit code value. Only the video
+ * thread uses them, they are rebuilt when the source transfer or peak changes. */
+#define TONEMAP_LUT_SIZE 1024
+
+typedef struct ToneMap {
+    int trc;                    /* transfer the tables are built for, 0 for none */
+    int full_range;
+    int primaries;
+    double peak;                /* source peak luminance in cd/m2 */
+    int32_t luma[TONEMAP_LUT_SIZE];         /* luma code value to 8-bit SDR luma */
+    int32_t chroma_scale[TONEMAP_LUT_SIZE]; /* saturation factor by luma code value, Q12 */
+    int32_t chroma_matrix[4];   /* BT.2020 to BT.709 chroma, Q12: uu, uv, vu, vv */
+} ToneMap;
+
+/* number of frame geometries the video buffer pool keeps around at once,
+ * enough for the decoder output, its converted copy and the downscaled ones */
+#define VIDEO_BUFFER_POOLS 8
+/* pictures are halved at most this many times to fit the window */
+#define DOWNSCALE_MAX_LEVELS 4
+
+typedef struct VideoBufferPoolEntry {
+    int width, height, format;          /* key, width == 0 for an unused entry */
+    int linesize[4];
+    int nb_planes;
+    AVBufferPool* pools[4];
+    int64_t last_used;
+} VideoBufferPoolEntry;
+
+/* Player-owned picture buffers handed to the video decoder via get_buffer2, so
+ * the frames travelling through pictq are recycled instead of reallocated. */
+typedef struct VideoBufferPool {
+    SDL_mutex* mutex;
+    VideoBufferPoolEntry entries[VIDEO_BUFFER_POOLS];
+    int64_t nb_gets;                    /* frames handed out */
+    int64_t nb_allocs;                  /* plane buffers actually allocated */
+    int64_t use_count;
+    int huge_pages;
+} VideoBufferPool;
+
+/* waits of less than 2^i microseconds land in bucket i, the last one takes the rest */
+#define QUEUE_WAIT_HIST_SIZE 24
+
+typedef struct QueueWaitStats {
+    int64_t nb_waits;
+    int64_t total_us;
+    int64_t max_us;
+    int64_t hist[QUEUE_WAIT_HIST_SIZE];
+} QueueWaitStats;
+
+/* Counters of a packet or frame queue. Each field is only written by one side
+ * of the queue (or with the queue mutex held), readers take a snapshot. */
+typedef struct QueueStats {
+    int64_t nb_put;
+    int64_t nb_get;
+    int max_nb;                 /* occupancy high-water mark */
+    int64_t max_size;           /* bytes, packet queues only */
+    int64_t nb_flushes;
+    int64_t nb_flushed;         /* packets dropped by flushes */
+    QueueWaitStats producer_wait;   /* time blocked on a full queue */
+    QueueWaitStats consumer_wait;   /* time blocked on an empty queue */
+
+    /* only filled in by snapshots */
+    int nb_cur;
+    int64_t size_cur;
+    int serial;
+} QueueStats;
+
+/* Overflow file of a linked list queue. Once the queue holds budget bytes in
+ * memory, packets are appended to the file for as long as it holds any, which
+ * keeps the packet order intact. The consumer moves them back to memory in
+ * batches whenever the memory part drops to half the budget, so spilling ends
+ * once it catches up, and the space it has read is reclaimed by moving the
+ * unread rest to the start of the file. Protected by the queue mutex. */
+typedef struct PacketSpill {
+    int64_t budget;         /* in-memory bytes before spilling, 0 to never spill */
+    FILE* file;
+    char* filename;         /* NULL for an anonymous tmpfile() */
+    int64_t read_pos, write_pos;
+    int64_t file_pos;       /* of the stdio stream after the last access, -1 if unknown */
+    int file_writing;       /* direction of the last access */
+    int64_t file_size;      /* largest extent of the file */
+    int nb_packets;
+    int64_t duration;
+    int64_t nb_spilled;     /* packets written since the queue was created */
+} PacketSpill;
+
+typedef struct PacketQueue {
+    MyAVPacketList* first_pkt, * last_pkt;
+    int nb_packets;
+    int size;
+    int64_t duration;
+    int abort_request;
+    int serial;
+    SDL_mutex* mutex;
+    SDL_cond* cond;
+    PacketPool pool;
+    PacketRing ring;
+
+    /* Low watermark armed by the producer before it goes to sleep. The consumer
+     * notifies wakeup once, as soon as the queue drains to any of the limits. */
+    EventCount* wakeup;
+    SDL_atomic_t wake_armed;
+    int wake_nb_packets;        /* -1 if unused */
+    int64_t wake_duration;      /* 0 if unused */
+    int wake_size;              /* -1 if unused */
+
+    /* flushed packets waiting for the reclaimer, protected by the mutex */
+    PacketReclaimer* reclaimer;
+    MyAVPacketList* reclaim_first, * reclaim_last;
+    int reclaim_queued;
+    struct PacketQueue* reclaim_next;
+
+    PacketSpill spill;
+    QueueStats stats;
+} PacketQueue;
+
+#define VIDEO_PICTURE_QUEUE_SIZE 3
+#define SUBPICTURE_QUEUE_SIZE 16
+#define SAMPLE_QUEUE_SIZE 9
+/* pictq grows up to this many pictures when frames are dropped late */
+#define VIDEO_PICTURE_QUEUE_MAX 16
+/* memory budget for queued pictures, bounds the depth for large frames */
+#define VIDEO_PICTURE_QUEUE_BYTES (512 * 1024 * 1024)
+/* pictq depth is revisited once per interval, it grows by one picture if
+ * frames were dropped late and shrinks by one after a calm period */
+#define PICTQ_ADAPT_INTERVAL 1000000
+#define PICTQ_SHRINK_DELAY 10000000
+/* streaming textures pictures are uploaded to ahead of their display time */
+#define VIDEO_TEXTURE_RING_SIZE 3
+#define VIDEO_TEXTURE_RING_MAX 8
+/* pictures above the maximum texture size are split into up to this many tiles */
+#define VIDEO_TEXTURE_TILES_MAX 16
+/* swscale conversions are split into at most this many horizontal slices */
+#define SLICE_SCALER_MAX 16
+/* slices shorter than this are not worth a thread */
+#define SLICE_SCALER_MIN_ROWS 32
+
+/* Same size swscale conversion split into horizontal slices, on a small
+ * pool of workers that also runs other jobs of its owner thread that split
+ * the same way, like tiled texture uploads. A SwsContext is not reentrant,
+ * so every slice has its own, created for the slice height. The calling
+ * thread takes slices too; the workers are started when the first job is
+ * large enough to be split. */
+typedef struct SliceScaler {
+    struct SwsContext* ctx[SLICE_SCALER_MAX];
+    SDL_Thread* workers[SLICE_SCALER_MAX - 1];
+    int nb_workers;                     /* workers wanted */
+    int nb_running;                     /* workers started */
+    SDL_mutex* mutex;
+    SDL_cond* start_cond;
+    SDL_cond* done_cond;
+    /* the job being run, protected by mutex */
+    int (*job)(void* opaque, int slice);
+    void* opaque;
+    int nb_slices;
+    int next;                           /* next slice to hand out */
+    int pending;                        /* slices not done yet */
+    int failed;                         /* error of a failed slice */
+    int abort_request;
+    /* the picture being converted */
+    const uint8_t* const* src;
+    const int* src_linesize;
+    uint8_t* const* dst;
+    const int* dst_linesize;
+    int src_format, dst_format;
+    int width, height, flags;
+    int scale_slices;
+    int align;                          /* slice rows are a multiple of it */
+} SliceScaler;
+
+typedef struct AudioParams {
+    int freq;
+    int channels;
+    int64_t channel_layout;
+    enum AVSampleFormat fmt;
+    int frame_size;
+    int bytes_per_sec;
+} AudioParams;
+
+typedef struct Clock {
+    double pts;           /* clock base */
+    double pts_drift;     /* clock base minus time at which we updated the clock */
+    double last_updated;
+    double speed;
+    int serial;           /* clock is based on a packet with this serial */
+    int paused;
+    int* queue_serial;    /* pointer to the current packet queue serial, used for obsolete clock detection */
+} Clock;
+
+/* Frame queue slots, one type per payload so each queue only carries the
+ * fields its producer and consumer actually use. */
+typedef struct VideoFrame {
+    AVFrame* frame;
+    int serial;
+    double pts;           /* presentation timestamp for the frame */
+    double duration;      /* estimated duration of the frame */
+    int64_t pos;          /* byte position of the frame in the input file */
+    int width;
+    int height;
+    int format;
+    AVRational sar;
+    int uploaded;
+    int texture;          /* index in the texture ring, valid once uploaded */
+    int flip_v;
+    int yuv_mode;         /* YUV conversion mode of the upload plan it was uploaded with */
+    int tiled;            /* uploaded to the tiles of the ring slot instead of its texture */
+} VideoFrame;
+
+/* How pictures of the current stream are put into textures. Rebuilt only when
+ * the format, size or color properties of the pictures change, so the per
+ * frame path is a key compare. Only used by the main thread. */
+typedef struct UploadPlan {
+    int serial;           /* bumped on every rebuild, 0 while no plan was built */
+    int format;
+    int width;
+    int height;
+    int colorspace;
+    int color_range;
+    Uint32 sdl_pix_fmt;   /* SDL_PIXELFORMAT_UNKNOWN: converted with swscale */
+    Uint32 texture_fmt;
+    SDL_BlendMode blendmode;
+    int yuv_mode;
+    int tile_w, tile_h;   /* the picture size unless it exceeds the maximum texture size */
+    int nb_cols, nb_rows;
+} UploadPlan;
+
+/* Grid of textures holding a picture larger than the renderer's maximum
+ * texture size, in row major order. Tiles are as large as allowed, the
+ * last column and row take the rest. */
+typedef struct VideoTextureTiles {
+    SDL_Texture* tiles[VIDEO_TEXTURE_TILES_MAX];
+    int tile_w, tile_h;
+    int nb_cols, nb_rows;
+} VideoTextureTiles;
+
+/* Bookkeeping of the subtitle texture. It only holds the bounding box of the
+ * rects on display, placed at its top left corner, and remembers which of
+ * its regions still hold pixels, so that a new subtitle clears and uploads
+ * only what changed instead of a frame sized texture. Main thread only. */
+#define SUBTITLE_DIRTY_MAX 8
+
+typedef struct SubtitleAtlas {
+    int tex_w, tex_h;                       /* size of sub_texture */
+    SDL_Rect box;                           /* part of the subtitle canvas the texture holds */
+    SDL_Rect dirty[SUBTITLE_DIRTY_MAX];     /* texture regions that may hold pixels, disjoint */
+    int nb_dirty;
+} SubtitleAtlas;
+
+/* YUV to RGB matrix of the CPU compositor, Q13 */
+typedef struct ComposeMatrix {
+    int16_t y_offset;
+    int16_t y_mul;
+    int16_t rv, gu, gv, bu;
+} ComposeMatrix;
+
+/* State of the CPU compositor, which draws pictures and subtitles straight
+ * into a texture of the size of the display rectangle. Main thread only. */
+typedef struct Compositor {
+    SDL_Texture* texture;
+    int* xmap;                          /* source column of every output column */
+    int xmap_src, xmap_dst;             /* widths xmap was computed for */
+    uint8_t* rows[3];                   /* Y, U and V gathered for an output row */
+    uint32_t* sub_row;                  /* subtitle colors gathered for an output row */
+    uint8_t* buf;
+    unsigned buf_size;
+} Compositor;
+
+typedef struct AudioFrame {
+    AVFrame* frame;
+    int serial;
+    double pts;
+    double duration;
+    int64_t pos;
+} AudioFrame;
+
+#define TEXT_SUB_GLYPH_W 8
+#define TEXT_SUB_GLYPH_H 16
+/* rasterized text subtitle events kept for reuse */
+#define TEXT_SUB_CACHE_SIZE 32
+
+typedef struct TextSubCacheEntry {
+    char* text;                         /* event text with the ASS tags stripped, NULL if unused */
+    uint32_t hash;
+    int canvas_w, canvas_h;
+    int x, y, w, h;
+    uint8_t* bitmap;                    /* PAL8 in the text_sub_palette, linesize w */
+    unsigned last_used;
+} TextSubCacheEntry;
+
+/* Rasterizer of text and ASS subtitles into bitmap rects, owned by the
+ * subtitle thread. Glyphs are scaled and outlined once into an atlas for
+ * the current canvas size, events are composed from atlas cells and the
+ * resulting bitmaps cached by text, so repeated events and karaoke
+ * updates, whose text only differs in tags, are not rasterized again. */
+typedef struct TextSubRenderer {
+    int scale;                          /* the atlas is built for, 0 for none */
+    int outline;
+    int cell_w, cell_h;
+    uint8_t* atlas;                     /* cells of the printable ASCII glyphs side by side */
+    int atlas_linesize;
+    TextSubCacheEntry cache[TEXT_SUB_CACHE_SIZE];
+    unsigned use_count;
+} TextSubRenderer;
+
+/* a bitmap subtitle rect expanded from PAL8 to BGRA */
+typedef struct SubtitleRectPixels {
+    uint8_t* data;
+    int linesize;
+} SubtitleRectPixels;
+
+typedef struct SubtitleFrame {
+    AVSubtitle sub;
+    SubtitleRectPixels* rects;  /* sub.num_rects entries, filled by the subtitle thread */
+    int serial;
+    double pts;
+    int width;            /* size of the video the rects are placed on */
+    int height;
+    int uploaded;
+    int in_atlas;         /* the rects are in the subtitle texture */
+} SubtitleFrame;
+
+/* Single-producer/single-consumer frame queue of slots of type T. The producer
+ * (a decoder thread) and the consumer (display or audio callback) each own
+ * their index and a free-running counter; the number of queued frames is
+ * nb_pushed - nb_released. max_size slots are allocated, the producer blocks
+ * once depth are queued. */
+template <typename T>
+struct FrameQueue {
+    T* queue;
+    int max_size;
+    SDL_atomic_t depth;
+    int keep_last;
+    PacketQueue* pktq;
+
+    char pad0[CACHE_LINE_SIZE];
+    /* producer side */
+    int windex;
+    SDL_atomic_t nb_pushed;
+
+    char pad1[CACHE_LINE_SIZE];
+    /* consumer side */
+    int rindex;
+    int rindex_shown;
+    SDL_atomic_t nb_released;
+
+    char pad2[CACHE_LINE_SIZE];
+    EventCount not_full;    /* waited on by the producer */
+    EventCount not_empty;   /* waited on by the consumer */
+    QueueStats stats;
+};
+
+enum {
+    AV_SYNC_AUDIO_MASTER, /* default choice */
+    AV_SYNC_VIDEO_MASTER,
+    AV_SYNC_EXTERNAL_CLOCK, /* synchronize to an external clock */
+};
+
+typedef struct Decoder {
+    AVPacket pkt;
+    PacketQueue* queue;
+    AVCodecContext* avctx;
+    int pkt_serial;
+    int finished;
+    int packet_pending;
+    EventCount* empty_queue_event;
+    int64_t start_pts;
+    AVRational start_pts_tb;
+    int64_t next_pts;
+    AVRational next_pts_tb;
+    SDL_Thread* decoder_tid;
+} Decoder;
+
+class FMediaPlayer 
+{
+public:
+    enum struct EShowMode : Uint8
+    {
+        SHOW_MODE_NONE = 0, SHOW_MODE_VIDEO, SHOW_MODE_WAVES, SHOW_MODE_RDFT, SHOW_MODE_NB
+    } eShow_mode;
+
+public:
+    SDL_Thread* read_tid;
+    AVInputFormat* iformat;
+    int abort_request;
+    int force_refresh;
+    int paused;
+    int last_paused;
+    int queue_attachments_req;
+    int seek_req;
+    int seek_flags;
+    int64_t seek_pos;
+    int64_t seek_rel;
+    int read_pause_return;
+    AVFormatContext* ic;
+    int realtime;
+
+    Clock audclk;
+    Clock vidclk;
+    Clock extclk;
+
+    FrameQueue<VideoFrame> pictq;
+    FrameQueue<SubtitleFrame> subpq;
+    FrameQueue<AudioFrame> sampq;
+
+    Decoder auddec;
+    Decoder viddec;
+    Decoder subdec;
+
+    int audio_stream;
+
+    int av_sync_type;
+
+    double audio_clock;
+    int audio_clock_serial;
+    double audio_diff_cum; /* used for AV difference average computation */
+    double audio_diff_avg_coef;
+    double audio_diff_threshold;
+    int audio_diff_avg_count;
+    AVStream* audio_st;
+    PacketQueue audioq;
+    int audio_hw_buf_size;
+    uint8_t* audio_buf;
+    uint8_t* audio_buf1;
+    unsigned int audio_buf_size; /* in bytes */
+    unsigned int audio_buf1_size;
+    int audio_buf_index; /* in bytes */
+    int audio_write_buf_size;
+    int audio_volume;
+    int muted;
+    struct AudioParams audio_src;
+#if CONFIG_AVFILTER
+    struct AudioParams audio_filter_src;
+#endif
+    struct AudioParams audio_tgt;
+    struct SwrContext* swr_ctx;
+    int frame_drops_early;
+    int frame_drops_late;
+    /* pictq depth adaptation */
+    int64_t pictq_adapt_time;
+    int64_t pictq_calm_time;
+    int pictq_adapt_drops;
+
+    int16_t sample_array[SAMPLE_ARRAY_SIZE];
+    int sample_array_index;
+    int last_i_start;
+    RDFTContext* rdft;
+    int rdft_bits;
+    FFTSample* rdft_data;
+    int xpos;
+    double last_vis_time;
+    SDL_Texture* vis_texture;
+    SDL_Texture* sub_texture;
+    SubtitleAtlas sub_atlas;
+    TextSubRenderer text_sub;           /* owned by the subtitle thread */
+    SDL_Texture* vid_textures[VIDEO_TEXTURE_RING_MAX];
+    VideoTextureTiles vid_tiles[VIDEO_TEXTURE_RING_MAX];
+    int vid_texture_plan[VIDEO_TEXTURE_RING_MAX];  /* upload plan serial each texture was set up for */
+    UploadPlan upload_plan;
+    Compositor compositor;
+
+    int subtitle_stream;
+    AVStream* subtitle_st;
+    PacketQueue subtitleq;
+
+    double frame_timer;
+    double frame_last_returned_time;
+    double frame_last_filter_delay;
+    int video_stream;
+    AVStream* video_st;
+    PacketQueue videoq;
+    double max_frame_duration;      // maximum duration of a frame - above this, we consider the jump a timestamp discontinuity
+    SliceScaler upload_scaler;          /* owned by the main thread */
+    SliceScaler vid_convert_scaler;     /* owned by the video thread */
+    AVFrame* vid_convert_frame;
+    const struct RepackFormatEntry* vid_repack;
+    int vid_repack_format;              /* format vid_repack and vid_convert were looked up for */
+    int vid_convert;                    /* vid_repack_format has no texture format of its own */
+    ToneMap tonemap;
+    int eof;
+
+    char* filename;
+    int width, height, xleft, ytop;
+    int step;
+
+#if CONFIG_AVFILTER
+    int vfilter_idx;
+    AVFilterContext* in_video_filter;   // the first filter in the video chain
+    AVFilterContext* out_video_filter;  // the last filter in the video chain
+    AVFilterContext* in_audio_filter;   // the first filter in the audio chain
+    AVFilterContext* out_audio_filter;  // the last filter in the audio chain
+    AVFilterGraph* agraph;              // audio filter graph
+#endif
+
+    int last_video_stream, last_audio_stream, last_subtitle_stream;
+
+    EventCount continue_read;
+    PacketReclaimer reclaimer;
+    VideoBufferPool video_buffer_pool;
+
+    /* queue statistics at the last dump, for rates */
+    QueueStats last_queue_stats[6];
+    int64_t last_queue_stats_time;
+};
+
+/* options specified by the user */
+static AVInputFormat* file_iformat;
+static const char* input_filename;
+static const char* window_title;
+static int default_width = 640;
+static int default_height = 480;
+static int screen_width = 0;
+static int screen_height = 0;
+static int screen_left = SDL_WINDOWPOS_CENTERED;
+static int screen_top = SDL_WINDOWPOS_CENTERED;
+static int audio_disable;
+static int video_disable;
+static int subtitle_disable;
+static const char* wanted_stream_spec[AVMEDIA_TYPE_NB] = { 0 };
+static int seek_by_bytes = -1;
+static float seek_interval = 10;
+static int display_disable;
+static int borderless;
+static int alwaysontop;
+static int startup_volume = 100;
+static int show_status = 1;
+static int av_sync_type = AV_SYNC_AUDIO_MASTER;
+static int64_t start_time = AV_NOPTS_VALUE;
+static int64_t duration = AV_NOPTS_VALUE;
+static int fast = 0;
+static int genpts = 0;
+static int lowres = 0;
+static int decoder_reorder_pts = -1;
+static int autoexit;
+static int exit_on_keydown;
+static int exit_on_mousedown;
+static int loop = 1;
+static int framedrop = -1;
+static int infinite_buffer = -1;
+static FMediaPlayer::EShowMode show_mode = FMediaPlayer::EShowMode::SHOW_MODE_NONE;
+static const char* audio_codec_name;
+static const char* subtitle_codec_name;
+static const char* video_codec_name;
+double rdftspeed = 0.02;
+static int64_t cursor_last_shown;
+static int cursor_hidden = 0;
+#if CONFIG_AVFILTER
+static const char** vfilters_list = NULL;
+static int nb_vfilters = 0;
+static char* afilters = NULL;
+#endif
+static int autorotate = 1;
+static int find_stream_info = 1;
+static int filter_nbthreads = 0;
+static int64_t spill_size = 0;
+static const char* spill_dir = NULL;
+static int packet_ring_size = 0;
+static int64_t pktq_bench = 0;
+/* indexed by media type, a zero target means the stream does not hold back reading.
+ * Subtitles are sparse, so by default they are only bounded by max_queue_size. */
+static double buffer_min_time[AVMEDIA_TYPE_NB] = { /* video */ BUFFER_MIN_TIME, /* audio */ BUFFER_MIN_TIME };
+static double buffer_max_time[AVMEDIA_TYPE_NB] = { /* video */ BUFFER_MAX_TIME, /* audio */ BUFFER_MAX_TIME };
+static int64_t max_queue_size = MAX_QUEUE_SIZE;
+static int frame_pool = 1;
+static int text_subs = 1;
+static int decoder_convert = 1;
+static int hbd_convert = 1;
+static int hbd_dither = 1;
+static int repack = 1;
+static int downscale = 0;
+static int tonemap = 1;
+static double tonemap_peak = 203.0;
+static int texture_ring_size = VIDEO_TEXTURE_RING_SIZE;
+static int convert_threads = 0;
+static int cpu_compose = -1;
+static int pictq_size = VIDEO_PICTURE_QUEUE_SIZE;
+static int pictq_max = VIDEO_PICTURE_QUEUE_MAX;
+static int64_t pictq_bytes = VIDEO_PICTURE_QUEUE_BYTES;
+static int huge_pages = 0;
+
+/* current context */
+static int is_full_screen;
+static int64_t audio_callback_time;
+
+static AVPacket flush_pkt;
+
+#define FF_QUIT_EVENT    (SDL_USEREVENT + 2)
+
+static SDL_Window* window;
+static SDL_Renderer* renderer;
+static SDL_RendererInfo renderer_info = { 0 };
+static SDL_AudioDeviceID audio_dev;
+
+static const struct TextureFormatEntry {
+    enum AVPixelFormat format;
+    int texture_fmt;
+} sdl_texture_format_map[] = {
+    { AV_PIX_FMT_RGB8,           SDL_PIXELFORMAT_RGB332 },
+    { AV_PIX_FMT_RGB444,         SDL_PIXELFORMAT_RGB444 },
+    { AV_PIX_FMT_RGB555,         SDL_PIXELFORMAT_RGB555 },
+    { AV_PIX_FMT_BGR555,         SDL_PIXELFORMAT_BGR555 },
+    { AV_PIX_FMT_RGB565,         SDL_PIXELFORMAT_RGB565 },
+    { AV_PIX_FMT_BGR565,         SDL_PIXELFORMAT_BGR565 },
+    { AV_PIX_FMT_RGB24,          SDL_PIXELFORMAT_RGB24 },
+    { AV_PIX_FMT_BGR24,          SDL_PIXELFORMAT_BGR24 },
+    { AV_PIX_FMT_0RGB32,         SDL_PIXELFORMAT_RGB888 },
+    { AV_PIX_FMT_0BGR32,         SDL_PIXELFORMAT_BGR888 },
+    { AV_PIX_FMT_NE(RGB0, 0BGR), SDL_PIXELFORMAT_RGBX8888 },
+    { AV_PIX_FMT_NE(BGR0, 0RGB), SDL_PIXELFORMAT_BGRX8888 },
+    { AV_PIX_FMT_RGB32,          SDL_PIXELFORMAT_ARGB8888 },
+    { AV_PIX_FMT_RGB32_1,        SDL_PIXELFORMAT_RGBA8888 },
+    { AV_PIX_FMT_BGR32,          SDL_PIXELFORMAT_ABGR8888 },
+    { AV_PIX_FMT_BGR32_1,        SDL_PIXELFORMAT_BGRA8888 },
+    { AV_PIX_FMT_YUV420P,        SDL_PIXELFORMAT_IYUV },
+    { AV_PIX_FMT_YUYV422,        SDL_PIXELFORMAT_YUY2 },
+    { AV_PIX_FMT_UYVY422,        SDL_PIXELFORMAT_UYVY },
+    { AV_PIX_FMT_NV12,           SDL_PIXELFORMAT_NV12 },
+    { AV_PIX_FMT_NV21,           SDL_PIXELFORMAT_NV21 },
+    { AV_PIX_FMT_NONE,           SDL_PIXELFORMAT_UNKNOWN },
+};
+
+#if CONFIG_AVFILTER
+static int opt_add_vfilter(void* optctx, const char* opt, const char* arg)
+{
+    GROW_ARRAY(vfilters_list, nb_vfilters);
+    vfilters_list[nb_vfilters - 1] = arg;
+    return 0;
+}
+#endif
+
+static inline
+int cmp_audio_fmts(enum AVSampleFormat fmt1, int64_t channel_count1,
+    enum AVSampleFormat fmt2, int64_t channel_count2)
+{
+    /* If channel count == 1, planar and non-planar formats are the same */
+    if (channel_count1 == 1 && channel_count2 == 1)
+        return av_get_packed_sample_fmt(fmt1) != av_get_packed_sample_fmt(fmt2);
+    else
+        return channel_count1 != channel_count2 || fmt1 != fmt2;
+}
+
+static inline
+int64_t get_valid_channel_layout(int64_t channel_layout, int channels)
+{
+    if (channel_layout && av_get_channel_layout_nb_channels(channel_layout) == channels)
+        return channel_layout;
+    else
+        return 0;
+}
+
+static void queue_wait_stats_add(QueueWaitStats* w, int64_t start)
+{
+    int64_t us = av_gettime_relative() - start;
+    int i = 0;
+
+    while (i < QUEUE_WAIT_HIST_SIZE - 1 && (INT64_C(1) << i) <= us)
+        i++;
+    w->hist[i]++;
+    w->nb_waits++;
+    w->total_us += us;
+    w->max_us = FFMAX(w->max_us, us);
+}
+
+static int event_init(EventCount* ev)
+{
+    SDL_AtomicSet(&ev->epoch, 0);
+    SDL_AtomicSet(&ev->waiters, 0);
+    ev->mutex = SDL_CreateMutex();
+    if (!ev->mutex) {
+        av_log(NULL, AV_LOG_FATAL, "SDL_CreateMutex(): %s\n", SDL_GetError());
+        return AVERROR(ENOMEM);
+    }
+    ev->cond = SDL_CreateCond();
+    if (!ev->cond) {
+        av_log(NULL, AV_LOG_FATAL, "SDL_CreateCond(): %s\n", SDL_GetError());
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+static void event_destroy(EventCount* ev)
+{
+    SDL_DestroyMutex(ev->mutex);
+    SDL_DestroyCond(ev->cond);
+    ev->mutex = NULL;
+    ev->cond = NULL;
+}
+
+/* Announce an upcoming wait. The caller must re-check its condition after this
+ * and then either cancel or commit the wait with the returned key. */
+static int event_prepare_wait(EventCount* ev)
+{
+    SDL_AtomicIncRef(&ev->waiters);
+    return SDL_AtomicGet(&ev->epoch);
+}
+
+static void event_cancel_wait(EventCount* ev)
+{
+    SDL_AtomicDecRef(&ev->waiters);
+}
+
+/* Sleep until the event is notified after event_prepare_wait() returned key.
+ * A negative timeout waits forever. */
+static void event_commit_wait(EventCount* ev, int key, int timeout_ms)
+{
+    SDL_LockMutex(ev->mutex);
+    while (SDL_AtomicGet(&ev->epoch) == key) {
+        if (timeout_ms < 0)
+            SDL_CondWait(ev->cond, ev->mutex);
+        else if (SDL_CondWaitTimeout(ev->cond, ev->mutex, timeout_ms))
+            break;
+    }
+    SDL_UnlockMutex(ev->mutex);
+    SDL_AtomicDecRef(&ev->waiters);
+}
+
+/* Wake all waiters unconditionally */
+static void event_wake(EventCount* ev)
+{
+    SDL_LockMutex(ev->mutex);
+    SDL_AtomicAdd(&ev->epoch, 1);
+    SDL_CondBroadcast(ev->cond);
+    SDL_UnlockMutex(ev->mutex);
+}
+
+/* Wake all waiters, if any. Reading waiters with an atomic read-modify-write
+ * is a full barrier, so the caller's state change is visible to a thread that
+ * announced itself before this check and missed by none that announce later. */
+static void event_notify(EventCount* ev)
+{
+    if (SDL_AtomicAdd(&ev->waiters, 0))
+        event_wake(ev);
+}
+
+/* must be called with the queue mutex held */
+static MyAVPacketList* packet_pool_get(PacketPool* pool)
+{
+    MyAVPacketList* node;
+
+    if (!pool->free_list) {
+        PacketPoolChunk* chunk;
+        MyAVPacketList* nodes;
+        int i, nb_nodes = FFMAX(PACKET_POOL_MIN_CHUNK, pool->nb_nodes);
+
+        chunk = static_cast<PacketPoolChunk*>(av_malloc(sizeof(PacketPoolChunk) + nb_nodes * sizeof(MyAVPacketList)));
+        if (!chunk)
+            return NULL;
+        chunk->nb_nodes = nb_nodes;
+        chunk->next = pool->chunks;
+        pool->chunks = chunk;
+        nodes = reinterpret_cast<MyAVPacketList*>(chunk + 1);
+        for (i = 0; i < nb_nodes - 1; i++)
+            nodes[i].next = &nodes[i + 1];
+        nodes[nb_nodes - 1].next = NULL;
+        pool->free_list = nodes;
+        pool->nb_free += nb_nodes;
+        pool->nb_nodes += nb_nodes;
+        pool->nb_mallocs++;
+        av_log(NULL, AV_LOG_DEBUG, "Packet pool grown to %d nodes.\n", pool->nb_nodes);
+    }
+
+    node = pool->free_list;
+    pool->free_list = node->next;
+    pool->nb_free--;
+    pool->nb_node_gets++;
+    pool->max_in_use = FFMAX(pool->max_in_use, pool->nb_nodes - pool->nb_free);
+    return node;
+}
+
+/* must be called with the queue mutex held */
+static void packet_pool_put(PacketPool* pool, MyAVPacketList* node)
+{
+    node->next = pool->free_list;
+    pool->free_list = node;
+    pool->nb_free++;
+}
+
+/* Unref the packets of a detached node list and give the nodes back to the
+ * pool of q. Unreferencing happens without the queue mutex. */
+static void packet_queue_reclaim(PacketQueue* q)
+{
+    MyAVPacketList* first, * last = NULL, * pkt;
+    int nb_nodes = 0;
+
+    SDL_LockMutex(q->mutex);
+    first = q->reclaim_first;
+    q->reclaim_first = q->reclaim_last = NULL;
+    SDL_UnlockMutex(q->mutex);
+    if (!first)
+        return;
+
+    for (pkt = first; pkt; pkt = pkt->next) {
+        av_packet_unref(&pkt->pkt);
+        last = pkt;
+        nb_nodes++;
+    }
+
+    SDL_LockMutex(q->mutex);
+    last->next = q->pool.free_list;
+    q->pool.free_list = first;
+    q->pool.nb_free += nb_nodes;
+    SDL_UnlockMutex(q->mutex);
+}
+
+static int packet_reclaimer_thread(void* arg)
+{
+    PacketReclaimer* rc = static_cast<PacketReclaimer*>(arg);
+
+    SDL_LockMutex(rc->mutex);
+    for (;;) {
+        PacketQueue* q = rc->first;
+        if (!q) {
+            if (rc->abort_request)
+                break;
+            SDL_CondWait(rc->cond, rc->mutex);
+            continue;
+        }
+        rc->first = q->reclaim_next;
+        if (!rc->first)
+            rc->last = NULL;
+        q->reclaim_next = NULL;
+        q->reclaim_queued = 0;
+        SDL_UnlockMutex(rc->mutex);
+
+        packet_queue_reclaim(q);
+
+        SDL_LockMutex(rc->mutex);
+    }
+    SDL_UnlockMutex(rc->mutex);
+    return 0;
+}
+
+static int packet_reclaimer_start(PacketReclaimer* rc)
+{
+    memset(rc, 0, sizeof(*rc));
+    rc->mutex = SDL_CreateMutex();
+    if (!rc->mutex) {
+        av_log(NULL, AV_LOG_FATAL, "SDL_CreateMutex(): %s\n", SDL_GetError());
+        return AVERROR(ENOMEM);
+    }
+    rc->cond = SDL_CreateCond();
+    if (!rc->cond) {
+        av_log(NULL, AV_LOG_FATAL, "SDL_CreateCond(): %s\n", SDL_GetError());
+        return AVERROR(ENOMEM);
+    }
+    rc->tid = SDL_CreateThread(packet_reclaimer_thread, "packet_reclaimer", rc);
+    if (!rc->tid) {
+        av_log(NULL, AV_LOG_ERROR, "SDL_CreateThread(): %s\n", SDL_GetError());
+        return AVERROR(ENOMEM);
+    }
+    rc->running = 1;
+    return 0;
+}
+
+/* Reclaim everything still pending and stop the thread. The queues must not be
+ * flushed concurrently; later flushes unref their packets synchronously. */
+static void packet_reclaimer_stop(PacketReclaimer* rc)
+{
+    if (rc->tid) {
+        SDL_LockMutex(rc->mutex);
+        rc->abort_request = 1;
+        SDL_CondSignal(rc->cond);
+        SDL_UnlockMutex(rc->mutex);
+        SDL_WaitThread(rc->tid, NULL);
+        rc->tid = NULL;
+    }
+    rc->running = 0;
+    SDL_DestroyMutex(rc->mutex);
+    SDL_DestroyCond(rc->cond);
+    rc->mutex = NULL;
+    rc->cond = NULL;
+}
+
+/* Dispose of the node list first..last. Must be called with the queue mutex
+ * held; the packets are handed to the reclaimer if there is one. */
+static void packet_queue_defer_unref(PacketQueue* q, MyAVPacketList* first, MyAVPacketList* last)
+{
+    PacketReclaimer* rc = q->reclaimer;
+    MyAVPacketList* pkt, * pkt1;
+
+    if (!first)
+        return;
+    if (!rc || !rc->running) {
+        for (pkt = first; pkt; pkt = pkt1) {
+            pkt1 = pkt->next;
+            av_packet_unref(&pkt->pkt);
+            packet_pool_put(&q->pool, pkt);
+        }
+        return;
+    }
+
+    last->next = NULL;
+    if (q->reclaim_last)
+        q->reclaim_last->next = first;
+    else
+        q->reclaim_first = first;
+    q->reclaim_last = last;
+
+    SDL_LockMutex(rc->mutex);
+    if (!q->reclaim_queued) {
+        q->reclaim_queued = 1;
+        q->reclaim_next = NULL;
+        if (rc->last)
+            rc->last->reclaim_next = q;
+        else
+            rc->first = q;
+        rc->last = q;
+        SDL_CondSignal(rc->cond);
+    }
+    SDL_UnlockMutex(rc->mutex);
+}
+
+static void packet_pool_uninit(PacketPool* pool)
+{
+    PacketPoolChunk* chunk, * next;
+
+    av_log(NULL, AV_LOG_VERBOSE, "Packet pool: %d nodes (peak %d in use), %" PRId64 " node gets, %" PRId64 " mallocs.\n",
+        pool->nb_nodes, pool->max_in_use, pool->nb_node_gets, pool->nb_mallocs);
+    for (chunk = pool->chunks; chunk; chunk = next) {
+        next = chunk->next;
+        av_free(chunk);
+    }
+    memset(pool, 0, sizeof(*pool));
+}
+
+static int packet_queue_nb_packets(PacketQueue* q)
+{
+    if (q->ring.capacity)
+        return (unsigned)SDL_AtomicGet(&q->ring.windex) - (unsigned)SDL_AtomicGet(&q->ring.rindex);
+    return q->nb_packets + q->spill.nb_packets;
+}
+
+static int packet_queue_size(PacketQueue* q)
+{
+    if (q->ring.capacity)
+        return SDL_AtomicGet(&q->ring.in_size) - SDL_AtomicGet(&q->ring.out_size);
+    return q->size;
+}
+
+static int64_t packet_queue_duration(PacketQueue* q)
+{
+    if (q->ring.capacity)
+        return (int)((unsigned)SDL_AtomicGet(&q->ring.in_duration) - (unsigned)SDL_AtomicGet(&q->ring.out_duration));
+    return q->duration + q->spill.duration;
+}
+
+/* called by the producer after it added a packet */
+static void packet_queue_count_put(PacketQueue* q)
+{
+    QueueStats* st = &q->stats;
+
+    st->nb_put++;
+    st->max_nb = FFMAX(st->max_nb, packet_queue_nb_packets(q));
+    st->max_size = FFMAX(st->max_size, packet_queue_size(q));
+}
+
+/* return 1 if a put would block; linked list queues are never full */
+static int packet_queue_full(PacketQueue* q)
+{
+    return q->ring.capacity && (unsigned)packet_queue_nb_packets(q) >= q->ring.capacity;
+}
+
+/* Ask the consumer to notify q->wakeup once the queue holds no more than
+ * nb_packets packets, duration worth of packets or size bytes. */
+static void packet_queue_arm_wakeup(PacketQueue* q, int nb_packets, int64_t duration, int size)
+{
+    q->wake_nb_packets = nb_packets;
+    q->wake_duration = duration;
+    q->wake_size = size;
+    SDL_AtomicSet(&q->wake_armed, 1);
+}
+
+/* called by the consumer after it removed a packet */
+static void packet_queue_check_wakeup(PacketQueue* q)
+{
+    int64_t duration;
+
+    if (!SDL_AtomicGet(&q->wake_armed))
+        return;
+    duration = packet_queue_duration(q);
+    if (packet_queue_nb_packets(q) > q->wake_nb_packets &&
+        !(q->wake_duration > 0 && duration > 0 && duration <= q->wake_duration) &&
+        packet_queue_size(q) > q->wake_size)
+        return;
+    if (SDL_AtomicCAS(&q->wake_armed, 1, 0))
+        event_notify(q->wakeup);
+}
+
+#ifdef _WIN32
+#define spill_fseek _fseeki64
+#else
+#define spill_fseek fseeko
+#endif
+
+typedef struct PacketSpillRecord {
+    int64_t pts, dts, duration, pos;
+    int size;
+    int stream_index;
+    int flags;
+    int serial;
+    int side_data_elems;
+    int is_flush;
+} PacketSpillRecord;
+
+/* forget the spilled packets, the file space is reused */
+static void packet_spill_reset(PacketSpill* spill)
+{
+    spill->read_pos = spill->write_pos = 0;
+    spill->nb_packets = 0;
+    spill->duration = 0;
+}
+
+static void packet_spill_close(PacketSpill* spill)
+{
+    if (spill->file) {
+        av_log(NULL, AV_LOG_VERBOSE, "Packet spill: %" PRId64 " packets spilled, %" PRId64 " bytes of file used.\n",
+            spill->nb_spilled, spill->file_size);
+        fclose(spill->file);
+        spill->file = NULL;
+    }
+    if (spill->filename) {
+        remove(spill->filename);
+        av_freep(&spill->filename);
+    }
+    packet_spill_reset(spill);
+}
+
+static int packet_spill_open(PacketSpill* spill)
+{
+    if (spill_dir) {
+        spill->filename = av_asprintf("%s/ffplay-spill-%" PRId64 "-%p.tmp", spill_dir, av_gettime(), (void*)spill);
+        if (!spill->filename)
+            return AVERROR(ENOMEM);
+        spill->file = fopen(spill->filename, "w+b");
+    }
+    else {
+        spill->file = tmpfile();
+    }
+    if (!spill->file) {
+        int ret = AVERROR(errno);
+        print_error(spill->filename ? spill->filename : "packet spill tmpfile", ret);
+        av_freep(&spill->filename);
+        return ret;
+    }
+    spill->file_pos = -1;
+    return 0;
+}
+
+/* Position the file for the next access. stdio needs a seek whenever the
+ * direction changes, consecutive accesses in one direction go without. */
+static int packet_spill_seek(PacketSpill* spill, int64_t pos, int writing)
+{
+    if (spill->file_pos == pos && spill->file_writing == writing)
+        return 0;
+    spill->file_pos = -1;
+    if (spill_fseek(spill->file, pos, SEEK_SET) < 0)
+        return AVERROR(EIO);
+    spill->file_pos = pos;
+    spill->file_writing = writing;
+    return 0;
+}
+
+/* Append pkt to the spill file, must be called with the queue mutex held */
+static int packet_spill_write(PacketSpill* spill, AVPacket* pkt, int serial)
+{
+    PacketSpillRecord rec = { 0 };
+    int64_t write_pos = spill->write_pos;
+    int i, ret;
+
+    if (!spill->file && (ret = packet_spill_open(spill)) < 0)
+        return ret;
+
+    rec.pts = pkt->pts;
+    rec.dts = pkt->dts;
+    rec.duration = pkt->duration;
+    rec.pos = pkt->pos;
+    rec.size = pkt->size;
+    rec.stream_index = pkt->stream_index;
+    rec.flags = pkt->flags;
+    rec.serial = serial;
+    rec.side_data_elems = pkt->side_data_elems;
+    rec.is_flush = pkt == &flush_pkt;
+
+    if ((ret = packet_spill_seek(spill, spill->write_pos, 1)) < 0)
+        return ret;
+    spill->file_pos = -1;
+    if (fwrite(&rec, sizeof(rec), 1, spill->file) != 1 ||
+        (pkt->size && fwrite(pkt->data, pkt->size, 1, spill->file) != 1))
+        return AVERROR(EIO);
+    write_pos += sizeof(rec) + pkt->size;
+    for (i = 0; i < pkt->side_data_elems; i++) {
+        AVPacketSideData* sd = &pkt->side_data[i];
+        int hdr[2] = { sd->type, sd->size };
+        if (fwrite(hdr, sizeof(hdr), 1, spill->file) != 1 ||
+            (sd->size && fwrite(sd->data, sd->size, 1, spill->file) != 1))
+            return AVERROR(EIO);
+        write_pos += sizeof(hdr) + sd->size;
+    }
+
+    spill->write_pos = spill->file_pos = write_pos;
+    spill->file_size = FFMAX(spill->file_size, write_pos);
+    spill->nb_packets++;
+    spill->duration += pkt->duration;
+    spill->nb_spilled++;
+    return 0;
+}
+
+/* Read back the oldest spilled packet, must be called with the queue mutex held */
+static int packet_spill_read(PacketSpill* spill, AVPacket* pkt, int* serial)
+{
+    PacketSpillRecord rec;
+    int i, ret;
+
+    if ((ret = packet_spill_seek(spill, spill->read_pos, 0)) < 0)
+        return ret;
+    spill->file_pos = -1;
+    if (fread(&rec, sizeof(rec), 1, spill->file) != 1)
+        return AVERROR(EIO);
+
+    if (rec.is_flush) {
+        *pkt = flush_pkt;
+    }
+    else if (rec.size) {
+        if ((ret = av_new_packet(pkt, rec.size)) < 0)
+            return ret;
+        if (fread(pkt->data, rec.size, 1, spill->file) != 1) {
+            av_packet_unref(pkt);
+            return AVERROR(EIO);
+        }
+    }
+    else {
+        av_init_packet(pkt);
+        pkt->data = NULL;
+        pkt->size = 0;
+    }
+    spill->read_pos += sizeof(rec) + rec.size;
+    for (i = 0; i < rec.side_data_elems; i++) {
+        int hdr[2];
+        uint8_t* data;
+        if (fread(hdr, sizeof(hdr), 1, spill->file) != 1 ||
+            !(data = av_packet_new_side_data(pkt, (enum AVPacketSideDataType)hdr[0], hdr[1])) ||
+            (hdr[1] && fread(data, hdr[1], 1, spill->file) != 1)) {
+            av_packet_unref(pkt);
+            return AVERROR(EIO);
+        }
+        spill->read_pos += sizeof(hdr) + hdr[1];
+    }
+    pkt->pts = rec.pts;
+    pkt->dts = rec.dts;
+    pkt->duration = rec.duration;
+    pkt->pos = rec.pos;
+    pkt->stream_index = rec.stream_index;
+    pkt->flags = rec.flags;
+    if (serial)
+        *serial = rec.serial;
+
+    spill->file_pos = spill->read_pos;
+    spill->duration -= rec.duration;
+    if (!--spill->nb_packets)
+        packet_spill_reset(spill);
+    return 0;
+}
+
+/* Move the unread part of the file to its start once the read part is at
+ * least as large, so the file stays within about twice what it holds. The
+ * copy never reaches the unread part, which is intact if it fails. */
+static int packet_spill_compact(PacketSpill* spill)
+{
+    int64_t src = spill->read_pos, dst = 0;
+    uint8_t* buf;
+    int ret = 0;
+
+    if (spill->read_pos < PACKET_SPILL_COMPACT_SIZE || spill->read_pos < spill->write_pos - spill->read_pos)
+        return 0;
+    if (!(buf = (uint8_t*)av_malloc(1 << 16)))
+        return AVERROR(ENOMEM);
+    while (src < spill->write_pos) {
+        size_t len = (size_t)FFMIN(spill->write_pos - src, 1 << 16);
+        if ((ret = packet_spill_seek(spill, src, 0)) < 0)
+            break;
+        spill->file_pos = -1;
+        if (fread(buf, len, 1, spill->file) != 1 ||
+            (ret = packet_spill_seek(spill, dst, 1)) < 0 ||
+            fwrite(buf, len, 1, spill->file) != 1) {
+            ret = ret < 0 ? ret : AVERROR(EIO);
+            break;
+        }
+        src += len;
+        dst += len;
+    }
+    av_free(buf);
+    spill->file_pos = -1;
+    if (ret < 0)
+        return ret;
+    spill->write_pos -= spill->read_pos;
+    spill->read_pos = 0;
+    return 0;
+}
+
+/* Producer side of a ring queue, called with the queue mutex held. Producers
+ * are serialized by the mutex, which the consumer only takes to discard stale
+ * packets after a flush, so it stays uncontended. */
+static int packet_ring_put(PacketQueue* q, AVPacket* pkt)
+{
+    PacketRing* r = &q->ring;
+    unsigned windex = SDL_AtomicGet(&r->windex);
+    MyAVPacketList* slot;
+    int64_t start;
+
+    if (pkt == &flush_pkt && windex - (unsigned)SDL_AtomicGet(&r->rindex) >= r->capacity) {
+        /* A seek must not wait for a consumer that may itself be stalled,
+         * e.g. on a full picture queue while paused. The serial is bumped
+         * without queueing the flush packet, the consumer then discards the
+         * stale packets and returns a flush packet in its place. */
+        q->serial++;
+        SDL_AtomicSet(&r->flush_serial, q->serial);
+        event_notify(&r->not_empty);
+        return 0;
+    }
+
+    while (windex - (unsigned)SDL_AtomicGet(&r->rindex) >= r->capacity) {
+        int key = event_prepare_wait(&r->not_full);
+        if (q->abort_request || windex - (unsigned)SDL_AtomicGet(&r->rindex) < r->capacity) {
+            event_cancel_wait(&r->not_full);
+            break;
+        }
+        SDL_UnlockMutex(q->mutex);
+        start = av_gettime_relative();
+        event_commit_wait(&r->not_full, key, -1);
+        queue_wait_stats_add(&q->stats.producer_wait, start);
+        SDL_LockMutex(q->mutex);
+        windex = SDL_AtomicGet(&r->windex);
+    }
+    if (q->abort_request)
+        return -1;
+
+    slot = &r->slots[windex & r->mask];
+    slot->pkt = *pkt;
+    if (pkt == &flush_pkt)
+        q->serial++;
+    slot->serial = q->serial;
+    SDL_AtomicSet(&r->in_size, SDL_AtomicGet(&r->in_size) + slot->pkt.size + sizeof(*slot));
+    SDL_AtomicAdd(&r->in_duration, (int)slot->pkt.duration);
+
+    SDL_AtomicAdd(&r->windex, 1);
+    event_notify(&r->not_empty);
+    return 0;
+}
+
+/* Move the packets that a flush left behind at the head of a ring into pool
+ * nodes for the reclaimer. Consumer side only. */
+static unsigned packet_ring_discard(PacketQueue* q, unsigned rindex, unsigned windex)
+{
+    PacketRing* r = &q->ring;
+    MyAVPacketList* first = NULL, * last = NULL;
+
+    SDL_LockMutex(q->mutex);
+    for (; rindex != windex; rindex++) {
+        MyAVPacketList* slot = &r->slots[rindex & r->mask];
+        MyAVPacketList* node;
+
+        if (slot->serial == q->serial)
+            break;
+        q->stats.nb_flushed++;
+        SDL_AtomicSet(&r->out_size, SDL_AtomicGet(&r->out_size) + slot->pkt.size + sizeof(*slot));
+        SDL_AtomicAdd(&r->out_duration, (int)slot->pkt.duration);
+        node = packet_pool_get(&q->pool);
+        if (!node) {
+            av_packet_unref(&slot->pkt);
+            continue;
+        }
+        node->pkt = slot->pkt;
+        node->next = NULL;
+        if (last)
+            last->next = node;
+        else
+            first = node;
+        last = node;
+    }
+    packet_queue_defer_unref(q, first, last);
+    SDL_UnlockMutex(q->mutex);
+
+    SDL_AtomicSet(&r->rindex, rindex);
+    event_notify(&r->not_full);
+    return rindex;
+}
+
+/* Consumer side of a ring queue, must only be called from one thread */
+static int packet_ring_get(PacketQueue* q, AVPacket* pkt, int block, int* serial)
+{
+    PacketRing* r = &q->ring;
+    unsigned rindex = SDL_AtomicGet(&r->rindex);
+    MyAVPacketList* slot;
+
+    for (;;) {
+        unsigned windex;
+        int key, flush_serial;
+
+        if (q->abort_request)
+            return -1;
+        flush_serial = SDL_AtomicGet(&r->flush_serial);
+        windex = SDL_AtomicGet(&r->windex);
+        if (windex != rindex && r->slots[rindex & r->mask].serial != q->serial)
+            rindex = packet_ring_discard(q, rindex, windex);
+        if (flush_serial == q->serial && flush_serial != r->out_serial) {
+            /* the flush packet packet_ring_put() skipped */
+            *pkt = flush_pkt;
+            if (serial)
+                *serial = flush_serial;
+            r->out_serial = flush_serial;
+            return 1;
+        }
+        if (windex != rindex)
+            break;
+        if (!block)
+            return 0;
+
+        key = event_prepare_wait(&r->not_empty);
+        if (!q->abort_request && (unsigned)SDL_AtomicGet(&r->windex) == rindex) {
+            int64_t start = av_gettime_relative();
+            event_commit_wait(&r->not_empty, key, -1);
+            queue_wait_stats_add(&q->stats.consumer_wait, start);
+        }
+        else
+            event_cancel_wait(&r->not_empty);
+    }
+
+    slot = &r->slots[rindex & r->mask];
+    *pkt = slot->pkt;
+    if (serial)
+        *serial = slot->serial;
+    r->out_serial = slot->serial;
+    SDL_AtomicSet(&r->out_size, SDL_AtomicGet(&r->out_size) + slot->pkt.size + sizeof(*slot));
+    SDL_AtomicAdd(&r->out_duration, (int)slot->pkt.duration);
+
+    SDL_AtomicAdd(&r->rindex, 1);
+    event_notify(&r->not_full);
+    return 1;
+}
+
+/* Drop everything in a ring queue. Only valid while no consumer is running. */
+static void packet_ring_drain(PacketQueue* q)
+{
+    PacketRing* r = &q->ring;
+    unsigned rindex = SDL_AtomicGet(&r->rindex);
+    unsigned windex = SDL_AtomicGet(&r->windex);
+
+    q->stats.nb_flushed += windex - rindex;
+    for (; rindex != windex; rindex++) {
+        MyAVPacketList* slot = &r->slots[rindex & r->mask];
+        SDL_AtomicSet(&r->out_size, SDL_AtomicGet(&r->out_size) + slot->pkt.size + sizeof(*slot));
+        SDL_AtomicAdd(&r->out_duration, (int)slot->pkt.duration);
+        av_packet_unref(&slot->pkt);
+    }
+    SDL_AtomicSet(&r->rindex, rindex);
+    event_notify(&r->not_full);
+}
+
+static int packet_queue_put_private(PacketQueue* q, AVPacket* pkt)
+{
+    MyAVPacketList* pkt1;
+
+    if (q->abort_request)
+        return -1;
+
+    if (q->ring.capacity) {
+        int ret = packet_ring_put(q, pkt);
+        if (ret >= 0)
+            packet_queue_count_put(q);
+        return ret;
+    }
+
+    if (q->spill.nb_packets ||
+        (q->spill.budget > 0 && q->size + pkt->size + (int64_t)sizeof(*pkt1) > q->spill.budget)) {
+        int serial = pkt == &flush_pkt ? q->serial + 1 : q->serial;
+        int ret = packet_spill_write(&q->spill, pkt, serial);
+        if (ret >= 0) {
+            q->serial = serial;
+            if (pkt != &flush_pkt)
+                av_packet_unref(pkt);
+            packet_queue_count_put(q);
+            SDL_CondSignal(q->cond);
+            return 0;
+        }
+        /* keep the packets in memory once the spill file failed, packets
+         * that would overtake the ones still in the file are dropped */
+        print_error("Spilling packets", ret);
+        q->spill.budget = 0;
+        if (q->spill.nb_packets)
+            return -1;
+    }
+
+    pkt1 = packet_pool_get(&q->pool);
+    if (!pkt1)
+        return -1;
+    pkt1->pkt = *pkt;
+    pkt1->next = NULL;
+    if (pkt == &flush_pkt)
+        q->serial++;
+    pkt1->serial = q->serial;
+
+    if (!q->last_pkt)
+        q->first_pkt = pkt1;
+    else
+        q->last_pkt->next = pkt1;
+    q->last_pkt = pkt1;
+    q->nb_packets++;
+    q->size += pkt1->pkt.size + sizeof(*pkt1);
+    q->duration += pkt1->pkt.duration;
+    packet_queue_count_put(q);
+    /* XXX: should duplicate packet data in DV case */
+    SDL_CondSignal(q->cond);
+    return 0;
+}
+
+/* Move spilled packets back to memory until it holds the budget again, the
+ * consumer side of the spill, called with the queue mutex held. */
+static int packet_queue_refill(PacketQueue* q)
+{
+    MyAVPacketList* pkt1;
+    AVPacket pkt;
+    int serial, ret;
+
+    while (q->spill.nb_packets && (!q->first_pkt || q->size < q->spill.budget)) {
+        if (!(pkt1 = packet_pool_get(&q->pool)))
+            return AVERROR(ENOMEM);
+        if ((ret = packet_spill_read(&q->spill, &pkt, &serial)) < 0) {
+            packet_pool_put(&q->pool, pkt1);
+            return ret;
+        }
+        pkt1->pkt = pkt;
+        pkt1->next = NULL;
+        pkt1->serial = serial;
+        if (!q->last_pkt)
+            q->first_pkt = pkt1;
+        else
+            q->last_pkt->next = pkt1;
+        q->last_pkt = pkt1;
+        q->nb_packets++;
+        q->size += pkt1->pkt.size + sizeof(*pkt1);
+        q->duration += pkt1->pkt.duration;
+    }
+    /* compacting only writes over read space, a failure loses no packet */
+    if (q->spill.nb_packets && (ret = packet_spill_compact(&q->spill)) < 0)
+        print_error("Compacting the packet spill file", ret);
+    return 0;
+}
+
+static int packet_queue_put(PacketQueue* q, AVPacket* pkt)
+{
+    int ret;
+
+    SDL_LockMutex(q->mutex);
+    ret = packet_queue_put_private(q, pkt);
+    SDL_UnlockMutex(q->mutex);
+
+    if (pkt != &flush_pkt && ret < 0)
+        av_packet_unref(pkt);
+
+    return ret;
+}
+
+static int packet_queue_put_nullpacket(PacketQueue* q, int stream_index)
+{
+    AVPacket pkt1, * pkt = &pkt1;
+    av_init_packet(pkt);
+    pkt->data = NULL;
+    pkt->size = 0;
+    pkt->stream_index = stream_index;
+    return packet_queue_put(q, pkt);
+}
+
+/* packet queue handling */
+static int packet_queue_init(PacketQueue* q, int ring_size)
+{
+    memset(q, 0, sizeof(PacketQueue));
+    q->mutex = SDL_CreateMutex();
+    if (!q->mutex) {
+        av_log(NULL, AV_LOG_FATAL, "SDL_CreateMutex(): %s\n", SDL_GetError());
+        return AVERROR(ENOMEM);
+    }
+    q->cond = SDL_CreateCond();
+    if (!q->cond) {
+        av_log(NULL, AV_LOG_FATAL, "SDL_CreateCond(): %s\n", SDL_GetError());
+        return AVERROR(ENOMEM);
+    }
+    if (ring_size > 0) {
+        PacketRing* r = &q->ring;
+        unsigned capacity = 2;
+        int ret;
+
+        while (capacity < (unsigned)ring_size)
+            capacity <<= 1;
+        r->slots = static_cast<MyAVPacketList*>(av_mallocz_array(capacity, sizeof(*r->slots)));
+        if (!r->slots)
+            return AVERROR(ENOMEM);
+        if ((ret = event_init(&r->not_empty)) < 0 ||
+            (ret = event_init(&r->not_full)) < 0)
+            return ret;
+        r->capacity = capacity;
+        r->mask = capacity - 1;
+    }
+    q->abort_request = 1;
+    return 0;
+}
+
+/* Detach all queued packets in O(1), they are unreferenced by the reclaimer */
+static void packet_queue_flush(PacketQueue* q)
+{
+    SDL_LockMutex(q->mutex);
+    /* The consumer owns the read side of a ring, so it can only be emptied here
+     * once the consumer is stopped. Otherwise the flush packet that follows
+     * bumps the serial and the consumer discards the stale packets itself. */
+    q->stats.nb_flushes++;
+    q->stats.nb_flushed += q->nb_packets + q->spill.nb_packets;
+    if (q->ring.capacity && q->abort_request)
+        packet_ring_drain(q);
+    packet_queue_defer_unref(q, q->first_pkt, q->last_pkt);
+    packet_spill_reset(&q->spill);
+    q->last_pkt = NULL;
+    q->first_pkt = NULL;
+    q->nb_packets = 0;
+    q->size = 0;
+    q->duration = 0;
+    SDL_UnlockMutex(q->mutex);
+}
+
+static void packet_queue_destroy(PacketQueue* q)
+{
+    packet_queue_flush(q);
+    packet_pool_uninit(&q->pool);
+    packet_spill_close(&q->spill);
+    if (q->ring.capacity) {
+        event_destroy(&q->ring.not_empty);
+        event_destroy(&q->ring.not_full);
+    }
+    av_freep(&q->ring.slots);
+    SDL_DestroyMutex(q->mutex);
+    SDL_DestroyCond(q->cond);
+}
+
+static void packet_queue_abort(PacketQueue* q)
+{
+    if (q->ring.capacity) {
+        /* a producer blocked on a full ring holds the mutex */
+        q->abort_request = 1;
+        event_wake(&q->ring.not_empty);
+        event_wake(&q->ring.not_full);
+        return;
+    }
+
+    SDL_LockMutex(q->mutex);
+
+    q->abort_request = 1;
+
+    SDL_CondSignal(q->cond);
+
+    SDL_UnlockMutex(q->mutex);
+}
+
+static void packet_queue_start(PacketQueue* q)
+{
+    SDL_LockMutex(q->mutex);
+    q->abort_request = 0;
+    packet_queue_put_private(q, &flush_pkt);
+    SDL_UnlockMutex(q->mutex);
+}
+
+/* return < 0 if aborted, 0 if no packet and > 0 if packet.  */
+static int packet_queue_get(PacketQueue* q, AVPacket* pkt, int block, int* serial)
+{
+    MyAVPacketList* pkt1;
+    int ret;
+
+    if (q->ring.capacity) {
+        ret = packet_ring_get(q, pkt, block, serial);
+        if (ret > 0) {
+            q->stats.nb_get++;
+            packet_queue_check_wakeup(q);
+        }
+        return ret;
+    }
+
+    SDL_LockMutex(q->mutex);
+
+    for (;;) {
+        if (q->abort_request) {
+            ret = -1;
+            break;
+        }
+
+        /* refill in batches from half the budget, not for every packet */
+        if (q->spill.nb_packets && (!q->first_pkt || q->size <= q->spill.budget / 2) &&
+            (ret = packet_queue_refill(q)) < 0) {
+            print_error("Reading spilled packets", ret);
+            packet_spill_reset(&q->spill);
+            q->spill.budget = 0;
+        }
+
+        pkt1 = q->first_pkt;
+        if (pkt1) {
+            q->first_pkt = pkt1->next;
+            if (!q->first_pkt)
+                q->last_pkt = NULL;
+            q->nb_packets--;
+            q->size -= pkt1->pkt.size + sizeof(*pkt1);
+            q->duration -= pkt1->pkt.duration;
+            *pkt = pkt1->pkt;
+            if (serial)
+                *serial = pkt1->serial;
+            packet_pool_put(&q->pool, pkt1);
+            ret = 1;
+            break;
+        }
+        else if (!block) {
+            ret = 0;
+            break;
+        }
+        else {
+            int64_t start = av_gettime_relative();
+            SDL_CondWait(q->cond, q->mutex);
+            queue_wait_stats_add(&q->stats.consumer_wait, start);
+        }
+    }
+    SDL_UnlockMutex(q->mutex);
+    if (ret > 0) {
+        q->stats.nb_get++;
+        packet_queue_check_wakeup(q);
+    }
+    return ret;
+}
+
+/* Take a snapshot of the statistics of a packet queue. The counters are
+ * updated without a common lock, so fields may be a few events apart. */
+static void packet_queue_get_stats(PacketQueue* q, QueueStats* stats)
+{
+    *stats = q->stats;
+    stats->nb_cur = packet_queue_nb_packets(q);
+    stats->size_cur = packet_queue_size(q);
+    stats->serial = q->serial;
+}
+
+#if HAVE_VIRTUALALLOC || (HAVE_MMAP && defined(MAP_HUGETLB))
+static void video_buffer_free_huge(void* opaque, uint8_t* data)
+{
+#if HAVE_VIRTUALALLOC
+    VirtualFree(data, 0, MEM_RELEASE);
+#else
+    munmap(data, (size_t)(intptr_t)opaque);
+#endif
+}
+
+/* Try to back a plane buffer with large pages, returns NULL if the system
+ * refuses (no privilege, no reserved huge pages) or the buffer is too small. */
+static AVBufferRef* video_buffer_alloc_huge(int size)
+{
+    static int warned;
+    AVBufferRef* buf;
+    uint8_t* data;
+    size_t alloc_size;
+#if HAVE_VIRTUALALLOC
+    size_t page_size = GetLargePageMinimum();
+
+    if (size <= 0 || !page_size || (size_t)size < page_size)
+        return NULL;
+    alloc_size = FFALIGN((size_t)size, page_size);
+    data = static_cast<uint8_t*>(VirtualAlloc(NULL, alloc_size, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE));
+#else
+    const size_t page_size = 2 * 1024 * 1024;
+    void* ptr;
+
+    if (size <= 0 || (size_t)size < page_size)
+        return NULL;
+    alloc_size = FFALIGN((size_t)size, page_size);
+    ptr = mmap(NULL, alloc_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    data = ptr == MAP_FAILED ? NULL : static_cast<uint8_t*>(ptr);
+#endif
+    if (!data) {
+        if (!warned) {
+            av_log(NULL, AV_LOG_WARNING, "Could not allocate huge pages for video frames, using normal pages\n");
+            warned = 1;
+        }
+        return NULL;
+    }
+    buf = av_buffer_create(data, size, video_buffer_free_huge, (void*)(intptr_t)alloc_size, 0);
+    if (!buf)
+        video_buffer_free_huge((void*)(intptr_t)alloc_size, data);
+    return buf;
+}
+#endif
+
+/* AVBufferPool allocator, only called from av_buffer_pool_get() with the
+ * video buffer pool mutex held. */
+static AVBufferRef* video_buffer_alloc(void* opaque, int size)
+{
+    VideoBufferPool* vbp = static_cast<VideoBufferPool*>(opaque);
+    AVBufferRef* buf = NULL;
+
+#if HAVE_VIRTUALALLOC || (HAVE_MMAP && defined(MAP_HUGETLB))
+    if (vbp->huge_pages)
+        buf = video_buffer_alloc_huge(size);
+#endif
+    if (!buf)
+        buf = av_buffer_alloc(size);
+    if (buf)
+        vbp->nb_allocs++;
+    return buf;
+}
+
+static void video_buffer_pool_entry_reset(VideoBufferPoolEntry* e)
+{
+    int i;
+
+    /* buffers still referenced by queued frames keep their pool alive */
+    for (i = 0; i < 4; i++)
+        av_buffer_pool_uninit(&e->pools[i]);
+    memset(e, 0, sizeof(*e));
+}
+
+static int video_buffer_pool_init(VideoBufferPool* vbp)
+{
+    memset(vbp, 0, sizeof(*vbp));
+    vbp->mutex = SDL_CreateMutex();
+    if (!vbp->mutex) {
+        av_log(NULL, AV_LOG_FATAL, "SDL_CreateMutex(): %s\n", SDL_GetError());
+        return AVERROR(ENOMEM);
+    }
+    vbp->huge_pages = huge_pages;
+    return 0;
+}
+
+/* Drop all geometries, called when the video decoder is closed */
+static void video_buffer_pool_flush(VideoBufferPool* vbp)
+{
+    int i;
+
+    if (!vbp->mutex)
+        return;
+    SDL_LockMutex(vbp->mutex);
+    if (vbp->nb_gets)
+        av_log(NULL, AV_LOG_VERBOSE, "Video buffer pool: %" PRId64 " frames served from %" PRId64 " allocations\n",
+            vbp->nb_gets, vbp->nb_allocs);
+    for (i = 0; i < VIDEO_BUFFER_POOLS; i++)
+        video_buffer_pool_entry_reset(&vbp->entries[i]);
+    vbp->nb_gets = vbp->nb_allocs = 0;
+    SDL_UnlockMutex(vbp->mutex);
+}
+
+static void video_buffer_pool_uninit(VideoBufferPool* vbp)
+{
+    video_buffer_pool_flush(vbp);
+    SDL_DestroyMutex(vbp->mutex);
+    vbp->mutex = NULL;
+}
+
+/* Find the entry for this geometry, recycling the least recently used one
+ * when the stream changed resolution or format. Called with the mutex held. */
+static VideoBufferPoolEntry* video_buffer_pool_entry(VideoBufferPool* vbp, AVCodecContext* avctx, AVFrame* frame)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+    VideoBufferPoolEntry* e = NULL;
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    int w = frame->width, h = frame->height;
+    int i, unaligned;
+
+    for (i = 0; i < VIDEO_BUFFER_POOLS; i++) {
+        VideoBufferPoolEntry* cur = &vbp->entries[i];
+        if (cur->width == frame->width && cur->height == frame->height && cur->format == frame->format) {
+            e = cur;
+            goto found;
+        }
+        if (!e || cur->last_used < e->last_used)
+            e = cur;
+    }
+    video_buffer_pool_entry_reset(e);
+
+    /* same padding and stride alignment as avcodec_default_get_buffer2(),
+     * frames not written by a decoder only need aligned lines */
+    if (avctx) {
+        avcodec_align_dimensions2(avctx, &w, &h, linesize_align);
+    }
+    else {
+        for (i = 0; i < AV_NUM_DATA_POINTERS; i++)
+            linesize_align[i] = 64;
+    }
+    do {
+        if (av_image_fill_linesizes(e->linesize, (enum AVPixelFormat)frame->format, w) < 0)
+            return NULL;
+        w += w & ~(w - 1);
+        unaligned = 0;
+        for (i = 0; i < 4; i++)
+            unaligned |= e->linesize[i] % linesize_align[i];
+    } while (unaligned);
+
+    e->nb_planes = av_pix_fmt_count_planes((enum AVPixelFormat)frame->format);
+    for (i = 0; i < e->nb_planes; i++) {
+        int plane_h = (i == 1 || i == 2) ? AV_CEIL_RSHIFT(h, desc->log2_chroma_h) : h;
+        int64_t size = (int64_t)e->linesize[i] * plane_h + 16 + 64 - 1;
+        if (size > INT_MAX)
+            goto fail;
+        e->pools[i] = av_buffer_pool_init2((int)size, vbp, video_buffer_alloc, NULL);
+        if (!e->pools[i])
+            goto fail;
+    }
+    e->width = frame->width;
+    e->height = frame->height;
+    e->format = frame->format;
+found:
+    e->last_used = ++vbp->use_count;
+    return e;
+fail:
+    video_buffer_pool_entry_reset(e);
+    return NULL;
+}
+
+/* Attach pooled planes for frame->width x frame->height in frame->format.
+ * avctx is the decoder the frame is for, or NULL for frames we write ourselves. */
+static int video_buffer_pool_get_frame(VideoBufferPool* vbp, AVCodecContext* avctx, AVFrame* frame)
+{
+    VideoBufferPoolEntry* e;
+    int i;
+
+    SDL_LockMutex(vbp->mutex);
+    e = video_buffer_pool_entry(vbp, avctx, frame);
+    if (!e) {
+        SDL_UnlockMutex(vbp->mutex);
+        return AVERROR(EINVAL);
+    }
+    for (i = 0; i < e->nb_planes; i++) {
+        frame->buf[i] = av_buffer_pool_get(e->pools[i]);
+        if (!frame->buf[i]) {
+            SDL_UnlockMutex(vbp->mutex);
+            goto fail;
+        }
+        frame->data[i] = frame->buf[i]->data;
+        frame->linesize[i] = e->linesize[i];
+    }
+    vbp->nb_gets++;
+    SDL_UnlockMutex(vbp->mutex);
+
+    for (; i < AV_NUM_DATA_POINTERS; i++) {
+        frame->data[i] = NULL;
+        frame->linesize[i] = 0;
+    }
+    frame->extended_data = frame->data;
+    return 0;
+fail:
+    for (i = 0; i < AV_NUM_DATA_POINTERS; i++)
+        av_buffer_unref(&frame->buf[i]);
+    return AVERROR(ENOMEM);
+}
+
+static int video_get_buffer2(AVCodecContext* avctx, AVFrame* frame, int flags)
+{
+    FMediaPlayer* is = static_cast<FMediaPlayer*>(avctx->opaque);
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((enum AVPixelFormat)frame->format);
+
+    if (!desc || avctx->hw_frames_ctx ||
+        (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_BITSTREAM)))
+        return avcodec_default_get_buffer2(avctx, frame, flags);
+
+    if (video_buffer_pool_get_frame(&is->video_buffer_pool, avctx, frame) < 0)
+        return avcodec_default_get_buffer2(avctx, frame, flags);
+    return 0;
+}
+
+static void decoder_init(Decoder* d, AVCodecContext* avctx, PacketQueue* queue, EventCount* empty_queue_event) {
+    memset(d, 0, sizeof(Decoder));
+    d->avctx = avctx;
+    d->queue = queue;
+    d->empty_queue_event = empty_queue_event;
+    d->start_pts = AV_NOPTS_VALUE;
+    d->pkt_serial = -1;
+}
+
+static int decoder_decode_frame(Decoder* d, AVFrame* frame, AVSubtitle* sub) {
+    int ret = AVERROR(EAGAIN);
+
+    for (;;) {
+        AVPacket pkt;
+
+        if (d->queue->serial == d->pkt_serial) {
+            do {
+                if (d->queue->abort_request)
+                    return -1;
+
+                switch (d->avctx->codec_type) {
+                case AVMEDIA_TYPE_VIDEO:
+                    ret = avcodec_receive_frame(d->avctx, frame);
+                    if (ret >= 0) {
+                        if (decoder_reorder_pts == -1) {
+                            frame->pts = frame->best_effort_timestamp;
+                        }
+                        else if (!decoder_reorder_pts) {
+                            frame->pts = frame->pkt_dts;
+                        }
+                    }
+                    break;
+                case AVMEDIA_TYPE_AUDIO:
+                    ret = avcodec_receive_frame(d->avctx, frame);
+                    if (ret >= 0) {
+                        AVRational tb = AVRational{ 1, frame->sample_rate };
+                        if (frame->pts != AV_NOPTS_VALUE)
+                            frame->pts = av_rescale_q(frame->pts, d->avctx->pkt_timebase, tb);
+                        else if (d->next_pts != AV_NOPTS_VALUE)
+                            frame->pts = av_rescale_q(d->next_pts, d->next_pts_tb, tb);
+                        if (frame->pts != AV_NOPTS_VALUE) {
+                            d->next_pts = frame->pts + frame->nb_samples;
+                            d->next_pts_tb = tb;
+                        }
+                    }
+                    break;
+                }
+                if (ret == AVERROR_EOF) {
+                    d->finished = d->pkt_serial;
+                    event_notify(d->empty_queue_event);
+                    avcodec_flush_buffers(d->avctx);
+                    return 0;
+                }
+                if (ret >= 0)
+                    return 1;
+            } while (ret != AVERROR(EAGAIN));
+        }
+
+        do {
+            if (d->packet_pending) {
+                av_packet_move_ref(&pkt, &d->pkt);
+                d->packet_pending = 0;
+            }
+            else {
+                if (packet_queue_get(d->queue, &pkt, 1, &d->pkt_serial) < 0)
+                    return -1;
+            }
+            if (d->queue->serial != d->pkt_serial)
+                av_packet_unref(&pkt);
+        } while (d->queue->serial != d->pkt_serial);
+
+        if (pkt.data == flush_pkt.data) {
+            avcodec_flush_buffers(d->avctx);
+            d->finished = 0;
+            d->next_pts = d->start_pts;
+            d->next_pts_tb = d->start_pts_tb;
+        }
+        else {
+            if (d->avctx->codec_type == AVMEDIA_TYPE_SUBTITLE) {
+                int got_frame = 0;
+                ret = avcodec_decode_subtitle2(d->avctx, sub, &got_frame, &pkt);
+                if (ret < 0) {
+                    ret = AVERROR(EAGAIN);
+                }
+                else {
+                    if (got_frame && !pkt.data) {
+                        d->packet_pending = 1;
+                        av_packet_move_ref(&d->pkt, &pkt);
+                    }
+                    ret = got_frame ? 0 : (pkt.data ? AVERROR(EAGAIN) : AVERROR_EOF);
+                }
+            }
+            else {
+                if (avcodec_send_packet(d->avctx, &pkt) == AVERROR(EAGAIN)) {
+                    av_log(d->avctx, AV_LOG_ERROR, "Receive_frame and send_packet both returned EAGAIN, which is an API violation.\n");
+                    d->packet_pending = 1;
+                    av_packet_move_ref(&d->pkt, &pkt);
+                }
+            }
+            av_packet_unref(&pkt);
+        }
+    }
+}
+
+static void decoder_destroy(Decoder* d) {
+    av_packet_unref(&d->pkt);
+    avcodec_free_context(&d->avctx);
+}
+
+static int frame_queue_alloc_item(VideoFrame* vp)
+{
+    return (vp->frame = av_frame_alloc()) ? 0 : AVERROR(ENOMEM);
+}
+
+static int frame_queue_alloc_item(AudioFrame* af)
+{
+    return (af->frame = av_frame_alloc()) ? 0 : AVERROR(ENOMEM);
+}
+
+static int frame_queue_alloc_item(SubtitleFrame* sp)
+{
+    return 0;
+}
+
+static void frame_queue_unref_item(VideoFrame* vp)
+{
+    av_frame_unref(vp->frame);
+}
+
+static void frame_queue_unref_item(AudioFrame* af)
+{
+    av_frame_unref(af->frame);
+}
+
+static void frame_queue_unref_item(SubtitleFrame* sp)
+{
+    unsigned i;
+    if (sp->rects) {
+        for (i = 0; i < sp->sub.num_rects; i++)
+            av_free(sp->rects[i].data);
+        av_freep(&sp->rects);
+    }
+    avsubtitle_free(&sp->sub);
+}
+
+static void frame_queue_free_item(VideoFrame* vp)
+{
+    av_frame_free(&vp->frame);
+}
+
+static void frame_queue_free_item(AudioFrame* af)
+{
+    av_frame_free(&af->frame);
+}
+
+static void frame_queue_free_item(SubtitleFrame* sp)
+{
+}
+
+template <typename T>
+static int frame_queue_init(FrameQueue<T>* f, PacketQueue* pktq, int max_size, int keep_last)
+{
+    int i, ret;
+    memset(f, 0, sizeof(*f));
+    if ((ret = event_init(&f->not_full)) < 0 ||
+        (ret = event_init(&f->not_empty)) < 0)
+        return ret;
+    f->pktq = pktq;
+    f->queue = static_cast<T*>(av_mallocz_array(max_size, sizeof(T)));
+    if (!f->queue)
+        return AVERROR(ENOMEM);
+    f->max_size = max_size;
+    SDL_AtomicSet(&f->depth, max_size);
+    f->keep_last = !!keep_last;
+    for (i = 0; i < f->max_size; i++)
+        if ((ret = frame_queue_alloc_item(&f->queue[i])) < 0)
+            return ret;
+    return 0;
+}
+
+template <typename T>
+static void frame_queue_destory(FrameQueue<T>* f)
+{
+    int i;
+    for (i = 0; i < f->max_size; i++) {
+        T* vp = &f->queue[i];
+        frame_queue_unref_item(vp);
+        frame_queue_free_item(vp);
+    }
+    av_freep(&f->queue);
+    event_destroy(&f->not_full);
+    event_destroy(&f->not_empty);
+}
+
+template <typename T>
+static void frame_queue_signal(FrameQueue<T>* f)
+{
+    event_wake(&f->not_full);
+    event_wake(&f->not_empty);
+}
+
+/* return the number of frames in the queue, including the last shown one */
+template <typename T>
+static int frame_queue_size(FrameQueue<T>* f)
+{
+    return SDL_AtomicGet(&f->nb_pushed) - SDL_AtomicGet(&f->nb_released);
+}
+
+template <typename T>
+static int frame_queue_depth(FrameQueue<T>* f)
+{
+    return SDL_AtomicGet(&f->depth);
+}
+
+/* Change the number of frames the producer may queue, within the allocated
+ * slots. Lowering it does not drop frames, the producer just blocks longer. */
+template <typename T>
+static void frame_queue_set_depth(FrameQueue<T>* f, int depth)
+{
+    depth = av_clip(depth, f->keep_last + 1, f->max_size);
+    if (SDL_AtomicSet(&f->depth, depth) < depth)
+        event_wake(&f->not_full);
+}
+
+template <typename T>
+static T* frame_queue_peek(FrameQueue<T>* f)
+{
+    return &f->queue[(f->rindex + f->rindex_shown) % f->max_size];
+}
+
+template <typename T>
+static T* frame_queue_peek_next(FrameQueue<T>* f)
+{
+    return &f->queue[(f->rindex + f->rindex_shown + 1) % f->max_size];
+}
+
+template <typename T>
+static T* frame_queue_peek_last(FrameQueue<T>* f)
+{
+    return &f->queue[f->rindex];
+}
+
+template <typename T>
+static T* frame_queue_peek_writable(FrameQueue<T>* f)
+{
+    /* wait until we have space to put a new frame */
+    if (frame_queue_size(f) >= frame_queue_depth(f) && !f->pktq->abort_request) {
+        int64_t start = av_gettime_relative();
+        for (;;) {
+            int key = event_prepare_wait(&f->not_full);
+            if (frame_queue_size(f) < frame_queue_depth(f) || f->pktq->abort_request) {
+                event_cancel_wait(&f->not_full);
+                break;
+            }
+            event_commit_wait(&f->not_full, key, -1);
+        }
+        queue_wait_stats_add(&f->stats.producer_wait, start);
+    }
+
+    if (f->pktq->abort_request)
+        return NULL;
+
+    return &f->queue[f->windex];
+}
+
+template <typename T>
+static T* frame_queue_peek_readable(FrameQueue<T>* f)
+{
+    /* wait until we have a readable a new frame */
+    if (frame_queue_size(f) - f->rindex_shown <= 0 && !f->pktq->abort_request) {
+        int64_t start = av_gettime_relative();
+        for (;;) {
+            int key = event_prepare_wait(&f->not_empty);
+            if (frame_queue_size(f) - f->rindex_shown > 0 || f->pktq->abort_request) {
+                event_cancel_wait(&f->not_empty);
+                break;
+            }
+            event_commit_wait(&f->not_empty, key, -1);
+        }
+        queue_wait_stats_add(&f->stats.consumer_wait, start);
+    }
+
+    if (f->pktq->abort_request)
+        return NULL;
+
+    return &f->queue[(f->rindex + f->rindex_shown) % f->max_size];
+}
+
+template <typename T>
+static void frame_queue_push(FrameQueue<T>* f)
+{
+    if (++f->windex == f->max_size)
+        f->windex = 0;
+    SDL_AtomicAdd(&f->nb_pushed, 1);
+    f->stats.nb_put++;
+    f->stats.max_nb = FFMAX(f->stats.max_nb, frame_queue_size(f));
+    event_notify(&f->not_empty);
+}
+
+template <typename T>
+static void frame_queue_next(FrameQueue<T>* f)
+{
+    if (f->keep_last && !f->rindex_shown) {
+        f->rindex_shown = 1;
+    }
+    else {
+        frame_queue_unref_item(&f->queue[f->rindex]);
+        if (++f->rindex == f->max_size)
+            f->rindex = 0;
+        SDL_AtomicAdd(&f->nb_released, 1);
+        f->stats.nb_get++;
+        event_notify(&f->not_full);
+    }
+    /* the read thread waits for the end of playback to loop or exit */
+    if (frame_queue_size(f) - f->rindex_shown == 0 && f->pktq->wakeup)
+        event_notify(f->pktq->wakeup);
+}
+
+/* return the number of undisplayed frames in the queue */
+template <typename T>
+static int frame_queue_nb_remaining(FrameQueue<T>* f)
+{
+    return frame_queue_size(f) - f->rindex_shown;
+}
+
+/* Take a snapshot of the statistics of a frame queue */
+template <typename T>
+static void frame_queue_get_stats(FrameQueue<T>* f, QueueStats* stats)
+{
+    *stats = f->stats;
+    stats->nb_cur = frame_queue_nb_remaining(f);
+    stats->size_cur = 0;
+    stats->serial = f->pktq->serial;
+}
+
+/* return last shown position */
+template <typename T>
+static int64_t frame_queue_last_pos(FrameQueue<T>* f)
+{
+    T* fp = &f->queue[f->rindex];
+    if (f->rindex_shown && fp->serial == f->pktq->serial)
+        return fp->pos;
+    else
+        return -1;
+}
+
+template <typename T>
+static void decoder_abort(Decoder* d, FrameQueue<T>* fq)
+{
+    packet_queue_abort(d->queue);
+    frame_queue_signal(fq);
+    SDL_WaitThread(d->decoder_tid, NULL);
+    d->decoder_tid = NULL;
+    packet_queue_flush(d->queue);
+}
+
+static inline void fill_rectangle(int x, int y, int w, int h)
+{
+    SDL_Rect rect;
+    rect.x = x;
+    rect.y = y;
+    rect.w = w;
+    rect.h = h;
+    if (w && h)
+        SDL_RenderFillRect(renderer, &rect);
+}
+
+static int realloc_texture(SDL_Texture** texture, Uint32 new_format, int new_width, int new_height, SDL_BlendMode blendmode, int init_texture)
+{
+    Uint32 format;
+    int access, w, h;
+    if (!*texture || SDL_QueryTexture(*texture, &format, &access, &w, &h) < 0 || new_width != w || new_height != h || new_format != format) {
+        void* pixels;
+        int pitch;
+        if (*texture)
+            SDL_DestroyTexture(*texture);
+        if (!(*texture = SDL_CreateTexture(renderer, new_format, SDL_TEXTUREACCESS_STREAMING, new_width, new_height)))
+            return -1;
+        if (SDL_SetTextureBlendMode(*texture, blendmode) < 0)
+            return -1;
+        if (init_texture) {
+            if (SDL_LockTexture(*texture, NULL, &pixels, &pitch) < 0)
+                return -1;
+            memset(pixels, 0, pitch * new_height);
+            SDL_UnlockTexture(*texture);
+        }
+        av_log(NULL, AV_LOG_VERBOSE, "Created %dx%d texture with %s.\n", new_width, new_height, SDL_GetPixelFormatName(new_format));
+    }
+    return 0;
+}
+
+static void calculate_display_rect(SDL_Rect* rect,
+    int scr_xleft, int scr_ytop, int scr_width, int scr_height,
+    int pic_width, int pic_height, AVRational pic_sar)
+{
+    AVRational aspect_ratio = pic_sar;
+    int64_t width, height, x, y;
+
+    if (av_cmp_q(aspect_ratio, av_make_q(0, 1)) <= 0)
+        aspect_ratio = av_make_q(1, 1);
+
+    aspect_ratio = av_mul_q(aspect_ratio, av_make_q(pic_width, pic_height));
+
+    /* XXX: we suppose the screen has a 1.0 pixel ratio */
+    height = scr_height;
+    width = av_rescale(height, aspect_ratio.num, aspect_ratio.den) & ~1;
+    if (width > scr_width) {
+        width = scr_width;
+        height = av_rescale(width, aspect_ratio.den, aspect_ratio.num) & ~1;
+    }
+    x = (scr_width - width) / 2;
+    y = (scr_height - height) / 2;
+    rect->x = scr_xleft + x;
+    rect->y = scr_ytop + y;
+    rect->w = FFMAX((int)width, 1);
+    rect->h = FFMAX((int)height, 1);
+}
+
+static void get_sdl_pix_fmt_and_blendmode(int format, Uint32* sdl_pix_fmt, SDL_BlendMode* sdl_blendmode)
+{
+    int i;
+    *sdl_blendmode = SDL_BLENDMODE_NONE;
+    *sdl_pix_fmt = SDL_PIXELFORMAT_UNKNOWN;
+    if (format == AV_PIX_FMT_RGB32 ||
+        format == AV_PIX_FMT_RGB32_1 ||
+        format == AV_PIX_FMT_BGR32 ||
+        format == AV_PIX_FMT_BGR32_1)
+        *sdl_blendmode = SDL_BLENDMODE_BLEND;
+    for (i = 0; i < FF_ARRAY_ELEMS(sdl_texture_format_map) - 1; i++) {
+        if (format == sdl_texture_format_map[i].format) {
+            *sdl_pix_fmt = sdl_texture_format_map[i].texture_fmt;
+            return;
+        }
+    }
+}
+
+/* return 1 if the renderer lists the texture format of the pixel format */
+static int texture_format_supported(int format)
+{
+    Uint32 sdl_pix_fmt;
+    SDL_BlendMode sdl_blendmode;
+    int i;
+
+    get_sdl_pix_fmt_and_blendmode(format, &sdl_pix_fmt, &sdl_blendmode);
+    if (sdl_pix_fmt == SDL_PIXELFORMAT_UNKNOWN)
+        return 0;
+    for (i = 0; i < (int)renderer_info.num_texture_formats; i++)
+        if (renderer_info.texture_formats[i] == sdl_pix_fmt)
+            return 1;
+    return 0;
+}
+
+/* NV12/NV21: a luma plane followed by one plane of interleaved chroma */
+static int update_nv_texture(SDL_Texture* tex, AVFrame* frame)
+{
+    const uint8_t* planes[2] = { frame->data[0], frame->data[1] };
+    int pitches[2] = { frame->linesize[0], frame->linesize[1] };
+    int chroma_h = AV_CEIL_RSHIFT(frame->height, 1);
+
+    if (pitches[0] < 0 && pitches[1] < 0) {
+        planes[0] += pitches[0] * (frame->height - 1);
+        planes[1] += pitches[1] * (chroma_h - 1);
+        pitches[0] = -pitches[0];
+        pitches[1] = -pitches[1];
+    }
+    else if (pitches[0] < 0 || pitches[1] < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Mixed negative and positive linesizes are not supported.\n");
+        return -1;
+    }
+#if SDL_VERSION_ATLEAST(2,0,16)
+    return SDL_UpdateNVTexture(tex, NULL, planes[0], pitches[0], planes[1], pitches[1]);
+#else
+    {
+        /* the locked texture holds the chroma plane right after the luma plane, with the same pitch */
+        uint8_t* pixels;
+        int pitch, y;
+
+        if (SDL_LockTexture(tex, NULL, (void**)&pixels, &pitch) < 0)
+            return -1;
+        for (y = 0; y < frame->height; y++)
+            memcpy(pixels + y * pitch, planes[0] + y * pitches[0], frame->width);
+        pixels += pitch * frame->height;
+        for (y = 0; y < chroma_h; y++)
+            memcpy(pixels + y * pitch, planes[1] + y * pitches[1], 2 * AV_CEIL_RSHIFT(frame->width, 1));
+        SDL_UnlockTexture(tex);
+        return 0;
+    }
+#endif
+}
+
+static void slice_scaler_init(SliceScaler* s, int nb_threads)
+{
+    memset(s, 0, sizeof(*s));
+    if (nb_threads <= 0)
+        nb_threads = av_cpu_count();
+    s->nb_workers = av_clip(nb_threads, 1, SLICE_SCALER_MAX) - 1;
+}
+
+static int slice_scaler_row(const SliceScaler* s, int slice)
+{
+    if (slice >= s->scale_slices)
+        return s->height;
+    return FFMIN(FFALIGN(s->height * slice / s->scale_slices, s->align), s->height);
+}
+
+/* planes of a picture starting at luma row y, the palette is left alone */
+static void slice_scaler_planes(int format, uint8_t* const* data, const int* linesize, int y, uint8_t* out[4])
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(format));
+    int nb_planes = av_pix_fmt_count_planes(static_cast<AVPixelFormat>(format));
+    int p;
+
+    for (p = 0; p < 4; p++) {
+        out[p] = data[p];
+        if (p < nb_planes && data[p])
+            out[p] += (ptrdiff_t)((p == 1 || p == 2) ? y >> desc->log2_chroma_h : y) * linesize[p];
+    }
+}
+
+static int slice_scaler_run(SliceScaler* s, int slice)
+{
+    int y0 = slice_scaler_row(s, slice), y1 = slice_scaler_row(s, slice + 1);
+    uint8_t* src[4], * dst[4];
+
+    if (y1 <= y0)
+        return 0;
+    s->ctx[slice] = sws_getCachedContext(s->ctx[slice],
+        s->width, y1 - y0, static_cast<AVPixelFormat>(s->src_format), s->width, y1 - y0,
+        static_cast<AVPixelFormat>(s->dst_format), s->flags, NULL, NULL, NULL);
+    if (!s->ctx[slice])
+        return AVERROR(EINVAL);
+    slice_scaler_planes(s->src_format, (uint8_t* const*)s->src, s->src_linesize, y0, src);
+    slice_scaler_planes(s->dst_format, s->dst, s->dst_linesize, y0, dst);
+    sws_scale(s->ctx[slice], (const uint8_t* const*)src, s->src_linesize, 0, y1 - y0, dst, s->dst_linesize);
+    return 0;
+}
+
+static int slice_scaler_job(void* opaque, int slice)
+{
+    return slice_scaler_run(static_cast<SliceScaler*>(opaque), slice);
+}
+
+static int slice_scaler_thread(void* arg)
+{
+    SliceScaler* s = static_cast<SliceScaler*>(arg);
+    int slice, ret;
+
+    SDL_LockMutex(s->mutex);
+    for (;;) {
+        if (s->abort_request)
+            break;
+        if (s->next >= s->nb_slices) {
+            SDL_CondWait(s->start_cond, s->mutex);
+            continue;
+        }
+        slice = s->next++;
+        SDL_UnlockMutex(s->mutex);
+
+        ret = s->job(s->opaque, slice);
+
+        SDL_LockMutex(s->mutex);
+        if (ret < 0)
+            s->failed = ret;
+        if (!--s->pending)
+            SDL_CondSignal(s->done_cond);
+    }
+    SDL_UnlockMutex(s->mutex);
+    return 0;
+}
+
+static int slice_scaler_start(SliceScaler* s)
+{
+    int i;
+
+    if (!(s->mutex = SDL_CreateMutex()) ||
+        !(s->start_cond = SDL_CreateCond()) ||
+        !(s->done_cond = SDL_CreateCond())) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot create the conversion threads: %s\n", SDL_GetError());
+        return AVERROR(ENOMEM);
+    }
+    for (i = 0; i < s->nb_workers; i++) {
+        s->workers[i] = SDL_CreateThread(slice_scaler_thread, "slice_scaler", s);
+        if (!s->workers[i]) {
+            av_log(NULL, AV_LOG_ERROR, "SDL_CreateThread(): %s\n", SDL_GetError());
+            break;
+        }
+        s->nb_running++;
+    }
+    return s->nb_running ? 0 : AVERROR(ENOMEM);
+}
+
+static void slice_scaler_uninit(SliceScaler* s)
+{
+    int i, nb_workers = s->nb_workers;
+
+    if (s->nb_running) {
+        SDL_LockMutex(s->mutex);
+        s->abort_request = 1;
+        SDL_CondBroadcast(s->start_cond);
+        SDL_UnlockMutex(s->mutex);
+        for (i = 0; i < s->nb_running; i++)
+            SDL_WaitThread(s->workers[i], NULL);
+    }
+    for (i = 0; i < SLICE_SCALER_MAX; i++)
+        sws_freeContext(s->ctx[i]);
+    if (s->mutex)
+        SDL_DestroyMutex(s->mutex);
+    if (s->start_cond)
+        SDL_DestroyCond(s->start_cond);
+    if (s->done_cond)
+        SDL_DestroyCond(s->done_cond);
+    /* usable again, the workers are restarted on demand */
+    memset(s, 0, sizeof(*s));
+    s->nb_workers = nb_workers;
+}
+
+/* Run job for the slices 0 to nb_slices - 1 on the calling thread and the
+ * workers, returns the error of a failed slice */
+static int slice_scaler_execute(SliceScaler* s, int nb_slices, int (*job)(void* opaque, int slice), void* opaque)
+{
+    int slice, ret = 0;
+
+    if (nb_slices > 1 && !s->nb_running && s->nb_workers && slice_scaler_start(s) < 0) {
+        av_log(NULL, AV_LOG_WARNING, "Converting pictures on a single thread\n");
+        slice_scaler_uninit(s);
+        s->nb_workers = 0;
+    }
+    if (nb_slices == 1 || !s->nb_running) {
+        for (slice = 0; slice < nb_slices; slice++) {
+            int err = job(opaque, slice);
+            if (err < 0)
+                ret = err;
+        }
+        return ret;
+    }
+
+    SDL_LockMutex(s->mutex);
+    s->job = job;
+    s->opaque = opaque;
+    s->nb_slices = nb_slices;
+    s->next = 0;
+    s->pending = nb_slices;
+    s->failed = 0;
+    SDL_CondBroadcast(s->start_cond);
+    while (s->next < s->nb_slices) {
+        slice = s->next++;
+        SDL_UnlockMutex(s->mutex);
+        ret = job(opaque, slice);
+        SDL_LockMutex(s->mutex);
+        if (ret < 0)
+            s->failed = ret;
+        s->pending--;
+    }
+    while (s->pending)
+        SDL_CondWait(s->done_cond, s->mutex);
+    ret = s->failed;
+    SDL_UnlockMutex(s->mutex);
+    return ret;
+}
+
+/* Convert a picture without resizing it, writing straight into dst */
+static int slice_scaler_scale(SliceScaler* s, const uint8_t* const src[], const int src_linesize[], int src_format,
+                              uint8_t* const dst[], const int dst_linesize[], int dst_format,
+                              int width, int height, int flags)
+{
+    const AVPixFmtDescriptor* src_desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(src_format));
+    const AVPixFmtDescriptor* dst_desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(dst_format));
+
+    if (!src_desc || !dst_desc)
+        return AVERROR(EINVAL);
+    s->src = src;
+    s->src_linesize = src_linesize;
+    s->src_format = src_format;
+    s->dst = dst;
+    s->dst_linesize = dst_linesize;
+    s->dst_format = dst_format;
+    s->width = width;
+    s->height = height;
+    s->flags = flags;
+    s->align = 1 << FFMAX(src_desc->log2_chroma_h, dst_desc->log2_chroma_h);
+    s->scale_slices = av_clip(height / SLICE_SCALER_MIN_ROWS, 1, s->nb_workers + 1);
+    /* Slices are converted as separate pictures. Only a change of the chroma
+     * height filters across rows, so that case is left in one piece unless
+     * it is point sampled. */
+    if (!(flags & SWS_POINT) && src_desc->log2_chroma_h != dst_desc->log2_chroma_h &&
+        src_desc->nb_components > 2 && !(src_desc->flags & AV_PIX_FMT_FLAG_PAL))
+        s->scale_slices = 1;
+    return slice_scaler_execute(s, s->scale_slices, slice_scaler_job, s);
+}
+
+static void set_sdl_yuv_conversion_mode(int mode);
+
+static int upload_texture(SDL_Texture** tex, int* tex_plan, const UploadPlan* plan, AVFrame* frame, SliceScaler* scaler) {
+    int ret = 0;
+    if (*tex_plan != plan->serial) {
+        /* some renderers pick the YUV matrix when the texture is created */
+        set_sdl_yuv_conversion_mode(plan->yuv_mode);
+        if (realloc_texture(tex, plan->texture_fmt, frame->width, frame->height, plan->blendmode, 0) < 0)
+            return -1;
+        *tex_plan = plan->serial;
+    }
+    switch (plan->sdl_pix_fmt) {
+    case SDL_PIXELFORMAT_UNKNOWN:
+        /* This should only happen if we are not using avfilter... */
+        {
+            uint8_t* pixels[4] = { NULL };
+            int pitch[4] = { 0 };
+            if (!SDL_LockTexture(*tex, NULL, (void**)pixels, pitch)) {
+                ret = slice_scaler_scale(scaler, (const uint8_t* const*)frame->data, frame->linesize, frame->format,
+                    pixels, pitch, AV_PIX_FMT_BGRA, frame->width, frame->height, sws_flags);
+                SDL_UnlockTexture(*tex);
+            }
+            if (ret < 0) {
+                av_log(NULL, AV_LOG_FATAL, "Cannot initialize the conversion context\n");
+                ret = -1;
+            }
+        }
+        break;
+    case SDL_PIXELFORMAT_IYUV:
+        if (frame->linesize[0] > 0 && frame->linesize[1] > 0 && frame->linesize[2] > 0) {
+            ret = SDL_UpdateYUVTexture(*tex, NULL, frame->data[0], frame->linesize[0],
+                frame->data[1], frame->linesize[1],
+                frame->data[2], frame->linesize[2]);
+        }
+        else if (frame->linesize[0] < 0 && frame->linesize[1] < 0 && frame->linesize[2] < 0) {
+            ret = SDL_UpdateYUVTexture(*tex, NULL, frame->data[0] + frame->linesize[0] * (frame->height - 1), -frame->linesize[0],
+                frame->data[1] + frame->linesize[1] * (AV_CEIL_RSHIFT(frame->height, 1) - 1), -frame->linesize[1],
+                frame->data[2] + frame->linesize[2] * (AV_CEIL_RSHIFT(frame->height, 1) - 1), -frame->linesize[2]);
+        }
+        else {
+            av_log(NULL, AV_LOG_ERROR, "Mixed negative and positive linesizes are not supported.\n");
+            return -1;
+        }
+        break;
+    case SDL_PIXELFORMAT_NV12:
+    case SDL_PIXELFORMAT_NV21:
+        ret = update_nv_texture(*tex, frame);
+        break;
+    default:
+        if (frame->linesize[0] < 0) {
+            ret = SDL_UpdateTexture(*tex, NULL, frame->data[0] + frame->linesize[0] * (frame->height - 1), -frame->linesize[0]);
+        }
+        else {
+            ret = SDL_UpdateTexture(*tex, NULL, frame->data[0], frame->linesize[0]);
+        }
+        break;
+    }
+    return ret;
+}
+
+static int get_sdl_yuv_conversion_mode(AVFrame* frame)
+{
+#if SDL_VERSION_ATLEAST(2,0,8)
+    SDL_YUV_CONVERSION_MODE mode = SDL_YUV_CONVERSION_AUTOMATIC;
+    if (frame && (frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUYV422 || frame->format == AV_PIX_FMT_UYVY422 ||
+                  frame->format == AV_PIX_FMT_NV12 || frame->format == AV_PIX_FMT_NV21)) {
+        if (frame->color_range == AVCOL_RANGE_JPEG)
+            mode = SDL_YUV_CONVERSION_JPEG;
+        else if (frame->colorspace == AVCOL_SPC_BT709)
+            mode = SDL_YUV_CONVERSION_BT709;
+        else if (frame->colorspace == AVCOL_SPC_BT470BG || frame->colorspace == AVCOL_SPC_SMPTE170M || frame->colorspace == AVCOL_SPC_SMPTE240M)
+            mode = SDL_YUV_CONVERSION_BT601;
+    }
+    return mode;
+#else
+    return 0;
+#endif
+}
+
+/* The conversion mode is global SDL state, only set it when it changes */
+static void set_sdl_yuv_conversion_mode(int mode)
+{
+#if SDL_VERSION_ATLEAST(2,0,8)
+    static int current_mode = -1;
+    if (mode != current_mode) {
+        SDL_SetYUVConversionMode(static_cast<SDL_YUV_CONVERSION_MODE>(mode));
+        current_mode = mode;
+    }
+#endif
+}
+
+/* Return a texture of the ring that no picture in pictq is using. If there is
+ * none and steal is set, take the one of the newest picture uploaded ahead. */
+static int video_texture_pick(FMediaPlayer* is, int steal)
+{
+    FrameQueue<VideoFrame>* f = &is->pictq;
+    int size = frame_queue_size(f);
+    unsigned used = 0;
+    int i;
+
+    for (i = 0; i < size; i++) {
+        VideoFrame* vp = &f->queue[(f->rindex + i) % f->max_size];
+        if (vp->uploaded)
+            used |= 1U << vp->texture;
+    }
+    for (i = 0; i < texture_ring_size; i++)
+        if (!(used & (1U << i)))
+            return i;
+    if (!steal)
+        return -1;
+    for (i = size - 1; i >= f->rindex_shown; i--) {
+        VideoFrame* vp = &f->queue[(f->rindex + i) % f->max_size];
+        if (vp->uploaded) {
+            vp->uploaded = 0;
+            return vp->texture;
+        }
+    }
+    return -1;
+}
+
+static const UploadPlan* video_upload_plan(FMediaPlayer* is, AVFrame* frame)
+{
+    UploadPlan* plan = &is->upload_plan;
+
+    if (plan->serial && plan->format == frame->format && plan->width == frame->width && plan->height == frame->height &&
+        plan->colorspace == frame->colorspace && plan->color_range == frame->color_range)
+        return plan;
+
+    plan->serial++;
+    plan->format = frame->format;
+    plan->width = frame->width;
+    plan->height = frame->height;
+    plan->colorspace = frame->colorspace;
+    plan->color_range = frame->color_range;
+    get_sdl_pix_fmt_and_blendmode(frame->format, &plan->sdl_pix_fmt, &plan->blendmode);
+    plan->texture_fmt = plan->sdl_pix_fmt == SDL_PIXELFORMAT_UNKNOWN ? SDL_PIXELFORMAT_ARGB8888 : plan->sdl_pix_fmt;
+    plan->yuv_mode = get_sdl_yuv_conversion_mode(frame);
+    /* even tile sizes keep the chroma of subsampled formats inside a tile */
+    plan->tile_w = plan->width;
+    plan->tile_h = plan->height;
+    if (renderer_info.max_texture_width && plan->width > renderer_info.max_texture_width)
+        plan->tile_w = renderer_info.max_texture_width & ~1;
+    if (renderer_info.max_texture_height && plan->height > renderer_info.max_texture_height)
+        plan->tile_h = renderer_info.max_texture_height & ~1;
+    plan->nb_cols = (plan->width + plan->tile_w - 1) / plan->tile_w;
+    plan->nb_rows = (plan->height + plan->tile_h - 1) / plan->tile_h;
+    if (plan->nb_cols * plan->nb_rows > 1)
+        av_log(NULL, AV_LOG_VERBOSE, "Uploading %dx%d pictures to %dx%d tiles of %dx%d\n",
+            plan->width, plan->height, plan->nb_cols, plan->nb_rows, plan->tile_w, plan->tile_h);
+    av_log(NULL, AV_LOG_DEBUG, "Upload plan %d: %dx%d %s -> %s\n", plan->serial, plan->width, plan->height,
+        (const char*)av_x_if_null(av_get_pix_fmt_name(static_cast<AVPixelFormat>(frame->format)), "none"),
+        SDL_GetPixelFormatName(plan->texture_fmt));
+    return plan;
+}
+
+static void video_texture_tiles_destroy(VideoTextureTiles* vt)
+{
+    int i;
+    for (i = 0; i < VIDEO_TEXTURE_TILES_MAX; i++)
+        if (vt->tiles[i])
+            SDL_DestroyTexture(vt->tiles[i]);
+    memset(vt, 0, sizeof(*vt));
+}
+
+typedef struct TileUpload {
+    const AVFrame* frame;
+    const VideoTextureTiles* vt;
+    Uint32 sdl_pix_fmt;
+    uint8_t* pixels[VIDEO_TEXTURE_TILES_MAX];
+    int pitch[VIDEO_TEXTURE_TILES_MAX];
+} TileUpload;
+
+static void copy_tile_plane(uint8_t* dst, int dst_pitch, const uint8_t* src, int src_linesize, int bytes, int rows)
+{
+    int y;
+    for (y = 0; y < rows; y++)
+        memcpy(dst + y * dst_pitch, src + y * src_linesize, bytes);
+}
+
+/* Copy one tile of the picture into its locked texture. Rows are copied top
+ * down, so negative linesizes need no flip when rendering. */
+static int upload_tile(void* opaque, int tile)
+{
+    const TileUpload* tu = static_cast<const TileUpload*>(opaque);
+    const AVFrame* frame = tu->frame;
+    const VideoTextureTiles* vt = tu->vt;
+    int x0 = tile % vt->nb_cols * vt->tile_w, y0 = tile / vt->nb_cols * vt->tile_h;
+    int w = FFMIN(vt->tile_w, frame->width - x0), h = FFMIN(vt->tile_h, frame->height - y0);
+    int cw = AV_CEIL_RSHIFT(w, 1), ch = AV_CEIL_RSHIFT(h, 1);
+    uint8_t* pixels = tu->pixels[tile];
+    int pitch = tu->pitch[tile];
+
+    switch (tu->sdl_pix_fmt) {
+    case SDL_PIXELFORMAT_IYUV:
+        /* the locked texture holds the chroma planes after the luma plane, with half its pitch */
+        copy_tile_plane(pixels, pitch, frame->data[0] + y0 * frame->linesize[0] + x0, frame->linesize[0], w, h);
+        pixels += pitch * h;
+        copy_tile_plane(pixels, (pitch + 1) / 2, frame->data[1] + (y0 >> 1) * frame->linesize[1] + (x0 >> 1), frame->linesize[1], cw, ch);
+        pixels += (pitch + 1) / 2 * ch;
+        copy_tile_plane(pixels, (pitch + 1) / 2, frame->data[2] + (y0 >> 1) * frame->linesize[2] + (x0 >> 1), frame->linesize[2], cw, ch);
+        break;
+    case SDL_PIXELFORMAT_NV12:
+    case SDL_PIXELFORMAT_NV21:
+        copy_tile_plane(pixels, pitch, frame->data[0] + y0 * frame->linesize[0] + x0, frame->linesize[0], w, h);
+        copy_tile_plane(pixels + pitch * h, pitch, frame->data[1] + (y0 >> 1) * frame->linesize[1] + x0, frame->linesize[1], 2 * cw, ch);
+        break;
+    default: {
+        int bpp = SDL_BYTESPERPIXEL(tu->sdl_pix_fmt);
+        copy_tile_plane(pixels, pitch, frame->data[0] + y0 * frame->linesize[0] + x0 * bpp, frame->linesize[0], w * bpp, h);
+        break;
+    }
+    }
+    return 0;
+}
+
+/* Upload a picture larger than the maximum texture size to a grid of
+ * textures. The tiles are all locked first, then filled from the frame
+ * planes in parallel on the upload workers. */
+static int upload_texture_tiles(VideoTextureTiles* vt, int* tex_plan, const UploadPlan* plan, AVFrame* frame, SliceScaler* scaler)
+{
+    int nb_tiles = plan->nb_cols * plan->nb_rows, locked, i, ret;
+    TileUpload tu;
+
+    if (plan->sdl_pix_fmt == SDL_PIXELFORMAT_UNKNOWN) {
+        av_log(NULL, AV_LOG_ERROR, "Cannot upload %dx%d %s pictures larger than the maximum texture size without -decoder_convert\n",
+            frame->width, frame->height, (const char*)av_x_if_null(av_get_pix_fmt_name(static_cast<AVPixelFormat>(frame->format)), "none"));
+        return -1;
+    }
+    if (nb_tiles > VIDEO_TEXTURE_TILES_MAX) {
+        av_log(NULL, AV_LOG_ERROR, "Pictures of %dx%d need more than %d textures\n", frame->width, frame->height, VIDEO_TEXTURE_TILES_MAX);
+        return -1;
+    }
+    if (*tex_plan != plan->serial) {
+        video_texture_tiles_destroy(vt);
+        vt->tile_w = plan->tile_w;
+        vt->tile_h = plan->tile_h;
+        vt->nb_cols = plan->nb_cols;
+        vt->nb_rows = plan->nb_rows;
+        set_sdl_yuv_conversion_mode(plan->yuv_mode);
+        for (i = 0; i < nb_tiles; i++) {
+            int w = FFMIN(vt->tile_w, frame->width - i % vt->nb_cols * vt->tile_w);
+            int h = FFMIN(vt->tile_h, frame->height - i / vt->nb_cols * vt->tile_h);
+            if (realloc_texture(&vt->tiles[i], plan->texture_fmt, w, h, plan->blendmode, 0) < 0)
+                return -1;
+        }
+        *tex_plan = plan->serial;
+    }
+
+    tu.frame = frame;
+    tu.vt = vt;
+    tu.sdl_pix_fmt = plan->sdl_pix_fmt;
+    for (locked = 0; locked < nb_tiles; locked++)
+        if (SDL_LockTexture(vt->tiles[locked], NULL, (void**)&tu.pixels[locked], &tu.pitch[locked]) < 0)
+            break;
+    ret = locked == nb_tiles ? slice_scaler_execute(scaler, nb_tiles, upload_tile, &tu) : -1;
+    for (i = 0; i < locked; i++)
+        SDL_UnlockTexture(vt->tiles[i]);
+    return ret;
+}
+
+static int video_upload_frame(FMediaPlayer* is, VideoFrame* vp, int texture)
+{
+    const UploadPlan* plan = video_upload_plan(is, vp->frame);
+    int tiled = plan->nb_cols * plan->nb_rows > 1;
+
+    /* a slot holds either a texture or tiles, drop the other kind when the plan changes */
+    if (is->vid_texture_plan[texture] != plan->serial) {
+        if (tiled && is->vid_textures[texture]) {
+            SDL_DestroyTexture(is->vid_textures[texture]);
+            is->vid_textures[texture] = NULL;
+        }
+        else if (!tiled)
+            video_texture_tiles_destroy(&is->vid_tiles[texture]);
+    }
+    if (tiled) {
+        if (upload_texture_tiles(&is->vid_tiles[texture], &is->vid_texture_plan[texture], plan, vp->frame, &is->upload_scaler) < 0)
+            return -1;
+    }
+    else if (upload_texture(&is->vid_textures[texture], &is->vid_texture_plan[texture], plan, vp->frame, &is->upload_scaler) < 0)
+        return -1;
+    vp->yuv_mode = plan->yuv_mode;
+    vp->texture = texture;
+    vp->tiled = tiled;
+    vp->uploaded = 1;
+    vp->flip_v = !tiled && vp->frame->linesize[0] < 0;
+    return 0;
+}
+
+/* Each tile covers the part of the display rectangle its pixels map to,
+ * rounded so that neighbouring tiles share their edges. */
+static void video_render_tiles(FMediaPlayer* is, VideoFrame* vp, const SDL_Rect* rect)
+{
+    const VideoTextureTiles* vt = &is->vid_tiles[vp->texture];
+    int width = vp->frame->width, height = vp->frame->height;
+    int col, row;
+
+    for (row = 0; row < vt->nb_rows; row++)
+        for (col = 0; col < vt->nb_cols; col++) {
+            int x0 = col * vt->tile_w, y0 = row * vt->tile_h;
+            int x1 = FFMIN(x0 + vt->tile_w, width), y1 = FFMIN(y0 + vt->tile_h, height);
+            SDL_Rect dst;
+            dst.x = rect->x + (int)av_rescale(x0, rect->w, width);
+            dst.y = rect->y + (int)av_rescale(y0, rect->h, height);
+            dst.w = rect->x + (int)av_rescale(x1, rect->w, width) - dst.x;
+            dst.h = rect->y + (int)av_rescale(y1, rect->h, height) - dst.y;
+            SDL_RenderCopy(renderer, vt->tiles[row * vt->nb_cols + col], NULL, &dst);
+        }
+}
+
+static int compose_supported(int format);
+
+/* Upload the pictures waiting in pictq while the ring has free textures, so
+ * that presenting them is only a copy of an already filled texture. Called
+ * from the event loop between refreshes. */
+static void video_upload_ahead(FMediaPlayer* is)
+{
+    FrameQueue<VideoFrame>* f = &is->pictq;
+    int remaining = frame_queue_nb_remaining(f);
+    int i, texture;
+
+    for (i = 0; i < remaining; i++) {
+        VideoFrame* vp = &f->queue[(f->rindex + f->rindex_shown + i) % f->max_size];
+        if (vp->uploaded || vp->serial != is->videoq.serial ||
+            (cpu_compose && compose_supported(vp->frame->format)))
+            continue;
+        if ((texture = video_texture_pick(is, 0)) < 0 ||
+            video_upload_frame(is, vp, texture) < 0)
+            break;
+    }
+}
+
+static const ComposeMatrix compose_matrix_bt601 = { 16, 9539, 13075, 3209, 6660, 16525 };
+static const ComposeMatrix compose_matrix_bt709 = { 16, 9539, 14686, 1747, 4366, 17305 };
+static const ComposeMatrix compose_matrix_jpeg = { 0, 8192, 11485, 2819, 5850, 14516 };
+
+/* the matrix SDL would pick for the frame, see get_sdl_yuv_conversion_mode() */
+static const ComposeMatrix* compose_matrix(const AVFrame* frame)
+{
+    if (frame->color_range == AVCOL_RANGE_JPEG)
+        return &compose_matrix_jpeg;
+    if (frame->colorspace == AVCOL_SPC_BT709)
+        return &compose_matrix_bt709;
+    if (frame->colorspace == AVCOL_SPC_BT470BG || frame->colorspace == AVCOL_SPC_SMPTE170M || frame->colorspace == AVCOL_SPC_SMPTE240M)
+        return &compose_matrix_bt601;
+    return frame->height > 576 ? &compose_matrix_bt709 : &compose_matrix_bt601;
+}
+
+static inline int compose_mulhi(int a, int b)
+{
+    return (a * b) >> 16;
+}
+
+/* inputs scaled to Q7 so that the Q13 products land in Q4, as the SIMD
+ * version computes them with 16 bit multiplies */
+static void compose_yuv_row_c(uint32_t* dst, const uint8_t* y, const uint8_t* u, const uint8_t* v, int n, const ComposeMatrix* m)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        int yc = compose_mulhi((y[i] - m->y_offset) * 128, m->y_mul);
+        int cu = (u[i] - 128) * 128, cv = (v[i] - 128) * 128;
+        int r = av_clip_uint8((yc + compose_mulhi(cv, m->rv) + 8) >> 4);
+        int g = av_clip_uint8((yc - compose_mulhi(cu, m->gu) - compose_mulhi(cv, m->gv) + 8) >> 4);
+        int b = av_clip_uint8((yc + compose_mulhi(cu, m->bu) + 8) >> 4);
+        dst[i] = 0xFF000000u | (r << 16) | (g << 8) | b;
+    }
+}
+
+/* straight alpha subtitle colors over opaque video */
+static void compose_blend_row_c(uint32_t* dst, const uint32_t* src, int n)
+{
+    int i, c;
+    for (i = 0; i < n; i++) {
+        uint32_t d = dst[i], s = src[i], a = s >> 24, out = 0xFF000000u;
+        for (c = 0; c < 24; c += 8) {
+            uint32_t t = ((d >> c) & 0xFF) * (255 - a) + ((s >> c) & 0xFF) * a + 128;
+            out |= ((t + (t >> 8)) >> 8) << c;
+        }
+        dst[i] = out;
+    }
+}
+
+#if ARCH_X86
+static void compose_yuv_row_sse2(uint32_t* dst, const uint8_t* y, const uint8_t* u, const uint8_t* v, int n, const ComposeMatrix* m)
+{
+    const __m128i zero = _mm_setzero_si128(), round = _mm_set1_epi16(8), alpha = _mm_set1_epi8((char)0xFF);
+    const __m128i y_offset = _mm_set1_epi16(m->y_offset), chroma_offset = _mm_set1_epi16(128);
+    const __m128i y_mul = _mm_set1_epi16(m->y_mul), rv = _mm_set1_epi16(m->rv);
+    const __m128i gu = _mm_set1_epi16(m->gu), gv = _mm_set1_epi16(m->gv), bu = _mm_set1_epi16(m->bu);
+    int i;
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m128i yy = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(y + i)), zero), y_offset), 7);
+        __m128i cu = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(u + i)), zero), chroma_offset), 7);
+        __m128i cv = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i*)(v + i)), zero), chroma_offset), 7);
+        __m128i yc = _mm_mulhi_epi16(yy, y_mul);
+        __m128i r = _mm_add_epi16(yc, _mm_mulhi_epi16(cv, rv));
+        __m128i g = _mm_sub_epi16(_mm_sub_epi16(yc, _mm_mulhi_epi16(cu, gu)), _mm_mulhi_epi16(cv, gv));
+        __m128i b = _mm_add_epi16(yc, _mm_mulhi_epi16(cu, bu));
+        __m128i bg, ra;
+        r = _mm_packus_epi16(_mm_srai_epi16(_mm_add_epi16(r, round), 4), zero);
+        g = _mm_packus_epi16(_mm_srai_epi16(_mm_add_epi16(g, round), 4), zero);
+        b = _mm_packus_epi16(_mm_srai_epi16(_mm_add_epi16(b, round), 4), zero);
+        bg = _mm_unpacklo_epi8(b, g);
+        ra = _mm_unpacklo_epi8(r, alpha);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_unpacklo_epi16(bg, ra));
+        _mm_storeu_si128((__m128i*)(dst + i + 4), _mm_unpackhi_epi16(bg, ra));
+    }
+    compose_yuv_row_c(dst + i, y + i, u + i, v + i, n - i, m);
+}
+
+static inline __m128i compose_blend_2_sse2(__m128i d, __m128i s)
+{
+    const __m128i full = _mm_set1_epi16(255), round = _mm_set1_epi16(128);
+    __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i t = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(d, _mm_sub_epi16(full, a)), _mm_mullo_epi16(s, a)), round);
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+static void compose_blend_row_sse2(uint32_t* dst, const uint32_t* src, int n)
+{
+    const __m128i zero = _mm_setzero_si128(), alpha = _mm_set1_epi32((int)0xFF000000u);
+    int i;
+    for (i = 0; i + 4 <= n; i += 4) {
+        __m128i d = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i s = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i lo = compose_blend_2_sse2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero));
+        __m128i hi = compose_blend_2_sse2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_packus_epi16(lo, hi), alpha));
+    }
+    compose_blend_row_c(dst + i, src + i, n - i);
+}
+#endif
+
+static int compose_supported(int format)
+{
+    return format == AV_PIX_FMT_YUV420P || format == AV_PIX_FMT_YUVJ420P ||
+           format == AV_PIX_FMT_NV12 || format == AV_PIX_FMT_NV21 || format == AV_PIX_FMT_0RGB32;
+}
+
+static void compositor_uninit(Compositor* c)
+{
+    if (c->texture)
+        SDL_DestroyTexture(c->texture);
+    av_freep(&c->buf);
+    memset(c, 0, sizeof(*c));
+}
+
+/* nearest neighbour, as the software renderer scales */
+static int compose_source_index(int i, int src_size, int dst_size)
+{
+    return (int)(((2 * (int64_t)i + 1) * src_size) / (2 * (int64_t)dst_size));
+}
+
+/* Blend the subtitle rectangles covering output row y, scaled from the
+ * subtitle canvas to the display rectangle like the texture path does. */
+static void compose_subtitle_row(Compositor* c, uint32_t* dst, const SubtitleFrame* sp, const SDL_Rect* rect, int y,
+    void (*blend_row)(uint32_t* dst, const uint32_t* src, int n))
+{
+    int sy = compose_source_index(y, sp->height, rect->h);
+    int i, x, x0, x1;
+
+    for (i = 0; i < (int)sp->sub.num_rects; i++) {
+        const AVSubtitleRect* sub_rect = sp->sub.rects[i];
+        const uint32_t* src;
+        if (!sp->rects[i].data || sy < sub_rect->y || sy >= sub_rect->y + sub_rect->h || !sub_rect->w)
+            continue;
+        src = (const uint32_t*)(sp->rects[i].data + (sy - sub_rect->y) * sp->rects[i].linesize);
+        x0 = (int)av_rescale(sub_rect->x, rect->w, sp->width);
+        x1 = FFMIN((int)av_rescale(sub_rect->x + sub_rect->w, rect->w, sp->width), rect->w);
+        for (x = x0; x < x1; x++)
+            c->sub_row[x - x0] = src[av_clip(compose_source_index(x, sp->width, rect->w) - sub_rect->x, 0, sub_rect->w - 1)];
+        if (x1 > x0)
+            blend_row(dst + x0, c->sub_row, x1 - x0);
+    }
+}
+
+/* Draw the picture, scaled to the display rectangle, and the subtitles over
+ * it in one pass per output row, into a texture of the size of the rectangle.
+ * Presenting it is then an unscaled copy. */
+static int video_compose(FMediaPlayer* is, VideoFrame* vp, SubtitleFrame* sp, const SDL_Rect* rect)
+{
+    Compositor* c = &is->compositor;
+    AVFrame* frame = vp->frame;
+    const ComposeMatrix* m = compose_matrix(frame);
+    void (*yuv_row)(uint32_t* dst, const uint8_t* y, const uint8_t* u, const uint8_t* v, int n, const ComposeMatrix* m) = compose_yuv_row_c;
+    void (*blend_row)(uint32_t* dst, const uint32_t* src, int n) = compose_blend_row_c;
+    int w = rect->w, h = rect->h, pitch, x, y;
+    size_t size;
+    uint8_t* pixels;
+
+#if ARCH_X86
+    if (av_get_cpu_flags() & AV_CPU_FLAG_SSE2) {
+        yuv_row = compose_yuv_row_sse2;
+        blend_row = compose_blend_row_sse2;
+    }
+#endif
+    if (realloc_texture(&c->texture, SDL_PIXELFORMAT_ARGB8888, w, h, SDL_BLENDMODE_NONE, 0) < 0)
+        return -1;
+
+    size = FFALIGN(w, 16) * (sizeof(*c->xmap) + 3 + sizeof(*c->sub_row));
+    if (size > c->buf_size) {
+        av_freep(&c->buf);
+        if (!(c->buf = (uint8_t*)av_malloc(size)))
+            return AVERROR(ENOMEM);
+        c->buf_size = (unsigned)size;
+        c->xmap_dst = 0;
+    }
+    c->xmap = (int*)c->buf;
+    c->sub_row = (uint32_t*)(c->buf + FFALIGN(w, 16) * sizeof(*c->xmap));
+    c->rows[0] = (uint8_t*)(c->sub_row + FFALIGN(w, 16));
+    c->rows[1] = c->rows[0] + FFALIGN(w, 16);
+    c->rows[2] = c->rows[1] + FFALIGN(w, 16);
+    if (c->xmap_src != frame->width || c->xmap_dst != w) {
+        for (x = 0; x < w; x++)
+            c->xmap[x] = compose_source_index(x, frame->width, w);
+        c->xmap_src = frame->width;
+        c->xmap_dst = w;
+    }
+
+    if (SDL_LockTexture(c->texture, NULL, (void**)&pixels, &pitch) < 0)
+        return -1;
+    for (y = 0; y < h; y++) {
+        uint32_t* dst = (uint32_t*)(pixels + y * pitch);
+        int sy = compose_source_index(y, frame->height, h);
+        const uint8_t* luma = frame->data[0] + sy * frame->linesize[0];
+
+        switch (frame->format) {
+        case AV_PIX_FMT_0RGB32:
+            for (x = 0; x < w; x++)
+                dst[x] = ((const uint32_t*)luma)[c->xmap[x]] | 0xFF000000u;
+            break;
+        case AV_PIX_FMT_NV12:
+        case AV_PIX_FMT_NV21: {
+            const uint8_t* uv = frame->data[1] + (sy >> 1) * frame->linesize[1];
+            int swap = frame->format == AV_PIX_FMT_NV21;
+            for (x = 0; x < w; x++) {
+                int sx = c->xmap[x];
+                c->rows[0][x] = luma[sx];
+                c->rows[1 + swap][x] = uv[sx & ~1];
+                c->rows[2 - swap][x] = uv[sx | 1];
+            }
+            yuv_row(dst, c->rows[0], c->rows[1], c->rows[2], w, m);
+            break;
+        }
+        default: {
+            const uint8_t* u = frame->data[1] + (sy >> 1) * frame->linesize[1];
+            const uint8_t* v = frame->data[2] + (sy >> 1) * frame->linesize[2];
+            for (x = 0; x < w; x++) {
+                int sx = c->xmap[x];
+                c->rows[0][x] = luma[sx];
+                c->rows[1][x] = u[sx >> 1];
+                c->rows[2][x] = v[sx >> 1];
+            }
+            yuv_row(dst, c->rows[0], c->rows[1], c->rows[2], w, m);
+            break;
+        }
+        }
+        if (sp)
+            compose_subtitle_row(c, dst, sp, rect, y, blend_row);
+    }
+    SDL_UnlockTexture(c->texture);
+
+    return SDL_RenderCopy(renderer, c->texture, NULL, rect);
+}
+
+/* Add r to a list of disjoint regions, merging it with those it overlaps.
+ * A full list collapses into its bounding box. */
+static void subtitle_dirty_add(SDL_Rect* list, int* nb, SDL_Rect r)
+{
+    int i;
+
+    if (r.w <= 0 || r.h <= 0)
+        return;
+    for (i = 0; i < *nb; i++) {
+        if (SDL_HasIntersection(&list[i], &r)) {
+            /* the grown rect may now overlap ones already passed */
+            SDL_UnionRect(&list[i], &r, &r);
+            list[i] = list[--*nb];
+            i = -1;
+        }
+    }
+    if (*nb == SUBTITLE_DIRTY_MAX) {
+        for (i = 0; i < *nb; i++)
+            SDL_UnionRect(&list[i], &r, &r);
+        *nb = 0;
+    }
+    list[(*nb)++] = r;
+}
+
+static void subtitle_clear_region(SDL_Texture* texture, const SDL_Rect* r)
+{
+    uint8_t* pixels;
+    int pitch, j;
+
+    if (!SDL_LockTexture(texture, r, (void**)&pixels, &pitch)) {
+        for (j = 0; j < r->h; j++, pixels += pitch)
+            memset(pixels, 0, r->w << 2);
+        SDL_UnlockTexture(texture);
+    }
+}
+
+static int rect_contains(const SDL_Rect* outer, const SDL_Rect* inner)
+{
+    return inner->x >= outer->x && inner->y >= outer->y &&
+           inner->x + inner->w <= outer->x + outer->w && inner->y + inner->h <= outer->y + outer->h;
+}
+
+/* Put the expanded rects of sp into the subtitle texture. Regions earlier
+ * subtitles left inside the new bounding box are cleared unless one of the
+ * new rects overwrites them, everything else is left alone. */
+static int subtitle_atlas_upload(FMediaPlayer* is, SubtitleFrame* sp)
+{
+    SubtitleAtlas* a = &is->sub_atlas;
+    SDL_Rect box = { 0, 0, 0, 0 }, tbox, dirty[SUBTITLE_DIRTY_MAX];
+    int nb_dirty = 0, i, j;
+
+    for (i = 0; i < (int)sp->sub.num_rects; i++) {
+        SDL_Rect* r = (SDL_Rect*)sp->sub.rects[i];
+        if (!sp->rects[i].data || !r->w || !r->h)
+            continue;
+        if (box.w)
+            SDL_UnionRect(&box, r, &box);
+        else
+            box = *r;
+    }
+    a->box = box;
+    if (!box.w)
+        return 0;
+
+    if (!is->sub_texture || box.w > a->tex_w || box.h > a->tex_h) {
+        /* grow in steps so that subtitles of similar size reuse the texture */
+        int w = FFMIN(FFMAX(a->tex_w, FFALIGN(box.w, 64)), sp->width);
+        int h = FFMIN(FFMAX(a->tex_h, FFALIGN(box.h, 64)), sp->height);
+        if (realloc_texture(&is->sub_texture, SDL_PIXELFORMAT_ARGB8888, w, h, SDL_BLENDMODE_BLEND, 0) < 0)
+            return -1;
+        a->tex_w = w;
+        a->tex_h = h;
+        /* contents of a new texture are undefined */
+        a->dirty[0].x = a->dirty[0].y = 0;
+        a->dirty[0].w = w;
+        a->dirty[0].h = h;
+        a->nb_dirty = 1;
+    }
+
+    tbox.x = tbox.y = 0;
+    tbox.w = box.w;
+    tbox.h = box.h;
+    for (i = 0; i < a->nb_dirty; i++) {
+        SDL_Rect c;
+        int covered = 0;
+        if (SDL_IntersectRect(&a->dirty[i], &tbox, &c)) {
+            for (j = 0; j < (int)sp->sub.num_rects && !covered; j++) {
+                SDL_Rect r = *(SDL_Rect*)sp->sub.rects[j];
+                r.x -= box.x;
+                r.y -= box.y;
+                covered = sp->rects[j].data && rect_contains(&r, &c);
+            }
+            if (!covered)
+                subtitle_clear_region(is->sub_texture, &c);
+        }
+        /* what lies outside the box is not drawn, keep it for a later, larger box */
+        if (!rect_contains(&tbox, &a->dirty[i]))
+            subtitle_dirty_add(dirty, &nb_dirty, a->dirty[i]);
+    }
+
+    for (i = 0; i < (int)sp->sub.num_rects; i++) {
+        SDL_Rect r = *(SDL_Rect*)sp->sub.rects[i];
+        if (!sp->rects[i].data || !r.w || !r.h)
+            continue;
+        r.x -= box.x;
+        r.y -= box.y;
+        SDL_UpdateTexture(is->sub_texture, &r, sp->rects[i].data, sp->rects[i].linesize);
+        subtitle_dirty_add(dirty, &nb_dirty, r);
+    }
+    memcpy(a->dirty, dirty, nb_dirty * sizeof(*dirty));
+    a->nb_dirty = nb_dirty;
+    return 0;
+}
+
+static void video_image_display(FMediaPlayer* is)
+{
+    VideoFrame* vp;
+    SubtitleFrame* sp = NULL;
+    SDL_Rect rect;
+    int compose;
+
+    vp = frame_queue_peek_last(&is->pictq);
+    compose = cpu_compose && compose_supported(vp->frame->format);
+    if (is->subtitle_st) {
+        if (frame_queue_nb_remaining(&is->subpq) > 0) {
+            sp = frame_queue_peek(&is->subpq);
+
+            if (vp->pts >= sp->pts + ((float)sp->sub.start_display_time / 1000)) {
+                if (!sp->uploaded) {
+                    int i;
+                    if (!sp->width || !sp->height) {
+                        sp->width = vp->width;
+                        sp->height = vp->height;
+                    }
+                    for (i = 0; i < sp->sub.num_rects; i++) {
+                        AVSubtitleRect* sub_rect = sp->sub.rects[i];
+
+                        sub_rect->x = av_clip(sub_rect->x, 0, sp->width);
+                        sub_rect->y = av_clip(sub_rect->y, 0, sp->height);
+                        sub_rect->w = av_clip(sub_rect->w, 0, sp->width - sub_rect->x);
+                        sub_rect->h = av_clip(sub_rect->h, 0, sp->height - sub_rect->y);
+                    }
+                    sp->uploaded = 1;
+                }
+            }
+            else
+                sp = NULL;
+        }
+    }
+
+    calculate_display_rect(&rect, is->xleft, is->ytop, is->width, is->height, vp->width, vp->height, vp->sar);
+
+    if (compose) {
+        if (video_compose(is, vp, sp, &rect) >= 0)
+            return;
+        /* the picture would stay black, draw it with the renderer from now on */
+        av_log(NULL, AV_LOG_WARNING, "Compositing on the CPU failed, drawing pictures with the renderer instead\n");
+        cpu_compose = 0;
+    }
+
+    /* the compositor blends the expanded rectangles itself, the texture is
+     * only filled once a picture is not composited */
+    if (sp && !sp->in_atlas) {
+        if (subtitle_atlas_upload(is, sp) < 0)
+            return;
+        sp->in_atlas = 1;
+    }
+
+    if (!vp->uploaded) {
+        int texture = video_texture_pick(is, 1);
+        if (texture < 0 || video_upload_frame(is, vp, texture) < 0)
+            return;
+    }
+
+    set_sdl_yuv_conversion_mode(vp->yuv_mode);
+    if (vp->tiled)
+        video_render_tiles(is, vp, &rect);
+    else
+        SDL_RenderCopyEx(renderer, is->vid_textures[vp->texture], NULL, &rect, 0, NULL, static_cast<SDL_RendererFlip>(vp->flip_v ? SDL_FLIP_VERTICAL : 0));
+    if (sp && is->sub_atlas.box.w) {
+        const SDL_Rect* box = &is->sub_atlas.box;
+#if USE_ONEPASS_SUBTITLE_RENDER
+        SDL_Rect source = { 0, 0, box->w, box->h }, target;
+        target.x = rect.x + (int)av_rescale(box->x, rect.w, sp->width);
+        target.y = rect.y + (int)av_rescale(box->y, rect.h, sp->height);
+        target.w = rect.x + (int)av_rescale(box->x + box->w, rect.w, sp->width) - target.x;
+        target.h = rect.y + (int)av_rescale(box->y + box->h, rect.h, sp->height) - target.y;
+        SDL_RenderCopy(renderer, is->sub_texture, &source, &target);
+#else
+        int i;
+        double xratio = (double)rect.w / (double)sp->width;
+        double yratio = (double)rect.h / (double)sp->height;
+        for (i = 0; i < sp->sub.num_rects; i++) {
+            SDL_Rect* sub_rect = (SDL_Rect*)sp->sub.rects[i];
+            SDL_Rect source = { sub_rect->x - box->x, sub_rect->y - box->y, sub_rect->w, sub_rect->h };
+            SDL_Rect target = { .x = rect.x + sub_rect->x * xratio,
+                               .y = rect.y + sub_rect->y * yratio,
+                               .w = sub_rect->w * xratio,
+                               .h = sub_rect->h * yratio };
+            SDL_RenderCopy(renderer, is->sub_texture, &source, &target);
+        }
+#endif
+    }
+}
+
+static inline int compute_mod(int a, int b)
+{
+    return a < 0 ? a % b + b : a % b;
+}
+
+static void video_audio_display(FMediaPlayer* s)
+{
+    int i, i_start, x, y1, y, ys, delay, n, nb_display_channels;
+    int ch, channels, h, h2;
+    int64_t time_diff;
+    int rdft_bits, nb_freq;
+
+    for (rdft_bits = 1; (1 << rdft_bits) < 2 * s->height; rdft_bits++)
+        ;
+    nb_freq = 1 << (rdft_bits - 1);
+
+    /* compute display index : center on currently output samples */
+    channels = s->audio_tgt.channels;
+    nb_display_channels = channels;
+    if (!s->paused) {
+        int data_used = s->eShow_mode == FMediaPlayer::EShowMode::SHOW_MODE_WAVES ? s->width : (2 * nb_freq);
+        n = 2 * channels;
+        delay = s->audio_write_buf_size;
+        delay /= n;
+
+        /* to be more precise, we take into account the time spent since
+           the last buffer computation */
+        if (audio_callback_time) {
+            time_diff = av_gettime_relative() - audio_callback_time;
+            delay -= (time_diff * s->audio_tgt.freq) / 1000000;
+        }
+
+        delay += 2 * data_used;
+        if (delay < data_used)
+            delay = data_used;
+
+        i_start = x = compute_mod(s->sample_array_index - delay * channels, SAMPLE_ARRAY_SIZE);
+        if (s->eShow_mode == FMediaPlayer::EShowMode::SHOW_MODE_WAVES) {
+            h = INT_MIN;
+            for (i = 0; i < 1000; i += channels) {
+                int idx = (SAMPLE_ARRAY_SIZE + x - i) % SAMPLE_ARRAY_SIZE;
+                int a = s->sample_array[idx];
+                int b = s->sample_array[(idx + 4 * channels) % SAMPLE_ARRAY_SIZE];
+                int c = s->sample_array[(idx + 5 * channels) % SAMPLE_ARRAY_SIZE];
+                int d = s->sample_array[(idx + 9 * channels) % SAMPLE_ARRAY_SIZE];
+                int score = a - d;
+                if (h < score && (b ^ c) < 0) {
+                    h = score;
+                    i_start = idx;
+                }
+            }
+        }
+
+        s->last_i_start = i_start;
+    }
+    else {
+        i_start = s->last_i_start;
+    }
+
+    if (s->eShow_mode == FMediaPlayer::EShowMode::SHOW_MODE_WAVES) {
+        SDL_SetRenderDrawColor(renderer, 255, 255, 255, 255);
+
+        /* total height for one channel */
+        h = s->height / nb_display_channels;
+        /* graph height / 2 */
+        h2 = (h * 9) / 20;
+        for (ch = 0; ch < nb_display_channels; ch++) {
+            i = i_start + ch;
+            y1 = s->ytop + ch * h + (h / 2); /* position of center line */
+            for (x = 0; x < s->width; x++) {
+                y = (s->sample_array[i] * h2) >> 15;
+                if (y < 0) {
+                    y = -y;
+                    ys = y1 - y;
+                }
+                else {
+                    ys = y1;
+                }
+                fill_rectangle(s->xleft + x, ys, 1, y);
+                i += channels;
+                if (i >= SAMPLE_ARRAY_SIZE)
+                    i -= SAMPLE_ARRAY_SIZE;
+            }
+        }
+
+        SDL_SetRenderDrawColor(renderer, 0, 0, 255, 255);
+
+        for (ch = 1; ch < nb_display_channels; ch++) {
+            y = s->ytop + ch * h;
+            fill_rectangle(s->xleft, y, s->width, 1);
+        }
+    }
+    else {
+        if (realloc_texture(&s->vis_texture, SDL_PIXELFORMAT_ARGB8888, s->width, s->height, SDL_BLENDMODE_NONE, 1) < 0)
+            return;
+
+        nb_display_channels = FFMIN(nb_display_channels, 2);
+        if (rdft_bits != s->rdft_bits) {
+            av_rdft_end(s->rdft);
+            av_free(s->rdft_data);
+            s->rdft = av_rdft_init(rdft_bits, DFT_R2C);
+            s->rdft_bits = rdft_bits;
+            s->rdft_data = static_cast<FFTSample*>(av_malloc_array(nb_freq, 4 * sizeof(*s->rdft_data)));
+        }
+        if (!s->rdft || !s->rdft_data) {
+            av_log(NULL, AV_LOG_ERROR, "Failed to allocate buffers for RDFT, switching to waves display\n");
+            s->eShow_mode = FMediaPlayer::EShowMode::SHOW_MODE_WAVES;
+        }
+        else {
+            FFTSample* data[2];
+            SDL_Rect rect;
+            rect.x = s->xpos; rect.y = 0; rect.w = 1; rect.h = s->height;
+
+            uint32_t* pixels;
+            int pitch;
+            for (ch = 0; ch < nb_display_channels; ch++) {
+                data[ch] = s->rdft_data + 2 * nb_freq * ch;
+                i = i_start + ch;
+                for (x = 0; x < 2 * nb_freq; x++) {
+                    double w = (x - nb_freq) * (1.0 / nb_freq);
+                    data[ch][x] = s->sample_array[i] * (1.0 - w * w);
+                    i += channels;
+                    if (i >= SAMPLE_ARRAY_SIZE)
+                        i -= SAMPLE_ARRAY_SIZE;
+                }
+                av_rdft_calc(s->rdft, data[ch]);
+            }
+            /* Least efficient way to do this, we should of course
+             * directly access it but it is more than fast enough. */
+            if (!SDL_LockTexture(s->vis_texture, &rect, (void**)&pixels, &pitch)) {
+                pitch >>= 2;
+                pixels += pitch * s->height;
+                for (y = 0; y < s->height; y++) {
+                    double w = 1 / sqrt(nb_freq);
+                    int a = sqrt(w * sqrt(data[0][2 * y + 0] * data[0][2 * y + 0] + data[0][2 * y + 1] * data[0][2 * y + 1]));
+                    int b = (nb_display_channels == 2) ? sqrt(w * hypot(data[1][2 * y + 0], data[1][2 * y + 1]))
+                        : a;
+                    a = FFMIN(a, 255);
+                    b = FFMIN(b, 255);
+                    pixels -= pitch;
+                    *pixels = (a << 16) + (b << 8) + ((a + b) >> 1);
+                }
+                SDL_UnlockTexture(s->vis_texture);
+            }
+            SDL_RenderCopy(renderer, s->vis_texture, NULL, NULL);
+        }
+        if (!s->paused)
+            s->xpos++;
+        if (s->xpos >= s->width)
+            s->xpos = s->xleft;
+    }
+}
+
+static void text_sub_uninit(TextSubRenderer* tr);
+
+static void stream_component_close(FMediaPlayer* is, int stream_index)
+{
+    AVFormatContext* ic = is->ic;
+    AVCodecParameters* codecpar;
+
+    if (stream_index < 0 || stream_index >= ic->nb_streams)
+        return;
+    codecpar = ic->streams[stream_index]->codecpar;
+
+    switch (codecpar->codec_type) {
+    case AVMEDIA_TYPE_AUDIO:
+        decoder_abort(&is->auddec, &is->sampq);
+        SDL_CloseAudioDevice(audio_dev);
+        decoder_destroy(&is->auddec);
+        swr_free(&is->swr_ctx);
+        av_freep(&is->audio_buf1);
+        is->audio_buf1_size = 0;
+        is->audio_buf = NULL;
+
+        if (is->rdft) {
+            av_rdft_end(is->rdft);
+            av_freep(&is->rdft_data);
+            is->rdft = NULL;
+            is->rdft_bits = 0;
+        }
+        break;
+    case AVMEDIA_TYPE_VIDEO:
+        decoder_abort(&is->viddec, &is->pictq);
+        decoder_destroy(&is->viddec);
+        slice_scaler_uninit(&is->vid_convert_scaler);
+        av_frame_free(&is->vid_convert_frame);
+        video_buffer_pool_flush(&is->video_buffer_pool);
+        break;
+    case AVMEDIA_TYPE_SUBTITLE:
+        decoder_abort(&is->subdec, &is->subpq);
+        decoder_destroy(&is->subdec);
+        text_sub_uninit(&is->text_sub);
+        break;
+    default:
+        break;
+    }
+
+    ic->streams[stream_index]->discard = AVDISCARD_ALL;
+    switch (codecpar->codec_type) {
+    case AVMEDIA_TYPE_AUDIO:
+        is->audio_st = NULL;
+        is->audio_stream = -1;
+        break;
+    case AVMEDIA_TYPE_VIDEO:
+        is->video_st = NULL;
+        is->video_stream = -1;
+        break;
+    case AVMEDIA_TYPE_SUBTITLE:
+        is->subtitle_st = NULL;
+        is->subtitle_stream = -1;
+        break;
+    default:
+        break;
+    }
+}
+
+static void stream_close(FMediaPlayer* is)
+{
+    int i;
+
+    /* XXX: use a special url_shutdown call to abort parse cleanly */
+    is->abort_request = 1;
+    /* the read thread may be blocked putting a packet into a full ring queue */
+    packet_queue_abort(&is->videoq);
+    packet_queue_abort(&is->audioq);
+    packet_queue_abort(&is->subtitleq);
+    event_notify(&is->continue_read);
+    SDL_WaitThread(is->read_tid, NULL);
+
+    /* close each stream */
+    if (is->audio_stream >= 0)
+        stream_component_close(is, is->audio_stream);
+    if (is->video_stream >= 0)
+        stream_component_close(is, is->video_stream);
+    if (is->subtitle_stream >= 0)
+        stream_component_close(is, is->subtitle_stream);
+
+    packet_reclaimer_stop(&is->reclaimer);
+    video_buffer_pool_uninit(&is->video_buffer_pool);
+    avformat_close_input(&is->ic);
+
+    packet_queue_destroy(&is->videoq);
+    packet_queue_destroy(&is->audioq);
+    packet_queue_destroy(&is->subtitleq);
+
+    /* free all pictures */
+    frame_queue_destory(&is->pictq);
+    frame_queue_destory(&is->sampq);
+    frame_queue_destory(&is->subpq);
+    event_destroy(&is->continue_read);
+    slice_scaler_uninit(&is->upload_scaler);
+    av_free(is->filename);
+    if (is->vis_texture)
+        SDL_DestroyTexture(is->vis_texture);
+    for (i = 0; i < VIDEO_TEXTURE_RING_MAX; i++) {
+        if (is->vid_textures[i])
+            SDL_DestroyTexture(is->vid_textures[i]);
+        video_texture_tiles_destroy(&is->vid_tiles[i]);
+    }
+    if (is->sub_texture)
+        SDL_DestroyTexture(is->sub_texture);
+    compositor_uninit(&is->compositor);
+    av_free(is);
+}
+
+static void do_exit(FMediaPlayer* is)
+{
+    if (is) {
+        stream_close(is);
+    }
+    if (renderer)
+        SDL_DestroyRenderer(renderer);
+    if (window)
+        SDL_DestroyWindow(window);
+    uninit_opts();
+#if CONFIG_AVFILTER
+    av_freep(&vfilters_list);
+#endif
+    avformat_network_deinit();
+    if (show_status)
+        printf("\n");
+    SDL_Quit();
+    av_log(NULL, AV_LOG_QUIET, "%s", "");
+    exit(0);
+}
+
+static void sigterm_handler(int sig)
+{
+    exit(123);
+}
+
+static void set_default_window_size(int width, int height, AVRational sar)
+{
+    SDL_Rect rect;
+    int max_width = screen_width ? screen_width : INT_MAX;
+    int max_height = screen_height ? screen_height : INT_MAX;
+    if (max_width == INT_MAX && max_height == INT_MAX)
+        max_height = height;
+    calculate_display_rect(&rect, 0, 0, max_width, max_height, width, height, sar);
+    default_width = rect.w;
+    default_height = rect.h;
+}
+
+static int video_open(FMediaPlayer* is)
+{
+    int w, h;
+
+    w = screen_width ? screen_width : default_width;
+    h = screen_height ? screen_height : default_height;
+
+    if (!window_title)
+        window_title = input_filename;
+    SDL_SetWindowTitle(window, window_title);
+
+    SDL_SetWindowSize(window, w, h);
+    SDL_SetWindowPosition(window, screen_left, screen_top);
+    if (is_full_screen)
+        SDL_SetWindowFullscreen(window, SDL_WINDOW_FULLSCREEN_DESKTOP);
+    SDL_ShowWindow(window);
+
+    is->width = w;
+    is->height = h;
+
+    return 0;
+}
+
+/* display the current picture, if any */
+static void video_display(FMediaPlayer* is)
+{
+    if (!is->width)
+        video_open(is);
+
+    SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+    SDL_RenderClear(renderer);
+    if (is->audio_st && is->eShow_mode != FMediaPlayer::EShowMode::SHOW_MODE_VIDEO)
+        video_audio_display(is);
+    else if (is->video_st)
+        video_image_display(is);
+    SDL_RenderPresent(renderer);
+}
+
+static double get_clock(Clock* c)
+{
+    if (*c->queue_serial != c->serial)
+        return NAN;
+    if (c->paused) {
+        return c->pts;
+    }
+    else {
+        double time = av_gettime_relative() / 1000000.0;
+        return c->pts_drift + time - (time - c->last_updated) * (1.0 - c->speed);
+    }
+}
+
+static void set_clock_at(Clock* c, double pts, int serial, double time)
+{
+    c->pts = pts;
+    c->last_updated = time;
+    c->pts_drift = c->pts - time;
+    c->serial = serial;
+}
+
+static void set_clock(Clock* c, double pts, int serial)
+{
+    double time = av_gettime_relative() / 1000000.0;
+    set_clock_at(c, pts, serial, time);
+}
+
+static void set_clock_speed(Clock* c, double speed)
+{
+    set_clock(c, get_clock(c), c->serial);
+    c->speed = speed;
+}
+
+static void init_clock(Clock* c, int* queue_serial)
+{
+    c->speed = 1.0;
+    c->paused = 0;
+    c->queue_serial = queue_serial;
+    set_clock(c, NAN, -1);
+}
+
+static void sync_clock_to_slave(Clock* c, Clock* slave)
+{
+    double clock = get_clock(c);
+    double slave_clock = get_clock(slave);
+    if (!isnan(slave_clock) && (isnan(clock) || fabs(clock - slave_clock) > AV_NOSYNC_THRESHOLD))
+        set_clock(c, slave_clock, slave->serial);
+}
+
+static int get_master_sync_type(FMediaPlayer* is) {
+    if (is->av_sync_type == AV_SYNC_VIDEO_MASTER) {
+        if (is->video_st)
+            return AV_SYNC_VIDEO_MASTER;
+        else
+            return AV_SYNC_AUDIO_MASTER;
+    }
+    else if (is->av_sync_type == AV_SYNC_AUDIO_MASTER) {
+        if (is->audio_st)
+            return AV_SYNC_AUDIO_MASTER;
+        else
+            return AV_SYNC_EXTERNAL_CLOCK;
+    }
+    else {
+        return AV_SYNC_EXTERNAL_CLOCK;
+    }
+}
+
+/* get the current master clock value */
+static double get_master_clock(FMediaPlayer* is)
+{
+    double val;
+
+    switch (get_master_sync_type(is)) {
+    case AV_SYNC_VIDEO_MASTER:
+        val = get_clock(&is->vidclk);
+        break;
+    case AV_SYNC_AUDIO_MASTER:
+        val = get_clock(&is->audclk);
+        break;
+    default:
+        val = get_clock(&is->extclk);
+        break;
+    }
+    return val;
+}
+
+static void check_external_clock_speed(FMediaPlayer* is) {
+    if (is->video_stream >= 0 && packet_queue_nb_packets(&is->videoq) <= EXTERNAL_CLOCK_MIN_FRAMES ||
+        is->audio_stream >= 0 && packet_queue_nb_packets(&is->audioq) <= EXTERNAL_CLOCK_MIN_FRAMES) {
+        set_clock_speed(&is->extclk, FFMAX(EXTERNAL_CLOCK_SPEED_MIN, is->extclk.speed - EXTERNAL_CLOCK_SPEED_STEP));
+    }
+    else if ((is->video_stream < 0 || packet_queue_nb_packets(&is->videoq) > EXTERNAL_CLOCK_MAX_FRAMES) &&
+        (is->audio_stream < 0 || packet_queue_nb_packets(&is->audioq) > EXTERNAL_CLOCK_MAX_FRAMES)) {
+        set_clock_speed(&is->extclk, FFMIN(EXTERNAL_CLOCK_SPEED_MAX, is->extclk.speed + EXTERNAL_CLOCK_SPEED_STEP));
+    }
+    else {
+        double speed = is->extclk.speed;
+        if (speed != 1.0)
+            set_clock_speed(&is->extclk, speed + EXTERNAL_CLOCK_SPEED_STEP * (1.0 - speed) / fabs(1.0 - speed));
+    }
+}
+
+/* seek in the stream */
+static void stream_seek(FMediaPlayer* is, int64_t pos, int64_t rel, int seek_by_bytes)
+{
+    if (!is->seek_req) {
+        is->seek_pos = pos;
+        is->seek_rel = rel;
+        is->seek_flags &= ~AVSEEK_FLAG_BYTE;
+        if (seek_by_bytes)
+            is->seek_flags |= AVSEEK_FLAG_BYTE;
+        is->seek_req = 1;
+        event_notify(&is->continue_read);
+    }
+}
+
+/* pause or resume the video */
+static void stream_toggle_pause(FMediaPlayer* is)
+{
+    if (is->paused) {
+        is->frame_timer += av_gettime_relative() / 1000000.0 - is->vidclk.last_updated;
+        if (is->read_pause_return != AVERROR(ENOSYS)) {
+            is->vidclk.paused = 0;
+        }
+        set_clock(&is->vidclk, get_clock(&is->vidclk), is->vidclk.serial);
+    }
+    set_clock(&is->extclk, get_clock(&is->extclk), is->extclk.serial);
+    is->paused = is->audclk.paused = is->vidclk.paused = is->extclk.paused = !is->paused;
+    event_notify(&is->continue_read);
+}
+
+static void log_queue_wait_stats(const char* name, const char* side,
+    const QueueWaitStats* w, const QueueWaitStats* prev)
+{
+    char hist[QUEUE_WAIT_HIST_SIZE * 24];
+    int i, len = 0;
+
+    if (w->nb_waits == prev->nb_waits)
+        return;
+    hist[0] = 0;
+    for (i = 0; i < QUEUE_WAIT_HIST_SIZE; i++) {
+        int64_t n = w->hist[i] - prev->hist[i];
+        if (n && len < (int)sizeof(hist))
+            len += snprintf(hist + len, sizeof(hist) - len, " <%" PRId64 "us:%" PRId64, INT64_C(1) << i, n);
+    }
+    av_log(NULL, AV_LOG_INFO, "  %-9s %s blocked %" PRId64 "x for %.3f s (longest ever %.3f s):%s\n",
+        name, side, w->nb_waits - prev->nb_waits, (w->total_us - prev->total_us) / 1000000.0,
+        w->max_us / 1000000.0, hist);
+}
+
+/* Log the queue statistics, rates and waits are since the previous dump.
+ * Consumers blocked on empty packet queues point to I/O starvation, consumers
+ * blocked on empty frame queues with full packet queues to decode starvation. */
+static void stream_log_queue_stats(FMediaPlayer* is)
+{
+    static const char* const names[6] = { "audioq", "videoq", "subtitleq", "sampq", "pictq", "subpq" };
+    QueueStats stats[6];
+    int64_t now = av_gettime_relative();
+    double elapsed = (now - is->last_queue_stats_time) / 1000000.0;
+    int i;
+
+    packet_queue_get_stats(&is->audioq, &stats[0]);
+    packet_queue_get_stats(&is->videoq, &stats[1]);
+    packet_queue_get_stats(&is->subtitleq, &stats[2]);
+    frame_queue_get_stats(&is->sampq, &stats[3]);
+    frame_queue_get_stats(&is->pictq, &stats[4]);
+    frame_queue_get_stats(&is->subpq, &stats[5]);
+
+    av_log(NULL, AV_LOG_INFO, "Queue statistics over the last %.1f s:\n", elapsed);
+    for (i = 0; i < 6; i++) {
+        const QueueStats* st = &stats[i], * prev = &is->last_queue_stats[i];
+        av_log(NULL, AV_LOG_INFO, "  %-9s in %7.1f/s out %7.1f/s, %4d queued (peak %4d",
+            names[i], (st->nb_put - prev->nb_put) / elapsed, (st->nb_get - prev->nb_get) / elapsed,
+            st->nb_cur, st->max_nb);
+        if (i < 3)
+            av_log(NULL, AV_LOG_INFO, ", %" PRId64 " KB, peak %" PRId64 " KB), serial %d, %" PRId64 " flushes dropping %" PRId64 " packets\n",
+                st->size_cur / 1024, st->max_size / 1024, st->serial, st->nb_flushes, st->nb_flushed);
+        else
+            av_log(NULL, AV_LOG_INFO, "), serial %d\n", st->serial);
+        log_queue_wait_stats(names[i], "producer", &st->producer_wait, &prev->producer_wait);
+        log_queue_wait_stats(names[i], "consumer", &st->consumer_wait, &prev->consumer_wait);
+        is->last_queue_stats[i] = *st;
+    }
+    is->last_queue_stats_time = now;
+}
+
+static void toggle_pause(FMediaPlayer* is)
+{
+    stream_toggle_pause(is);
+    is->step = 0;
+}
+
+static void toggle_mute(FMediaPlayer* is)
+{
+    is->muted = !is->muted;
+}
+
+static void update_volume(FMediaPlayer* is, int sign, double step)
+{
+    double volume_level = is->audio_volume ? (20 * log(is->audio_volume / (double)SDL_MIX_MAXVOLUME) / log(10)) : -1000.0;
+    int new_volume = lrint(SDL_MIX_MAXVOLUME * pow(10.0, (volume_level + sign * step) / 20.0));
+    is->audio_volume = av_clip(is->audio_volume == new_volume ? (is->audio_volume + sign) : new_volume, 0, SDL_MIX_MAXVOLUME);
+}
+
+static void step_to_next_frame(FMediaPlayer* is)
+{
+    /* if the stream is paused unpause it, then step */
+    if (is->paused)
+        stream_toggle_pause(is);
+    is->step = 1;
+}
+
+static double compute_target_delay(double delay, FMediaPlayer* is)
+{
+    double sync_threshold, diff = 0;
+
+    /* update delay to follow master synchronisation source */
+    if (get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER) {
+        /* if video is slave, we try to correct big delays by
+           duplicating or deleting a frame */
+        diff = get_clock(&is->vidclk) - get_master_clock(is);
+
+        /* skip or repeat frame. We take into account the
+           delay to compute the threshold. I still don't know
+           if it is the best guess */
+        sync_threshold = FFMAX(AV_SYNC_THRESHOLD_MIN, FFMIN(AV_SYNC_THRESHOLD_MAX, delay));
+        if (!isnan(diff) && fabs(diff) < is->max_frame_duration) {
+            if (diff <= -sync_threshold)
+                delay = FFMAX(0, delay + diff);
+            else if (diff >= sync_threshold && delay > AV_SYNC_FRAMEDUP_THRESHOLD)
+                delay = delay + diff;
+            else if (diff >= sync_threshold)
+                delay = 2 * delay;
+        }
+    }
+
+    av_log(NULL, AV_LOG_TRACE, "video: delay=%0.3f A-V=%f\n",
+        delay, -diff);
+
+    return delay;
+}
+
+static double vp_duration(FMediaPlayer* is, VideoFrame* vp, VideoFrame* nextvp) {
+    if (vp->serial == nextvp->serial) {
+        double duration = nextvp->pts - vp->pts;
+        if (isnan(duration) || duration <= 0 || duration > is->max_frame_duration)
+            return vp->duration;
+        else
+            return duration;
+    }
+    else {
+        return 0.0;
+    }
+}
+
+static void update_video_pts(FMediaPlayer* is, double pts, int64_t pos, int serial) {
+    /* update current video pts */
+    set_clock(&is->vidclk, pts, serial);
+    sync_clock_to_slave(&is->extclk, &is->vidclk);
+}
+
+/* Adapt the pictq depth to the decode jitter: grow while pictures are dropped
+ * late, shrink back towards -pictq_size once playback has been smooth for a
+ * while, and never hold more than -pictq_bytes worth of pictures. */
+static void video_adapt_queue_depth(FMediaPlayer* is, VideoFrame* vp)
+{
+    FrameQueue<VideoFrame>* f = &is->pictq;
+    int64_t now = av_gettime_relative();
+    int depth = frame_queue_depth(f), new_depth = depth;
+    int frame_size, limit = f->max_size;
+
+    frame_size = av_image_get_buffer_size((enum AVPixelFormat)vp->format, vp->frame->width, vp->frame->height, 1);
+    if (frame_size > 0)
+        limit = (int)FFMIN(limit, pictq_bytes / frame_size);
+
+    if (now - is->pictq_adapt_time >= PICTQ_ADAPT_INTERVAL) {
+        if (is->frame_drops_late != is->pictq_adapt_drops) {
+            new_depth++;
+            is->pictq_calm_time = now;
+        }
+        else if (now - is->pictq_calm_time >= PICTQ_SHRINK_DELAY && new_depth > pictq_size) {
+            new_depth--;
+            is->pictq_calm_time = now;
+        }
+        is->pictq_adapt_drops = is->frame_drops_late;
+        is->pictq_adapt_time = now;
+    }
+    new_depth = av_clip(FFMIN(new_depth, limit), f->keep_last + 1, f->max_size);
+
+    if (new_depth != depth) {
+        av_log(NULL, AV_LOG_VERBOSE, "pictq depth %d -> %d (%d late drops, %d KB per picture)\n",
+            depth, new_depth, is->frame_drops_late, frame_size / 1024);
+        frame_queue_set_depth(f, new_depth);
+    }
+}
+
+/* called to display each frame */
+static void video_refresh(void* pUserData, double* remaining_time)
+{
+    FMediaPlayer* is = static_cast<FMediaPlayer*>(pUserData);
+    double time;
+
+    SubtitleFrame* sp, * sp2;
+
+    if (!is->paused && get_master_sync_type(is) == AV_SYNC_EXTERNAL_CLOCK && is->realtime)
+        check_external_clock_speed(is);
+
+    if (!display_disable && is->eShow_mode != FMediaPlayer::EShowMode::SHOW_MODE_VIDEO && is->audio_st) {
+        time = av_gettime_relative() / 1000000.0;
+        if (is->force_refresh || is->last_vis_time + rdftspeed < time) {
+            video_display(is);
+            is->last_vis_time = time;
+        }
+        *remaining_time = FFMIN(*remaining_time, is->last_vis_time + rdftspeed - time);
+    }
+
+    if (is->video_st) {
+    retry:
+        if (frame_queue_nb_remaining(&is->pictq) == 0) {
+            // nothing to do, no picture to display in the queue
+        }
+        else {
+            double last_duration, duration, delay;
+            VideoFrame* vp, * lastvp;
+
+            /* dequeue the picture */
+            lastvp = frame_queue_peek_last(&is->pictq);
+            vp = frame_queue_peek(&is->pictq);
+
+            if (vp->serial != is->videoq.serial) {
+                frame_queue_next(&is->pictq);
+                goto retry;
+            }
+
+            if (lastvp->serial != vp->serial)
+                is->frame_timer = av_gettime_relative() / 1000000.0;
+
+            video_adapt_queue_depth(is, vp);
+
+            if (is->paused)
+                goto display;
+
+            /* compute nominal last_duration */
+            last_duration = vp_duration(is, lastvp, vp);
+            delay = compute_target_delay(last_duration, is);
+
+            time = av_gettime_relative() / 1000000.0;
+            if (time < is->frame_timer + delay) {
+                *remaining_time = FFMIN(is->frame_timer + delay - time, *remaining_time);
+                goto display;
+            }
+
+            is->frame_timer += delay;
+            if (delay > 0 && time - is->frame_timer > AV_SYNC_THRESHOLD_MAX)
+                is->frame_timer = time;
+
+            if (!isnan(vp->pts))
+                update_video_pts(is, vp->pts, vp->pos, vp->serial);
+
+            if (frame_queue_nb_remaining(&is->pictq) > 1) {
+                VideoFrame* nextvp = frame_queue_peek_next(&is->pictq);
+                duration = vp_duration(is, vp, nextvp);
+                if (!is->step && (framedrop > 0 || (framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)) && time > is->frame_timer + duration) {
+                    is->frame_drops_late++;
+                    frame_queue_next(&is->pictq);
+                    goto retry;
+                }
+            }
+
+            if (is->subtitle_st) {
+                while (frame_queue_nb_remaining(&is->subpq) > 0) {
+                    sp = frame_queue_peek(&is->subpq);
+
+                    if (frame_queue_nb_remaining(&is->subpq) > 1)
+                        sp2 = frame_queue_peek_next(&is->subpq);
+                    else
+                        sp2 = NULL;
+
+                    if (sp->serial != is->subtitleq.serial
+                        || (is->vidclk.pts > (sp->pts + ((float)sp->sub.end_display_time / 1000)))
+                        || (sp2 && is->vidclk.pts > (sp2->pts + ((float)sp2->sub.start_display_time / 1000))))
+                    {
+                        /* the subtitle texture is only drawn along with a subtitle,
+                         * the next upload clears what is left of this one */
+                        frame_queue_next(&is->subpq);
+                    }
+                    else {
+                        break;
+                    }
+                }
+            }
+
+            frame_queue_next(&is->pictq);
+            is->force_refresh = 1;
+
+            if (is->step && !is->paused)
+                stream_toggle_pause(is);
+        }
+    display:
+        /* display picture */
+        if (!display_disable && is->force_refresh && is->eShow_mode == FMediaPlayer::EShowMode::SHOW_MODE_VIDEO && is->pictq.rindex_shown)
+            video_display(is);
+    }
+    is->force_refresh = 0;
+    if (show_status) {
+        static int64_t last_time;
+        int64_t cur_time;
+        int aqsize, vqsize, sqsize;
+        double av_diff;
+
+        cur_time = av_gettime_relative();
+        if (!last_time || (cur_time - last_time) >= 30000) {
+            aqsize = 0;
+            vqsize = 0;
+            sqsize = 0;
+            if (is->audio_st)
+                aqsize = packet_queue_size(&is->audioq);
+            if (is->video_st)
+                vqsize = packet_queue_size(&is->videoq);
+            if (is->subtitle_st)
+                sqsize = packet_queue_size(&is->subtitleq);
+            av_diff = 0;
+            if (is->audio_st && is->video_st)
+                av_diff = get_clock(&is->audclk) - get_clock(&is->vidclk);
+            else if (is->video_st)
+                av_diff = get_master_clock(is) - get_clock(&is->vidclk);
+            else if (is->audio_st)
+                av_diff = get_master_clock(is) - get_clock(&is->audclk);
+            /*av_log(NULL, AV_LOG_INFO,
+                "%7.2f %s:%7.3f fd=%4d aq=%5dKB vq=%5dKB sq=%5dB f=%"PRId64"/%"PRId64"   \r",
+                get_master_clock(is),
+                (is->audio_st && is->video_st) ? "A-V" : (is->video_st ? "M-V" : (is->audio_st ? "M-A" : "   ")),
+                av_diff,
+                is->frame_drops_early + is->frame_drops_late,
+                aqsize / 1024,
+                vqsize / 1024,
+                sqsize,
+                is->video_st ? is->viddec.avctx->pts_correction_num_faulty_dts : 0,
+                is->video_st ? is->viddec.avctx->pts_correction_num_faulty_pts : 0);*/
+            fflush(stdout);
+            last_time = cur_time;
+        }
+    }
+}
+
+/* Reduce a row of 16-bit samples to 8 bits: (src + dither) >> shift, saturated.
+ * dither holds one row of the dither pattern, repeating every 8 samples. */
+static void reduce_row_16to8_c(uint8_t* dst, const uint16_t* src, int n, int shift, const uint16_t* dither)
+{
+    int x;
+    for (x = 0; x < n; x++)
+        dst[x] = av_clip_uint8((src[x] + dither[x & 7]) >> shift);
+}
+
+#if ARCH_X86
+static void reduce_row_16to8_sse2(uint8_t* dst, const uint16_t* src, int n, int shift, const uint16_t* dither)
+{
+    __m128i d = _mm_loadu_si128((const __m128i*)dither);
+    __m128i sh = _mm_cvtsi32_si128(shift);
+    int x;
+
+    for (x = 0; x + 16 <= n; x += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + x));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + x + 8));
+        a = _mm_srl_epi16(_mm_adds_epu16(a, d), sh);
+        b = _mm_srl_epi16(_mm_adds_epu16(b, d), sh);
+        _mm_storeu_si128((__m128i*)(dst + x), _mm_packus_epi16(a, b));
+    }
+    reduce_row_16to8_c(dst + x, src + x, n - x, shift, dither);
+}
+
+TARGET_AVX2 static void reduce_row_16to8_avx2(uint8_t* dst, const uint16_t* src, int n, int shift, const uint16_t* dither)
+{
+    __m256i d = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)dither));
+    __m128i sh = _mm_cvtsi32_si128(shift);
+    int x;
+
+    for (x = 0; x + 32 <= n; x += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + x));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + x + 16));
+        a = _mm256_srl_epi16(_mm256_adds_epu16(a, d), sh);
+        b = _mm256_srl_epi16(_mm256_adds_epu16(b, d), sh);
+        /* packus works per 128-bit lane, put the quadwords back in order */
+        _mm256_storeu_si256((__m256i*)(dst + x), _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+    }
+    reduce_row_16to8_c(dst + x, src + x, n - x, shift, dither);
+}
+#endif
+
+/* Reduce a 10 to 16-bit frame to the same layout with 8-bit samples, with
+ * ordered dithering or rounding. The sample shift does not need the range
+ * or colorspace, they are carried over with the frame properties. */
+static void reduce_frame_16to8(AVFrame* dst, const AVFrame* src)
+{
+    static const uint8_t bayer8x8[8][8] = {
+        {  0, 32,  8, 40,  2, 34, 10, 42 },
+        { 48, 16, 56, 24, 50, 18, 58, 26 },
+        { 12, 44,  4, 36, 14, 46,  6, 38 },
+        { 60, 28, 52, 20, 62, 30, 54, 22 },
+        {  3, 35, 11, 43,  1, 33,  9, 41 },
+        { 51, 19, 59, 27, 49, 17, 57, 25 },
+        { 15, 47,  7, 39, 13, 45,  5, 37 },
+        { 63, 31, 55, 23, 61, 29, 53, 21 },
+    };
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((enum AVPixelFormat)src->format);
+    void (*reduce_row)(uint8_t* dst, const uint16_t* src, int n, int shift, const uint16_t* dither) = reduce_row_16to8_c;
+    int shift = desc->comp[0].shift + desc->comp[0].depth - 8;
+    uint16_t dither[8][8];
+    int linesize[4];
+    int nb_planes = av_pix_fmt_count_planes((enum AVPixelFormat)src->format);
+    int p, x, y;
+
+#if ARCH_X86
+    int cpu_flags = av_get_cpu_flags();
+    if (cpu_flags & AV_CPU_FLAG_AVX2)
+        reduce_row = reduce_row_16to8_avx2;
+    else if (cpu_flags & AV_CPU_FLAG_SSE2)
+        reduce_row = reduce_row_16to8_sse2;
+#endif
+
+    for (y = 0; y < 8; y++)
+        for (x = 0; x < 8; x++)
+            dither[y][x] = hbd_dither ? (bayer8x8[y][x] << shift) >> 6 : 1 << (shift - 1);
+
+    av_image_fill_linesizes(linesize, (enum AVPixelFormat)src->format, src->width);
+    for (p = 0; p < nb_planes; p++) {
+        int h = p ? AV_CEIL_RSHIFT(src->height, desc->log2_chroma_h) : src->height;
+        for (y = 0; y < h; y++)
+            reduce_row(dst->data[p] + y * dst->linesize[p],
+                (const uint16_t*)(src->data[p] + y * src->linesize[p]), linesize[p] / 2, shift, dither[y & 7]);
+    }
+}
+
+/* SMPTE ST 2084 (PQ) EOTF and its inverse, signal in [0, 1], luminance in cd/m2 */
+static double pq_to_nits(double e)
+{
+    const double m1 = 0.1593017578125, m2 = 78.84375;
+    const double c1 = 0.8359375, c2 = 18.8515625, c3 = 18.6875;
+    double p = pow(FFMAX(e, 0.0), 1.0 / m2);
+    return 10000.0 * pow(FFMAX(p - c1, 0.0) / (c2 - c3 * p), 1.0 / m1);
+}
+
+static double nits_to_pq(double nits)
+{
+    const double m1 = 0.1593017578125, m2 = 78.84375;
+    const double c1 = 0.8359375, c2 = 18.8515625, c3 = 18.6875;
+    double y = pow(FFMAX(nits, 0.0) / 10000.0, m1);
+    return pow((c1 + c2 * y) / (1.0 + c3 * y), m2);
+}
+
+/* ARIB STD-B67 (HLG) inverse OETF and the OOTF of a 1000 cd/m2 display, applied to luma */
+static double hlg_to_nits(double e)
+{
+    const double a = 0.17883277, b = 0.28466892, c = 0.55991073;
+    double scene = e <= 0.5 ? e * e / 3.0 : (exp((e - c) / a) + b) / 12.0;
+    return 1000.0 * pow(FFMAX(scene, 0.0), 1.2);
+}
+
+/* (Re)build the tone mapping tables for the frame, returns 0 if it is not HDR */
+static int tonemap_update(ToneMap* tm, const AVFrame* frame)
+{
+    AVFrameSideData* sd;
+    double peak = 1000.0, src_peak_pq, dst_peak, ks;
+    int full_range = frame->color_range == AVCOL_RANGE_JPEG;
+    int i;
+
+    if (frame->color_trc != AVCOL_TRC_SMPTE2084 && frame->color_trc != AVCOL_TRC_ARIB_STD_B67)
+        return 0;
+
+    /* HLG is relative, its OOTF above is for the nominal 1000 cd/m2 peak */
+    if (frame->color_trc == AVCOL_TRC_SMPTE2084) {
+        if ((sd = av_frame_get_side_data(frame, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL)) &&
+            ((AVContentLightMetadata*)sd->data)->MaxCLL)
+            peak = ((AVContentLightMetadata*)sd->data)->MaxCLL;
+        else if ((sd = av_frame_get_side_data(frame, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA)) &&
+            ((AVMasteringDisplayMetadata*)sd->data)->has_luminance)
+            peak = av_q2d(((AVMasteringDisplayMetadata*)sd->data)->max_luminance);
+    }
+    peak = av_clipd(peak, tonemap_peak, 10000.0);
+
+    if (tm->trc == frame->color_trc && tm->peak == peak && tm->full_range == full_range &&
+        tm->primaries == frame->color_primaries)
+        return 1;
+    tm->trc = frame->color_trc;
+    tm->peak = peak;
+    tm->full_range = full_range;
+    tm->primaries = frame->color_primaries;
+    av_log(NULL, AV_LOG_VERBOSE, "Tone mapping %s video with a %.0f cd/m2 peak to SDR\n",
+        tm->trc == AVCOL_TRC_SMPTE2084 ? "PQ" : "HLG", peak);
+
+    /* BT.2390 EETF: roll off the highlights in the PQ domain above the knee ks */
+    src_peak_pq = nits_to_pq(peak);
+    dst_peak = nits_to_pq(tonemap_peak) / src_peak_pq;
+    ks = 1.5 * dst_peak - 0.5;
+    for (i = 0; i < TONEMAP_LUT_SIZE; i++) {
+        double e = full_range ? i / 1023.0 : av_clipd((i - 64) / 876.0, 0.0, 1.0);
+        double nits = tm->trc == AVCOL_TRC_SMPTE2084 ? pq_to_nits(e) : hlg_to_nits(e);
+        double e1 = FFMIN(nits_to_pq(nits) / src_peak_pq, 1.0), e2 = e1, v;
+
+        if (e1 > ks && ks < 1.0) {
+            double t = (e1 - ks) / (1.0 - ks), t2 = t * t, t3 = t2 * t;
+            e2 = (2 * t3 - 3 * t2 + 1) * ks + (t3 - 2 * t2 + t) * (1.0 - ks) + (-2 * t3 + 3 * t2) * dst_peak;
+        }
+        /* relative to the SDR peak, then BT.1886 gamma */
+        v = pow(av_clipd(pq_to_nits(e2 * src_peak_pq) / tonemap_peak, 0.0, 1.0), 1.0 / 2.4);
+        tm->luma[i] = lrint(full_range ? v * 255.0 : 16.0 + v * 219.0);
+        /* keep the saturation by scaling chroma like the encoded luma */
+        tm->chroma_scale[i] = e > 0.001 ? lrint(av_clipd(v / e, 0.0, 4.0) * 4096) : 4096;
+    }
+
+    /* BT.2020 to BT.709 primaries on the non-linear signal, which leaves luma alone */
+    if (tm->primaries == AVCOL_PRI_BT2020 || tm->primaries == AVCOL_PRI_UNSPECIFIED) {
+        tm->chroma_matrix[0] = 4682;
+        tm->chroma_matrix[1] = 68;
+        tm->chroma_matrix[2] = -105;
+        tm->chroma_matrix[3] = 7242;
+    }
+    else {
+        tm->chroma_matrix[0] = tm->chroma_matrix[3] = 4096;
+        tm->chroma_matrix[1] = tm->chroma_matrix[2] = 0;
+    }
+    return 1;
+}
+
+static void tonemap_luma_row_c(uint8_t* dst, const uint16_t* src, int n, int shift, const int32_t* lut)
+{
+    int x;
+    for (x = 0; x < n; x++)
+        dst[x] = lut[(src[x] >> shift) & (TONEMAP_LUT_SIZE - 1)];
+}
+
+/* Chroma of a 4:2:0 row, sample i is scaled by the tone mapping of luma[2 * i].
+ * step is 1 for planar chroma, 2 for interleaved chroma with v = u + 1. */
+static void tonemap_chroma_row_c(uint8_t* dst_u, uint8_t* dst_v, const uint16_t* src_u, const uint16_t* src_v, int step,
+    const uint16_t* luma, int luma_n, int n, int shift, const ToneMap* tm)
+{
+    const int32_t* m = tm->chroma_matrix;
+    int i;
+    for (i = 0; i < n; i++) {
+        int f = tm->chroma_scale[(luma[2 * i] >> shift) & (TONEMAP_LUT_SIZE - 1)];
+        int u = ((src_u[i * step] >> shift) & (TONEMAP_LUT_SIZE - 1)) - 512;
+        int v = ((src_v[i * step] >> shift) & (TONEMAP_LUT_SIZE - 1)) - 512;
+        int cu = (m[0] * u + m[1] * v + 2048) >> 12;
+        int cv = (m[2] * u + m[3] * v + 2048) >> 12;
+        /* Q12 factor, and 10 to 8 bits */
+        dst_u[i * step] = av_clip_uint8(128 + ((cu * f + (1 << 13)) >> 14));
+        dst_v[i * step] = av_clip_uint8(128 + ((cv * f + (1 << 13)) >> 14));
+    }
+}
+
+#if ARCH_X86
+TARGET_AVX2 static void tonemap_luma_row_avx2(uint8_t* dst, const uint16_t* src, int n, int shift, const int32_t* lut)
+{
+    const __m256i mask = _mm256_set1_epi16(TONEMAP_LUT_SIZE - 1);
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    int x;
+
+    for (x = 0; x + 16 <= n; x += 16) {
+        __m256i idx = _mm256_and_si256(_mm256_srl_epi16(_mm256_loadu_si256((const __m256i*)(src + x)), sh), mask);
+        __m256i lo = _mm256_i32gather_epi32((const int*)lut, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(idx)), 4);
+        __m256i hi = _mm256_i32gather_epi32((const int*)lut, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(idx, 1)), 4);
+        __m256i w = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8);
+        __m256i b = _mm256_permute4x64_epi64(_mm256_packus_epi16(w, w), 0x08);
+        _mm_storeu_si128((__m128i*)(dst + x), _mm256_castsi256_si128(b));
+    }
+    tonemap_luma_row_c(dst + x, src + x, n - x, shift, lut);
+}
+
+/* 8 chroma samples: matrix, saturation scale from the co-sited luma, 8-bit result in int32 lanes */
+TARGET_AVX2 static inline void tonemap_chroma_8_avx2(__m256i* u, __m256i* v, const uint16_t* luma, __m128i sh, const ToneMap* tm)
+{
+    const __m256i mask = _mm256_set1_epi32(TONEMAP_LUT_SIZE - 1), c512 = _mm256_set1_epi32(512);
+    const __m256i lo16 = _mm256_set1_epi32(0xFFFF);
+    const __m256i round12 = _mm256_set1_epi32(1 << 11), round14 = _mm256_set1_epi32(1 << 13), c128 = _mm256_set1_epi32(128);
+    __m256i y = _mm256_and_si256(_mm256_srl_epi32(_mm256_and_si256(_mm256_loadu_si256((const __m256i*)luma), lo16), sh), mask);
+    __m256i f = _mm256_i32gather_epi32((const int*)tm->chroma_scale, y, 4);
+    __m256i cu, cv;
+
+    *u = _mm256_sub_epi32(_mm256_and_si256(_mm256_srl_epi32(*u, sh), mask), c512);
+    *v = _mm256_sub_epi32(_mm256_and_si256(_mm256_srl_epi32(*v, sh), mask), c512);
+    cu = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(*u, _mm256_set1_epi32(tm->chroma_matrix[0])),
+        _mm256_mullo_epi32(*v, _mm256_set1_epi32(tm->chroma_matrix[1]))), round12), 12);
+    cv = _mm256_srai_epi32(_mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(*u, _mm256_set1_epi32(tm->chroma_matrix[2])),
+        _mm256_mullo_epi32(*v, _mm256_set1_epi32(tm->chroma_matrix[3]))), round12), 12);
+    cu = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(cu, f), round14), 14), c128);
+    cv = _mm256_add_epi32(_mm256_srai_epi32(_mm256_add_epi32(_mm256_mullo_epi32(cv, f), round14), 14), c128);
+    *u = _mm256_min_epi32(_mm256_max_epi32(cu, _mm256_setzero_si256()), _mm256_set1_epi32(255));
+    *v = _mm256_min_epi32(_mm256_max_epi32(cv, _mm256_setzero_si256()), _mm256_set1_epi32(255));
+}
+
+TARGET_AVX2 static void tonemap_chroma_row_avx2(uint8_t* dst_u, uint8_t* dst_v, const uint16_t* src_u, const uint16_t* src_v, int step,
+    const uint16_t* luma, int luma_n, int n, int shift, const ToneMap* tm)
+{
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    const __m128i split = _mm_setr_epi8(0, 1, 2, 3, 8, 9, 10, 11, 4, 5, 6, 7, 12, 13, 14, 15);
+    int i;
+
+    for (i = 0; i + 8 <= n && 2 * (i + 8) <= luma_n; i += 8) {
+        __m256i u, v, b;
+        if (step == 1) {
+            u = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src_u + i)));
+            v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(src_v + i)));
+            tonemap_chroma_8_avx2(&u, &v, luma + 2 * i, sh, tm);
+            /* u0-3 v0-3 | u4-7 v4-7 as bytes, then split into the two planes */
+            b = _mm256_packus_epi16(_mm256_packs_epi32(u, v), _mm256_setzero_si256());
+            b = _mm256_permute4x64_epi64(b, 0x08);
+            __m128i uv = _mm_shuffle_epi8(_mm256_castsi256_si128(b), split);
+            _mm_storel_epi64((__m128i*)(dst_u + i), uv);
+            _mm_storel_epi64((__m128i*)(dst_v + i), _mm_unpackhi_epi64(uv, uv));
+        }
+        else {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(src_u + 2 * i));
+            u = _mm256_and_si256(x, _mm256_set1_epi32(0xFFFF));
+            v = _mm256_srli_epi32(x, 16);
+            tonemap_chroma_8_avx2(&u, &v, luma + 2 * i, sh, tm);
+            b = _mm256_or_si256(u, _mm256_slli_epi32(v, 16));
+            b = _mm256_permute4x64_epi64(_mm256_packus_epi16(b, b), 0x08);
+            _mm_storeu_si128((__m128i*)(dst_u + 2 * i), _mm256_castsi256_si128(b));
+        }
+    }
+    tonemap_chroma_row_c(dst_u + i * step, dst_v + i * step, src_u + i * step, src_v + i * step, step,
+        luma + 2 * i, luma_n - 2 * i, n - i, shift, tm);
+}
+#endif
+
+/* Tone map a 10 to 16-bit 4:2:0 frame to 8-bit BT.709 SDR in the same layout.
+ * This works on Y'CbCr directly: luma through the tables, chroma through the
+ * primaries matrix and scaled by the change of its luma. */
+static void tonemap_frame(const ToneMap* tm, AVFrame* dst, const AVFrame* src)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((enum AVPixelFormat)src->format);
+    void (*luma_row)(uint8_t* dst, const uint16_t* src, int n, int shift, const int32_t* lut) = tonemap_luma_row_c;
+    void (*chroma_row)(uint8_t* dst_u, uint8_t* dst_v, const uint16_t* src_u, const uint16_t* src_v, int step,
+        const uint16_t* luma, int luma_n, int n, int shift, const ToneMap* tm) = tonemap_chroma_row_c;
+    int shift = desc->comp[0].shift + desc->comp[0].depth - 10;
+    int semi_planar = av_pix_fmt_count_planes((enum AVPixelFormat)src->format) == 2;
+    int cw = AV_CEIL_RSHIFT(src->width, desc->log2_chroma_w);
+    int ch = AV_CEIL_RSHIFT(src->height, desc->log2_chroma_h);
+    int y;
+
+#if ARCH_X86
+    if (av_get_cpu_flags() & AV_CPU_FLAG_AVX2) {
+        luma_row = tonemap_luma_row_avx2;
+        chroma_row = tonemap_chroma_row_avx2;
+    }
+#endif
+
+    for (y = 0; y < src->height; y++)
+        luma_row(dst->data[0] + y * dst->linesize[0],
+            (const uint16_t*)(src->data[0] + y * src->linesize[0]), src->width, shift, tm->luma);
+    for (y = 0; y < ch; y++) {
+        const uint16_t* luma = (const uint16_t*)(src->data[0] + (y << desc->log2_chroma_h) * src->linesize[0]);
+        if (semi_planar) {
+            const uint16_t* uv = (const uint16_t*)(src->data[1] + y * src->linesize[1]);
+            uint8_t* out = dst->data[1] + y * dst->linesize[1];
+            chroma_row(out, out + 1, uv, uv + 1, 2, luma, src->width, cw, shift, tm);
+        }
+        else {
+            chroma_row(dst->data[1] + y * dst->linesize[1], dst->data[2] + y * dst->linesize[2],
+                (const uint16_t*)(src->data[1] + y * src->linesize[1]),
+                (const uint16_t*)(src->data[2] + y * src->linesize[2]), 1, luma, src->width, cw, shift, tm);
+        }
+    }
+}
+
+/* 4:2:2 planar to packed YUYV, n is the number of chroma samples */
+static void repack_row_422p_yuyv_c(uint8_t* dst, const uint8_t* y, const uint8_t* u, const uint8_t* v, int n)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        dst[4 * i + 0] = y[2 * i];
+        dst[4 * i + 1] = u[i];
+        dst[4 * i + 2] = y[2 * i + 1];
+        dst[4 * i + 3] = v[i];
+    }
+}
+
+/* Average 2x2 blocks of rows a and b into n samples, w is the width of the input rows */
+static void decimate_row_2x2_c(uint8_t* dst, const uint8_t* a, const uint8_t* b, int n, int w)
+{
+    int i;
+    for (i = 0; i < n; i++) {
+        int j = FFMIN(2 * i + 1, w - 1);
+        dst[i] = (a[2 * i] + a[j] + b[2 * i] + b[j] + 2) >> 2;
+    }
+}
+
+#if ARCH_X86
+static void repack_row_422p_yuyv_sse2(uint8_t* dst, const uint8_t* y, const uint8_t* u, const uint8_t* v, int n)
+{
+    int i;
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m128i cu = _mm_loadu_si128((const __m128i*)(u + i));
+        __m128i cv = _mm_loadu_si128((const __m128i*)(v + i));
+        __m128i y0 = _mm_loadu_si128((const __m128i*)(y + 2 * i));
+        __m128i y1 = _mm_loadu_si128((const __m128i*)(y + 2 * i + 16));
+        __m128i uv0 = _mm_unpacklo_epi8(cu, cv), uv1 = _mm_unpackhi_epi8(cu, cv);
+        _mm_storeu_si128((__m128i*)(dst + 4 * i), _mm_unpacklo_epi8(y0, uv0));
+        _mm_storeu_si128((__m128i*)(dst + 4 * i + 16), _mm_unpackhi_epi8(y0, uv0));
+        _mm_storeu_si128((__m128i*)(dst + 4 * i + 32), _mm_unpacklo_epi8(y1, uv1));
+        _mm_storeu_si128((__m128i*)(dst + 4 * i + 48), _mm_unpackhi_epi8(y1, uv1));
+    }
+    repack_row_422p_yuyv_c(dst + 4 * i, y + 2 * i, u + i, v + i, n - i);
+}
+
+static inline __m128i pair_sums_sse2(__m128i x)
+{
+    return _mm_add_epi16(_mm_and_si128(x, _mm_set1_epi16(0xFF)), _mm_srli_epi16(x, 8));
+}
+
+static void decimate_row_2x2_sse2(uint8_t* dst, const uint8_t* a, const uint8_t* b, int n, int w)
+{
+    const __m128i round = _mm_set1_epi16(2);
+    int i;
+    for (i = 0; i + 16 <= n && 2 * (i + 16) <= w; i += 16) {
+        __m128i s0 = _mm_add_epi16(pair_sums_sse2(_mm_loadu_si128((const __m128i*)(a + 2 * i))),
+            pair_sums_sse2(_mm_loadu_si128((const __m128i*)(b + 2 * i))));
+        __m128i s1 = _mm_add_epi16(pair_sums_sse2(_mm_loadu_si128((const __m128i*)(a + 2 * i + 16))),
+            pair_sums_sse2(_mm_loadu_si128((const __m128i*)(b + 2 * i + 16))));
+        s0 = _mm_srli_epi16(_mm_add_epi16(s0, round), 2);
+        s1 = _mm_srli_epi16(_mm_add_epi16(s1, round), 2);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(s0, s1));
+    }
+    decimate_row_2x2_c(dst + i, a + 2 * i, b + 2 * i, n - i, w - 2 * i);
+}
+#endif
+
+/* 2x2 box over pixels of step bytes, n output pixels from 2 * n input ones */
+static void decimate_pixels_2x2_c(uint8_t* dst, const uint8_t* a, const uint8_t* b, int n, int step)
+{
+    int i, c;
+    for (i = 0; i < n; i++)
+        for (c = 0; c < step; c++) {
+            int j = 2 * i * step + c;
+            dst[i * step + c] = (a[j] + a[j + step] + b[j] + b[j + step] + 2) >> 2;
+        }
+}
+
+#if ARCH_X86
+/* row sums of 16 bytes widened to words, then the neighbouring pixels added:
+ * the float shuffles pick the even and odd 2 or 4 byte pixels of both halves */
+template <int step>
+static inline __m128i decimate_pixels_sums_sse2(__m128i a, __m128i b)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128 lo = _mm_castsi128_ps(_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)));
+    __m128 hi = _mm_castsi128_ps(_mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)));
+    if (step == 2)
+        return _mm_add_epi16(_mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0))),
+            _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1))));
+    return _mm_add_epi16(_mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(1, 0, 1, 0))),
+        _mm_castps_si128(_mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 2, 3, 2))));
+}
+
+template <int step>
+static void decimate_pixels_2x2_sse2(uint8_t* dst, const uint8_t* a, const uint8_t* b, int n)
+{
+    const __m128i round = _mm_set1_epi16(2);
+    int i, bytes = n * step;
+    for (i = 0; i + 16 <= bytes; i += 16) {
+        __m128i s0 = decimate_pixels_sums_sse2<step>(_mm_loadu_si128((const __m128i*)(a + 2 * i)),
+            _mm_loadu_si128((const __m128i*)(b + 2 * i)));
+        __m128i s1 = decimate_pixels_sums_sse2<step>(_mm_loadu_si128((const __m128i*)(a + 2 * i + 16)),
+            _mm_loadu_si128((const __m128i*)(b + 2 * i + 16)));
+        s0 = _mm_srli_epi16(_mm_add_epi16(s0, round), 2);
+        s1 = _mm_srli_epi16(_mm_add_epi16(s1, round), 2);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(s0, s1));
+    }
+    decimate_pixels_2x2_c(dst + i, a + 2 * i, b + 2 * i, (bytes - i) / step, step);
+}
+#endif
+
+static void repack_frame_422p_yuyv(AVFrame* dst, const AVFrame* src)
+{
+    void (*repack_row)(uint8_t* dst, const uint8_t* y, const uint8_t* u, const uint8_t* v, int n) = repack_row_422p_yuyv_c;
+    int y;
+
+#if ARCH_X86
+    if (av_get_cpu_flags() & AV_CPU_FLAG_SSE2)
+        repack_row = repack_row_422p_yuyv_sse2;
+#endif
+    /* an odd width reads the luma padding for the last pair, as a 4:2:2 decoder output has */
+    for (y = 0; y < src->height; y++)
+        repack_row(dst->data[0] + y * dst->linesize[0], src->data[0] + y * src->linesize[0],
+            src->data[1] + y * src->linesize[1], src->data[2] + y * src->linesize[2], AV_CEIL_RSHIFT(src->width, 1));
+}
+
+/* 4:4:4 to 4:2:0: luma is copied, chroma averaged over 2x2 blocks */
+static void repack_frame_444p_420p(AVFrame* dst, const AVFrame* src)
+{
+    void (*decimate_row)(uint8_t* dst, const uint8_t* a, const uint8_t* b, int n, int w) = decimate_row_2x2_c;
+    int cw = AV_CEIL_RSHIFT(src->width, 1), ch = AV_CEIL_RSHIFT(src->height, 1);
+    int p, y;
+
+#if ARCH_X86
+    if (av_get_cpu_flags() & AV_CPU_FLAG_SSE2)
+        decimate_row = decimate_row_2x2_sse2;
+#endif
+    av_image_copy_plane(dst->data[0], dst->linesize[0], src->data[0], src->linesize[0], src->width, src->height);
+    for (p = 1; p < 3; p++)
+        for (y = 0; y < ch; y++) {
+            const uint8_t* a = src->data[p] + 2 * y * src->linesize[p];
+            const uint8_t* b = 2 * y + 1 < src->height ? a + src->linesize[p] : a;
+            decimate_row(dst->data[p] + y * dst->linesize[p], a, b, cw, src->width);
+        }
+}
+
+/* Halve a picture with a 2x2 box filter. Only 8 bit formats whose planes
+ * hold 1, 2 or 4 byte pixels and that are subsampled alike in both
+ * directions qualify, which covers the YUV 4:2:0, NV12 and 32 bit RGB
+ * texture formats. */
+static int downscale_frame_step(int format, int plane)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(format));
+    int c, step = 0;
+
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_HWACCEL)) ||
+        desc->log2_chroma_w != desc->log2_chroma_h || desc->log2_chroma_w > 1)
+        return 0;
+    for (c = 0; c < desc->nb_components; c++) {
+        if (desc->comp[c].depth != 8)
+            return 0;
+        if (desc->comp[c].plane == plane)
+            step = desc->comp[c].step;
+    }
+    return step == 1 || step == 2 || step == 4 ? step : 0;
+}
+
+static void downscale_frame_2x2(AVFrame* dst, const AVFrame* src)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(src->format));
+    int nb_planes = av_pix_fmt_count_planes(static_cast<AVPixelFormat>(src->format));
+    int p, y;
+
+    for (p = 0; p < nb_planes; p++) {
+        int step = downscale_frame_step(src->format, p);
+        int chroma = p == 1 || p == 2;
+        int w = chroma ? AV_CEIL_RSHIFT(dst->width, desc->log2_chroma_w) : dst->width;
+        int h = chroma ? AV_CEIL_RSHIFT(dst->height, desc->log2_chroma_h) : dst->height;
+        void (*decimate_row)(uint8_t* dst, const uint8_t* a, const uint8_t* b, int n, int w) = decimate_row_2x2_c;
+        void (*decimate_pixels)(uint8_t* dst, const uint8_t* a, const uint8_t* b, int n) = NULL;
+
+#if ARCH_X86
+        if (av_get_cpu_flags() & AV_CPU_FLAG_SSE2) {
+            decimate_row = decimate_row_2x2_sse2;
+            if (step > 1)
+                decimate_pixels = step == 2 ? decimate_pixels_2x2_sse2<2> : decimate_pixels_2x2_sse2<4>;
+        }
+#endif
+        for (y = 0; y < h; y++) {
+            uint8_t* d = dst->data[p] + y * dst->linesize[p];
+            const uint8_t* a = src->data[p] + 2 * y * src->linesize[p];
+            const uint8_t* b = a + src->linesize[p];
+            if (step == 1)
+                decimate_row(d, a, b, w, 2 * w);
+            else if (decimate_pixels)
+                decimate_pixels(d, a, b, w);
+            else
+                decimate_pixels_2x2_c(d, a, b, w, step);
+        }
+    }
+}
+
+/* Formats the video thread repacks without scaling into one with an SDL
+ * texture format, instead of a full swscale conversion to RGB. */
+static const struct RepackFormatEntry {
+    enum AVPixelFormat format;
+    enum AVPixelFormat format_out;
+    void (*repack)(AVFrame* dst, const AVFrame* src);
+    const int* enabled;
+} repack_format_map[] = {
+    { AV_PIX_FMT_YUV420P10LE,    AV_PIX_FMT_YUV420P, reduce_frame_16to8,      &hbd_convert },
+    { AV_PIX_FMT_YUV420P12LE,    AV_PIX_FMT_YUV420P, reduce_frame_16to8,      &hbd_convert },
+    { AV_PIX_FMT_P010LE,         AV_PIX_FMT_NV12,    reduce_frame_16to8,      &hbd_convert },
+    { AV_PIX_FMT_P016LE,         AV_PIX_FMT_NV12,    reduce_frame_16to8,      &hbd_convert },
+    { AV_PIX_FMT_YUV422P,        AV_PIX_FMT_YUYV422, repack_frame_422p_yuyv,  &repack },
+    { AV_PIX_FMT_YUVJ422P,       AV_PIX_FMT_YUYV422, repack_frame_422p_yuyv,  &repack },
+    { AV_PIX_FMT_YUV444P,        AV_PIX_FMT_YUV420P, repack_frame_444p_420p,  &repack },
+    { AV_PIX_FMT_YUVJ444P,       AV_PIX_FMT_YUV420P, repack_frame_444p_420p,  &repack },
+    { AV_PIX_FMT_NONE,           AV_PIX_FMT_NONE,    NULL,                    NULL },
+};
+
+/* Only targets the renderer has textures for are used, SDL would otherwise
+ * convert them to RGB itself at every upload. */
+static const struct RepackFormatEntry* find_repack_format(int format)
+{
+    int i;
+    for (i = 0; repack_format_map[i].format != AV_PIX_FMT_NONE; i++)
+        if (format == repack_format_map[i].format && *repack_format_map[i].enabled &&
+            texture_format_supported(repack_format_map[i].format_out))
+            return &repack_format_map[i];
+    return NULL;
+}
+
+/* Convert frames SDL has no texture format for on the video thread, into a
+ * pooled frame, so that displaying them is a plain texture update. Frames
+ * that can be uploaded as they are are left alone. Formats of
+ * repack_format_map keep using a YUV texture, high bit depth ones are reduced
+ * to 8 bits and tone mapped if they are HDR. The rest goes through swscale
+ * to RGB. */
+static int video_convert_frame(FMediaPlayer* is, AVFrame* frame)
+{
+    const struct RepackFormatEntry* rp;
+    AVFrame* dst;
+    int tonemapped, ret;
+
+    if (frame->format != is->vid_repack_format) {
+        Uint32 sdl_pix_fmt;
+        SDL_BlendMode sdl_blendmode;
+        get_sdl_pix_fmt_and_blendmode(frame->format, &sdl_pix_fmt, &sdl_blendmode);
+        is->vid_convert = sdl_pix_fmt == SDL_PIXELFORMAT_UNKNOWN;
+        is->vid_repack = is->vid_convert ? find_repack_format(frame->format) : NULL;
+        is->vid_repack_format = frame->format;
+        if (is->vid_convert)
+            av_log(NULL, AV_LOG_VERBOSE, "Converting %s video to %s on the video thread\n",
+                (const char*)av_x_if_null(av_get_pix_fmt_name(static_cast<AVPixelFormat>(frame->format)), "none"),
+                av_get_pix_fmt_name(is->vid_repack ? is->vid_repack->format_out : AV_PIX_FMT_0RGB32));
+    }
+    if (!is->vid_convert)
+        return 0;
+    rp = is->vid_repack;
+
+    if (!is->vid_convert_frame && !(is->vid_convert_frame = av_frame_alloc()))
+        return AVERROR(ENOMEM);
+    dst = is->vid_convert_frame;
+    dst->width = frame->width;
+    dst->height = frame->height;
+    dst->format = rp ? rp->format_out : AV_PIX_FMT_0RGB32;
+    if ((ret = video_buffer_pool_get_frame(&is->video_buffer_pool, NULL, dst)) < 0 &&
+        (ret = av_frame_get_buffer(dst, 0)) < 0)
+        return ret;
+    tonemapped = rp && rp->repack == reduce_frame_16to8 && tonemap && tonemap_update(&is->tonemap, frame);
+    if (tonemapped)
+        tonemap_frame(&is->tonemap, dst, frame);
+    else if (rp)
+        rp->repack(dst, frame);
+    else if ((ret = slice_scaler_scale(&is->vid_convert_scaler, (const uint8_t* const*)frame->data, frame->linesize,
+                 frame->format, dst->data, dst->linesize, dst->format, frame->width, frame->height, sws_flags)) < 0) {
+        av_log(NULL, AV_LOG_FATAL, "Cannot initialize the conversion context\n");
+        av_frame_unref(dst);
+        return ret;
+    }
+    if ((ret = av_frame_copy_props(dst, frame)) < 0) {
+        av_frame_unref(dst);
+        return ret;
+    }
+    if (tonemapped) {
+        dst->color_trc = AVCOL_TRC_BT709;
+        dst->color_primaries = AVCOL_PRI_BT709;
+        dst->colorspace = AVCOL_SPC_BT709;
+    }
+    av_frame_unref(frame);
+    av_frame_move_ref(frame, dst);
+    return 0;
+}
+
+/* Halve pictures that are at least twice as large as their rectangle in the
+ * window, so that neither the upload nor the renderer has to deal with the
+ * pixels that would be scaled away. Power of two steps keep the size, and so
+ * the texture, the same until the window crosses one. */
+static int video_downscale_frame(FMediaPlayer* is, AVFrame* frame)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    int scr_width = is->width, scr_height = is->height;
+    int p, level, levels = 0, mask, ret;
+    SDL_Rect rect;
+
+    if (!scr_width || !scr_height || !desc)
+        return 0;
+    for (p = 0; p < av_pix_fmt_count_planes(static_cast<AVPixelFormat>(frame->format)); p++)
+        if (!downscale_frame_step(frame->format, p))
+            return 0;
+    calculate_display_rect(&rect, 0, 0, scr_width, scr_height, frame->width, frame->height, frame->sample_aspect_ratio);
+    while (levels < DOWNSCALE_MAX_LEVELS &&
+           frame->width >> (levels + 1) >= rect.w && frame->height >> (levels + 1) >= rect.h)
+        levels++;
+
+    /* subsampled planes need an even size to have their full 2x2 source blocks */
+    mask = ~((1 << desc->log2_chroma_w) - 1);
+    for (level = 0; level < levels; level++) {
+        AVFrame* dst;
+        if (!is->vid_convert_frame && !(is->vid_convert_frame = av_frame_alloc()))
+            return AVERROR(ENOMEM);
+        dst = is->vid_convert_frame;
+        dst->width = (frame->width >> 1) & mask;
+        dst->height = (frame->height >> 1) & mask;
+        dst->format = frame->format;
+        if (!dst->width || !dst->height)
+            break;
+        if ((ret = video_buffer_pool_get_frame(&is->video_buffer_pool, NULL, dst)) < 0 &&
+            (ret = av_frame_get_buffer(dst, 0)) < 0)
+            return ret;
+        downscale_frame_2x2(dst, frame);
+        if ((ret = av_frame_copy_props(dst, frame)) < 0) {
+            av_frame_unref(dst);
+            return ret;
+        }
+        av_frame_unref(frame);
+        av_frame_move_ref(frame, dst);
+    }
+    return 0;
+}
+
+static int queue_picture(FMediaPlayer* is, AVFrame* src_frame, double pts, double duration, int64_t pos, int serial)
+{
+    VideoFrame* vp;
+    int width = src_frame->width, height = src_frame->height;
+    int ret;
+
+#if defined(DEBUG_SYNC)
+    printf("frame_type=%c pts=%0.3f\n",
+        av_get_picture_type_char(src_frame->pict_type), pts);
+#endif
+
+    /* convert before waiting for a slot, overlapping with the display of the queued pictures */
+    if (decoder_convert && (ret = video_convert_frame(is, src_frame)) < 0)
+        return ret;
+    if (downscale && (ret = video_downscale_frame(is, src_frame)) < 0)
+        return ret;
+
+    if (!(vp = frame_queue_peek_writable(&is->pictq)))
+        return -1;
+
+    vp->sar = src_frame->sample_aspect_ratio;
+    vp->uploaded = 0;
+
+    /* the display size, the frame may have been downscaled for the window */
+    vp->width = width;
+    vp->height = height;
+    vp->format = src_frame->format;
+
+    vp->pts = pts;
+    vp->duration = duration;
+    vp->pos = pos;
+    vp->serial = serial;
+
+    set_default_window_size(vp->width, vp->height, vp->sar);
+
+    av_frame_move_ref(vp->frame, src_frame);
+    frame_queue_push(&is->pictq);
+    return 0;
+}
+
+static int get_video_frame(FMediaPlayer* is, AVFrame* frame)
+{
+    int got_picture;
+
+    if ((got_picture = decoder_decode_frame(&is->viddec, frame, NULL)) < 0)
+        return -1;
+
+    if (got_picture) {
+        double dpts = NAN;
+
+        if (frame->pts != AV_NOPTS_VALUE)
+            dpts = av_q2d(is->video_st->time_base) * frame->pts;
+
+        frame->sample_aspect_ratio = av_guess_sample_aspect_ratio(is->ic, is->video_st, frame);
+
+        if (framedrop > 0 || (framedrop && get_master_sync_type(is) != AV_SYNC_VIDEO_MASTER)) {
+            if (frame->pts != AV_NOPTS_VALUE) {
+                double diff = dpts - get_master_clock(is);
+                if (!isnan(diff) && fabs(diff) < AV_NOSYNC_THRESHOLD &&
+                    diff - is->frame_last_filter_delay < 0 &&
+                    is->viddec.pkt_serial == is->vidclk.serial &&
+                    packet_queue_nb_packets(&is->videoq)) {
+                    is->frame_drops_early++;
+                    av_frame_unref(frame);
+                    got_picture = 0;
+                }
+            }
+        }
+    }
+
+    return got_picture;
+}
+
+#if CONFIG_AVFILTER
+static int configure_filtergraph(AVFilterGraph* graph, const char* filtergraph,
+    AVFilterContext* source_ctx, AVFilterContext* sink_ctx)
+{
+    int ret, i;
+    int nb_filters = graph->nb_filters;
+    AVFilterInOut* outputs = NULL, * inputs = NULL;
+
+    if (filtergraph) {
+        outputs = avfilter_inout_alloc();
+        inputs = avfilter_inout_alloc();
+        if (!outputs || !inputs) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+
+        outputs->name = av_strdup("in");
+        outputs->filter_ctx = source_ctx;
+        outputs->pad_idx = 0;
+        outputs->next = NULL;
+
+        inputs->name = av_strdup("out");
+        inputs->filter_ctx = sink_ctx;
+        inputs->pad_idx = 0;
+        inputs->next = NULL;
+
+        if ((ret = avfilter_graph_parse_ptr(graph, filtergraph, &inputs, &outputs, NULL)) < 0)
+            goto fail;
+    }
+    else {
+        if ((ret = avfilter_link(source_ctx, 0, sink_ctx, 0)) < 0)
+            goto fail;
+    }
+
+    /* Reorder the filters to ensure that inputs of the custom filters are merged first */
+    for (i = 0; i < graph->nb_filters - nb_filters; i++)
+        FFSWAP(AVFilterContext*, graph->filters[i], graph->filters[i + nb_filters]);
+
+    ret = avfilter_graph_config(graph, NULL);
+fail:
+    avfilter_inout_free(&outputs);
+    avfilter_inout_free(&inputs);
+    return ret;
+}
+
+static int configure_video_filters(AVFilterGraph* graph, VideoState* is, const char* vfilters, AVFrame* frame)
+{
+    enum AVPixelFormat pix_fmts[FF_ARRAY_ELEMS(sdl_texture_format_map) + FF_ARRAY_ELEMS(repack_format_map)];
+    char sws_flags_str[512] = "";
+    char buffersrc_args[256];
+    int ret;
+    AVFilterContext* filt_src = NULL, * filt_out = NULL, * last_filter = NULL;
+    AVCodecParameters* codecpar = is->video_st->codecpar;
+    AVRational fr = av_guess_frame_rate(is->ic, is->video_st, NULL);
+    AVDictionaryEntry* e = NULL;
+    int nb_pix_fmts = 0;
+    int i, j;
+
+    for (i = 0; i < renderer_info.num_texture_formats; i++) {
+        for (j = 0; j < FF_ARRAY_ELEMS(sdl_texture_format_map) - 1; j++) {
+            if (renderer_info.texture_formats[i] == sdl_texture_format_map[j].texture_fmt) {
+                pix_fmts[nb_pix_fmts++] = sdl_texture_format_map[j].format;
+                break;
+            }
+        }
+    }
+    /* let formats through that the video thread can repack to a supported one */
+    if (decoder_convert) {
+        int nb_texture_fmts = nb_pix_fmts;
+        for (i = 0; i < FF_ARRAY_ELEMS(repack_format_map) - 1; i++) {
+            if (!*repack_format_map[i].enabled)
+                continue;
+            for (j = 0; j < nb_texture_fmts; j++)
+                if (pix_fmts[j] == repack_format_map[i].format_out) {
+                    pix_fmts[nb_pix_fmts++] = repack_format_map[i].format;
+                    break;
+                }
+        }
+    }
+    pix_fmts[nb_pix_fmts] = AV_PIX_FMT_NONE;
+
+    while ((e = av_dict_get(sws_dict, "", e, AV_DICT_IGNORE_SUFFIX))) {
+        if (!strcmp(e->key, "sws_flags")) {
+            av_strlcatf(sws_flags_str, sizeof(sws_flags_str), "%s=%s:", "flags", e->value);
+        }
+        else
+            av_strlcatf(sws_flags_str, sizeof(sws_flags_str), "%s=%s:", e->key, e->value);
+    }
+    if (strlen(sws_flags_str))
+        sws_flags_str[strlen(sws_flags_str) - 1] = '\0';
+
+    graph->scale_sws_opts = av_strdup(sws_flags_str);
+
+    snprintf(buffersrc_args, sizeof(buffersrc_args),
+        "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
+        frame->width, frame->height, frame->format,
+        is->video_st->time_base.num, is->video_st->time_base.den,
+        codecpar->sample_aspect_ratio.num, FFMAX(codecpar->sample_aspect_ratio.den, 1));
+    if (fr.num && fr.den)
+        av_strlcatf(buffersrc_args, sizeof(buffersrc_args), ":frame_rate=%d/%d", fr.num, fr.den);
+
+    if ((ret = avfilter_graph_create_filter(&filt_src,
+        avfilter_get_by_name("buffer"),
+        "ffplay_buffer", buffersrc_args, NULL,
+        graph)) < 0)
+        goto fail;
+
+    ret = avfilter_graph_create_filter(&filt_out,
+        avfilter_get_by_name("buffersink"),
+        "ffplay_buffersink", NULL, NULL, graph);
+    if (ret < 0)
+        goto fail;
+
+    if ((ret = av_opt_set_int_list(filt_out, "pix_fmts", pix_fmts, AV_PIX_FMT_NONE, AV_OPT_SEARCH_CHILDREN)) < 0)
+        goto fail;
+
+    last_filter = filt_out;
+
+    /* Note: this macro adds a filter before the lastly added filter, so the
+     * processing order of the filters is in reverse */
+#define INSERT_FILT(name, arg) do {                                          \
+    AVFilterContext *filt_ctx;                                               \
+                                                                             \
+    ret = avfilter_graph_create_filter(&filt_ctx,                            \
+                                       avfilter_get_by_name(name),           \
+                                       "ffplay_" name, arg, NULL, graph);    \
+    if (ret < 0)                                                             \
+        goto fail;                                                           \
+                                                                             \
+    ret = avfilter_link(filt_ctx, 0, last_filter, 0);                        \
+    if (ret < 0)                                                             \
+        goto fail;                                                           \
+                                                                             \
+    last_filter = filt_ctx;                                                  \
+} while (0)
+
+    if (autorotate) {
+        double theta = get_rotation(is->video_st);
+
+        if (fabs(theta - 90) < 1.0) {
+            INSERT_FILT("transpose", "clock");
+        }
+        else if (fabs(theta - 180) < 1.0) {
+            INSERT_FILT("hflip", NULL);
+            INSERT_FILT("vflip", NULL);
+        }
+        else if (fabs(theta - 270) < 1.0) {
+            INSERT_FILT("transpose", "cclock");
+        }
+        else if (fabs(theta) > 1.0) {
+            char rotate_buf[64];
+            snprintf(rotate_buf, sizeof(rotate_buf), "%f*PI/180", theta);
+            INSERT_FILT("rotate", rotate_buf);
+        }
+    }
+
+    if ((ret = configure_filtergraph(graph, vfilters, filt_src, last_filter)) < 0)
+        goto fail;
+
+    is->in_video_filter = filt_src;
+    is->out_video_filter = filt_out;
+
+fail:
+    return ret;
+}
+
+static int configure_audio_filters(VideoState* is, const char* afilters, int force_output_format)
+{
+    static const enum AVSampleFormat sample_fmts[] = { AV_SAMPLE_FMT_S16, AV_SAMPLE_FMT_NONE };
+    int sample_rates[2] = { 0, -1 };
+    int64_t channel_layouts[2] = { 0, -1 };
+    int channels[2] = { 0, -1 };
+    AVFilterContext* filt_asrc = NULL, * filt_asink = NULL;
+    char aresample_swr_opts[512] = "";
+    AVDictionaryEntry* e = NULL;
+    char asrc_args[256];
+    int ret;
+
+    avfilter_graph_free(&is->agraph);
+    if (!(is->agraph = avfilter_graph_alloc()))
+        return AVERROR(ENOMEM);
+    is->agraph->nb_threads = filter_nbthreads;
+
+    while ((e = av_dict_get(swr_opts, "", e, AV_DICT_IGNORE_SUFFIX)))
+        av_strlcatf(aresample_swr_opts, sizeof(aresample_swr_opts), "%s=%s:", e->key, e->value);
+    if (strlen(aresample_swr_opts))
+        aresample_swr_opts[strlen(aresample_swr_opts) - 1] = '\0';
+    av_opt_set(is->agraph, "aresample_swr_opts", aresample_swr_opts, 0);
+
+    ret = snprintf(asrc_args, sizeof(asrc_args),
+        "sample_rate=%d:sample_fmt=%s:channels=%d:time_base=%d/%d",
+        is->audio_filter_src.freq, av_get_sample_fmt_name(is->audio_filter_src.fmt),
+        is->audio_filter_src.channels,
+        1, is->audio_filter_src.freq);
+    if (is->audio_filter_src.channel_layout)
+        snprintf(asrc_args + ret, sizeof(asrc_args) - ret,
+            ":channel_layout=0x%"PRIx64, is->audio_filter_src.channel_layout);
+
+    ret = avfilter_graph_create_filter(&filt_asrc,
+        avfilter_get_by_name("abuffer"), "ffplay_abuffer",
+        asrc_args, NULL, is->agraph);
+    if (ret < 0)
+        goto end;
+
+
+    ret = avfilter_graph_create_filter(&filt_asink,
+        avfilter_get_by_name("abuffersink"), "ffplay_abuffersink",
+        NULL, NULL, is->agraph);
+    if (ret < 0)
+        goto end;
+
+    if ((ret = av_opt_set_int_list(filt_asink, "sample_fmts", sample_fmts, AV_SAMPLE_FMT_NONE, AV_OPT_SEARCH_CHILDREN)) < 0)
+        goto end;
+    if ((ret = av_opt_set_int(filt_asink, "all_channel_counts", 1, AV_OPT_SEARCH_CHILDREN)) < 0)
+        goto end;
+
+    if (force_output_format) {
+        channel_layouts[0] = is->audio_tgt.channel_layout;
+        channels[0] = is->audio_tgt.channels;
+        sample_rates[0] = is->audio_tgt.freq;
+        if ((ret = av_opt_set_int(filt_asink, "all_channel_counts", 0, AV_OPT_SEARCH_CHILDREN)) < 0)
+            goto end;
+        if ((ret = av_opt_set_int_list(filt_asink, "channel_layouts", channel_layouts, -1, AV_OPT_SEARCH_CHILDREN)) < 0)
+            goto end;
+        if ((ret = av_opt_set_int_list(filt_asink, "channel_counts", channels, -1, AV_OPT_SEARCH_CHILDREN)) < 0)
+            goto end;
+        if ((ret = av_opt_set_int_list(filt_asink, "sample_rates", sample_rates, -1, AV_OPT_SEARCH_CHILDREN)) < 0)
+            goto end;
+    }
+
+
+    if ((ret = configure_filtergraph(is->agraph, afilters, filt_asrc, filt_asink)) < 0)
+        goto end;
+
+    is->in_audio_filter = filt_asrc;
+    is->out_audio_filter = filt_asink;
+
+end:
+    if (ret < 0)
+        avfilter_graph_free(&is->agraph);
+    return ret;
+}
+#endif  /* CONFIG_AVFILTER */
+
+static int audio_thread(void* pUserData)
+{
+    FMediaPlayer* is = static_cast<FMediaPlayer*>(pUserData);
+    AVFrame* frame = av_frame_alloc();
+    AudioFrame* af;
+#if CONFIG_AVFILTER
+    int last_serial = -1;
+    int64_t dec_channel_layout;
+    int reconfigure;
+#endif
+    int got_frame = 0;
+    AVRational tb;
+    int ret = 0;
+
+    if (!frame)
+        return AVERROR(ENOMEM);
+
+    do {
+        if ((got_frame = decoder_decode_frame(&is->auddec, frame, NULL)) < 0)
+            goto the_end;
+
+        if (got_frame) {
+            tb = AVRational{ 1, frame->sample_rate };
+
+#if CONFIG_AVFILTER
+            dec_channel_layout = get_valid_channel_layout(frame->channel_layout, frame->channels);
+
+            reconfigure =
+                cmp_audio_fmts(is->audio_filter_src.fmt, is->audio_filter_src.channels,
+                    frame->format, frame->channels) ||
+                is->audio_filter_src.channel_layout != dec_channel_layout ||
+                is->audio_filter_src.freq != frame->sample_rate ||
+                is->auddec.pkt_serial != last_serial;
+
+            if (reconfigure) {
+                char buf1[1024], buf2[1024];
+                av_get_channel_layout_string(buf1, sizeof(buf1), -1, is->audio_filter_src.channel_layout);
+                av_get_channel_layout_string(buf2, sizeof(buf2), -1, dec_channel_layout);
+                av_log(NULL, AV_LOG_DEBUG,
+                    "Audio frame changed from rate:%d ch:%d fmt:%s layout:%s serial:%d to rate:%d ch:%d fmt:%s layout:%s serial:%d\n",
+                    is->audio_filter_src.freq, is->audio_filter_src.channels, av_get_sample_fmt_name(is->audio_filter_src.fmt), buf1, last_serial,
+                    frame->sample_rate, frame->channels, av_get_sample_fmt_name(frame->format), buf2, is->auddec.pkt_serial);
+
+                is->audio_filter_src.fmt = frame->format;
+                is->audio_filter_src.channels = frame->channels;
+                is->audio_filter_src.channel_layout = dec_channel_layout;
+                is->audio_filter_src.freq = frame->sample_rate;
+                last_serial = is->auddec.pkt_serial;
+
+                if ((ret = configure_audio_filters(is, afilters, 1)) < 0)
+                    goto the_end;
+            }
+
+            if ((ret = av_buffersrc_add_frame(is->in_audio_filter, frame)) < 0)
+                goto the_end;
+
+            while ((ret = av_buffersink_get_frame_flags(is->out_audio_filter, frame, 0)) >= 0) {
+                tb = av_buffersink_get_time_base(is->out_audio_filter);
+#endif
+                if (!(af = frame_queue_peek_writable(&is->sampq)))
+                    goto the_end;
+
+                af->pts = (frame->pts == AV_NOPTS_VALUE) ? NAN : frame->pts * av_q2d(tb);
+                af->pos = frame->pkt_pos;
+                af->serial = is->auddec.pkt_serial;
+                af->duration = av_q2d(AVRational { frame->nb_samples, frame->sample_rate });
+
+                av_frame_move_ref(af->frame, frame);
+                frame_queue_push(&is->sampq);
+
+#if CONFIG_AVFILTER
+                if (is->audioq.serial != is->auddec.pkt_serial)
+                    break;
+            }
+            if (ret == AVERROR_EOF)
+                is->auddec.finished = is->auddec.pkt_serial;
+#endif
+        }
+    } while (ret >= 0 || ret == AVERROR(EAGAIN) || ret == AVERROR_EOF);
+the_end:
+#if CONFIG_AVFILTER
+    avfilter_graph_free(&is->agraph);
+#endif
+    av_frame_free(&frame);
+    return ret;
+}
+
+static int decoder_start(Decoder* d, int (*fn)(void*), const char* thread_name, void* arg)
+{
+    packet_queue_start(d->queue);
+    d->decoder_tid = SDL_CreateThread(fn, thread_name, arg);
+    if (!d->decoder_tid) {
+        av_log(NULL, AV_LOG_ERROR, "SDL_CreateThread(): %s\n", SDL_GetError());
+        return AVERROR(ENOMEM);
+    }
+    return 0;
+}
+
+static int video_thread(void* pUserData)
+{
+    FMediaPlayer* is = static_cast<FMediaPlayer*>(pUserData);
+    AVFrame* frame = av_frame_alloc();
+    double pts;
+    double duration;
+    int ret;
+    AVRational tb = is->video_st->time_base;
+    AVRational frame_rate = av_guess_frame_rate(is->ic, is->video_st, NULL);
+
+#if CONFIG_AVFILTER
+    AVFilterGraph* graph = NULL;
+    AVFilterContext* filt_out = NULL, * filt_in = NULL;
+    int last_w = 0;
+    int last_h = 0;
+    enum AVPixelFormat last_format = -2;
+    int last_serial = -1;
+    int last_vfilter_idx = 0;
+#endif
+
+    if (!frame)
+        return AVERROR(ENOMEM);
+
+    for (;;) {
+        ret = get_video_frame(is, frame);
+        if (ret < 0)
+            goto the_end;
+        if (!ret)
+            continue;
+
+#if CONFIG_AVFILTER
+        if (last_w != frame->width
+            || last_h != frame->height
+            || last_format != frame->format
+            || last_serial != is->viddec.pkt_serial
+            || last_vfilter_idx != is->vfilter_idx) {
+            av_log(NULL, AV_LOG_DEBUG,
+                "Video frame changed from size:%dx%d format:%s serial:%d to size:%dx%d format:%s serial:%d\n",
+                last_w, last_h,
+                (const char*)av_x_if_null(av_get_pix_fmt_name(last_format), "none"), last_serial,
+                frame->width, frame->height,
+                (const char*)av_x_if_null(av_get_pix_fmt_name(frame->format), "none"), is->viddec.pkt_serial);
+            avfilter_graph_free(&graph);
+            graph = avfilter_graph_alloc();
+            if (!graph) {
+                ret = AVERROR(ENOMEM);
+                goto the_end;
+            }
+            graph->nb_threads = filter_nbthreads;
+            if ((ret = configure_video_filters(graph, is, vfilters_list ? vfilters_list[is->vfilter_idx] : NULL, frame)) < 0) {
+                SDL_Event event;
+                event.type = FF_QUIT_EVENT;
+                event.user.data1 = is;
+                SDL_PushEvent(&event);
+                goto the_end;
+            }
+            filt_in = is->in_video_filter;
+            filt_out = is->out_video_filter;
+            last_w = frame->width;
+            last_h = frame->height;
+            last_format = frame->format;
+            last_serial = is->viddec.pkt_serial;
+            last_vfilter_idx = is->vfilter_idx;
+            frame_rate = av_buffersink_get_frame_rate(filt_out);
+        }
+
+        ret = av_buffersrc_add_frame(filt_in, frame);
+        if (ret < 0)
+            goto the_end;
+
+        while (ret >= 0) {
+            is->frame_last_returned_time = av_gettime_relative() / 1000000.0;
+
+            ret = av_buffersink_get_frame_flags(filt_out, frame, 0);
+            if (ret < 0) {
+                if (ret == AVERROR_EOF)
+                    is->viddec.finished = is->viddec.pkt_serial;
+                ret = 0;
+                break;
+            }
+
+            is->frame_last_filter_delay = av_gettime_relative() / 1000000.0 - is->frame_last_returned_time;
+            if (fabs(is->frame_last_filter_delay) > AV_NOSYNC_THRESHOLD / 10.0)
+                is->frame_last_filter_delay = 0;
+            tb = av_buffersink_get_time_base(filt_out);
+#endif
+            duration = (frame_rate.num && frame_rate.den ? av_q2d(AVRational { frame_rate.den, frame_rate.num }) : 0);
+            pts = (frame->pts == AV_NOPTS_VALUE) ? NAN : frame->pts * av_q2d(tb);
+            ret = queue_picture(is, frame, pts, duration, frame->pkt_pos, is->viddec.pkt_serial);
+            av_frame_unref(frame);
+#if CONFIG_AVFILTER
+            if (is->videoq.serial != is->viddec.pkt_serial)
+                break;
+        }
+#endif
+
+        if (ret < 0)
+            goto the_end;
+    }
+the_end:
+#if CONFIG_AVFILTER
+    avfilter_graph_free(&graph);
+#endif
+    av_frame_free(&frame);
+    return 0;
+}
+
+static void expand_pal8_row_c(uint32_t* dst, const uint8_t* src, const uint32_t* pal, int n)
+{
+    int i;
+    for (i = 0; i < n; i++)
+        dst[i] = pal[src[i]];
+}
+
+#if ARCH_X86
+TARGET_AVX2 static void expand_pal8_row_avx2(uint32_t* dst, const uint8_t* src, const uint32_t* pal, int n)
+{
+    int i;
+    for (i = 0; i + 16 <= n; i += 16) {
+        __m128i idx = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_i32gather_epi32((const int*)pal, _mm256_cvtepu8_epi32(idx), 4));
+        _mm256_storeu_si256((__m256i*)(dst + i + 8), _mm256_i32gather_epi32((const int*)pal, _mm256_cvtepu8_epi32(_mm_srli_si128(idx, 8)), 4));
+    }
+    expand_pal8_row_c(dst + i, src + i, pal, n - i);
+}
+#endif
+
+/* Expand the palettized rects to BGRA, the layout of the subtitle texture,
+ * so that the main thread only has to upload them. The palette entries are
+ * native endian ARGB, which is BGRA in memory on little endian hosts like
+ * the texture. */
+static int subtitle_expand_rects(SubtitleFrame* sp)
+{
+    void (*expand_row)(uint32_t* dst, const uint8_t* src, const uint32_t* pal, int n) = expand_pal8_row_c;
+    unsigned i;
+    int y;
+
+#if ARCH_X86
+    if (av_get_cpu_flags() & AV_CPU_FLAG_AVX2)
+        expand_row = expand_pal8_row_avx2;
+#endif
+    if (!sp->sub.num_rects)
+        return 0;
+    if (!(sp->rects = (SubtitleRectPixels*)av_mallocz_array(sp->sub.num_rects, sizeof(*sp->rects))))
+        return AVERROR(ENOMEM);
+    for (i = 0; i < sp->sub.num_rects; i++) {
+        const AVSubtitleRect* sub_rect = sp->sub.rects[i];
+        SubtitleRectPixels* px = &sp->rects[i];
+        if (sub_rect->type != SUBTITLE_BITMAP || sub_rect->w <= 0 || sub_rect->h <= 0 || !sub_rect->data[1])
+            continue;
+        px->linesize = sub_rect->w * 4;
+        if (!(px->data = (uint8_t*)av_malloc_array(sub_rect->h, px->linesize)))
+            return AVERROR(ENOMEM);
+        for (y = 0; y < sub_rect->h; y++)
+            expand_row((uint32_t*)(px->data + y * px->linesize), sub_rect->data[0] + y * sub_rect->linesize[0],
+                (const uint32_t*)sub_rect->data[1], sub_rect->w);
+    }
+    return 0;
+}
+
+/* Printable ASCII in 8x16 cells, one byte per row with the leftmost pixel
+ * in the most significant bit, rasterized from DejaVu Sans Mono (Bitstream
+ * Vera license). */
+static const uint8_t text_sub_font[95][TEXT_SUB_GLYPH_H] = {
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /*   */
+    0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00,  /* ! */
+    0x00, 0x24, 0x24, 0x24, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* " */
+    0x00, 0x12, 0x12, 0x12, 0xff, 0x36, 0x24, 0x6c, 0xff, 0x48, 0x48, 0x48, 0x00, 0x00, 0x00, 0x00,  /* # */
+    0x00, 0x08, 0x3e, 0x6a, 0x48, 0x68, 0x78, 0x1e, 0x0b, 0x0b, 0x4a, 0x7c, 0x08, 0x08, 0x00, 0x00,  /* $ */
+    0x00, 0x60, 0xf0, 0x90, 0x90, 0xf3, 0x1c, 0x66, 0x09, 0x09, 0x09, 0x0e, 0x00, 0x00, 0x00, 0x00,  /* % */
+    0x00, 0x3c, 0x60, 0x60, 0x60, 0x70, 0xd9, 0x89, 0x8d, 0x87, 0xc7, 0x7f, 0x00, 0x00, 0x00, 0x00,  /* & */
+    0x00, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* ' */
+    0x04, 0x0c, 0x08, 0x18, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x18, 0x18, 0x08, 0x0c, 0x00, 0x00,  /* ( */
+    0x20, 0x30, 0x10, 0x18, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x18, 0x18, 0x10, 0x30, 0x00, 0x00,  /* ) */
+    0x00, 0x00, 0x42, 0x3c, 0x3c, 0x66, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* 0x2a */
+    0x00, 0x00, 0x00, 0x18, 0x18, 0x18, 0x18, 0xff, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x00,  /* + */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x10, 0x30, 0x00, 0x00,  /* , */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x3c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* - */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00,  /* . */
+    0x00, 0x02, 0x06, 0x04, 0x0c, 0x08, 0x18, 0x10, 0x30, 0x30, 0x60, 0x60, 0xc0, 0x00, 0x00, 0x00,  /* 0x2f */
+    0x00, 0x3c, 0x66, 0x42, 0xc3, 0xc3, 0xdb, 0xc3, 0xc3, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00,  /* 0 */
+    0x00, 0x78, 0x78, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x1c, 0x7f, 0x00, 0x00, 0x00, 0x00,  /* 1 */
+    0x00, 0x7c, 0x46, 0x02, 0x02, 0x06, 0x0c, 0x18, 0x10, 0x20, 0x60, 0xfe, 0x00, 0x00, 0x00, 0x00,  /* 2 */
+    0x00, 0x7c, 0x06, 0x02, 0x06, 0x1c, 0x1c, 0x06, 0x03, 0x02, 0x86, 0xfc, 0x00, 0x00, 0x00, 0x00,  /* 3 */
+    0x00, 0x0c, 0x0c, 0x14, 0x34, 0x24, 0x44, 0xc4, 0xff, 0x0e, 0x04, 0x04, 0x00, 0x00, 0x00, 0x00,  /* 4 */
+    0x00, 0x7e, 0x60, 0x40, 0x60, 0x7c, 0x06, 0x02, 0x02, 0x02, 0x06, 0xfc, 0x00, 0x00, 0x00, 0x00,  /* 5 */
+    0x00, 0x3e, 0x60, 0x40, 0xc0, 0xfe, 0xe2, 0xc3, 0xc3, 0x43, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00,  /* 6 */
+    0x00, 0xff, 0x06, 0x06, 0x04, 0x0c, 0x0c, 0x08, 0x18, 0x18, 0x30, 0x30, 0x00, 0x00, 0x00, 0x00,  /* 7 */
+    0x00, 0x7e, 0x66, 0x42, 0x42, 0x7e, 0x3c, 0x42, 0xc3, 0xc3, 0x66, 0x7e, 0x00, 0x00, 0x00, 0x00,  /* 8 */
+    0x00, 0x7c, 0x46, 0xc2, 0xc3, 0xc3, 0x67, 0x7f, 0x02, 0x02, 0x06, 0x7c, 0x00, 0x00, 0x00, 0x00,  /* 9 */
+    0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00,  /* : */
+    0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x10, 0x30, 0x00, 0x00,  /* ; */
+    0x00, 0x00, 0x00, 0x00, 0x07, 0x1c, 0xf0, 0xe0, 0x38, 0x0f, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,  /* < */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* = */
+    0x00, 0x00, 0x00, 0x00, 0xe0, 0x38, 0x0f, 0x07, 0x1c, 0xf0, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00,  /* > */
+    0x00, 0x7e, 0x46, 0x02, 0x06, 0x0c, 0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00,  /* ? */
+    0x00, 0x00, 0x3e, 0x43, 0xc1, 0x9f, 0x91, 0xb1, 0xb1, 0x93, 0x9f, 0xc0, 0x60, 0x3e, 0x00, 0x00,  /* @ */
+    0x00, 0x18, 0x18, 0x3c, 0x24, 0x24, 0x66, 0x66, 0x7e, 0xc3, 0xc3, 0x81, 0x00, 0x00, 0x00, 0x00,  /* A */
+    0x00, 0x7c, 0x46, 0x43, 0x42, 0x7e, 0x7e, 0x43, 0x43, 0x43, 0x47, 0x7e, 0x00, 0x00, 0x00, 0x00,  /* B */
+    0x00, 0x3e, 0x60, 0x60, 0x40, 0xc0, 0xc0, 0xc0, 0x40, 0x60, 0x60, 0x3e, 0x00, 0x00, 0x00, 0x00,  /* C */
+    0x00, 0xfc, 0xce, 0xc6, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xc6, 0xce, 0xf8, 0x00, 0x00, 0x00, 0x00,  /* D */
+    0x00, 0x7f, 0x60, 0x40, 0x40, 0x7e, 0x7e, 0x40, 0x40, 0x40, 0x60, 0x7f, 0x00, 0x00, 0x00, 0x00,  /* E */
+    0x00, 0x7f, 0x60, 0x60, 0x60, 0x7e, 0x7e, 0x60, 0x60, 0x60, 0x60, 0x60, 0x00, 0x00, 0x00, 0x00,  /* F */
+    0x00, 0x3e, 0x62, 0x40, 0xc0, 0xc0, 0xc7, 0xc7, 0xc3, 0x43, 0x63, 0x3e, 0x00, 0x00, 0x00, 0x00,  /* G */
+    0x00, 0xc3, 0xc3, 0xc3, 0xc3, 0xff, 0xff, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0x00, 0x00, 0x00, 0x00,  /* H */
+    0x00, 0x7e, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x7e, 0x00, 0x00, 0x00, 0x00,  /* I */
+    0x00, 0x3e, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x06, 0x8c, 0xfc, 0x00, 0x00, 0x00, 0x00,  /* J */
+    0x00, 0xc3, 0xc6, 0xcc, 0xd8, 0xf0, 0xf8, 0xcc, 0xcc, 0xc6, 0xc3, 0xc3, 0x00, 0x00, 0x00, 0x00,  /* K */
+    0x00, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x7f, 0x00, 0x00, 0x00, 0x00,  /* L */
+    0x00, 0xc3, 0xe7, 0xe7, 0xa7, 0xbf, 0x9b, 0x9b, 0x83, 0x83, 0x83, 0x83, 0x00, 0x00, 0x00, 0x00,  /* M */
+    0x00, 0xe3, 0xe3, 0xf3, 0xf3, 0xd3, 0xdb, 0xcb, 0xcf, 0xc7, 0xc7, 0xc7, 0x00, 0x00, 0x00, 0x00,  /* N */
+    0x00, 0x3c, 0x66, 0x42, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00,  /* O */
+    0x00, 0x7e, 0x67, 0x43, 0x43, 0x43, 0x7e, 0x78, 0x40, 0x40, 0x40, 0x40, 0x00, 0x00, 0x00, 0x00,  /* P */
+    0x00, 0x3c, 0x66, 0x42, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0x42, 0x66, 0x3c, 0x0c, 0x06, 0x00, 0x00,  /* Q */
+    0x00, 0xfc, 0xc6, 0xc2, 0xc2, 0xc6, 0xfc, 0xcc, 0xc6, 0xc2, 0xc3, 0xc1, 0x00, 0x00, 0x00, 0x00,  /* R */
+    0x00, 0x7e, 0x62, 0xc0, 0xc0, 0x70, 0x3e, 0x06, 0x03, 0x03, 0x46, 0x7c, 0x00, 0x00, 0x00, 0x00,  /* S */
+    0x00, 0xff, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00,  /* T */
+    0x00, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0xc3, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00,  /* U */
+    0x00, 0xc3, 0xc3, 0x42, 0x42, 0x66, 0x66, 0x24, 0x24, 0x3c, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00,  /* V */
+    0x00, 0x81, 0x81, 0x81, 0x99, 0xdb, 0xdb, 0xff, 0xe7, 0x66, 0x66, 0x66, 0x00, 0x00, 0x00, 0x00,  /* W */
+    0x00, 0xc3, 0x62, 0x26, 0x3c, 0x18, 0x18, 0x3c, 0x24, 0x66, 0xc3, 0xc3, 0x00, 0x00, 0x00, 0x00,  /* X */
+    0x00, 0xc3, 0x42, 0x66, 0x24, 0x3c, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00,  /* Y */
+    0x00, 0x7f, 0x03, 0x06, 0x04, 0x0c, 0x18, 0x10, 0x30, 0x60, 0x60, 0x7f, 0x00, 0x00, 0x00, 0x00,  /* Z */
+    0x1c, 0x1c, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1c, 0x00, 0x00,  /* [ */
+    0x00, 0xc0, 0x40, 0x60, 0x20, 0x30, 0x10, 0x18, 0x08, 0x0c, 0x04, 0x06, 0x02, 0x00, 0x00, 0x00,  /* 0x5c */
+    0x38, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x38, 0x00, 0x00,  /* ] */
+    0x00, 0x18, 0x3c, 0x66, 0xc3, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* ^ */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff,  /* _ */
+    0x30, 0x10, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* ` */
+    0x00, 0x00, 0x00, 0x38, 0x7e, 0x02, 0x02, 0x7e, 0x42, 0xc2, 0xc6, 0x7e, 0x00, 0x00, 0x00, 0x00,  /* a */
+    0x40, 0x40, 0x40, 0x48, 0x7e, 0x62, 0x43, 0x43, 0x43, 0x63, 0x66, 0x7c, 0x00, 0x00, 0x00, 0x00,  /* b */
+    0x00, 0x00, 0x00, 0x0c, 0x3e, 0x60, 0x60, 0x40, 0x40, 0x60, 0x60, 0x3e, 0x00, 0x00, 0x00, 0x00,  /* c */
+    0x02, 0x02, 0x02, 0x12, 0x7e, 0x46, 0xc2, 0xc2, 0xc2, 0xc2, 0x66, 0x3e, 0x00, 0x00, 0x00, 0x00,  /* d */
+    0x00, 0x00, 0x00, 0x18, 0x7e, 0x42, 0xc3, 0xff, 0xc0, 0xc0, 0x60, 0x3e, 0x00, 0x00, 0x00, 0x00,  /* e */
+    0x06, 0x1e, 0x18, 0x18, 0x7e, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00, 0x00, 0x00, 0x00,  /* f */
+    0x00, 0x00, 0x00, 0x10, 0x7e, 0x46, 0xc2, 0xc2, 0xc2, 0xc6, 0x66, 0x3e, 0x02, 0x06, 0x7c, 0x00,  /* g */
+    0x40, 0x40, 0x40, 0x4c, 0x7e, 0x62, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00, 0x00,  /* h */
+    0x08, 0x18, 0x00, 0x00, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x7f, 0x00, 0x00, 0x00, 0x00,  /* i */
+    0x08, 0x08, 0x00, 0x00, 0x38, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x08, 0x18, 0x78, 0x00,  /* j */
+    0x40, 0x60, 0x60, 0x60, 0x66, 0x6c, 0x78, 0x78, 0x6c, 0x66, 0x62, 0x63, 0x00, 0x00, 0x00, 0x00,  /* k */
+    0x70, 0x30, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x18, 0x0e, 0x00, 0x00, 0x00, 0x00,  /* l */
+    0x00, 0x00, 0x00, 0x36, 0xff, 0xdb, 0xd9, 0xd9, 0xd9, 0xd9, 0xd9, 0xd9, 0x00, 0x00, 0x00, 0x00,  /* m */
+    0x00, 0x00, 0x00, 0x0c, 0x7e, 0x62, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x00, 0x00, 0x00, 0x00,  /* n */
+    0x00, 0x00, 0x00, 0x18, 0x7e, 0x42, 0xc3, 0xc3, 0xc3, 0x42, 0x66, 0x3c, 0x00, 0x00, 0x00, 0x00,  /* o */
+    0x00, 0x00, 0x00, 0x08, 0x7e, 0x62, 0x43, 0x43, 0x43, 0x43, 0x66, 0x7c, 0x40, 0x40, 0x40, 0x00,  /* p */
+    0x00, 0x00, 0x00, 0x10, 0x7e, 0x46, 0xc2, 0xc2, 0xc2, 0x42, 0x66, 0x3e, 0x02, 0x02, 0x02, 0x00,  /* q */
+    0x00, 0x00, 0x00, 0x06, 0x3f, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x30, 0x00, 0x00, 0x00, 0x00,  /* r */
+    0x00, 0x00, 0x00, 0x1c, 0x7e, 0x60, 0x60, 0x3c, 0x0e, 0x02, 0x46, 0x7c, 0x00, 0x00, 0x00, 0x00,  /* s */
+    0x00, 0x10, 0x10, 0x30, 0xfe, 0x10, 0x10, 0x10, 0x10, 0x10, 0x18, 0x1e, 0x00, 0x00, 0x00, 0x00,  /* t */
+    0x00, 0x00, 0x00, 0x00, 0x42, 0x42, 0x42, 0x42, 0x42, 0x42, 0x66, 0x3e, 0x00, 0x00, 0x00, 0x00,  /* u */
+    0x00, 0x00, 0x00, 0x00, 0xc3, 0x42, 0x66, 0x66, 0x24, 0x3c, 0x3c, 0x18, 0x00, 0x00, 0x00, 0x00,  /* v */
+    0x00, 0x00, 0x00, 0x00, 0x81, 0x81, 0x99, 0xdb, 0xdb, 0x66, 0x66, 0x66, 0x00, 0x00, 0x00, 0x00,  /* w */
+    0x00, 0x00, 0x00, 0x00, 0x46, 0x24, 0x3c, 0x18, 0x18, 0x24, 0x66, 0xc3, 0x00, 0x00, 0x00, 0x00,  /* x */
+    0x00, 0x00, 0x00, 0x00, 0xc3, 0x42, 0x66, 0x26, 0x34, 0x3c, 0x18, 0x18, 0x18, 0x10, 0x70, 0x00,  /* y */
+    0x00, 0x00, 0x00, 0x00, 0x7e, 0x06, 0x0c, 0x18, 0x10, 0x30, 0x60, 0x7e, 0x00, 0x00, 0x00, 0x00,  /* z */
+    0x06, 0x0e, 0x18, 0x18, 0x18, 0x18, 0x18, 0x70, 0x18, 0x18, 0x18, 0x18, 0x18, 0x0e, 0x06, 0x00,  /* { */
+    0x00, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00,  /* | */
+    0x60, 0x70, 0x18, 0x18, 0x18, 0x18, 0x18, 0x0e, 0x18, 0x18, 0x18, 0x18, 0x18, 0x70, 0x60, 0x00,  /* } */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x71, 0xff, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,  /* ~ */
+};
+
+/* transparent, outline, text */
+static const uint32_t text_sub_palette[3] = { 0x00000000, 0xFF000000, 0xFFFFFFFF };
+
+static void text_sub_uninit(TextSubRenderer* tr)
+{
+    int i;
+    for (i = 0; i < TEXT_SUB_CACHE_SIZE; i++) {
+        av_free(tr->cache[i].text);
+        av_free(tr->cache[i].bitmap);
+    }
+    av_free(tr->atlas);
+    memset(tr, 0, sizeof(*tr));
+}
+
+/* Scale every glyph into its atlas cell and surround it with an outline */
+static int text_sub_build_atlas(TextSubRenderer* tr, int scale)
+{
+    int o = FFMAX(1, scale / 2), cell_w = TEXT_SUB_GLYPH_W * scale + 2 * o, cell_h = TEXT_SUB_GLYPH_H * scale + 2 * o;
+    int g, x, y, dx, dy;
+    uint8_t* atlas;
+
+    if (!(atlas = (uint8_t*)av_mallocz_array(95 * cell_w, cell_h)))
+        return AVERROR(ENOMEM);
+    av_free(tr->atlas);
+    tr->atlas = atlas;
+    tr->atlas_linesize = 95 * cell_w;
+    tr->scale = scale;
+    tr->outline = o;
+    tr->cell_w = cell_w;
+    tr->cell_h = cell_h;
+
+    for (g = 0; g < 95; g++) {
+        uint8_t* cell = atlas + g * cell_w;
+        for (y = 0; y < TEXT_SUB_GLYPH_H * scale; y++)
+            for (x = 0; x < TEXT_SUB_GLYPH_W * scale; x++)
+                if (text_sub_font[g][y / scale] & (0x80 >> (x / scale)))
+                    cell[(y + o) * tr->atlas_linesize + x + o] = 2;
+        for (y = 0; y < cell_h; y++)
+            for (x = 0; x < cell_w; x++) {
+                if (cell[y * tr->atlas_linesize + x] != 2)
+                    continue;
+                for (dy = FFMAX(y - o, 0); dy <= FFMIN(y + o, cell_h - 1); dy++)
+                    for (dx = FFMAX(x - o, 0); dx <= FFMIN(x + o, cell_w - 1); dx++)
+                        if (!cell[dy * tr->atlas_linesize + dx])
+                            cell[dy * tr->atlas_linesize + dx] = 1;
+            }
+    }
+    return 0;
+}
+
+static int text_sub_putc(char** buf, int* len, int* size, char c)
+{
+    if (*len + 2 > *size) {
+        int new_size = FFMAX(*size * 2, 256);
+        char* tmp = (char*)av_realloc(*buf, new_size);
+        if (!tmp)
+            return AVERROR(ENOMEM);
+        *buf = tmp;
+        *size = new_size;
+    }
+    (*buf)[(*len)++] = c;
+    (*buf)[*len] = 0;
+    return 0;
+}
+
+/* Append the plain text of a rect to buf: the fields before the text of an
+ * ASS event and the {} override blocks are dropped, \N and \n become line
+ * breaks and \h a space. Characters outside printable ASCII are mapped to
+ * '?', one per code point. */
+static int text_sub_strip(char** buf, int* len, int* size, const AVSubtitleRect* rect)
+{
+    const char* p = rect->type == SUBTITLE_ASS ? rect->ass : rect->text;
+    int fields = 0, skip = 0, ret;
+
+    if (!p)
+        return 0;
+    if (rect->type == SUBTITLE_ASS) {
+        /* "ReadOrder,Layer,Style,Name,MarginL,MarginR,MarginV,Effect,Text",
+         * older decoders emit the whole "Dialogue:" line with one more field */
+        fields = av_strstart(p, "Dialogue:", NULL) ? 9 : 8;
+        for (; *p && fields; p++)
+            if (*p == ',')
+                fields--;
+    }
+    for (; *p; p++) {
+        char c = *p;
+        if (skip) {
+            skip = c != '}';
+            continue;
+        }
+        if (c == '{' && rect->type == SUBTITLE_ASS) {
+            skip = 1;
+            continue;
+        }
+        if (c == '\\' && (p[1] == 'N' || p[1] == 'n' || p[1] == 'h')) {
+            c = p[1] == 'h' ? ' ' : '\n';
+            p++;
+        }
+        else if (c == '\r')
+            continue;
+        else if ((uint8_t)c >= 0x80) {
+            /* continuation bytes belong to the '?' of their lead byte */
+            if ((uint8_t)c < 0xC0)
+                continue;
+            c = '?';
+        }
+        else if (c != '\n' && (c < 32 || c > 126))
+            c = ' ';
+        if ((ret = text_sub_putc(buf, len, size, c)) < 0)
+            return ret;
+    }
+    return 0;
+}
+
+/* Greedy word wrap of text to lines of at most max_cols characters, as
+ * offsets and lengths into text. Returns the number of lines. */
+static int text_sub_wrap(const char* text, int max_cols, int* starts, int* lens, int max_lines)
+{
+    int nb = 0, pos = 0, len = (int)strlen(text);
+
+    while (pos < len && nb < max_lines) {
+        int end = pos, brk = -1;
+        while (end < len && text[end] != '\n' && end - pos < max_cols) {
+            if (text[end] == ' ')
+                brk = end;
+            end++;
+        }
+        if (end < len && text[end] != '\n' && brk > pos)
+            end = brk;
+        starts[nb] = pos;
+        lens[nb++] = end - pos;
+        pos = end;
+        if (pos < len && (text[pos] == '\n' || text[pos] == ' '))
+            pos++;
+    }
+    return nb;
+}
+
+/* Compose the event from atlas cells, centered near the bottom of the canvas */
+static int text_sub_rasterize(TextSubRenderer* tr, TextSubCacheEntry* e, const char* text)
+{
+    int starts[16], lens[16];
+    int advance = TEXT_SUB_GLYPH_W * tr->scale, line_h = (TEXT_SUB_GLYPH_H + 2) * tr->scale;
+    int max_cols = FFMAX(e->canvas_w * 9 / 10 / advance, 1);
+    int nb_lines, cols = 0, i, j, x, y;
+
+    nb_lines = text_sub_wrap(text, max_cols, starts, lens, FFMIN(FF_ARRAY_ELEMS(starts), FFMAX(e->canvas_h / line_h, 1)));
+    for (i = 0; i < nb_lines; i++)
+        cols = FFMAX(cols, lens[i]);
+    e->w = cols * advance + 2 * tr->outline;
+    e->h = (nb_lines - 1) * line_h + tr->cell_h;
+    if (!(e->bitmap = (uint8_t*)av_mallocz_array(e->w, e->h)))
+        return AVERROR(ENOMEM);
+    for (i = 0; i < nb_lines; i++) {
+        int x0 = (cols - lens[i]) * advance / 2;
+        for (j = 0; j < lens[i]; j++) {
+            const uint8_t* cell = tr->atlas + (text[starts[i] + j] - 32) * tr->cell_w;
+            uint8_t* dst = e->bitmap + i * line_h * e->w + x0 + j * advance;
+            /* cells overlap by the outline, the text wins over the outline of a neighbour */
+            for (y = 0; y < tr->cell_h; y++)
+                for (x = 0; x < tr->cell_w; x++)
+                    dst[y * e->w + x] = FFMAX(dst[y * e->w + x], cell[y * tr->atlas_linesize + x]);
+        }
+    }
+    e->x = FFMAX((e->canvas_w - e->w) / 2, 0);
+    e->y = FFMAX(e->canvas_h - e->h - e->canvas_h / 20, 0);
+    return 0;
+}
+
+static uint32_t text_sub_hash(const char* text)
+{
+    uint32_t h = 2166136261u;
+    for (; *text; text++)
+        h = (h ^ (uint8_t)*text) * 16777619u;
+    return h;
+}
+
+/* Replace the text rects of sub with a bitmap rect of their rasterized text,
+ * or with no rect when there is nothing to show. */
+static int text_sub_render(TextSubRenderer* tr, AVSubtitle* sub, int canvas_w, int canvas_h)
+{
+    uint32_t start_display_time = sub->start_display_time, end_display_time = sub->end_display_time;
+    int64_t pts = sub->pts;
+    TextSubCacheEntry* e = NULL;
+    AVSubtitleRect* rect;
+    char* text = NULL;
+    int len = 0, size = 0, scale, i, ret = 0;
+
+    for (i = 0; i < (int)sub->num_rects; i++) {
+        if (sub->rects[i]->type != SUBTITLE_TEXT && sub->rects[i]->type != SUBTITLE_ASS)
+            continue;
+        if (len && text[len - 1] != '\n' && (ret = text_sub_putc(&text, &len, &size, '\n')) < 0)
+            goto end;
+        if ((ret = text_sub_strip(&text, &len, &size, sub->rects[i])) < 0)
+            goto end;
+    }
+    while (len && (text[len - 1] == '\n' || text[len - 1] == ' '))
+        text[--len] = 0;
+
+    if (len) {
+        uint32_t hash = text_sub_hash(text);
+        /* about 18 lines of text on the canvas */
+        scale = av_clip((canvas_h + 9 * TEXT_SUB_GLYPH_H) / (18 * TEXT_SUB_GLYPH_H), 1, 8);
+        if (scale != tr->scale) {
+            for (i = 0; i < TEXT_SUB_CACHE_SIZE; i++) {
+                av_freep(&tr->cache[i].text);
+                av_freep(&tr->cache[i].bitmap);
+            }
+            if ((ret = text_sub_build_atlas(tr, scale)) < 0)
+                goto end;
+        }
+        for (i = 0; i < TEXT_SUB_CACHE_SIZE && !e; i++) {
+            TextSubCacheEntry* c = &tr->cache[i];
+            if (c->text && c->hash == hash && c->canvas_w == canvas_w && c->canvas_h == canvas_h && !strcmp(c->text, text))
+                e = c;
+        }
+        if (!e) {
+            e = &tr->cache[0];
+            for (i = 1; i < TEXT_SUB_CACHE_SIZE && e->text; i++)
+                if (!tr->cache[i].text || tr->cache[i].last_used < e->last_used)
+                    e = &tr->cache[i];
+            av_freep(&e->text);
+            av_freep(&e->bitmap);
+            e->hash = hash;
+            e->canvas_w = canvas_w;
+            e->canvas_h = canvas_h;
+            if ((ret = text_sub_rasterize(tr, e, text)) < 0)
+                goto end;
+            e->text = text;
+            text = NULL;
+        }
+        e->last_used = ++tr->use_count;
+    }
+
+    avsubtitle_free(sub);
+    sub->format = 0;
+    sub->start_display_time = start_display_time;
+    sub->end_display_time = end_display_time;
+    sub->pts = pts;
+    if (!e)
+        goto end;
+    if (!(sub->rects = (AVSubtitleRect**)av_mallocz(sizeof(*sub->rects))) ||
+        !(sub->rects[0] = (AVSubtitleRect*)av_mallocz(sizeof(*sub->rects[0])))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    sub->num_rects = 1;
+    rect = sub->rects[0];
+    rect->type = SUBTITLE_BITMAP;
+    rect->x = e->x;
+    rect->y = e->y;
+    rect->w = e->w;
+    rect->h = e->h;
+    rect->nb_colors = FF_ARRAY_ELEMS(text_sub_palette);
+    rect->linesize[0] = e->w;
+    if (!(rect->data[0] = (uint8_t*)av_memdup(e->bitmap, e->w * e->h)) ||
+        !(rect->data[1] = (uint8_t*)av_mallocz(AVPALETTE_SIZE))) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    memcpy(rect->data[1], text_sub_palette, sizeof(text_sub_palette));
+end:
+    av_free(text);
+    return ret;
+}
+
+static int subtitle_thread(void* pUserData)
+{
+    FMediaPlayer* is = static_cast<FMediaPlayer*>(pUserData);
+    SubtitleFrame* sp;
+    int got_subtitle, text, canvas_w, canvas_h;
+    double pts;
+
+    for (;;) {
+        if (!(sp = frame_queue_peek_writable(&is->subpq)))
+            return 0;
+
+        if ((got_subtitle = decoder_decode_frame(&is->subdec, NULL, &sp->sub)) < 0)
+            break;
+
+        pts = 0;
+        text = 0;
+
+        if (got_subtitle && sp->sub.format != 0 && text_subs) {
+            /* text subtitles are drawn on a canvas of the video size */
+            canvas_w = is->subdec.avctx->width;
+            canvas_h = is->subdec.avctx->height;
+            if ((canvas_w <= 0 || canvas_h <= 0) && is->video_st) {
+                canvas_w = is->video_st->codecpar->width;
+                canvas_h = is->video_st->codecpar->height;
+            }
+            if (canvas_w <= 0 || canvas_h <= 0) {
+                canvas_w = 640;
+                canvas_h = 480;
+            }
+            if (text_sub_render(&is->text_sub, &sp->sub, canvas_w, canvas_h) < 0) {
+                av_log(NULL, AV_LOG_ERROR, "Not enough memory to render text subtitle, dropping it\n");
+                avsubtitle_free(&sp->sub);
+                continue;
+            }
+            text = 1;
+        }
+
+        if (got_subtitle && sp->sub.format == 0) {
+            if (sp->sub.pts != AV_NOPTS_VALUE)
+                pts = sp->sub.pts / (double)AV_TIME_BASE;
+            sp->pts = pts;
+            sp->serial = is->subdec.pkt_serial;
+            sp->width = text ? canvas_w : is->subdec.avctx->width;
+            sp->height = text ? canvas_h : is->subdec.avctx->height;
+            sp->uploaded = 0;
+            sp->in_atlas = 0;
+            if (subtitle_expand_rects(sp) < 0) {
+                av_log(NULL, AV_LOG_ERROR, "Not enough memory for subtitle bitmaps, dropping them\n");
+                frame_queue_unref_item(sp);
+                continue;
+            }
+
+            /* now we can update the picture count */
+            frame_queue_push(&is->subpq);
+        }
+        else if (got_subtitle) {
+            avsubtitle_free(&sp->sub);
+        }
+    }
+    return 0;
+}
+
+/* copy samples for viewing in editor window */
+static void update_sample_display(FMediaPlayer* is, short* samples, int samples_size)
+{
+    int size, len;
+
+    size = samples_size / sizeof(short);
+    while (size > 0) {
+        len = SAMPLE_ARRAY_SIZE - is->sample_array_index;
+        if (len > size)
+            len = size;
+        memcpy(is->sample_array + is->sample_array_index, samples, len * sizeof(short));
+        samples += len;
+        is->sample_array_index += len;
+        if (is->sample_array_index >= SAMPLE_ARRAY_SIZE)
+            is->sample_array_index = 0;
+        size -= len;
+    }
+}
+
+/* return the wanted number of samples to get better sync if sync_type is video
+ * or external master clock */
+static int synchronize_audio(FMediaPlayer* is, int nb_samples)
+{
+    int wanted_nb_samples = nb_samples;
+
+    /* if not master, then we try to remove or add samples to correct the clock */
+    if (get_master_sync_type(is) != AV_SYNC_AUDIO_MASTER) {
+        double diff, avg_diff;
+        int min_nb_samples, max_nb_samples;
+
+        diff = get_clock(&is->audclk) - get_master_clock(is);
+
+        if (!isnan(diff) && fabs(diff) < AV_NOSYNC_THRESHOLD) {
+            is->audio_diff_cum = diff + is->audio_diff_avg_coef * is->audio_diff_cum;
+            if (is->audio_diff_avg_count < AUDIO_DIFF_AVG_NB) {
+                /* not enough measures to have a correct estimate */
+                is->audio_diff_avg_count++;
+            }
+            else {
+                /* estimate the A-V difference */
+                avg_diff = is->audio_diff_cum * (1.0 - is->audio_diff_avg_coef);
+
+                if (fabs(avg_diff) >= is->audio_diff_threshold) {
+                    wanted_nb_samples = nb_samples + (int)(diff * is->audio_src.freq);
+                    min_nb_samples = ((nb_samples * (100 - SAMPLE_CORRECTION_PERCENT_MAX) / 100));
+                    max_nb_samples = ((nb_samples * (100 + SAMPLE_CORRECTION_PERCENT_MAX) / 100));
+                    wanted_nb_samples = av_clip(wanted_nb_samples, min_nb_samples, max_nb_samples);
+                }
+                av_log(NULL, AV_LOG_TRACE, "diff=%f adiff=%f sample_diff=%d apts=%0.3f %f\n",
+                    diff, avg_diff, wanted_nb_samples - nb_samples,
+                    is->audio_clock, is->audio_diff_threshold);
+            }
+        }
+        else {
+            /* too big difference : may be initial PTS errors, so
+               reset A-V filter */
+            is->audio_diff_avg_count = 0;
+            is->audio_diff_cum = 0;
+        }
+    }
+
+    return wanted_nb_samples;
+}
+
+/**
+ * Decode one audio frame and return its uncompressed size.
+ *
+ * The processed audio frame is decoded, converted if required, and
+ * stored in is->audio_buf, with size in bytes given by the return
+ * value.
+ */
+static int audio_decode_frame(FMediaPlayer* is)
+{
+    int data_size, resampled_data_size;
+    int64_t dec_channel_layout;
+    av_unused double audio_clock0;
+    int wanted_nb_samples;
+    AudioFrame* af;
+
+    if (is->paused)
+        return -1;
+
+    do {
+#if defined(_WIN32)
+        while (frame_queue_nb_remaining(&is->sampq) == 0) {
+            if ((av_gettime_relative() - audio_callback_time) > 1000000LL * is->audio_hw_buf_size / is->audio_tgt.bytes_per_sec / 2)
+                return -1;
+            av_usleep(1000);
+        }
+#endif
+        if (!(af = frame_queue_peek_readable(&is->sampq)))
+            return -1;
+        frame_queue_next(&is->sampq);
+    } while (af->serial != is->audioq.serial);
+
+    data_size = av_samples_get_buffer_size(NULL, af->frame->channels,af->frame->nb_samples, static_cast<AVSampleFormat>(af->frame->format), 1);
+
+    dec_channel_layout =
+        (af->frame->channel_layout && af->frame->channels == av_get_channel_layout_nb_channels(af->frame->channel_layout)) ?
+        af->frame->channel_layout : av_get_default_channel_layout(af->frame->channels);
+    wanted_nb_samples = synchronize_audio(is, af->frame->nb_samples);
+
+    if (af->frame->format != is->audio_src.fmt ||
+        dec_channel_layout != is->audio_src.channel_layout ||
+        af->frame->sample_rate != is->audio_src.freq ||
+        (wanted_nb_samples != af->frame->nb_samples && !is->swr_ctx)) {
+        swr_free(&is->swr_ctx);
+        is->swr_ctx = swr_alloc_set_opts(NULL,
+            is->audio_tgt.channel_layout, is->audio_tgt.fmt, is->audio_tgt.freq,
+            dec_channel_layout, static_cast<AVSampleFormat>(af->frame->format), af->frame->sample_rate,
+            0, NULL);
+        if (!is->swr_ctx || swr_init(is->swr_ctx) < 0) {
+            av_log(NULL, AV_LOG_ERROR,
+                "Cannot create sample rate converter for conversion of %d Hz %s %d channels to %d Hz %s %d channels!\n",
+                af->frame->sample_rate, av_get_sample_fmt_name(static_cast<AVSampleFormat>(af->frame->format)), af->frame->channels,
+                is->audio_tgt.freq, av_get_sample_fmt_name(is->audio_tgt.fmt), is->audio_tgt.channels);
+            swr_free(&is->swr_ctx);
+            return -1;
+        }
+        is->audio_src.channel_layout = dec_channel_layout;
+        is->audio_src.channels = af->frame->channels;
+        is->audio_src.freq = af->frame->sample_rate;
+        is->audio_src.fmt = static_cast<AVSampleFormat>(af->frame->format);
+    }
+
+    if (is->swr_ctx) {
+        const uint8_t** in = (const uint8_t**)af->frame->extended_data;
+        uint8_t** out = &is->audio_buf1;
+        int out_count = (int64_t)wanted_nb_samples * is->audio_tgt.freq / af->frame->sample_rate + 256;
+        int out_size = av_samples_get_buffer_size(NULL, is->audio_tgt.channels, out_count, is->audio_tgt.fmt, 0);
+        int len2;
+        if (out_size < 0) {
+            av_log(NULL, AV_LOG_ERROR, "av_samples_get_buffer_size() failed\n");
+            return -1;
+        }
+        if (wanted_nb_samples != af->frame->nb_samples) {
+            if (swr_set_compensation(is->swr_ctx, (wanted_nb_samples - af->frame->nb_samples) * is->audio_tgt.freq / af->frame->sample_rate,
+                wanted_nb_samples * is->audio_tgt.freq / af->frame->sample_rate) < 0) {
+                av_log(NULL, AV_LOG_ERROR, "swr_set_compensation() failed\n");
+                return -1;
+            }
+        }
+        av_fast_malloc(&is->audio_buf1, &is->audio_buf1_size, out_size);
+        if (!is->audio_buf1)
+            return AVERROR(ENOMEM);
+        len2 = swr_convert(is->swr_ctx, out, out_count, in, af->frame->nb_samples);
+        if (len2 < 0) {
+            av_log(NULL, AV_LOG_ERROR, "swr_convert() failed\n");
+            return -1;
+        }
+        if (len2 == out_count) {
+            av_log(NULL, AV_LOG_WARNING, "audio buffer is probably too small\n");
+            if (swr_init(is->swr_ctx) < 0)
+                swr_free(&is->swr_ctx);
+        }
+        is->audio_buf = is->audio_buf1;
+        resampled_data_size = len2 * is->audio_tgt.channels * av_get_bytes_per_sample(is->audio_tgt.fmt);
+    }
+    else {
+        is->audio_buf = af->frame->data[0];
+        resampled_data_size = data_size;
+    }
+
+    audio_clock0 = is->audio_clock;
+    /* update the audio clock with the pts */
+    if (!isnan(af->pts))
+        is->audio_clock = af->pts + (double)af->frame->nb_samples / af->frame->sample_rate;
+    else
+        is->audio_clock = NAN;
+    is->audio_clock_serial = af->serial;
+#ifdef DEBUG
+    {
+        static double last_clock;
+        printf("audio: delay=%0.3f clock=%0.3f clock0=%0.3f\n",
+            is->audio_clock - last_clock,
+            is->audio_clock, audio_clock0);
+        last_clock = is->audio_clock;
+    }
+#endif
+    return resampled_data_size;
+}
+
+/* prepare a new audio buffer */
+static void sdl_audio_callback(void* pUserData, Uint8* stream, int len)
+{
+    FMediaPlayer* is = static_cast<FMediaPlayer*>(pUserData);
+    int audio_size, len1;
+
+    audio_callback_time = av_gettime_relative();
+
+    while (len > 0) {
+        if (is->audio_buf_index >= is->audio_buf_size) {
+            audio_size = audio_decode_frame(is);
+            if (audio_size < 0) {
+                /* if error, just output silence */
+                is->audio_buf = NULL;
+                is->audio_buf_size = SDL_AUDIO_MIN_BUFFER_SIZE / is->audio_tgt.frame_size * is->audio_tgt.frame_size;
+            }
+            else {
+                if (is->eShow_mode != FMediaPlayer::EShowMode::SHOW_MODE_VIDEO)
+                    update_sample_display(is, (int16_t*)is->audio_buf, audio_size);
+                is->audio_buf_size = audio_size;
+            }
+            is->audio_buf_index = 0;
+        }
+        len1 = is->audio_buf_size - is->audio_buf_index;
+        if (len1 > len)
+            len1 = len;
+        if (!is->muted && is->audio_buf && is->audio_volume == SDL_MIX_MAXVOLUME)
+            memcpy(stream, (uint8_t*)is->audio_buf + is->audio_buf_index, len1);
+        else {
+            memset(stream, 0, len1);
+            if (!is->muted && is->audio_buf)
+                SDL_MixAudioFormat(stream, (uint8_t*)is->audio_buf + is->audio_buf_index, AUDIO_S16SYS, len1, is->audio_volume);
+        }
+        len -= len1;
+        stream += len1;
+        is->audio_buf_index += len1;
+    }
+    is->audio_write_buf_size = is->audio_buf_size - is->audio_buf_index;
+    /* Let's assume the audio driver that is used by SDL has two periods. */
+    if (!isnan(is->audio_clock)) {
+        set_clock_at(&is->audclk, is->audio_clock - (double)(2 * is->audio_hw_buf_size + is->audio_write_buf_size) / is->audio_tgt.bytes_per_sec, is->audio_clock_serial, audio_callback_time / 1000000.0);
+        sync_clock_to_slave(&is->extclk, &is->audclk);
+    }
+}
+
+static int audio_open(void* opaque, int64_t wanted_channel_layout, int wanted_nb_channels, int wanted_sample_rate, struct AudioParams* audio_hw_params)
+{
+    SDL_AudioSpec wanted_spec, spec;
+    const char* env;
+    static const int next_nb_channels[] = { 0, 0, 1, 6, 2, 6, 4, 6 };
+    static const int next_sample_rates[] = { 0, 44100, 48000, 96000, 192000 };
+    int next_sample_rate_idx = FF_ARRAY_ELEMS(next_sample_rates) - 1;
+
+    env = SDL_getenv("SDL_AUDIO_CHANNELS");
+    if (env) {
+        wanted_nb_channels = atoi(env);
+        wanted_channel_layout = av_get_default_channel_layout(wanted_nb_channels);
+    }
+    if (!wanted_channel_layout || wanted_nb_channels != av_get_channel_layout_nb_channels(wanted_channel_layout)) {
+        wanted_channel_layout = av_get_default_channel_layout(wanted_nb_channels);
+        wanted_channel_layout &= ~AV_CH_LAYOUT_STEREO_DOWNMIX;
+    }
+    wanted_nb_channels = av_get_channel_layout_nb_channels(wanted_channel_layout);
+    wanted_spec.channels = wanted_nb_channels;
+    wanted_spec.freq = wanted_sample_rate;
+    if (wanted_spec.freq <= 0 || wanted_spec.channels <= 0) {
+        av_log(NULL, AV_LOG_ERROR, "Invalid sample rate or channel count!\n");
+        return -1;
+    }
+    while (next_sample_rate_idx && next_sample_rates[next_sample_rate_idx] >= wanted_spec.freq)
+        next_sample_rate_idx--;
+    wanted_spec.format = AUDIO_S16SYS;
+    wanted_spec.silence = 0;
+    wanted_spec.samples = FFMAX(SDL_AUDIO_MIN_BUFFER_SIZE, 2 << av_log2(wanted_spec.freq / SDL_AUDIO_MAX_CALLBACKS_PER_SEC));
+    wanted_spec.callback = sdl_audio_callback;
+    wanted_spec.userdata = opaque;
+    while (!(audio_dev = SDL_OpenAudioDevice(NULL, 0, &wanted_spec, &spec, SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_CHANNELS_CHANGE))) {
+        av_log(NULL, AV_LOG_WARNING, "SDL_OpenAudio (%d channels, %d Hz): %s\n",
+            wanted_spec.channels, wanted_spec.freq, SDL_GetError());
+        wanted_spec.channels = next_nb_channels[FFMIN(7, wanted_spec.channels)];
+        if (!wanted_spec.channels) {
+            wanted_spec.freq = next_sample_rates[next_sample_rate_idx--];
+            wanted_spec.channels = wanted_nb_channels;
+            if (!wanted_spec.freq) {
+                av_log(NULL, AV_LOG_ERROR,
+                    "No more combinations to try, audio open failed\n");
+                return -1;
+            }
+        }
+        wanted_channel_layout = av_get_default_channel_layout(wanted_spec.channels);
+    }
+    if (spec.format != AUDIO_S16SYS) {
+        av_log(NULL, AV_LOG_ERROR,
+            "SDL advised audio format %d is not supported!\n", spec.format);
+        return -1;
+    }
+    if (spec.channels != wanted_spec.channels) {
+        wanted_channel_layout = av_get_default_channel_layout(spec.channels);
+        if (!wanted_channel_layout) {
+            av_log(NULL, AV_LOG_ERROR,
+                "SDL advised channel count %d is not supported!\n", spec.channels);
+            return -1;
+        }
+    }
+
+    audio_hw_params->fmt = AV_SAMPLE_FMT_S16;
+    audio_hw_params->freq = spec.freq;
+    audio_hw_params->channel_layout = wanted_channel_layout;
+    audio_hw_params->channels = spec.channels;
+    audio_hw_params->frame_size = av_samples_get_buffer_size(NULL, audio_hw_params->channels, 1, audio_hw_params->fmt, 1);
+    audio_hw_params->bytes_per_sec = av_samples_get_buffer_size(NULL, audio_hw_params->channels, audio_hw_params->freq, audio_hw_params->fmt, 1);
+    if (audio_hw_params->bytes_per_sec <= 0 || audio_hw_params->frame_size <= 0) {
+        av_log(NULL, AV_LOG_ERROR, "av_samples_get_buffer_size failed\n");
+        return -1;
+    }
+    return spec.size;
+}
+
+/* open a given stream. Return 0 if OK */
+static int stream_component_open(FMediaPlayer* is, int stream_index)
+{
+    AVFormatContext* ic = is->ic;
+    AVCodecContext* avctx;
+    AVCodec* codec;
+    const char* forced_codec_name = NULL;
+    AVDictionary* opts = NULL;
+    AVDictionaryEntry* t = NULL;
+    int sample_rate, nb_channels;
+    int64_t channel_layout;
+    int ret = 0;
+    int stream_lowres = lowres;
+
+    if (stream_index < 0 || stream_index >= ic->nb_streams)
+        return -1;
+
+    avctx = avcodec_alloc_context3(NULL);
+    if (!avctx)
+        return AVERROR(ENOMEM);
+
+    ret = avcodec_parameters_to_context(avctx, ic->streams[stream_index]->codecpar);
+    if (ret < 0)
+        goto fail;
+    avctx->pkt_timebase = ic->streams[stream_index]->time_base;
+
+    codec = avcodec_find_decoder(avctx->codec_id);
+
+    switch (avctx->codec_type) {
+    case AVMEDIA_TYPE_AUDIO: is->last_audio_stream = stream_index; forced_codec_name = audio_codec_name; break;
+    case AVMEDIA_TYPE_SUBTITLE: is->last_subtitle_stream = stream_index; forced_codec_name = subtitle_codec_name; break;
+    case AVMEDIA_TYPE_VIDEO: is->last_video_stream = stream_index; forced_codec_name = video_codec_name; break;
+    }
+    if (forced_codec_name)
+        codec = avcodec_find_decoder_by_name(forced_codec_name);
+    if (!codec) {
+        if (forced_codec_name) av_log(NULL, AV_LOG_WARNING,
+            "No codec could be found with name '%s'\n", forced_codec_name);
+        else                   av_log(NULL, AV_LOG_WARNING,
+            "No decoder could be found for codec %s\n", avcodec_get_name(avctx->codec_id));
+        ret = AVERROR(EINVAL);
+        goto fail;
+    }
+
+    avctx->codec_id = codec->id;
+    if (stream_lowres > codec->max_lowres) {
+        av_log(avctx, AV_LOG_WARNING, "The maximum value for lowres supported by the decoder is %d\n",
+            codec->max_lowres);
+        stream_lowres = codec->max_lowres;
+    }
+    avctx->lowres = stream_lowres;
+
+    if (fast)
+        avctx->flags2 |= AV_CODEC_FLAG2_FAST;
+
+    opts = filter_codec_opts(codec_opts, avctx->codec_id, ic, ic->streams[stream_index], codec);
+    if (!av_dict_get(opts, "threads", NULL, 0))
+        av_dict_set(&opts, "threads", "auto", 0);
+    if (stream_lowres)
+        av_dict_set_int(&opts, "lowres", stream_lowres, 0);
+    if (avctx->codec_type == AVMEDIA_TYPE_VIDEO || avctx->codec_type == AVMEDIA_TYPE_AUDIO)
+        av_dict_set(&opts, "refcounted_frames", "1", 0);
+    if (avctx->codec_type == AVMEDIA_TYPE_VIDEO && frame_pool && (codec->capabilities & AV_CODEC_CAP_DR1)) {
+        avctx->opaque = is;
+        avctx->get_buffer2 = video_get_buffer2;
+        avctx->thread_safe_callbacks = 1;
+    }
+    if ((ret = avcodec_open2(avctx, codec, &opts)) < 0) {
+        goto fail;
+    }
+    if ((t = av_dict_get(opts, "", NULL, AV_DICT_IGNORE_SUFFIX))) {
+        av_log(NULL, AV_LOG_ERROR, "Option %s not found.\n", t->key);
+        ret = AVERROR_OPTION_NOT_FOUND;
+        goto fail;
+    }
+
+    is->eof = 0;
+    ic->streams[stream_index]->discard = AVDISCARD_DEFAULT;
+    switch (avctx->codec_type) {
+    case AVMEDIA_TYPE_AUDIO:
+#if CONFIG_AVFILTER
+    {
+        AVFilterContext* sink;
+
+        is->audio_filter_src.freq = avctx->sample_rate;
+        is->audio_filter_src.channels = avctx->channels;
+        is->audio_filter_src.channel_layout = get_valid_channel_layout(avctx->channel_layout, avctx->channels);
+        is->audio_filter_src.fmt = avctx->sample_fmt;
+        if ((ret = configure_audio_filters(is, afilters, 0)) < 0)
+            goto fail;
+        sink = is->out_audio_filter;
+        sample_rate = av_buffersink_get_sample_rate(sink);
+        nb_channels = av_buffersink_get_channels(sink);
+        channel_layout = av_buffersink_get_channel_layout(sink);
+    }
+#else
+        sample_rate = avctx->sample_rate;
+        nb_channels = avctx->channels;
+        channel_layout = avctx->channel_layout;
+#endif
+
+        /* prepare audio output */
+        if ((ret = audio_open(is, channel_layout, nb_channels, sample_rate, &is->audio_tgt)) < 0)
+            goto fail;
+        is->audio_hw_buf_size = ret;
+        is->audio_src = is->audio_tgt;
+        is->audio_buf_size = 0;
+        is->audio_buf_index = 0;
+
+        /* init averaging filter */
+        is->audio_diff_avg_coef = exp(log(0.01) / AUDIO_DIFF_AVG_NB);
+        is->audio_diff_avg_count = 0;
+        /* since we do not have a precise anough audio FIFO fullness,
+           we correct audio sync only if larger than this threshold */
+        is->audio_diff_threshold = (double)(is->audio_hw_buf_size) / is->audio_tgt.bytes_per_sec;
+
+        is->audio_stream = stream_index;
+        is->audio_st = ic->streams[stream_index];
+
+        decoder_init(&is->auddec, avctx, &is->audioq, &is->continue_read);
+        if ((is->ic->iformat->flags & (AVFMT_NOBINSEARCH | AVFMT_NOGENSEARCH | AVFMT_NO_BYTE_SEEK)) && !is->ic->iformat->read_seek) {
+            is->auddec.start_pts = is->audio_st->start_time;
+            is->auddec.start_pts_tb = is->audio_st->time_base;
+        }
+        if ((ret = decoder_start(&is->auddec, audio_thread, "audio_decoder", is)) < 0)
+            goto out;
+        SDL_PauseAudioDevice(audio_dev, 0);
+        break;
+    case AVMEDIA_TYPE_VIDEO:
+        is->video_stream = stream_index;
+        is->video_st = ic->streams[stream_index];
+
+        decoder_init(&is->viddec, avctx, &is->videoq, &is->continue_read);
+        if ((ret = decoder_start(&is->viddec, video_thread, "video_decoder", is)) < 0)
+            goto out;
+        is->queue_attachments_req = 1;
+        break;
+    case AVMEDIA_TYPE_SUBTITLE:
+        is->subtitle_stream = stream_index;
+        is->subtitle_st = ic->streams[stream_index];
+
+        decoder_init(&is->subdec, avctx, &is->subtitleq, &is->continue_read);
+        if ((ret = decoder_start(&is->subdec, subtitle_thread, "subtitle_decoder", is)) < 0)
+            goto out;
+        break;
+    default:
+        break;
+    }
+    goto out;
+
+fail:
+    avcodec_free_context(&avctx);
+out:
+    av_dict_free(&opts);
+    /* a new stream needs packets and may have attachments to queue */
+    event_notify(&is->continue_read);
+
+    return ret;
+}
+
+static int decode_interrupt_cb(void* pUserData)
+{
+    FMediaPlayer* is = static_cast<FMediaPlayer*>(pUserData);
+    return is->abort_request;
+}
+
+static int stream_has_enough_packets(AVStream* st, int stream_id, PacketQueue* queue) {
+    int64_t duration;
+
+    if (stream_id < 0 ||
+        queue->abort_request ||
+        (st->disposition & AV_DISPOSITION_ATTACHED_PIC) ||
+        buffer_max_time[st->codecpar->codec_type] <= 0)
+        return 1;
+    duration = packet_queue_duration(queue);
+    if (!duration)
+        return packet_queue_nb_packets(queue) > MIN_FRAMES;
+    return av_q2d(st->time_base) * duration >= buffer_max_time[st->codecpar->codec_type];
+}
+
+static int64_t stream_queues_size(FMediaPlayer* is)
+{
+    return (int64_t)packet_queue_size(&is->audioq) + packet_queue_size(&is->videoq) + packet_queue_size(&is->subtitleq);
+}
+
+/* return 1 if enough packets are buffered and the read thread should wait */
+static int stream_queues_full(FMediaPlayer* is)
+{
+    if (packet_queue_full(&is->audioq) || packet_queue_full(&is->videoq) || packet_queue_full(&is->subtitleq))
+        return 1;
+    return infinite_buffer < 1 &&
+        (stream_queues_size(is) > max_queue_size
+            || (stream_has_enough_packets(is->audio_st, is->audio_stream, &is->audioq) &&
+                stream_has_enough_packets(is->video_st, is->video_stream, &is->videoq) &&
+                stream_has_enough_packets(is->subtitle_st, is->subtitle_stream, &is->subtitleq)));
+}
+
+/* Arm the watermark at which a decoder wakes the read thread up: the low
+ * buffer target of the stream, which gives hysteresis against the high target
+ * checked by stream_has_enough_packets(). A queue that is already short of
+ * packets is only armed on its share of the excess over max_queue_size. */
+static void stream_arm_queue_wakeup(AVStream* st, int stream_id, PacketQueue* q, int64_t excess)
+{
+    int nb_packets = -1, size = -1;
+    int64_t duration = 0;
+
+    if (stream_id < 0)
+        return;
+    if (infinite_buffer < 1) {
+        enum AVMediaType type = st->codecpar->codec_type;
+        if (!(st->disposition & AV_DISPOSITION_ATTACHED_PIC) && buffer_max_time[type] > 0 &&
+            stream_has_enough_packets(st, stream_id, q)) {
+            if (packet_queue_duration(q)) {
+                nb_packets = 0;
+                duration = (int64_t)(FFMIN(buffer_min_time[type], buffer_max_time[type]) / av_q2d(st->time_base));
+            }
+            else {
+                nb_packets = MIN_FRAMES;
+            }
+        }
+        if (excess > 0)
+            size = (int)FFMAX(packet_queue_size(q) - excess, 0);
+    }
+    if (packet_queue_full(q))
+        nb_packets = FFMAX(nb_packets, (int)q->ring.capacity - 1);
+    packet_queue_arm_wakeup(q, nb_packets, duration, size);
+}
+
+static void stream_arm_queue_wakeups(FMediaPlayer* is)
+{
+    int64_t excess = stream_queues_size(is) - max_queue_size;
+
+    stream_arm_queue_wakeup(is->audio_st, is->audio_stream, &is->audioq, excess);
+    stream_arm_queue_wakeup(is->video_st, is->video_stream, &is->videoq, excess);
+    stream_arm_queue_wakeup(is->subtitle_st, is->subtitle_stream, &is->subtitleq, excess);
+}
+
+/* return 1 if all decoded data has been played */
+static int stream_playback_finished(FMediaPlayer* is)
+{
+    return !is->paused &&
+        (!is->audio_st || (is->auddec.finished == is->audioq.serial && frame_queue_nb_remaining(&is->sampq) == 0)) &&
+        (!is->video_st || (is->viddec.finished == is->videoq.serial && frame_queue_nb_remaining(&is->pictq) == 0));
+}
+
+/* return 1 if the main thread requested something the read thread must handle */
+static int read_thread_interrupted(FMediaPlayer* is)
+{
+    return is->abort_request || is->seek_req || is->queue_attachments_req || is->paused != is->last_paused;
+}
+
+static int is_realtime(AVFormatContext* s)
+{
+    if (!strcmp(s->iformat->name, "rtp")
+        || !strcmp(s->iformat->name, "rtsp")
+        || !strcmp(s->iformat->name, "sdp")
+        )
+        return 1;
+
+    if (s->pb && (!strncmp(s->url, "rtp:", 4)
+        || !strncmp(s->url, "udp:", 4)
+        )
+        )
+        return 1;
+    return 0;
+}
+
+/* this thread gets the stream from the disk or the network */
+static int read_thread(void* pUserData)
+{
+    FMediaPlayer* is = static_cast<FMediaPlayer*>(pUserData);
+    AVFormatContext* ic = NULL;
+    int err, i, ret;
+    int st_index[AVMEDIA_TYPE_NB];
+    AVPacket pkt1, * pkt = &pkt1;
+    int64_t stream_start_time;
+    int pkt_in_play_range = 0;
+    AVDictionaryEntry* t;
+    int scan_all_pmts_set = 0;
+    int64_t pkt_ts;
+    int key;
+
+    memset(st_index, -1, sizeof(st_index));
+    is->last_video_stream = is->video_stream = -1;
+    is->last_audio_stream = is->audio_stream = -1;
+    is->last_subtitle_stream = is->subtitle_stream = -1;
+    is->eof = 0;
+
+    ic = avformat_alloc_context();
+    if (!ic) {
+        av_log(NULL, AV_LOG_FATAL, "Could not allocate context.\n");
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    ic->interrupt_callback.callback = decode_interrupt_cb;
+    ic->interrupt_callback.opaque = is;
+    if (!av_dict_get(format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE)) {
+        av_dict_set(&format_opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
+        scan_all_pmts_set = 1;
+    }
+    err = avformat_open_input(&ic, is->filename, is->iformat, &format_opts);
+    if (err < 0) {
+        print_error(is->filename, err);
+        ret = -1;
+        goto fail;
+    }
+    if (scan_all_pmts_set)
+        av_dict_set(&format_opts, "scan_all_pmts", NULL, AV_DICT_MATCH_CASE);
+
+    if ((t = av_dict_get(format_opts, "", NULL, AV_DICT_IGNORE_SUFFIX))) {
+        av_log(NULL, AV_LOG_ERROR, "Option %s not found.\n", t->key);
+        ret = AVERROR_OPTION_NOT_FOUND;
+        goto fail;
+    }
+    is->ic = ic;
+
+    if (genpts)
+        ic->flags |= AVFMT_FLAG_GENPTS;
+
+    av_format_inject_global_side_data(ic);
+
+    if (find_stream_info) {
+        AVDictionary** opts = setup_find_stream_info_opts(ic, codec_opts);
+        int orig_nb_streams = ic->nb_streams;
+
+        err = avformat_find_stream_info(ic, opts);
+
+        for (i = 0; i < orig_nb_streams; i++)
+            av_dict_free(&opts[i]);
+        av_freep(&opts);
+
+        if (err < 0) {
+            av_log(NULL, AV_LOG_WARNING,
+                "%s: could not find codec parameters\n", is->filename);
+            ret = -1;
+            goto fail;
+        }
+    }
+
+    if (ic->pb)
+        ic->pb->eof_reached = 0; // FIXME hack, ffplay maybe should not use avio_feof() to test for the end
+
+    if (seek_by_bytes < 0)
+        seek_by_bytes = !!(ic->iformat->flags & AVFMT_TS_DISCONT) && strcmp("ogg", ic->iformat->name);
+
+    is->max_frame_duration = (ic->iformat->flags & AVFMT_TS_DISCONT) ? 10.0 : 3600.0;
+
+    if (!window_title && (t = av_dict_get(ic->metadata, "title", NULL, 0)))
+        window_title = av_asprintf("%s - %s", t->value, input_filename);
+
+    /* if seeking requested, we execute it */
+    if (start_time != AV_NOPTS_VALUE) {
+        int64_t timestamp;
+
+        timestamp = start_time;
+        /* add the stream start time */
+        if (ic->start_time != AV_NOPTS_VALUE)
+            timestamp += ic->start_time;
+        ret = avformat_seek_file(ic, -1, INT64_MIN, timestamp, INT64_MAX, 0);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_WARNING, "%s: could not seek to position %0.3f\n",
+                is->filename, (double)timestamp / AV_TIME_BASE);
+        }
+    }
+
+    is->realtime = is_realtime(ic);
+
+    if (show_status)
+        av_dump_format(ic, 0, is->filename, 0);
+
+    for (i = 0; i < ic->nb_streams; i++) {
+        AVStream* st = ic->streams[i];
+        enum AVMediaType type = st->codecpar->codec_type;
+        st->discard = AVDISCARD_ALL;
+        if (type >= 0 && wanted_stream_spec[type] && st_index[type] == -1)
+            if (avformat_match_stream_specifier(ic, st, wanted_stream_spec[type]) > 0)
+                st_index[type] = i;
+    }
+    for (i = 0; i < AVMEDIA_TYPE_NB; i++) {
+        if (wanted_stream_spec[i] && st_index[i] == -1) {
+            av_log(NULL, AV_LOG_ERROR, "Stream specifier %s does not match any %s stream\n", wanted_stream_spec[i], av_get_media_type_string(static_cast<AVMediaType>(i)));
+            st_index[i] = INT_MAX;
+        }
+    }
+
+    if (!video_disable)
+        st_index[AVMEDIA_TYPE_VIDEO] =
+        av_find_best_stream(ic, AVMEDIA_TYPE_VIDEO,
+            st_index[AVMEDIA_TYPE_VIDEO], -1, NULL, 0);
+    if (!audio_disable)
+        st_index[AVMEDIA_TYPE_AUDIO] =
+        av_find_best_stream(ic, AVMEDIA_TYPE_AUDIO,
+            st_index[AVMEDIA_TYPE_AUDIO],
+            st_index[AVMEDIA_TYPE_VIDEO],
+            NULL, 0);
+    if (!video_disable && !subtitle_disable)
+        st_index[AVMEDIA_TYPE_SUBTITLE] =
+        av_find_best_stream(ic, AVMEDIA_TYPE_SUBTITLE,
+            st_index[AVMEDIA_TYPE_SUBTITLE],
+            (st_index[AVMEDIA_TYPE_AUDIO] >= 0 ?
+                st_index[AVMEDIA_TYPE_AUDIO] :
+                st_index[AVMEDIA_TYPE_VIDEO]),
+            NULL, 0);
+
+    is->eShow_mode = show_mode;
+    if (st_index[AVMEDIA_TYPE_VIDEO] >= 0) {
+        AVStream* st = ic->streams[st_index[AVMEDIA_TYPE_VIDEO]];
+        AVCodecParameters* codecpar = st->codecpar;
+        AVRational sar = av_guess_sample_aspect_ratio(ic, st, NULL);
+        if (codecpar->width)
+            set_default_window_size(codecpar->width, codecpar->height, sar);
+    }
+
+    /* open the streams */
+    if (st_index[AVMEDIA_TYPE_AUDIO] >= 0) {
+        stream_component_open(is, st_index[AVMEDIA_TYPE_AUDIO]);
+    }
+
+    ret = -1;
+    if (st_index[AVMEDIA_TYPE_VIDEO] >= 0) {
+        ret = stream_component_open(is, st_index[AVMEDIA_TYPE_VIDEO]);
+    }
+    if (is->eShow_mode == FMediaPlayer::EShowMode::SHOW_MODE_NONE)
+        is->eShow_mode = ret >= 0 ? FMediaPlayer::EShowMode::SHOW_MODE_VIDEO : FMediaPlayer::EShowMode::SHOW_MODE_RDFT;
+
+    if (st_index[AVMEDIA_TYPE_SUBTITLE] >= 0) {
+        stream_component_open(is, st_index[AVMEDIA_TYPE_SUBTITLE]);
+    }
+
+    if (is->video_stream < 0 && is->audio_stream < 0) {
+        av_log(NULL, AV_LOG_FATAL, "Failed to open file '%s' or configure filtergraph\n",
+            is->filename);
+        ret = -1;
+        goto fail;
+    }
+
+    if (infinite_buffer < 0 && is->realtime)
+        infinite_buffer = 1;
+
+    for (;;) {
+        if (is->abort_request)
+            break;
+        if (is->paused != is->last_paused) {
+            is->last_paused = is->paused;
+            if (is->paused)
+                is->read_pause_return = av_read_pause(ic);
+            else
+                av_read_play(ic);
+        }
+#if CONFIG_RTSP_DEMUXER || CONFIG_MMSH_PROTOCOL
+        if (is->paused &&
+            (!strcmp(ic->iformat->name, "rtsp") ||
+            (ic->pb && !strncmp(input_filename, "mmsh:", 5)))) {
+            /* wait 10 ms to avoid trying to get another packet */
+            /* XXX: horrible */
+            SDL_Delay(10);
+            continue;
+        }
+#endif
+        if (is->seek_req) {
+            int64_t seek_target = is->seek_pos;
+            int64_t seek_min = is->seek_rel > 0 ? seek_target - is->seek_rel + 2 : INT64_MIN;
+            int64_t seek_max = is->seek_rel < 0 ? seek_target - is->seek_rel - 2 : INT64_MAX;
+            // FIXME the +-2 is due to rounding being not done in the correct direction in generation
+            //      of the seek_pos/seek_rel variables
+
+            ret = avformat_seek_file(is->ic, -1, seek_min, seek_target, seek_max, is->seek_flags);
+            if (ret < 0) {
+                av_log(NULL, AV_LOG_ERROR,
+                    "%s: error while seeking\n", is->ic->url);
+            }
+            else {
+                if (is->audio_stream >= 0) {
+                    packet_queue_flush(&is->audioq);
+                    packet_queue_put(&is->audioq, &flush_pkt);
+                }
+                if (is->subtitle_stream >= 0) {
+                    packet_queue_flush(&is->subtitleq);
+                    packet_queue_put(&is->subtitleq, &flush_pkt);
+                }
+                if (is->video_stream >= 0) {
+                    packet_queue_flush(&is->videoq);
+                    packet_queue_put(&is->videoq, &flush_pkt);
+                }
+                if (is->seek_flags & AVSEEK_FLAG_BYTE) {
+                    set_clock(&is->extclk, NAN, 0);
+                }
+                else {
+                    set_clock(&is->extclk, seek_target / (double)AV_TIME_BASE, 0);
+                }
+            }
+            is->seek_req = 0;
+            is->queue_attachments_req = 1;
+            is->eof = 0;
+            if (is->paused)
+                step_to_next_frame(is);
+        }
+        if (is->queue_attachments_req) {
+            if (is->video_st && is->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC) {
+                AVPacket copy = { 0 };
+                if ((ret = av_packet_ref(&copy, &is->video_st->attached_pic)) < 0)
+                    goto fail;
+                packet_queue_put(&is->videoq, &copy);
+                packet_queue_put_nullpacket(&is->videoq, is->video_stream);
+            }
+            is->queue_attachments_req = 0;
+        }
+
+        /* if the queue are full, no need to read more */
+        if (stream_queues_full(is)) {
+            /* sleep until a decoder drains its queue below the watermark */
+            stream_arm_queue_wakeups(is);
+            key = event_prepare_wait(&is->continue_read);
+            if (stream_queues_full(is) && !read_thread_interrupted(is))
+                event_commit_wait(&is->continue_read, key, -1);
+            else
+                event_cancel_wait(&is->continue_read);
+            continue;
+        }
+        if (stream_playback_finished(is)) {
+            if (loop != 1 && (!loop || --loop)) {
+                stream_seek(is, start_time != AV_NOPTS_VALUE ? start_time : 0, 0, 0);
+            }
+            else if (autoexit) {
+                ret = AVERROR_EOF;
+                goto fail;
+            }
+        }
+        ret = av_read_frame(ic, pkt);
+        if (ret < 0) {
+            if ((ret == AVERROR_EOF || avio_feof(ic->pb)) && !is->eof) {
+                if (is->video_stream >= 0)
+                    packet_queue_put_nullpacket(&is->videoq, is->video_stream);
+                if (is->audio_stream >= 0)
+                    packet_queue_put_nullpacket(&is->audioq, is->audio_stream);
+                if (is->subtitle_stream >= 0)
+                    packet_queue_put_nullpacket(&is->subtitleq, is->subtitle_stream);
+                is->eof = 1;
+            }
+            if (ic->pb && ic->pb->error)
+                break;
+            /* at the end of the file only a request from the main thread or the
+             * end of playback can change anything, other errors are retried */
+            key = event_prepare_wait(&is->continue_read);
+            if (read_thread_interrupted(is) || (is->eof && (loop != 1 || autoexit) && stream_playback_finished(is)))
+                event_cancel_wait(&is->continue_read);
+            else
+                event_commit_wait(&is->continue_read, key, is->eof ? -1 : 10);
+            continue;
+        }
+        else {
+            is->eof = 0;
+        }
+        /* check if packet is in play range specified by user, then queue, otherwise discard */
+        stream_start_time = ic->streams[pkt->stream_index]->start_time;
+        pkt_ts = pkt->pts == AV_NOPTS_VALUE ? pkt->dts : pkt->pts;
+        pkt_in_play_range = duration == AV_NOPTS_VALUE ||
+            (pkt_ts - (stream_start_time != AV_NOPTS_VALUE ? stream_start_time : 0)) *
+            av_q2d(ic->streams[pkt->stream_index]->time_base) -
+            (double)(start_time != AV_NOPTS_VALUE ? start_time : 0) / 1000000
+            <= ((double)duration / 1000000);
+        if (pkt->stream_index == is->audio_stream && pkt_in_play_range) {
+            packet_queue_put(&is->audioq, pkt);
+        }
+        else if (pkt->stream_index == is->video_stream && pkt_in_play_range
+            && !(is->video_st->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+            packet_queue_put(&is->videoq, pkt);
+        }
+        else if (pkt->stream_index == is->subtitle_stream && pkt_in_play_range) {
+            packet_queue_put(&is->subtitleq, pkt);
+        }
+        else {
+            av_packet_unref(pkt);
+        }
+    }
+
+    ret = 0;
+fail:
+    if (ic && !is->ic)
+        avformat_close_input(&ic);
+
+    if (ret != 0) {
+        SDL_Event event;
+
+        event.type = FF_QUIT_EVENT;
+        event.user.data1 = is;
+        SDL_PushEvent(&event);
+    }
+    return 0;
+}
+
+static FMediaPlayer* stream_open(const char* filename, AVInputFormat* iformat)
+{
+    FMediaPlayer* pPlayer;
+
+    pPlayer = static_cast<FMediaPlayer*>(av_mallocz(sizeof(FMediaPlayer)));
+    if (!pPlayer)
+        return NULL;
+    pPlayer->filename = av_strdup(filename);
+    if (!pPlayer->filename)
+        goto fail;
+    pPlayer->iformat = iformat;
+    pPlayer->ytop = 0;
+    pPlayer->xleft = 0;
+
+    /* start video display */
+    pictq_max = FFMAX(pictq_max, 2);
+    pictq_size = av_clip(pictq_size, 2, pictq_max);
+    texture_ring_size = av_clip(texture_ring_size, 1, VIDEO_TEXTURE_RING_MAX);
+    slice_scaler_init(&pPlayer->upload_scaler, convert_threads);
+    slice_scaler_init(&pPlayer->vid_convert_scaler, convert_threads);
+    if (frame_queue_init(&pPlayer->pictq, &pPlayer->videoq, pictq_max, 1) < 0)
+        goto fail;
+    frame_queue_set_depth(&pPlayer->pictq, pictq_size);
+    if (frame_queue_init(&pPlayer->subpq, &pPlayer->subtitleq, SUBPICTURE_QUEUE_SIZE, 0) < 0)
+        goto fail;
+    if (frame_queue_init(&pPlayer->sampq, &pPlayer->audioq, SAMPLE_QUEUE_SIZE, 1) < 0)
+        goto fail;
+
+    if (packet_queue_init(&pPlayer->videoq, packet_ring_size) < 0 ||
+        packet_queue_init(&pPlayer->audioq, packet_ring_size) < 0 ||
+        packet_queue_init(&pPlayer->subtitleq, packet_ring_size) < 0)
+        goto fail;
+
+    if (event_init(&pPlayer->continue_read) < 0)
+        goto fail;
+    pPlayer->videoq.wakeup = &pPlayer->continue_read;
+    pPlayer->audioq.wakeup = &pPlayer->continue_read;
+    pPlayer->subtitleq.wakeup = &pPlayer->continue_read;
+
+    if (packet_reclaimer_start(&pPlayer->reclaimer) < 0)
+        goto fail;
+    pPlayer->videoq.reclaimer = &pPlayer->reclaimer;
+    pPlayer->audioq.reclaimer = &pPlayer->reclaimer;
+    pPlayer->subtitleq.reclaimer = &pPlayer->reclaimer;
+    if (video_buffer_pool_init(&pPlayer->video_buffer_pool) < 0)
+        goto fail;
+    if (!packet_ring_size) {
+        pPlayer->videoq.spill.budget = spill_size;
+        pPlayer->audioq.spill.budget = spill_size;
+        pPlayer->subtitleq.spill.budget = spill_size;
+    }
+
+    init_clock(&pPlayer->vidclk, &pPlayer->videoq.serial);
+    init_clock(&pPlayer->audclk, &pPlayer->audioq.serial);
+    init_clock(&pPlayer->extclk, &pPlayer->extclk.serial);
+    pPlayer->audio_clock_serial = -1;
+    pPlayer->last_queue_stats_time = av_gettime_relative();
+    pPlayer->pictq_adapt_time = pPlayer->pictq_calm_time = av_gettime_relative();
+    pPlayer->vid_repack_format = AV_PIX_FMT_NONE;
+    if (startup_volume < 0)
+        av_log(NULL, AV_LOG_WARNING, "-volume=%d < 0, setting to 0\n", startup_volume);
+    if (startup_volume > 100)
+        av_log(NULL, AV_LOG_WARNING, "-volume=%d > 100, setting to 100\n", startup_volume);
+    startup_volume = av_clip(startup_volume, 0, 100);
+    startup_volume = av_clip(SDL_MIX_MAXVOLUME * startup_volume / 100, 0, SDL_MIX_MAXVOLUME);
+    pPlayer->audio_volume = startup_volume;
+    pPlayer->muted = 0;
+    pPlayer->av_sync_type = av_sync_type;
+    pPlayer->read_tid = SDL_CreateThread(read_thread, "read_thread", pPlayer);
+    if (!pPlayer->read_tid) {
+        av_log(NULL, AV_LOG_FATAL, "SDL_CreateThread(): %s\n", SDL_GetError());
+    fail:
+        stream_close(pPlayer);
+        return NULL;
+    }
+    return pPlayer;
+}
+
+static void stream_cycle_channel(FMediaPlayer* pPlayer, int codec_type)
+{
+    AVFormatContext* ic = pPlayer->ic;
+    int start_index, stream_index;
+    int old_index;
+    AVStream* st;
+    AVProgram* p = NULL;
+    int nb_streams = pPlayer->ic->nb_streams;
+
+    if (codec_type == AVMEDIA_TYPE_VIDEO) {
+        start_index = pPlayer->last_video_stream;
+        old_index = pPlayer->video_stream;
+    }
+    else if (codec_type == AVMEDIA_TYPE_AUDIO) {
+        start_index = pPlayer->last_audio_stream;
+        old_index = pPlayer->audio_stream;
+    }
+    else {
+        start_index = pPlayer->last_subtitle_stream;
+        old_index = pPlayer->subtitle_stream;
+    }
+    stream_index = start_index;
+
+    if (codec_type != AVMEDIA_TYPE_VIDEO && pPlayer->video_stream != -1) {
+        p = av_find_program_from_stream(ic, NULL, pPlayer->video_stream);
+        if (p) {
+            nb_streams = p->nb_stream_indexes;
+            for (start_index = 0; start_index < nb_streams; start_index++)
+                if (p->stream_index[start_index] == stream_index)
+                    break;
+            if (start_index == nb_streams)
+                start_index = -1;
+            stream_index = start_index;
+        }
+    }
+
+    for (;;) {
+        if (++stream_index >= nb_streams)
+        {
+            if (codec_type == AVMEDIA_TYPE_SUBTITLE)
+            {
+                stream_index = -1;
+                pPlayer->last_subtitle_stream = -1;
+                goto the_end;
+            }
+            if (start_index == -1)
+                return;
+            stream_index = 0;
+        }
+        if (stream_index == start_index)
+            return;
+        st = pPlayer->ic->streams[p ? p->stream_index[stream_index] : stream_index];
+        if (st->codecpar->codec_type == codec_type) {
+            /* check that parameters are OK */
+            switch (codec_type) {
+            case AVMEDIA_TYPE_AUDIO:
+                if (st->codecpar->sample_rate != 0 &&
+                    st->codecpar->channels != 0)
+                    goto the_end;
+                break;
+            case AVMEDIA_TYPE_VIDEO:
+            case AVMEDIA_TYPE_SUBTITLE:
+                goto the_end;
+            default:
+                break;
+            }
+        }
+    }
+the_end:
+    if (p && stream_index != -1)
+        stream_index = p->stream_index[stream_index];
+    av_log(NULL, AV_LOG_INFO, "Switch %s stream from #%d to #%d\n", av_get_media_type_string(static_cast<AVMediaType>(codec_type)), old_index, stream_index);
+
+    stream_component_close(pPlayer, old_index);
+    stream_component_open(pPlayer, stream_index);
+}
+
+
+static void toggle_full_screen(FMediaPlayer* pPlayer)
+{
+    is_full_screen = !is_full_screen;
+    SDL_SetWindowFullscreen(window, is_full_screen ? SDL_WINDOW_FULLSCREEN_DESKTOP : 0);
+}
+
+static void toggle_audio_display(FMediaPlayer* pPlayer)
+{
+    int next = static_cast<int>(pPlayer->eShow_mode);
+    do {
+        next = (next + 1) % int(FMediaPlayer::EShowMode::SHOW_MODE_NB);
+    } while (next != int(pPlayer->eShow_mode) && (next == int(FMediaPlayer::EShowMode::SHOW_MODE_VIDEO) && !pPlayer->video_st || next != int(FMediaPlayer::EShowMode::SHOW_MODE_VIDEO) && !pPlayer->audio_st));
+    if (int(pPlayer->eShow_mode) != next) {
+        pPlayer->force_refresh = 1;
+        pPlayer->eShow_mode = FMediaPlayer::EShowMode(next);
+    }
+}
+
+static void refresh_loop_wait_event(FMediaPlayer* pPlayer, SDL_Event* event) {
+    double remaining_time = 0.0;
+    SDL_PumpEvents();
+    while (!SDL_PeepEvents(event, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT)) {
+        if (!cursor_hidden && av_gettime_relative() - cursor_last_shown > CURSOR_HIDE_DELAY) {
+            SDL_ShowCursor(0);
+            cursor_hidden = 1;
+        }
+        if (remaining_time > 0.0)
+            av_usleep((int64_t)(remaining_time * 1000000.0));
+        remaining_time = REFRESH_RATE;
+        if (pPlayer->eShow_mode != FMediaPlayer::EShowMode::SHOW_MODE_NONE && (!pPlayer->paused || pPlayer->force_refresh))
+            video_refresh(pPlayer, &remaining_time);
+        /* the compositor draws from the frames themselves */
+        if (pPlayer->video_st && pPlayer->eShow_mode == FMediaPlayer::EShowMode::SHOW_MODE_VIDEO)
+            video_upload_ahead(pPlayer);
+        SDL_PumpEvents();
+    }
+}
+
+static void seek_chapter(FMediaPlayer* pPlayer, int incr)
+{
+    int64_t pos = get_master_clock(pPlayer) * AV_TIME_BASE;
+    int i;
+
+    if (!pPlayer->ic->nb_chapters)
+        return;
+
+    /* find the current chapter */
+    for (i = 0; i < pPlayer->ic->nb_chapters; i++) {
+        AVChapter* ch = pPlayer->ic->chapters[i];
+        if (av_compare_ts(pos, AVRational{ 1, AV_TIME_BASE }, ch->start, ch->time_base) < 0) {
+            i--;
+            break;
+        }
+    }
+
+    i += incr;
+    i = FFMAX(i, 0);
+    if (i >= pPlayer->ic->nb_chapters)
+        return;
+
+    av_log(NULL, AV_LOG_VERBOSE, "Seeking to chapter %d.\n", i);
+    stream_seek(pPlayer, av_rescale_q(pPlayer->ic->chapters[i]->start, pPlayer->ic->chapters[i]->time_base,
+        AVRational{1, AV_TIME_BASE}), 0, 0);
+}
+
+/* handle an event sent by the GUI */
+static void event_loop(FMediaPlayer* cur_stream)
+{
+    SDL_Event event;
+    double incr, pos, frac;
+
+    for (;;) {
+        double x;
+        refresh_loop_wait_event(cur_stream, &event);
+        switch (event.type) {
+        case SDL_KEYDOWN:
+            if (exit_on_keydown || event.key.keysym.sym == SDLK_ESCAPE || event.key.keysym.sym == SDLK_q) {
+                do_exit(cur_stream);
+                break;
+            }
+            // If we don't yet have a window, skip all key events, because read_thread might still be initializing...
+            if (!cur_stream->width)
+                continue;
+            switch (event.key.keysym.sym) {
+            case SDLK_f:
+                toggle_full_screen(cur_stream);
+                cur_stream->force_refresh = 1;
+                break;
+            case SDLK_p:
+            case SDLK_SPACE:
+                toggle_pause(cur_stream);
+                break;
+            case SDLK_i:
+                stream_log_queue_stats(cur_stream);
+                break;
+            case SDLK_m:
+                toggle_mute(cur_stream);
+                break;
+            case SDLK_KP_MULTIPLY:
+            case SDLK_0:
+                update_volume(cur_stream, 1, SDL_VOLUME_STEP);
+                break;
+            case SDLK_KP_DIVIDE:
+            case SDLK_9:
+                update_volume(cur_stream, -1, SDL_VOLUME_STEP);
+                break;
+            case SDLK_s: // S: Step to next frame
+                step_to_next_frame(cur_stream);
+                break;
+            case SDLK_a:
+                stream_cycle_channel(cur_stream, AVMEDIA_TYPE_AUDIO);
+                break;
+            case SDLK_v:
+                stream_cycle_channel(cur_stream, AVMEDIA_TYPE_VIDEO);
+                break;
+            case SDLK_c:
+                stream_cycle_channel(cur_stream, AVMEDIA_TYPE_VIDEO);
+                stream_cycle_channel(cur_stream, AVMEDIA_TYPE_AUDIO);
+                stream_cycle_channel(cur_stream, AVMEDIA_TYPE_SUBTITLE);
+                break;
+            case SDLK_t:
+                stream_cycle_channel(cur_stream, AVMEDIA_TYPE_SUBTITLE);
+                break;
+            case SDLK_w:
+#if CONFIG_AVFILTER
+                if (cur_stream->show_mode == SHOW_MODE_VIDEO && cur_stream->vfilter_idx < nb_vfilters - 1) {
+                    if (++cur_stream->vfilter_idx >= nb_vfilters)
+                        cur_stream->vfilter_idx = 0;
+                }
+                else {
+                    cur_stream->vfilter_idx = 0;
+                    toggle_audio_display(cur_stream);
+                }
+#else
+                toggle_audio_display(cur_stream);
+#endif
+                break;
+            case SDLK_PAGEUP:
+                if (cur_stream->ic->nb_chapters <= 1) {
+                    incr = 600.0;
+                    goto do_seek;
+                }
+                seek_chapter(cur_stream, 1);
+                break;
+            case SDLK_PAGEDOWN:
+                if (cur_stream->ic->nb_chapters <= 1) {
+                    incr = -600.0;
+                    goto do_seek;
+                }
+                seek_chapter(cur_stream, -1);
+                break;
+            case SDLK_LEFT:
+                incr = seek_interval ? -seek_interval : -10.0;
+                goto do_seek;
+            case SDLK_RIGHT:
+                incr = seek_interval ? seek_interval : 10.0;
+                goto do_seek;
+            case SDLK_UP:
+                incr = 60.0;
+                goto do_seek;
+            case SDLK_DOWN:
+                incr = -60.0;
+            do_seek:
+                if (seek_by_bytes) {
+                    pos = -1;
+                    if (pos < 0 && cur_stream->video_stream >= 0)
+                        pos = frame_queue_last_pos(&cur_stream->pictq);
+                    if (pos < 0 && cur_stream->audio_stream >= 0)
+                        pos = frame_queue_last_pos(&cur_stream->sampq);
+                    if (pos < 0)
+                        pos = avio_tell(cur_stream->ic->pb);
+                    if (cur_stream->ic->bit_rate)
+                        incr *= cur_stream->ic->bit_rate / 8.0;
+                    else
+                        incr *= 180000.0;
+                    pos += incr;
+                    stream_seek(cur_stream, pos, incr, 1);
+                }
+                else {
+                    pos = get_master_clock(cur_stream);
+                    if (isnan(pos))
+                        pos = (double)cur_stream->seek_pos / AV_TIME_BASE;
+                    pos += incr;
+                    if (cur_stream->ic->start_time != AV_NOPTS_VALUE && pos < cur_stream->ic->start_time / (double)AV_TIME_BASE)
+                        pos = cur_stream->ic->start_time / (double)AV_TIME_BASE;
+                    stream_seek(cur_stream, (int64_t)(pos * AV_TIME_BASE), (int64_t)(incr * AV_TIME_BASE), 0);
+                }
+                break;
+            default:
+                break;
+            }
+            break;
+        case SDL_MOUSEBUTTONDOWN:
+            if (exit_on_mousedown) {
+                do_exit(cur_stream);
+                break;
+            }
+            if (event.button.button == SDL_BUTTON_LEFT) {
+                static int64_t last_mouse_left_click = 0;
+                if (av_gettime_relative() - last_mouse_left_click <= 500000) {
+                    toggle_full_screen(cur_stream);
+                    cur_stream->force_refresh = 1;
+                    last_mouse_left_click = 0;
+                }
+                else {
+                    last_mouse_left_click = av_gettime_relative();
+                }
+            }
+        case SDL_MOUSEMOTION:
+            if (cursor_hidden) {
+                SDL_ShowCursor(1);
+                cursor_hidden = 0;
+            }
+            cursor_last_shown = av_gettime_relative();
+            if (event.type == SDL_MOUSEBUTTONDOWN) {
+                if (event.button.button != SDL_BUTTON_RIGHT)
+                    break;
+                x = event.button.x;
+            }
+            else {
+                if (!(event.motion.state & SDL_BUTTON_RMASK))
+                    break;
+                x = event.motion.x;
+            }
+            if (seek_by_bytes || cur_stream->ic->duration <= 0) {
+                uint64_t size = avio_size(cur_stream->ic->pb);
+                stream_seek(cur_stream, size * x / cur_stream->width, 0, 1);
+            }
+            else {
+                int64_t ts;
+                int ns, hh, mm, ss;
+                int tns, thh, tmm, tss;
+                tns = cur_stream->ic->duration / 1000000LL;
+                thh = tns / 3600;
+                tmm = (tns % 3600) / 60;
+                tss = (tns % 60);
+                frac = x / cur_stream->width;
+                ns = frac * tns;
+                hh = ns / 3600;
+                mm = (ns % 3600) / 60;
+                ss = (ns % 60);
+                av_log(NULL, AV_LOG_INFO,
+                    "Seek to %2.0f%% (%2d:%02d:%02d) of total duration (%2d:%02d:%02d)       \n", frac * 100,
+                    hh, mm, ss, thh, tmm, tss);
+                ts = frac * cur_stream->ic->duration;
+                if (cur_stream->ic->start_time != AV_NOPTS_VALUE)
+                    ts += cur_stream->ic->start_time;
+                stream_seek(cur_stream, ts, 0, 0);
+            }
+            break;
+        case SDL_WINDOWEVENT:
+            switch (event.window.event) {
+            case SDL_WINDOWEVENT_SIZE_CHANGED:
+                screen_width = cur_stream->width = event.window.data1;
+                screen_height = cur_stream->height = event.window.data2;
+                if (cur_stream->vis_texture) {
+                    SDL_DestroyTexture(cur_stream->vis_texture);
+                    cur_stream->vis_texture = NULL;
+                }
+            case SDL_WINDOWEVENT_EXPOSED:
+                cur_stream->force_refresh = 1;
+            }
+            break;
+        case SDL_QUIT:
+        case FF_QUIT_EVENT:
+            do_exit(cur_stream);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static int opt_frame_size(void* optctx, const char* opt, const char* arg)
+{
+    av_log(NULL, AV_LOG_WARNING, "Option -s is deprecated, use -video_size.\n");
+    return opt_default(NULL, "video_size", arg);
+}
+
+static int opt_width(void* optctx, const char* opt, const char* arg)
+{
+    screen_width = parse_number_or_die(opt, arg, OPT_INT64, 1, INT_MAX);
+    return 0;
+}
+
+static int opt_height(void* optctx, const char* opt, const char* arg)
+{
+    screen_height = parse_number_or_die(opt, arg, OPT_INT64, 1, INT_MAX);
+    return 0;
+}
+
+static int opt_format(void* optctx, const char* opt, const char* arg)
+{
+    file_iformat = av_find_input_format(arg);
+    if (!file_iformat) {
+        av_log(NULL, AV_LOG_FATAL, "Unknown input format: %s\n", arg);
+        return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
+static int opt_frame_pix_fmt(void* optctx, const char* opt, const char* arg)
+{
+    av_log(NULL, AV_LOG_WARNING, "Option -pix_fmt is deprecated, use -pixel_format.\n");
+    return opt_default(NULL, "pixel_format", arg);
+}
+
+static int opt_sync(void* optctx, const char* opt, const char* arg)
+{
+    if (!strcmp(arg, "audio"))
+        av_sync_type = AV_SYNC_AUDIO_MASTER;
+    else if (!strcmp(arg, "video"))
+        av_sync_type = AV_SYNC_VIDEO_MASTER;
+    else if (!strcmp(arg, "ext"))
+        av_sync_type = AV_SYNC_EXTERNAL_CLOCK;
+    else {
+        av_log(NULL, AV_LOG_ERROR, "Unknown value for %s: %s\n", opt, arg);
+        exit(1);
+    }
+    return 0;
+}
+
+static int opt_seek(void* optctx, const char* opt, const char* arg)
+{
+    start_time = parse_time_or_die(opt, arg, 1);
+    return 0;
+}
+
+static int opt_duration(void* optctx, const char* opt, const char* arg)
+{
+    duration = parse_time_or_die(opt, arg, 1);
+    return 0;
+}
+
+static int opt_show_mode(void* optctx, const char* opt, const char* arg)
+{
+    show_mode = !strcmp(arg, "video") ? FMediaPlayer::EShowMode::SHOW_MODE_VIDEO :
+        !strcmp(arg, "waves") ? FMediaPlayer::EShowMode::SHOW_MODE_WAVES :
+        !strcmp(arg, "rdft") ? FMediaPlayer::EShowMode::SHOW_MODE_RDFT : FMediaPlayer::EShowMode(int(parse_number_or_die(opt, arg, OPT_INT, 0, double(int(FMediaPlayer::EShowMode::SHOW_MODE_NB) - 1))));
+    return 0;
+}
+
+static void opt_input_file(void* optctx, const char* filename)
+{
+    if (input_filename) {
+        av_log(NULL, AV_LOG_FATAL,
+            "Argument '%s' provided as input filename, but '%s' was already specified.\n",
+            filename, input_filename);
+        exit(1);
+    }
+    if (!strcmp(filename, "-"))
+        filename = "pipe:";
+    input_filename = filename;
+}
+
+static int opt_codec(void* optctx, const char* opt, const char* arg)
+{
+    const char* spec = strchr(opt, ':');
+    if (!spec) {
+        av_log(NULL, AV_LOG_ERROR,
+            "No media specifier was specified in '%s' in option '%s'\n",
+            arg, opt);
+        return AVERROR(EINVAL);
+    }
+    spec++;
+    switch (spec[0]) {
+    case 'a':    audio_codec_name = arg; break;
+    case 's': subtitle_codec_name = arg; break;
+    case 'v':    video_codec_name = arg; break;
+    default:
+        av_log(NULL, AV_LOG_ERROR,
+            "Invalid media specifier '%s' in option '%s'\n", spec, opt);
+        return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
+/* take -sws_flags for the conversions done outside the filter graph too */
+static void init_sws_flags(void)
+{
+    const AVClass* sws_class = sws_get_class();
+    const AVOption* o = av_opt_find(&sws_class, "sws_flags", NULL, 0, AV_OPT_SEARCH_FAKE_OBJ);
+    AVDictionaryEntry* e = av_dict_get(sws_dict, "sws_flags", NULL, 0);
+    int flags;
+
+    if (!e)
+        e = av_dict_get(sws_dict, "flags", NULL, 0);
+    if (e && o && av_opt_eval_flags(&sws_class, o, e->value, &flags) >= 0)
+        sws_flags = flags;
+}
+
+static int opt_buffer_time(void* optctx, const char* opt, const char* arg)
+{
+    double* targets = !strncmp(opt, "buffer_min", 10) ? buffer_min_time : buffer_max_time;
+    const char* spec = strchr(opt, ':');
+    double value = parse_number_or_die(opt, arg, OPT_DOUBLE, 0, 24 * 3600);
+
+    /* subtitles are sparse and keep no target unless asked for with :s */
+    if (!spec) {
+        targets[AVMEDIA_TYPE_AUDIO] = targets[AVMEDIA_TYPE_VIDEO] = value;
+        return 0;
+    }
+    spec++;
+    switch (spec[0]) {
+    case 'a': targets[AVMEDIA_TYPE_AUDIO]    = value; break;
+    case 's': targets[AVMEDIA_TYPE_SUBTITLE] = value; break;
+    case 'v': targets[AVMEDIA_TYPE_VIDEO]    = value; break;
+    default:
+        av_log(NULL, AV_LOG_ERROR,
+            "Invalid media specifier '%s' in option '%s'\n", spec, opt);
+        return AVERROR(EINVAL);
+    }
+    return 0;
+}
+
+typedef struct PacketQueueBench {
+    PacketQueue q;
+    int64_t nb_packets;
+} PacketQueueBench;
+
+static int packet_queue_bench_consumer(void* arg)
+{
+    PacketQueueBench* b = static_cast<PacketQueueBench*>(arg);
+    AVPacket pkt;
+    int64_t n = 0;
+
+    while (n < b->nb_packets) {
+        if (packet_queue_get(&b->q, &pkt, 1, NULL) < 0)
+            return -1;
+        if (pkt.data != flush_pkt.data)
+            n++;
+    }
+    return 0;
+}
+
+/* push nb_packets empty packets from this thread to a consumer thread */
+static int packet_queue_bench_run(int ring_size, int64_t nb_packets, double* rate)
+{
+    PacketQueueBench b;
+    SDL_Thread* consumer;
+    int64_t i, t;
+    int ret;
+
+    b.nb_packets = nb_packets;
+    if ((ret = packet_queue_init(&b.q, ring_size)) < 0)
+        goto end;
+    packet_queue_start(&b.q);
+
+    t = av_gettime_relative();
+    consumer = SDL_CreateThread(packet_queue_bench_consumer, "pktq_bench", &b);
+    if (!consumer) {
+        av_log(NULL, AV_LOG_ERROR, "SDL_CreateThread(): %s\n", SDL_GetError());
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    for (i = 0; i < nb_packets; i++) {
+        AVPacket pkt;
+        av_init_packet(&pkt);
+        pkt.data = NULL;
+        pkt.size = 0;
+        pkt.duration = 1;
+        packet_queue_put(&b.q, &pkt);
+    }
+    SDL_WaitThread(consumer, &ret);
+    t = av_gettime_relative() - t;
+    *rate = nb_packets * 1000000.0 / FFMAX(t, 1);
+
+end:
+    packet_queue_abort(&b.q);
+    packet_queue_destroy(&b.q);
+    return ret;
+}
+
+/* run by main() once all options are parsed, so that -pktq_ring applies wherever it is given */
+static int packet_queue_bench(int64_t nb_packets)
+{
+    int ring_size = packet_ring_size > 0 ? packet_ring_size : 256;
+    double list_rate, ring_rate;
+
+    av_init_packet(&flush_pkt);
+    flush_pkt.data = (uint8_t*)&flush_pkt;
+
+    if (packet_queue_bench_run(0, nb_packets, &list_rate) < 0 ||
+        packet_queue_bench_run(ring_size, nb_packets, &ring_rate) < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Packet queue benchmark failed\n");
+        return AVERROR(EINVAL);
+    }
+    av_log(NULL, AV_LOG_INFO, "Packet queue: %" PRId64 " packets, linked list %.0f packets/s, ring of %d %.0f packets/s\n",
+        nb_packets, list_rate, ring_size, ring_rate);
+    return 0;
+}
+
+static int dummy;
+
+static const OptionDef options[] = {
+    //CMDUTILS_COMMON_OPTIONS
+    { "x", HAS_ARG, /*{.func_arg = */opt_width/* }*/, "force displayed width", "width" },
+    { "y", HAS_ARG, /*{.func_arg = */opt_height/* }*/, "force displayed height", "height" },
+    { "s", HAS_ARG | OPT_VIDEO,/* {.func_arg = */opt_frame_size/* }*/, "set frame size (WxH or abbreviation)", "size" },
+    { "fs", OPT_BOOL, { &is_full_screen }, "force full screen" },
+    { "an", OPT_BOOL, { &audio_disable }, "disable audio" },
+    { "vn", OPT_BOOL, { &video_disable }, "disable video" },
+    { "sn", OPT_BOOL, { &subtitle_disable }, "disable subtitling" },
+    { "ast", OPT_STRING | HAS_ARG | OPT_EXPERT, { &wanted_stream_spec[AVMEDIA_TYPE_AUDIO] }, "select desired audio stream", "stream_specifier" },
+    { "vst", OPT_STRING | HAS_ARG | OPT_EXPERT, { &wanted_stream_spec[AVMEDIA_TYPE_VIDEO] }, "select desired video stream", "stream_specifier" },
+    { "sst", OPT_STRING | HAS_ARG | OPT_EXPERT, { &wanted_stream_spec[AVMEDIA_TYPE_SUBTITLE] }, "select desired subtitle stream", "stream_specifier" },
+    { "ss", HAS_ARG, /*{.func_arg = */opt_seek/* }*/, "seek to a given position in seconds", "pos" },
+    { "t", HAS_ARG, /*{.func_arg = */opt_duration/* }*/, "play  \"duration\" seconds of audio/video", "duration" },
+    { "bytes", OPT_INT | HAS_ARG, { &seek_by_bytes }, "seek by bytes 0=off 1=on -1=auto", "val" },
+    { "seek_interval", OPT_FLOAT | HAS_ARG, { &seek_interval }, "set seek interval for left/right keys, in seconds", "seconds" },
+    { "nodisp", OPT_BOOL, { &display_disable }, "disable graphical display" },
+    { "noborder", OPT_BOOL, { &borderless }, "borderless window" },
+    { "alwaysontop", OPT_BOOL, { &alwaysontop }, "window always on top" },
+    { "volume", OPT_INT | HAS_ARG, { &startup_volume}, "set startup volume 0=min 100=max", "volume" },
+    { "f", HAS_ARG,/* {.func_arg = */opt_format/* }*/, "force format", "fmt" },
+    { "pix_fmt", HAS_ARG | OPT_EXPERT | OPT_VIDEO, /*{.func_arg = */opt_frame_pix_fmt/* }*/, "set pixel format", "format" },
+    { "stats", OPT_BOOL | OPT_EXPERT, { &show_status }, "show status", "" },
+    { "fast", OPT_BOOL | OPT_EXPERT, { &fast }, "non spec compliant optimizations", "" },
+    { "genpts", OPT_BOOL | OPT_EXPERT, { &genpts }, "generate pts", "" },
+    { "drp", OPT_INT | HAS_ARG | OPT_EXPERT, { &decoder_reorder_pts }, "let decoder reorder pts 0=off 1=on -1=auto", ""},
+    { "lowres", OPT_INT | HAS_ARG | OPT_EXPERT, { &lowres }, "", "" },
+    { "sync", HAS_ARG | OPT_EXPERT,/* {.func_arg = */opt_sync/* }*/, "set audio-video sync. type (type=audio/video/ext)", "type" },
+    { "autoexit", OPT_BOOL | OPT_EXPERT, { &autoexit }, "exit at the end", "" },
+    { "exitonkeydown", OPT_BOOL | OPT_EXPERT, { &exit_on_keydown }, "exit on key down", "" },
+    { "exitonmousedown", OPT_BOOL | OPT_EXPERT, { &exit_on_mousedown }, "exit on mouse down", "" },
+    { "loop", OPT_INT | HAS_ARG | OPT_EXPERT, { &loop }, "set number of times the playback shall be looped", "loop count" },
+    { "framedrop", OPT_BOOL | OPT_EXPERT, { &framedrop }, "drop frames when cpu is too slow", "" },
+    { "infbuf", OPT_BOOL | OPT_EXPERT, { &infinite_buffer }, "don't limit the input buffer size (useful with realtime streams)", "" },
+    { "window_title", OPT_STRING | HAS_ARG, { &window_title }, "set window title", "window title" },
+    { "left", OPT_INT | HAS_ARG | OPT_EXPERT, { &screen_left }, "set the x position for the left of the window", "x pos" },
+    { "top", OPT_INT | HAS_ARG | OPT_EXPERT, { &screen_top }, "set the y position for the top of the window", "y pos" },
+#if CONFIG_AVFILTER
+    { "vf", OPT_EXPERT | HAS_ARG, {.func_arg = opt_add_vfilter }, "set video filters", "filter_graph" },
+    { "af", OPT_STRING | HAS_ARG, { &afilters }, "set audio filters", "filter_graph" },
+#endif
+    { "rdftspeed", OPT_INT | HAS_ARG | OPT_AUDIO | OPT_EXPERT, { &rdftspeed }, "rdft speed", "msecs" },
+    { "showmode", HAS_ARG, /*{.func_arg = */opt_show_mode/*}*/, "select show mode (0 = video, 1 = waves, 2 = RDFT)", "mode" },
+    { "default", HAS_ARG | OPT_AUDIO | OPT_VIDEO | OPT_EXPERT, /*{.func_arg = */opt_default/* }*/, "generic catch all option", "" },
+    { "i", OPT_BOOL, { &dummy}, "read specified file", "input_file"},
+    { "codec", HAS_ARG,/* {.func_arg = */opt_codec/*}*/, "force decoder", "decoder_name" },
+    { "acodec", HAS_ARG | OPT_STRING | OPT_EXPERT, {    &audio_codec_name }, "force audio decoder",    "decoder_name" },
+    { "scodec", HAS_ARG | OPT_STRING | OPT_EXPERT, { &subtitle_codec_name }, "force subtitle decoder", "decoder_name" },
+    { "vcodec", HAS_ARG | OPT_STRING | OPT_EXPERT, {    &video_codec_name }, "force video decoder",    "decoder_name" },
+    { "autorotate", OPT_BOOL, { &autorotate }, "automatically rotate video", "" },
+    { "find_stream_info", OPT_BOOL | OPT_INPUT | OPT_EXPERT, { &find_stream_info },
+        "read and decode the streams to fill missing information with heuristics" },
+    { "filter_threads", HAS_ARG | OPT_INT | OPT_EXPERT, { &filter_nbthreads }, "number of filter threads per graph" },
+    { "buffer_min", HAS_ARG | OPT_EXPERT, /*{.func_arg = */opt_buffer_time/* }*/, "resume reading once a stream has less than this buffered, per type with :a or :v, subtitles only with :s", "seconds" },
+    { "buffer_max", HAS_ARG | OPT_EXPERT, /*{.func_arg = */opt_buffer_time/* }*/, "stop reading once every audio and video stream has this much buffered (0 for no target), per type with :a or :v, subtitles only with :s", "seconds" },
+    { "buffer_bytes", HAS_ARG | OPT_INT64 | OPT_EXPERT, { &max_queue_size }, "hard limit on the total size of buffered packets", "bytes" },
+    { "spill_size", HAS_ARG | OPT_INT64 | OPT_EXPERT, { &spill_size }, "keep at most this many bytes of packets in memory per stream and spill the rest to a file, 0 to disable", "bytes" },
+    { "spill_dir", HAS_ARG | OPT_STRING | OPT_EXPERT, { &spill_dir }, "directory for packet spill files instead of the system temporary directory", "directory" },
+    { "pictq_size", HAS_ARG | OPT_INT | OPT_EXPERT, { &pictq_size }, "initial and minimum number of queued pictures", "pictures" },
+    { "pictq_max", HAS_ARG | OPT_INT | OPT_EXPERT, { &pictq_max }, "maximum number of queued pictures, equal to pictq_size for a fixed depth", "pictures" },
+    { "pictq_bytes", HAS_ARG | OPT_INT64 | OPT_EXPERT, { &pictq_bytes }, "memory budget for queued pictures", "bytes" },
+    { "cpu_compose", HAS_ARG | OPT_INT | OPT_EXPERT, { &cpu_compose }, "draw pictures and subtitles on the CPU instead of with the renderer, -1 when the renderer is not accelerated", "" },
+    { "convert_threads", HAS_ARG | OPT_INT | OPT_EXPERT, { &convert_threads }, "threads converting pictures with swscale, 0 for one per CPU", "count" },
+    { "texture_ring", HAS_ARG | OPT_INT | OPT_EXPERT, { &texture_ring_size }, "number of textures pictures are uploaded to ahead of display, 1 to upload when due", "count" },
+    { "tonemap", OPT_BOOL | OPT_EXPERT, { &tonemap }, "tone map PQ and HLG video to SDR when reducing it to 8 bits", "" },
+    { "tonemap_peak", OPT_DOUBLE | HAS_ARG | OPT_EXPERT, { &tonemap_peak }, "luminance in cd/m2 shown as SDR white when tone mapping", "nits" },
+    { "downscale", OPT_BOOL | OPT_EXPERT, { &downscale }, "halve pictures much larger than the window before uploading them", "" },
+    { "repack", OPT_BOOL | OPT_EXPERT, { &repack }, "repack 4:2:2 planar video to YUYV and decimate 4:4:4 chroma instead of converting them to RGB", "" },
+    { "hbd_convert", OPT_BOOL | OPT_EXPERT, { &hbd_convert }, "reduce 10 to 16-bit 4:2:0 YUV to 8 bits instead of converting it to RGB", "" },
+    { "hbd_dither", OPT_BOOL | OPT_EXPERT, { &hbd_dither }, "use ordered dithering when reducing high bit depth video, rounding otherwise", "" },
+    { "decoder_convert", OPT_BOOL | OPT_EXPERT, { &decoder_convert }, "convert pictures without a matching texture format on the video thread instead of at display time", "" },
+    { "frame_pool", OPT_BOOL | OPT_EXPERT, { &frame_pool }, "decode video into player-owned recycled buffers", "" },
+    { "text_subs", OPT_BOOL | OPT_EXPERT, { &text_subs }, "render text and ASS subtitles with the built-in font", "" },
+    { "huge_pages", OPT_BOOL | OPT_EXPERT, { &huge_pages }, "back video frame buffers with huge pages when the system allows it", "" },
+    { "pktq_ring", HAS_ARG | OPT_INT | OPT_EXPERT, { &packet_ring_size }, "use lock-free rings of this many packets (rounded up to a power of two) as packet queues, 0 for linked lists", "packets" },
+    { "pktq_bench", HAS_ARG | OPT_INT64 | OPT_EXPERT, { &pktq_bench }, "benchmark the ring packet queue against the linked list one with this many packets and exit", "packets" },
+    { NULL, },
+};
+
+static void show_usage(void)
+{
+    av_log(NULL, AV_LOG_INFO, "Simple media player\n");
+    av_log(NULL, AV_LOG_INFO, "usage: %s [options] input_file\n", program_name);
+    av_log(NULL, AV_LOG_INFO, "\n");
+}
+
+void show_help_default(const char* opt, const char* arg)
+{
+    av_log_set_callback(log_callback_help);
+    show_usage();
+    show_help_options(options, "Main options:", 0, OPT_EXPERT, 0);
+    show_help_options(options, "Advanced options:", OPT_EXPERT, 0, 0);
+    printf("\n");
+    show_help_children(avcodec_get_class(), AV_OPT_FLAG_DECODING_PARAM);
+    show_help_children(avformat_get_class(), AV_OPT_FLAG_DECODING_PARAM);
+#if !CONFIG_AVFILTER
+    show_help_children(sws_get_class(), AV_OPT_FLAG_ENCODING_PARAM);
+#else
+    show_help_children(avfilter_get_class(), AV_OPT_FLAG_FILTERING_PARAM);
+#endif
+    printf("\nWhile playing:\n"
+        "q, ESC              quit\n"
+        "f                   toggle full screen\n"
+        "p, SPC              pause\n"
+        "m                   toggle mute\n"
+        "9, 0                decrease and increase volume respectively\n"
+        "/, *                decrease and increase volume respectively\n"
+        "a                   cycle audio channel in the current program\n"
+        "v                   cycle video channel\n"
+        "t                   cycle subtitle channel in the current program\n"
+        "c                   cycle program\n"
+        "w                   cycle video filters or show modes\n"
+        "s                   activate frame-step mode\n"
+        "i                   log queue statistics\n"
+        "left/right          seek backward/forward 10 seconds or to custom interval if -seek_interval is set\n"
+        "down/up             seek backward/forward 1 minute\n"
+        "page down/page up   seek backward/forward 10 minutes\n"
+        "right mouse click   seek to percentage in file corresponding to fraction of width\n"
+        "left double-click   toggle full screen\n"
+    );
+}
+
+/* Called from the main */
+int main(int argc, char** argv)
+{
+    int flags;
+    FMediaPlayer* is;
+
+    init_dynload();
+
+    av_log_set_flags(AV_LOG_SKIP_REPEATED);
+    parse_loglevel(argc, argv, options);
+
+    /* register all codecs, demux and protocols */
+#if CONFIG_AVDEVICE
+    avdevice_register_all();
+#endif
+    avformat_network_init();
+
+    init_opts();
+
+    signal(SIGINT, sigterm_handler); /* Interrupt (ANSI).    */
+    signal(SIGTERM, sigterm_handler); /* Termination (ANSI).  */
+
+    show_banner(argc, argv, options);
+
+    parse_options(NULL, argc, argv, options, opt_input_file);
+    init_sws_flags();
+
+    if (pktq_bench > 0)
+        exit(packet_queue_bench(FFMIN(pktq_bench, INT_MAX)) < 0);
+
+    if (!input_filename) {
+        show_usage();
+        av_log(NULL, AV_LOG_FATAL, "An input file must be specified\n");
+        av_log(NULL, AV_LOG_FATAL,
+            "Use -h to get full help or, even better, run 'man %s'\n", program_name);
+        exit(1);
+    }
+
+    if (display_disable) {
+        video_disable = 1;
+    }
+    flags = SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER;
+    if (audio_disable)
+        flags &= ~SDL_INIT_AUDIO;
+    else {
+        /* Try to work around an occasional ALSA buffer underflow issue when the
+         * period size is NPOT due to ALSA resampling by forcing the buffer size. */
+        if (!SDL_getenv("SDL_AUDIO_ALSA_SET_BUFFER_SIZE"))
+            SDL_setenv("SDL_AUDIO_ALSA_SET_BUFFER_SIZE", "1", 1);
+    }
+    if (display_disable)
+        flags &= ~SDL_INIT_VIDEO;
+    if (SDL_Init(flags)) {
+        av_log(NULL, AV_LOG_FATAL, "Could not initialize SDL - %s\n", SDL_GetError());
+        av_log(NULL, AV_LOG_FATAL, "(Did you set the DISPLAY variable?)\n");
+        exit(1);
+    }
+
+    SDL_EventState(SDL_SYSWMEVENT, SDL_IGNORE);
+    SDL_EventState(SDL_USEREVENT, SDL_IGNORE);
+
+    av_init_packet(&flush_pkt);
+    flush_pkt.data = (uint8_t*)&flush_pkt;
+
+    if (!display_disable) {
+        int flags = SDL_WINDOW_HIDDEN;
+        if (alwaysontop)
+#if SDL_VERSION_ATLEAST(2,0,5)
+            flags |= SDL_WINDOW_ALWAYS_ON_TOP;
+#else
+            av_log(NULL, AV_LOG_WARNING, "Your SDL version doesn't support SDL_WINDOW_ALWAYS_ON_TOP. Feature will be inactive.\n");
+#endif
+        if (borderless)
+            flags |= SDL_WINDOW_BORDERLESS;
+        else
+            flags |= SDL_WINDOW_RESIZABLE;
+        window = SDL_CreateWindow(program_name, SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, default_width, default_height, flags);
+        SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "linear");
+        if (window) {
+            renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+            if (!renderer) {
+                av_log(NULL, AV_LOG_WARNING, "Failed to initialize a hardware accelerated renderer: %s\n", SDL_GetError());
+                renderer = SDL_CreateRenderer(window, -1, 0);
+            }
+            if (renderer) {
+                if (!SDL_GetRendererInfo(renderer, &renderer_info))
+                    av_log(NULL, AV_LOG_VERBOSE, "Initialized %s renderer.\n", renderer_info.name);
+                if (cpu_compose < 0)
+                    cpu_compose = !(renderer_info.flags & SDL_RENDERER_ACCELERATED);
+                if (cpu_compose)
+                    av_log(NULL, AV_LOG_VERBOSE, "Compositing pictures and subtitles on the CPU.\n");
+            }
+        }
+        if (!window || !renderer || !renderer_info.num_texture_formats) {
+            av_log(NULL, AV_LOG_FATAL, "Failed to create window or renderer: %s", SDL_GetError());
+            do_exit(NULL);
+        }
+    }
+
+    is = stream_open(input_filename, file_iformat);
+    if (!is) {
+        av_log(NULL, AV_LOG_FATAL, "Failed to initialize VideoState!\n");
+        do_exit(NULL);
+    }
+
+    event_loop(is);
+
+    /* never returns */
+
+    return 0;
+}